@@ -0,0 +1,186 @@
+// AppendOnlyVector.h
+
+// Declares the AppendOnlyVector class template representing a growable array that can be read while being appended to
+
+
+
+
+
+#ifndef APPENDONLYVECTOR_H
+#define APPENDONLYVECTOR_H
+
+
+
+
+
+#include <assert.h>
+#include <atomic>
+#include <new>
+#include <utility>
+
+#ifdef _MSC_VER
+	#include <intrin.h>
+#endif
+
+
+
+
+
+/** A growable array of items, appended to by a single (writer) thread and readable by other threads at the same time.
+Unlike in std::vector, the items never move once added. The storage is a sequence of segments, each twice as big
+as the previous one, so an item's segment is given by the highest set bit of its index and the segments themselves
+never need to be reallocated.
+The writer makes the items added so far visible to the other threads by calling publish(). The readers may only
+access the items below publishedSize(); the writer must not modify those anymore. */
+template <typename T>
+class AppendOnlyVector
+{
+public:
+
+	/** The number of items in the first segment, as a power of two. */
+	static const unsigned FIRST_SEGMENT_BITS = 10;
+
+	/** The maximum number of segments, limits the capacity to ((2 ^ MAX_SEGMENTS) - 1) << FIRST_SEGMENT_BITS items. */
+	static const unsigned MAX_SEGMENTS = 32;
+
+
+	AppendOnlyVector():
+		m_Size(0),
+		m_PublishedSize(0)
+	{
+		for (auto & segment: m_Segments)
+		{
+			segment = nullptr;
+		}
+	}
+
+	AppendOnlyVector(const AppendOnlyVector &) = delete;
+	AppendOnlyVector & operator = (const AppendOnlyVector &) = delete;
+
+	~AppendOnlyVector()
+	{
+		clear();
+	}
+
+
+	/** Constructs a new item at the end of the array. To be called only from the writer thread. */
+	template <typename... Args>
+	void emplace_back(Args &&... a_Args)
+	{
+		unsigned segment;
+		size_t offset;
+		locate(m_Size, segment, offset);
+		if (offset == 0)
+		{
+			// Starting a new segment:
+			assert(segment < MAX_SEGMENTS);
+			m_Segments[segment] = static_cast<T *>(::operator new(segmentSize(segment) * sizeof(T)));
+		}
+		new (m_Segments[segment] + offset) T(std::forward<Args>(a_Args)...);
+		m_Size += 1;
+	}
+
+	/** Moves the specified item to the end of the array. To be called only from the writer thread. */
+	void push_back(T && a_Item)
+	{
+		emplace_back(std::move(a_Item));
+	}
+
+	T & operator [] (size_t a_Index)
+	{
+		unsigned segment;
+		size_t offset;
+		locate(a_Index, segment, offset);
+		return m_Segments[segment][offset];
+	}
+
+	const T & operator [] (size_t a_Index) const
+	{
+		unsigned segment;
+		size_t offset;
+		locate(a_Index, segment, offset);
+		return m_Segments[segment][offset];
+	}
+
+	/** Returns the last item. To be called only from the writer thread, on a non-empty array. */
+	T & back()
+	{
+		assert(m_Size > 0);
+		return (*this)[m_Size - 1];
+	}
+
+	/** Returns the number of items added so far. To be called only from the writer thread. */
+	size_t size() const { return m_Size; }
+
+	/** Returns true if there are no items. To be called only from the writer thread. */
+	bool empty() const { return (m_Size == 0); }
+
+	/** Makes the first a_Count items (and everything they reference) visible to the other threads.
+	The number of published items can only grow. To be called only from the writer thread. */
+	void publish(size_t a_Count)
+	{
+		assert(a_Count <= m_Size);
+		assert(a_Count >= m_PublishedSize.load(std::memory_order_relaxed));
+		m_PublishedSize.store(a_Count, std::memory_order_release);
+	}
+
+	/** Returns the number of items that may be read by the threads other than the writer. Thread-safe. */
+	size_t publishedSize() const { return m_PublishedSize.load(std::memory_order_acquire); }
+
+	/** Removes all the items and frees the memory.
+	To be called only from the writer thread, when no other thread reads the array. */
+	void clear()
+	{
+		for (size_t i = 0; i < m_Size; ++i)
+		{
+			(*this)[i].~T();
+		}
+		for (auto & segment: m_Segments)
+		{
+			::operator delete(segment);
+			segment = nullptr;
+		}
+		m_Size = 0;
+		m_PublishedSize.store(0, std::memory_order_relaxed);
+	}
+
+
+protected:
+
+	/** The segments of the storage, nullptr for the ones not allocated yet.
+	Segment i holds the items from ((2 ^ i) - 1) << FIRST_SEGMENT_BITS, (1 << FIRST_SEGMENT_BITS) << i items. */
+	T * m_Segments[MAX_SEGMENTS];
+
+	/** The number of items added so far. Used only by the writer thread. */
+	size_t m_Size;
+
+	/** The number of items published for the other threads. */
+	std::atomic<size_t> m_PublishedSize;
+
+
+	/** Returns the number of items in the specified segment. */
+	static size_t segmentSize(unsigned a_Segment)
+	{
+		return (static_cast<size_t>(1) << FIRST_SEGMENT_BITS) << a_Segment;
+	}
+
+	/** Returns the segment and the offset within it where the item with the specified index is stored. */
+	static void locate(size_t a_Index, unsigned & a_Segment, size_t & a_Offset)
+	{
+		auto blockNumber = static_cast<unsigned>((a_Index >> FIRST_SEGMENT_BITS) + 1);
+		#ifdef _MSC_VER
+			unsigned long highestBit;
+			_BitScanReverse(&highestBit, blockNumber);
+			a_Segment = static_cast<unsigned>(highestBit);
+		#else
+			a_Segment = 31 - static_cast<unsigned>(__builtin_clz(blockNumber));
+		#endif
+		a_Offset = a_Index - ((((static_cast<size_t>(1) << a_Segment) - 1)) << FIRST_SEGMENT_BITS);
+	}
+};
+
+
+
+
+
+#endif // APPENDONLYVECTOR_H
@@ -7,39 +7,145 @@
 
 
 #include "BackgroundParser.h"
+#include <assert.h>
+#include <algorithm>
 #include <QThread>
 #include <QDir>
 #include <QDebug>
 #include "FileParser.h"
+#include "TextBuffer.h"
 
 
 
 
 
 ////////////////////////////////////////////////////////////////////////////////
-/** Task executed inside BackgroundParser to parse a single file. */
+/** Task executed inside BackgroundParser's CPU stage to parse a single file, already read by FileReadTask. */
 class FileParseTask:
 	public QRunnable
 {
 public:
-	FileParseTask(BackgroundParser & a_BackgroundParser, const QString & a_FileName):
+	FileParseTask(BackgroundParser & a_BackgroundParser, const QString & a_FileName, quint64 a_Generation, TextBufferPtr a_Contents, size_t a_ReadAheadSize):
 		m_FileName(a_FileName),
+		m_Generation(a_Generation),
+		m_Contents(a_Contents),
+		m_ReadAheadSize(a_ReadAheadSize),
 		m_BackgroundParser(a_BackgroundParser)
 	{
 	}
 
 
-	virtual void run()
+	virtual ~FileParseTask() override
+	{
+		// Release the read-ahead space even if the task was removed from the queue without running:
+		m_Contents.reset();
+		m_BackgroundParser.releaseReadAhead(m_ReadAheadSize);
+	}
+
+
+	virtual void run() override
 	{
 		FileParser parser(m_BackgroundParser.m_ShouldAbort);
+		parser.setShouldCompressText(m_BackgroundParser.m_ShouldCompressText.load());
+		// The followed files are parsed eagerly, the header of their last line may be incomplete when decoded lazily:
+		parser.setShouldParseLazily(m_BackgroundParser.m_ShouldParseLazily.load() && !m_BackgroundParser.m_ShouldFollowFiles.load());
+		parser.setGeneration(m_Generation);
 		QObject::connect(&parser, &FileParser::finishedParsingFile, &m_BackgroundParser, &BackgroundParser::finishedParsingFile);
-		parser.parse(m_FileName);
+		QObject::connect(&parser, &FileParser::publishedMessages, &m_BackgroundParser, &BackgroundParser::publishedMessages);
+		QObject::connect(&parser, &FileParser::foundZipEntry, &m_BackgroundParser, &BackgroundParser::addZipEntry, Qt::DirectConnection);
+		parser.parse(m_FileName, m_Contents);
+	}
+
+
+protected:
+
+	QString m_FileName;
+	quint64 m_Generation;
+	TextBufferPtr m_Contents;
+	size_t m_ReadAheadSize;
+	BackgroundParser & m_BackgroundParser;
+};
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+/** Task executed inside BackgroundParser's I/O stage to open a single file and read it ahead into memory.
+Once read, the file is handed over to the CPU stage for parsing. */
+class FileReadTask:
+	public QRunnable
+{
+public:
+	FileReadTask(BackgroundParser & a_BackgroundParser, const QString & a_FileName, quint64 a_Generation):
+		m_FileName(a_FileName),
+		m_Generation(a_Generation),
+		m_BackgroundParser(a_BackgroundParser)
+	{
+	}
+
+
+	virtual void run() override
+	{
+		if (m_BackgroundParser.m_ShouldAbort.load())
+		{
+			return;
+		}
+		auto contents = FileParser::openFile(m_FileName, !m_BackgroundParser.m_ShouldFollowFiles.load());
+		size_t readAheadSize = 0;
+		if (contents != nullptr)
+		{
+			readAheadSize = m_BackgroundParser.reserveReadAhead(contents->size());
+			contents->prefetch(readAheadSize, m_BackgroundParser.m_ShouldAbort);
+		}
+		m_BackgroundParser.m_ThreadPool.start(new FileParseTask(m_BackgroundParser, m_FileName, m_Generation, contents, readAheadSize));
 	}
 
 
 protected:
 
 	QString m_FileName;
+	quint64 m_Generation;
+	BackgroundParser & m_BackgroundParser;
+};
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+/** Task executed inside BackgroundParser to parse a single entry of a ZIP archive. */
+class ZipEntryParseTask:
+	public QRunnable
+{
+public:
+	ZipEntryParseTask(BackgroundParser & a_BackgroundParser, const QString & a_FileName, quint64 a_Generation, ZipArchivePtr a_Archive, size_t a_EntryIndex):
+		m_FileName(a_FileName),
+		m_Generation(a_Generation),
+		m_Archive(a_Archive),
+		m_EntryIndex(a_EntryIndex),
+		m_BackgroundParser(a_BackgroundParser)
+	{
+	}
+
+
+	virtual void run() override
+	{
+		FileParser parser(m_BackgroundParser.m_ShouldAbort);
+		parser.setShouldCompressText(m_BackgroundParser.m_ShouldCompressText.load());
+		parser.setShouldParseLazily(m_BackgroundParser.m_ShouldParseLazily.load());
+		parser.setGeneration(m_Generation);
+		QObject::connect(&parser, &FileParser::finishedParsingFile, &m_BackgroundParser, &BackgroundParser::finishedParsingFile);
+		parser.parseZipEntry(m_FileName, m_Archive, m_EntryIndex);
+	}
+
+
+protected:
+
+	QString m_FileName;
+	quint64 m_Generation;
+	ZipArchivePtr m_Archive;
+	size_t m_EntryIndex;
 	BackgroundParser & m_BackgroundParser;
 };
 
@@ -68,15 +174,9 @@ public:
 
 	void addFolderLogFiles(const QString & a_FolderPath)
 	{
-		static QStringList logFileNameFilters;
-		if (logFileNameFilters.isEmpty())
-		{
-			logFileNameFilters << "*.log" << "*.gz" << "*.txt";
-		}
-
 		QDir folder(a_FolderPath);
 		QStringList res;
-		for (const auto & fileName: folder.entryList(logFileNameFilters, QDir::Files | QDir::Hidden | QDir::System))
+		for (const auto & fileName: folder.entryList(BackgroundParser::logFileNameFilters(), QDir::Files | QDir::Hidden | QDir::System))
 		{
 			m_BackgroundParser.addFile(a_FolderPath + "/" + fileName);
 		}
@@ -100,9 +200,22 @@ protected:
 ////////////////////////////////////////////////////////////////////////////////
 // BackgroundParser:
 
+const size_t BackgroundParser::MAX_READ_AHEAD;
+const int BackgroundParser::NUM_IO_THREADS;
+
+
+
+
+
 BackgroundParser::BackgroundParser():
-	Super(nullptr)
+	Super(nullptr),
+	m_ShouldAbort(false),
+	m_ShouldCompressText(false),
+	m_ShouldParseLazily(false),
+	m_ShouldFollowFiles(false),
+	m_ReadAheadSize(0)
 {
+	m_IOThreadPool.setMaxThreadCount(NUM_IO_THREADS);
 }
 
 
@@ -112,17 +225,30 @@ BackgroundParser::BackgroundParser():
 BackgroundParser::~BackgroundParser()
 {
 	qDebug() << "Aborting all parsers";
+	m_IOThreadPool.clear();
 	m_ThreadPool.clear();
+	QMutexLocker lock(&m_ReadAheadMtx);
 	m_ShouldAbort.store(true);
+	m_ReadAheadFreed.wakeAll();
 }
 
 
 
 
 
-void BackgroundParser::addFile(const QString & a_FileName)
+const QStringList & BackgroundParser::logFileNameFilters()
 {
-	m_ThreadPool.start(new FileParseTask(*this, a_FileName));
+	static const QStringList filters = {"*.log", "*.gz", "*.txt", "*.zip", "*.tar", "*.tgz"};
+	return filters;
+}
+
+
+
+
+
+void BackgroundParser::addFile(const QString & a_FileName, quint64 a_Generation)
+{
+	m_IOThreadPool.start(new FileReadTask(*this, a_FileName, a_Generation));
 }
 
 
@@ -133,3 +259,48 @@ void BackgroundParser::addFolder(const QString & a_FolderPath)
 {
 	m_ThreadPool.start(new FolderParseTask(*this, a_FolderPath));
 }
+
+
+
+
+
+void BackgroundParser::addZipEntry(const QString & a_FileName, quint64 a_Generation, ZipArchivePtr a_Archive, size_t a_EntryIndex)
+{
+	m_ThreadPool.start(new ZipEntryParseTask(*this, a_FileName, a_Generation, a_Archive, a_EntryIndex));
+}
+
+
+
+
+
+size_t BackgroundParser::reserveReadAhead(size_t a_Size)
+{
+	auto size = std::min(a_Size, MAX_READ_AHEAD);
+	QMutexLocker lock(&m_ReadAheadMtx);
+	while ((m_ReadAheadSize > 0) && (m_ReadAheadSize + size > MAX_READ_AHEAD))
+	{
+		if (m_ShouldAbort.load())
+		{
+			return 0;
+		}
+		m_ReadAheadFreed.wait(&m_ReadAheadMtx);
+	}
+	m_ReadAheadSize += size;
+	return size;
+}
+
+
+
+
+
+void BackgroundParser::releaseReadAhead(size_t a_Size)
+{
+	if (a_Size == 0)
+	{
+		return;
+	}
+	QMutexLocker lock(&m_ReadAheadMtx);
+	assert(m_ReadAheadSize >= a_Size);
+	m_ReadAheadSize -= a_Size;
+	m_ReadAheadFreed.wakeAll();
+}
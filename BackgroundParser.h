@@ -17,7 +17,10 @@
 #include <atomic>
 
 #include <QObject>
+#include <QMutex>
+#include <QStringList>
 #include <QThreadPool>
+#include <QWaitCondition>
 
 
 
@@ -25,12 +28,18 @@
 
 // fwd:
 class LogFile;
+class ZipArchive;
 typedef std::shared_ptr<LogFile> LogFilePtr;
+typedef std::shared_ptr<ZipArchive> ZipArchivePtr;
 
 
 
 
 
+/** Parses files in the background, in two stages.
+The I/O stage (a few threads) opens each file and reads it ahead into memory, while the CPU stage (one thread per core)
+decompresses and parses the files that have already been read. The amount of data read ahead but not yet parsed
+is limited by MAX_READ_AHEAD. */
 class BackgroundParser:
 	public QObject
 {
@@ -40,33 +49,100 @@ class BackgroundParser:
 
 public:
 
+	/** The maximum number of bytes read ahead by the I/O stage that haven't been parsed yet.
+	A single file bigger than this is read ahead only partially. */
+	static const size_t MAX_READ_AHEAD = 256 * 1024 * 1024;
+
+	/** The number of threads in the I/O stage. */
+	static const int NUM_IO_THREADS = 2;
+
+
 	BackgroundParser();
 
 	~BackgroundParser();
 
-	/** Adds a file to be parsed in the background. */
-	void addFile(const QString & a_FileName);
+	/** Adds a file to be parsed in the background.
+	a_Generation is given to the LogFiles parsed from the file, see Session::fileGeneration(). */
+	void addFile(const QString & a_FileName, quint64 a_Generation = 0);
 
-	/** Adds a folder to be parsed in the background. */
+	/** Adds a folder to be parsed in the background. Its files are parsed as generation 0, see addFile(). */
 	void addFolder(const QString & a_FolderPath);
 
+	/** Returns the file name patterns of the files that are parsed from the folders. */
+	static const QStringList & logFileNameFilters();
 
-protected:
+	/** Adds a single entry of a ZIP archive (read from the a_FileName disk file of the specified generation,
+	see addFile()) to be parsed in the background. */
+	void addZipEntry(const QString & a_FileName, quint64 a_Generation, ZipArchivePtr a_Archive, size_t a_EntryIndex);
 
-	friend class FileParseTask;  // Needs access to m_ShouldAbort
+	/** Sets whether the text of the files parsed from now on should be kept in memory compressed. */
+	void setShouldCompressText(bool a_ShouldCompressText) { m_ShouldCompressText.store(a_ShouldCompressText); }
 
-	/** The threads that do the actual parsing. */
-	QThreadPool m_ThreadPool;
+	/** Sets whether the files parsed from now on should be parsed lazily (see FileParser::setShouldParseLazily()). */
+	void setShouldParseLazily(bool a_ShouldParseLazily) { m_ShouldParseLazily.store(a_ShouldParseLazily); }
+
+	/** Sets whether the files parsed from now on are to be followed (FileFollower) once parsed.
+	Such files are read into memory instead of being memory-mapped, since they may get truncated by log rotation,
+	and they are never parsed lazily. */
+	void setShouldFollowFiles(bool a_ShouldFollowFiles) { m_ShouldFollowFiles.store(a_ShouldFollowFiles); }
+
+	/** Returns true if the parsed files are to be followed, see setShouldFollowFiles(). */
+	bool shouldFollowFiles() const { return m_ShouldFollowFiles.load(); }
+
+
+protected:
+
+	friend class FileReadTask;       // Needs access to m_ShouldAbort, m_ThreadPool, m_ShouldFollowFiles and the read-ahead accounting
+	friend class FileParseTask;      // Needs access to m_ShouldAbort, the parsing options and the read-ahead accounting
+	friend class ZipEntryParseTask;  // Needs access to m_ShouldAbort and the parsing options
 
 	/** Flag that is shared with all the parsers to indicate they should abort parsing. */
 	std::atomic<bool> m_ShouldAbort;
 
+	/** If true, the parsed files' text is kept in memory compressed. */
+	std::atomic<bool> m_ShouldCompressText;
+
+	/** If true, the plain text logs are parsed lazily, the message headers are decoded only once needed. */
+	std::atomic<bool> m_ShouldParseLazily;
+
+	/** If true, the parsed files are to be followed, see setShouldFollowFiles(). */
+	std::atomic<bool> m_ShouldFollowFiles;
+
+	/** The mutex protecting m_ReadAheadSize. */
+	QMutex m_ReadAheadMtx;
+
+	/** Signalled whenever m_ReadAheadSize decreases, or when aborting. */
+	QWaitCondition m_ReadAheadFreed;
+
+	/** The number of bytes read ahead by the I/O stage whose parsing hasn't finished yet. */
+	size_t m_ReadAheadSize;
+
+	/** The threads that do the actual parsing (the CPU stage). */
+	QThreadPool m_ThreadPool;
+
+	/** The threads that open and read ahead the files to be parsed (the I/O stage).
+	Declared after m_ThreadPool, so that it is destroyed first, while m_ThreadPool can still accept its tasks. */
+	QThreadPool m_IOThreadPool;
+
+
+	/** Reserves space for reading ahead the specified number of bytes.
+	Blocks until the already read-ahead data gets parsed enough to make space, or until aborting.
+	Returns the number of bytes actually reserved (less than requested for files bigger than MAX_READ_AHEAD). */
+	size_t reserveReadAhead(size_t a_Size);
+
+	/** Releases the space reserved by reserveReadAhead(), after the data has been parsed. */
+	void releaseReadAhead(size_t a_Size);
+
 signals:
 
 	/** (Re-emitted from FileParser)
 	Emitted after a single file (out of possibly a multi-file archive) has been parsed successfully. */
 	void finishedParsingFile(LogFilePtr a_Data);
 
+	/** (Re-emitted from FileParser)
+	Emitted while parsing a big file, each time another batch of its messages has been published. */
+	void publishedMessages(LogFilePtr a_LogFile);
+
 public slots:
 };
 
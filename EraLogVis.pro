@@ -38,7 +38,17 @@ SOURCES += \
 	SessionMessagesModel.cpp \
 	Stopwatch.cpp \
 	MessageView.cpp \
-	BackgroundParser.cpp
+	BackgroundParser.cpp \
+	TextBuffer.cpp \
+	ZipArchive.cpp \
+	ParallelInflater.cpp \
+	FileFollower.cpp \
+	FolderWatcher.cpp \
+	MetricExtractor.cpp \
+	MetricPlot.cpp \
+	MetricsDialog.cpp \
+	TokenIndex.cpp \
+	ModuleNames.cpp
 
 HEADERS  += \
 	MainWindow.h \
@@ -50,7 +60,19 @@ HEADERS  += \
 	SessionMessagesModel.h \
 	Stopwatch.h \
 	MessageView.h \
-	BackgroundParser.h
+	BackgroundParser.h \
+	TextBuffer.h \
+	ZipArchive.h \
+	ParallelInflater.h \
+	AppendOnlyVector.h \
+	FileFollower.h \
+	FolderWatcher.h \
+	MetricExtractor.h \
+	MetricPlot.h \
+	MetricsDialog.h \
+	TokenIndex.h \
+	ModuleNames.h \
+	Simd.h
 
 FORMS    += \
 	MainWindow.ui
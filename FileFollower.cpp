@@ -0,0 +1,301 @@
+// FileFollower.cpp
+
+// Implements the FileFollower class that keeps parsing the log files that grow while they are displayed
+
+
+
+
+
+#include "FileFollower.h"
+#include <algorithm>
+#include <vector>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include "FileParser.h"
+#include "LogFile.h"
+
+#ifdef Q_OS_UNIX
+	#include <sys/stat.h>
+#endif
+
+
+
+
+
+/** The number of bytes from the beginning of a followed file used for detecting its format. */
+static const qint64 FORMAT_SAMPLE_SIZE = 4096;
+
+
+
+
+
+/** Returns true if the opened file is still the file at the specified path, false if the path refers to a different
+file, or to none (the opened file has been renamed or removed). */
+static bool isSameFile(QFile & a_File, const QString & a_Path)
+{
+	#ifdef Q_OS_UNIX
+		struct stat openedStat, pathStat;
+		if (
+			(fstat(a_File.handle(), &openedStat) != 0) ||
+			(stat(QFile::encodeName(a_Path).constData(), &pathStat) != 0)
+		)
+		{
+			return false;
+		}
+		return ((openedStat.st_dev == pathStat.st_dev) && (openedStat.st_ino == pathStat.st_ino));
+	#else
+		// No file identity available; a log file only grows, so a file at the path that is smaller is a new one:
+		QFileInfo fi(a_Path);
+		return (fi.exists() && (fi.size() >= a_File.size()));
+	#endif
+}
+
+
+
+
+
+/** Returns true if the opened file still starts with the specified data, false if it starts with something else
+(it has been truncated and written anew) or cannot be read. */
+static bool startsWith(QFile & a_File, const QByteArray & a_Head)
+{
+	if (a_Head.isEmpty())
+	{
+		return true;
+	}
+	if (!a_File.seek(0))
+	{
+		return false;
+	}
+	return (a_File.read(a_Head.size()) == a_Head);
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// FileFollower:
+
+const int FileFollower::UPDATE_DELAY_MSEC;
+const qint64 FileFollower::MAX_READ_SIZE;
+
+
+
+
+
+FileFollower::FileFollower():
+	m_ShouldAbort(false)
+{
+	m_UpdateTimer.setSingleShot(true);
+	m_UpdateTimer.setInterval(UPDATE_DELAY_MSEC);
+	connect(&m_Watcher,     &QFileSystemWatcher::fileChanged,      this, &FileFollower::fileChanged);
+	connect(&m_Watcher,     &QFileSystemWatcher::directoryChanged, this, &FileFollower::directoryChanged);
+	connect(&m_UpdateTimer, &QTimer::timeout,                      this, &FileFollower::processChanges);
+}
+
+
+
+
+
+FileFollower::~FileFollower()
+{
+}
+
+
+
+
+
+void FileFollower::follow(LogFilePtr a_LogFile)
+{
+	// Only the disk files themselves can be followed, not the archive members:
+	const auto & fileName = a_LogFile->fileName();
+	if (!a_LogFile->innerFileName().isEmpty() || (m_Files.find(fileName) != m_Files.end()))
+	{
+		return;
+	}
+	std::unique_ptr<QFile> f(new QFile(fileName));
+	if (!f->open(QFile::ReadOnly))
+	{
+		return;
+	}
+	auto sample = f->read(FORMAT_SAMPLE_SIZE);
+	std::unique_ptr<FileParser> parser(new FileParser(m_ShouldAbort));
+	if (!parser->startFollowing(a_LogFile, sample.constData(), static_cast<size_t>(sample.size())))
+	{
+		qDebug() << "Cannot follow file " << fileName;
+		return;
+	}
+
+	auto & followed = m_Files[fileName];
+	followed.m_LogFile = a_LogFile;
+	followed.m_File = std::move(f);
+	followed.m_Parser = std::move(parser);
+	const auto & completeText = a_LogFile->getCompleteText();
+	auto headSize = std::min(static_cast<size_t>(FORMAT_SAMPLE_SIZE), completeText.size());
+	std::string helper;
+	followed.m_Pos = static_cast<qint64>(completeText.size());
+	followed.m_Head = QByteArray(completeText.span(0, headSize, helper), static_cast<int>(headSize));
+	m_Watcher.addPath(fileName);
+
+	// Catch up with the data appended since the file was read for parsing:
+	updateFile(fileName);
+}
+
+
+
+
+
+void FileFollower::updateFile(const QString & a_FileName)
+{
+	auto itr = m_Files.find(a_FileName);
+	if (itr == m_Files.end())
+	{
+		return;
+	}
+	auto & followed = itr->second;
+
+	if ((followed.m_File->size() < followed.m_Pos) || !startsWith(*followed.m_File, followed.m_Head))
+	{
+		// The file has been truncated (rotated by copying and truncating), parse it anew once it gets some data.
+		// It may have grown past the parsed position again before the change got processed, hence the head check:
+		stopFollowing(a_FileName);
+		awaitNewFile(a_FileName);
+		return;
+	}
+
+	// Parse whatever has been appended to the opened file, even if it has been renamed away meanwhile:
+	if (!parseAppendedData(followed))
+	{
+		qDebug() << "Failed to parse the data appended to file " << a_FileName;
+		stopFollowing(a_FileName);
+		return;
+	}
+	if (isSameFile(*followed.m_File, a_FileName))
+	{
+		return;
+	}
+
+	// The file has been renamed or removed, the file at the path (if any) is a new one:
+	stopFollowing(a_FileName);
+	awaitNewFile(a_FileName);
+}
+
+
+
+
+
+bool FileFollower::parseAppendedData(FollowedFile & a_File)
+{
+	auto size = a_File.m_File->size();
+	if (size <= a_File.m_Pos)
+	{
+		return true;
+	}
+	if (!a_File.m_File->seek(a_File.m_Pos))
+	{
+		return false;
+	}
+	while (a_File.m_Pos < size)
+	{
+		auto data = a_File.m_File->read(std::min(size - a_File.m_Pos, MAX_READ_SIZE));
+		if (data.isEmpty())
+		{
+			break;
+		}
+		if (!a_File.m_Parser->parseAppendedData(data.constData(), static_cast<size_t>(data.size())))
+		{
+			return false;
+		}
+		a_File.m_Pos += data.size();
+	}
+	emit appendedMessages(a_File.m_LogFile);
+	return true;
+}
+
+
+
+
+
+void FileFollower::stopFollowing(const QString & a_FileName)
+{
+	m_Watcher.removePath(a_FileName);
+	m_Files.erase(a_FileName);
+	m_ChangedFiles.erase(a_FileName);
+	m_AwaitedFiles.erase(a_FileName);
+}
+
+
+
+
+
+void FileFollower::awaitNewFile(const QString & a_FileName)
+{
+	QFileInfo fi(a_FileName);
+	if (fi.exists() && (fi.size() > 0))
+	{
+		m_AwaitedFiles.erase(a_FileName);
+		emit fileReplaced(a_FileName);
+		return;
+	}
+
+	// Watch the empty file for growth, or the folder for the file's creation:
+	m_AwaitedFiles.insert(a_FileName);
+	m_Watcher.addPath(fi.exists() ? a_FileName : fi.absolutePath());
+}
+
+
+
+
+
+void FileFollower::fileChanged(const QString & a_FileName)
+{
+	m_ChangedFiles.insert(a_FileName);
+	if (!m_UpdateTimer.isActive())
+	{
+		m_UpdateTimer.start();
+	}
+}
+
+
+
+
+
+void FileFollower::directoryChanged(const QString & a_Path)
+{
+	// Check the awaited files in the folder, stop watching the folder once none is awaited there:
+	std::vector<QString> awaitedInFolder;
+	for (const auto & fileName: m_AwaitedFiles)
+	{
+		if (QFileInfo(fileName).absolutePath() == a_Path)
+		{
+			awaitedInFolder.push_back(fileName);
+		}
+	}
+	m_Watcher.removePath(a_Path);
+	for (const auto & fileName: awaitedInFolder)
+	{
+		awaitNewFile(fileName);
+	}
+}
+
+
+
+
+
+void FileFollower::processChanges()
+{
+	std::set<QString> changedFiles;
+	std::swap(changedFiles, m_ChangedFiles);
+	for (const auto & fileName: changedFiles)
+	{
+		if (m_AwaitedFiles.find(fileName) != m_AwaitedFiles.end())
+		{
+			awaitNewFile(fileName);
+		}
+		else
+		{
+			updateFile(fileName);
+		}
+	}
+}
@@ -0,0 +1,159 @@
+// FileFollower.h
+
+// Declares the FileFollower class that keeps parsing the log files that grow while they are displayed
+
+
+
+
+
+#ifndef FILEFOLLOWER_H
+#define FILEFOLLOWER_H
+
+
+
+
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <set>
+
+#include <QObject>
+#include <QFileSystemWatcher>
+#include <QTimer>
+
+
+
+
+
+// fwd:
+class QFile;
+class FileParser;
+class LogFile;
+typedef std::shared_ptr<LogFile> LogFilePtr;
+
+
+
+
+
+/** Follows the plain text log files that are still being written to, such as the logs of a live server.
+The files are watched using QFileSystemWatcher (inotify on Linux). When a file grows, only the appended data is read
+and parsed, continuing with the parser's state from where it stopped (see FileParser::startFollowing()), and the new
+messages are added to the file's LogFile.
+When a file is rotated (truncated, detected by its size or by its changed beginning, or renamed and replaced by a new
+file), its LogFile is no longer followed and the
+new file is to be parsed from scratch (fileReplaced()). If there's no new file yet, it is waited for.
+All the work is done in the thread owning the object (the UI thread), which is the thread that reads the LogFiles. */
+class FileFollower:
+	public QObject
+{
+	Q_OBJECT
+	typedef QObject Super;
+
+
+public:
+
+	/** The time for which the changes to the files are collected before they are processed together.
+	Limits the rate of the updates for the files that are written to often. */
+	static const int UPDATE_DELAY_MSEC = 100;
+
+	/** The maximum number of bytes read and parsed at once. */
+	static const qint64 MAX_READ_SIZE = 4 * 1024 * 1024;
+
+
+	FileFollower();
+
+	~FileFollower();
+
+	/** Starts following the disk file from which the specified LogFile has been parsed.
+	The data appended to the file since the LogFile was parsed is processed right away.
+	Does nothing if the file cannot be followed (not a plain text log file, compressed text, already followed). */
+	void follow(LogFilePtr a_LogFile);
+
+	/** Stops following the specified file, its LogFile stays as it is.
+	If the file has been rotated, no longer waits for the new file at its path. */
+	void stopFollowing(const QString & a_FileName);
+
+
+signals:
+
+	/** Emitted after new messages have been added to a followed LogFile. */
+	void appendedMessages(LogFilePtr a_LogFile);
+
+	/** Emitted when a followed file has been rotated and there's a new file at its path, to be parsed (and followed)
+	from scratch. The LogFile of the old file stays, it just isn't followed anymore. */
+	void fileReplaced(const QString & a_FileName);
+
+
+protected:
+
+	/** A single followed file. */
+	struct FollowedFile
+	{
+		/** The LogFile to which the new messages are added. */
+		LogFilePtr m_LogFile;
+
+		/** The disk file, kept open so that the data appended to it can be read even after it is renamed. */
+		std::unique_ptr<QFile> m_File;
+
+		/** The parser that continues parsing the file. */
+		std::unique_ptr<FileParser> m_Parser;
+
+		/** The position in m_File up to which the data has been parsed. */
+		qint64 m_Pos;
+
+		/** The first bytes of the parsed text (up to the format sample size).
+		If m_File no longer starts with them, it has been truncated and written anew (rotated by copying and truncating)
+		even if it has meanwhile grown past m_Pos again. */
+		QByteArray m_Head;
+	};
+
+
+	/** The abort flag for the parsers. Never set, the appended data is parsed synchronously. */
+	std::atomic<bool> m_ShouldAbort;
+
+	/** Watches the followed files, the awaited files and the folders where the awaited files are to appear. */
+	QFileSystemWatcher m_Watcher;
+
+	/** Collects the changes to the files for UPDATE_DELAY_MSEC before processing them. */
+	QTimer m_UpdateTimer;
+
+	/** The followed files, by their disk file name. */
+	std::map<QString, FollowedFile> m_Files;
+
+	/** The names of the files whose changes haven't been processed yet. */
+	std::set<QString> m_ChangedFiles;
+
+	/** The names of the followed files that have been rotated away, and the new file at the path is waited for. */
+	std::set<QString> m_AwaitedFiles;
+
+
+	/** Processes the changes of the specified followed file: parses the appended data and detects the rotation. */
+	void updateFile(const QString & a_FileName);
+
+	/** Reads and parses the data appended to the specified file since the last time.
+	Returns true on success, false if the data cannot be parsed. */
+	bool parseAppendedData(FollowedFile & a_File);
+
+	/** Emits fileReplaced() if there is a non-empty file at the specified path (so that its format can be detected),
+	otherwise watches the file, or its folder, until the file appears. */
+	void awaitNewFile(const QString & a_FileName);
+
+
+protected slots:
+
+	/** Emitted by m_Watcher when a watched file changes (grows, gets truncated, renamed or removed). */
+	void fileChanged(const QString & a_FileName);
+
+	/** Emitted by m_Watcher when a folder where an awaited file is to appear changes. */
+	void directoryChanged(const QString & a_Path);
+
+	/** Emitted by m_UpdateTimer, processes the collected changes. */
+	void processChanges();
+};
+
+
+
+
+
+#endif // FILEFOLLOWER_H
@@ -9,8 +9,18 @@
 #include "FileParser.h"
 
 #include <assert.h>
+#include <deque>
+#include <limits>
+#include <QElapsedTimer>
 #include <QFile>
+#include <QMetaMethod>
+#include <QMutexLocker>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
 #include <QtDebug>
+#include <QtEndian>
 
 #ifdef _MSC_VER
 	// When compiling in MSVC on Windows, use Qt-provided zlib (there's no system-zlib)
@@ -24,6 +34,8 @@
 #include "LogFile.h"
 #include "Stopwatch.h"
 #include "Exceptions.h"
+#include "ParallelInflater.h"
+#include "Simd.h"
 
 
 
@@ -46,990 +58,3381 @@ static std::string readWholeStream(QIODevice & a_DataStream)
 
 
 
-/** Passes the specified data into ungzip, returns everything decompressed.
-Returns an empty string on failure. */
-static std::string ungzipString(const void * a_Data, size_t a_DataSize)
+/** Returns the pointer to the first LF or CR in the specified range, or a_End if there is none.
+Used by the parsers to skip over the message text, which needs no parsing.
+Scans 32 bytes at a time using SSE2, where available. */
+static const char * findEOL(const char * a_Start, const char * a_End)
 {
-	char buf[30000];
-	std::string res;
-	res.reserve(a_DataSize);
+	auto p = a_Start;
+	#ifdef HAS_SSE2
+		auto lf = _mm_set1_epi8('\n');
+		auto cr = _mm_set1_epi8('\r');
+		while (a_End - p >= 32)
+		{
+			auto v0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+			auto v1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16));
+			auto mask0 = static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v0, lf), _mm_cmpeq_epi8(v0, cr))));
+			auto mask1 = static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v1, lf), _mm_cmpeq_epi8(v1, cr))));
+			auto mask = mask0 | (mask1 << 16);
+			if (mask != 0)
+			{
+				return p + lowestSetBit(mask);
+			}
+			p += 32;
+		}
+	#endif
+	while ((p < a_End) && (*p != '\n') && (*p != '\r'))
+	{
+		++p;
+	}
+	return p;
+}
+
+
+
+
+
+/** The Julian day number of the Unix epoch (1970-01-01), for converting QDate to the epoch-based timestamps. */
+static const qint64 JULIAN_DAY_OF_EPOCH = 2440588;
+
+
+
+
+
+/** Returns true if all the bytes of a_Word selected by a_DigitMask (0xff per byte) are ASCII digits. */
+static inline bool areAllDigits(quint64 a_Word, quint64 a_DigitMask)
+{
+	// Bytes that are digits become 0 - 9, adding 0x76 keeps them below 0x80; anything else ends up with the top bit set:
+	auto values = (a_Word ^ 0x3030303030303030ull) & a_DigitMask;
+	return ((((values + 0x7676767676767676ull) | values) & 0x8080808080808080ull & a_DigitMask) == 0);
+}
+
+
+
+
+
+/** Decodes the fixed-width "yyyy-MM-dd HH:mm:ss" timestamp at the start of a_Data (at least 19 bytes available).
+The "yyyy-MM-" and "HH:mm:ss" parts are loaded as two 64-bit words, validated and converted using SWAR arithmetic,
+the day in between is converted separately.
+Returns true on success, false if the data doesn't match the format. The value ranges are not checked. */
+static bool decodeFixedTimestamp(
+	const char * a_Data,
+	int & a_Year, int & a_Month, int & a_Day,
+	int & a_Hour, int & a_Minute, int & a_Second
+)
+{
+	static const quint64 DATE_DIGITS     = 0x00ffff00ffffffffull;  // "yyyy-MM-", little endian
+	static const quint64 DATE_SEPARATORS = 0x2d00002d00000000ull;
+	static const quint64 TIME_DIGITS     = 0xffff00ffff00ffffull;  // "HH:mm:ss", little endian
+	static const quint64 TIME_SEPARATORS = 0x00003a00003a0000ull;
+
+	auto date = qFromLittleEndian<quint64>(a_Data);
+	auto time = qFromLittleEndian<quint64>(a_Data + 11);
+	if (
+		!areAllDigits(date, DATE_DIGITS) || ((date & ~DATE_DIGITS) != DATE_SEPARATORS) ||
+		!areAllDigits(time, TIME_DIGITS) || ((time & ~TIME_DIGITS) != TIME_SEPARATORS) ||
+		(a_Data[8] < '0') || (a_Data[8] > '9') || (a_Data[9] < '0') || (a_Data[9] > '9') || (a_Data[10] != ' ')
+	)
+	{
+		return false;
+	}
+
+	// Combine each pair of adjacent digits into a two-digit number, in the byte of the first digit:
+	date = (date ^ 0x3030303030303030ull) & DATE_DIGITS;
+	time = (time ^ 0x3030303030303030ull) & TIME_DIGITS;
+	date = date * 10 + (date >> 8);
+	time = time * 10 + (time >> 8);
+	a_Year   = static_cast<int>(date & 0xff) * 100 + static_cast<int>((date >> 16) & 0xff);
+	a_Month  = static_cast<int>((date >> 40) & 0xff);
+	a_Day    = (a_Data[8] - '0') * 10 + (a_Data[9] - '0');
+	a_Hour   = static_cast<int>(time & 0xff);
+	a_Minute = static_cast<int>((time >> 24) & 0xff);
+	a_Second = static_cast<int>((time >> 48) & 0xff);
+	return true;
+}
+
+
+
+
+
+#ifdef HAS_SSE2
+/** Packs the 8 nibbles stored in the bytes of a_Word (first nibble in the lowest byte) into a 32-bit number,
+first nibble being the most significant. */
+static inline quint64 packNibbles(quint64 a_Word)
+{
+	a_Word = ((a_Word & 0x00ff00ff00ff00ffull) << 4) | ((a_Word >> 8) & 0x00ff00ff00ff00ffull);
+	a_Word = ((a_Word & 0x0000ffff0000ffffull) << 8) | ((a_Word >> 16) & 0x0000ffff0000ffffull);
+	return ((a_Word & 0xffffffffull) << 16) | (a_Word >> 32);
+}
+
+
+
+
+
+/** Decodes the run of hex digits at the start of a_Data (at least 17 bytes available) using SSE2.
+Returns the number of digits in the run and stores their value into a_Value.
+Returns 0 if there are no digits at the start, or if the run is longer than 16 digits (doesn't fit 64 bits). */
+static size_t decodeHexRun(const char * a_Data, quint64 & a_Value)
+{
+	auto hexMask = hexDigitMask(a_Data);
+	auto numDigits = lowestSetBit(~hexMask);
+	auto next = a_Data[16] | 0x20;
+	if ((numDigits == 0) || ((numDigits == 16) && (((next >= '0') && (next <= '9')) || ((next >= 'a') && (next <= 'f')))))
+	{
+		return 0;
+	}
+
+	// Convert the chars to nibble values (the letters are the hex digits with bit 0x40 set), pack them into the number:
+	auto chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a_Data));
+	auto isLetter = _mm_cmpeq_epi8(_mm_and_si128(chars, _mm_set1_epi8(0x40)), _mm_set1_epi8(0x40));
+	auto nibbles = _mm_add_epi8(
+		_mm_and_si128(chars, _mm_set1_epi8(0x0f)),
+		_mm_and_si128(isLetter, _mm_set1_epi8(9))
+	);
+	quint64 words[2];
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(words), nibbles);
+	if (numDigits < 8)
+	{
+		words[0] &= (1ull << (8 * numDigits)) - 1;
+		words[1] = 0;
+	}
+	else if (numDigits < 16)
+	{
+		words[1] &= (1ull << (8 * (numDigits - 8))) - 1;
+	}
+	a_Value = ((packNibbles(words[0]) << 32) | packNibbles(words[1])) >> (4 * (16 - numDigits));
+	return numDigits;
+}
+#endif
+
+
+
+
+
+/** Makes the contents of the specified (opened) file available as a TextBuffer.
+Memory-maps the file, if possible, so that no copy of the data is made; if mapping fails, reads the
+whole file into memory instead. The returned TextBuffer takes over the ownership of the file. */
+static TextBufferPtr mapWholeFile(std::unique_ptr<QFile> && a_File)
+{
+	auto size = a_File->size();
+	if (size > 0)
+	{
+		auto data = a_File->map(0, size);
+		if (data != nullptr)
+		{
+			return std::make_shared<MappedTextBuffer>(std::move(a_File), data, static_cast<size_t>(size));
+		}
+		qDebug("%s: Cannot map file %s, reading it instead.", __FUNCTION__, a_File->fileName().toUtf8().constData());
+	}
+	return std::make_shared<StringTextBuffer>(readWholeStream(*a_File));
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// TextParser:
+
+/** Interface for the parsers of the plain-text log data.
+The log text is pushed into the parser in blocks, in order, via processBlock(). After the last block,
+finish() is called to process any leftovers and report the parsed LogFile.
+The blocks may be provided as soon as they are available (such as while decompressing), the parser
+keeps all its state between the blocks.
+Archive parsers (TarParser) implement the same interface, passing the data on to the parsers of their members. */
+class TextParser
+{
+public:
+	virtual ~TextParser() {}
+
+	/** Parses the next block of the log text.
+	The blocks, concatenated, must form the complete text stored in the LogFile that is being parsed.
+	Returns true on success, false on failure. */
+	virtual bool processBlock(const char * a_Buf, size_t a_Length) = 0;
+
+	/** Processes any leftover data after the last block and reports the parsed LogFile.
+	Returns true on success, false on failure. */
+	virtual bool finish() = 0;
+};
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// LogTextParser:
+
+/** Interface for the parsers of the plain-text log formats.
+Apart from parsing the complete text, these can parse a part of the text on their own, starting at any message line,
+so that a single big file can be parsed in parallel chunks that are then joined together. */
+class LogTextParser:
+	public TextParser
+{
+public:
+
+	/** The number of new messages after which a progressively publishing parser publishes them. */
+	static const size_t PUBLISH_BATCH_SIZE = 64 * 1024;
+
+	/** The time after which a progressively publishing parser publishes the new messages, even if there are fewer
+	than PUBLISH_BATCH_SIZE of them. */
+	static const qint64 PUBLISH_INTERVAL_MSEC = 100;
+
+	/** The number of the leading grammar fields (the timestamp and the log level) that the lazy parse mode checks
+	to recognize a line starting a new message. */
+	static const int LAZY_NUM_FIELDS = 2;
+
+
+	/** Sets the position within the complete text where the first block passed to processBlock() starts.
+	The position must be the start of a line that begins a new message (not a continuation).
+	To be called before the first processBlock(). */
+	virtual void startAt(size_t a_Pos) = 0;
+
+	/** Processes any leftover data after the last block, but doesn't report the LogFile (unlike finish()).
+	Returns true on success, false on failure. */
+	virtual bool finishChunk() = 0;
+
+	/** Returns the LogFile into which the messages are parsed. */
+	virtual LogFilePtr logFile() const = 0;
+
+	/** Makes the parser publish the messages parsed so far (publishMessages()) in batches of PUBLISH_BATCH_SIZE
+	messages or every PUBLISH_INTERVAL_MSEC, whichever comes first.
+	Only usable if the complete text is already available and won't change (such as a memory-mapped file),
+	because the published messages' text is read by the UI while the parsing continues. */
+	virtual void startPublishingProgressively() = 0;
+
+	/** Publishes the messages parsed so far into the LogFile and reports them via FileParser::publishedMessages(),
+	so that they can be displayed before the whole file is parsed. Does nothing if there's nothing new to publish. */
+	virtual void publishMessages() = 0;
+
+	/** Makes the parser add the messages to the specified, already parsed, LogFile instead of its own one.
+	The blocks passed to processBlock() then continue the LogFile's complete text after its current end, and the lines
+	that don't start a new message are continuations of the LogFile's last message. */
+	virtual void continueLogFile(LogFilePtr a_LogFile) = 0;
+};
+
+const size_t LogTextParser::PUBLISH_BATCH_SIZE;
+const qint64 LogTextParser::PUBLISH_INTERVAL_MSEC;
+const int LogTextParser::LAZY_NUM_FIELDS;
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Log grammar:
+
+/*
+The plain text log formats are described declaratively, as a LogGrammar - a sequence of typed fields that make up
+the header of a line that starts a new message, such as:
+	typedef LogGrammar<TimestampField, LevelLettersField, ThreadIDField<10>, MessageField> Grammar;
+Each field is a struct with a static parse() function that consumes its part of the line from a LogLineCursor and
+stores the parsed value into a ParsedLogLine, or returns false if the line doesn't match. The grammar calls the
+fields' functions in sequence, so the compiler inlines them into a single parsing function specialized for the format.
+A line that the grammar accepts starts a new message, any other line is a continuation of the previous message.
+*/
+
+
+
+
+
+/** The part of a single log line that remains to be parsed by the grammar fields. */
+struct LogLineCursor
+{
+	/** The next character to be parsed. */
+	const char * m_Pos;
+
+	/** The end of the line (its EOL, not included). */
+	const char * m_End;
+
+	/** The end of the readable memory, at or after m_End; vectorized code may read up to here. */
+	const char * m_Limit;
+};
+
+
+
+
+
+/** Translates the loglevel indicator character into the internal loglevel value. */
+static LogFile::LogLevel logLevelFromChar(char a_Indicator)
+{
+	switch (a_Indicator)
+	{
+		case 'f':
+		case 'F':
+		{
+			return LogFile::LogLevel::llFatal;
+		}
+		case 'c':
+		case 'C':
+		{
+			return LogFile::LogLevel::llCritical;
+		}
+		case 'e':
+		case 'E':
+		{
+			return LogFile::LogLevel::llError;
+		}
+		case 'w':
+		case 'W':
+		{
+			return LogFile::LogLevel::llWarning;
+		}
+		case 'i':
+		case 'I':
+		{
+			return LogFile::LogLevel::llInformation;
+		}
+		case 'd':
+		case 'D':
+		{
+			return LogFile::LogLevel::llDebug;
+		}
+		case 't':
+		case 'T':
+		{
+			return LogFile::LogLevel::llTrace;
+		}
+		case 's':
+		case 'S':
+		{
+			return LogFile::LogLevel::llStatus;
+		}
+		default:
+		{
+			return LogFile::LogLevel::llUnknown;
+		}
+	}
+}
+
+
+
+
+
+/** Converts a digit character in the specified radix (10 or 16) to its value.
+Returns true on success, false if the input is not a valid digit in the radix. */
+static inline bool toDigitValue(char a_Char, int a_Radix, quint64 & a_OutValue)
+{
+	if ((a_Char >= '0') && (a_Char <= '9'))
+	{
+		a_OutValue = static_cast<quint64>(a_Char - '0');
+		return true;
+	}
+	if (a_Radix == 16)
+	{
+		if ((a_Char >= 'a') && (a_Char <= 'f'))
+		{
+			a_OutValue = static_cast<quint64>(a_Char - 'a' + 10);
+			return true;
+		}
+		if ((a_Char >= 'A') && (a_Char <= 'F'))
+		{
+			a_OutValue = static_cast<quint64>(a_Char - 'A' + 10);
+			return true;
+		}
+	}
+	return false;
+}
+
+
+
+
+
+/** Consumes the characters up to and including the first a_Char in the rest of the line.
+Returns false if there's no such character. */
+static inline bool skipPast(LogLineCursor & a_Cursor, char a_Char)
+{
+	auto found = static_cast<const char *>(memchr(a_Cursor.m_Pos, a_Char, static_cast<size_t>(a_Cursor.m_End - a_Cursor.m_Pos)));
+	if (found == nullptr)
+	{
+		return false;
+	}
+	a_Cursor.m_Pos = found + 1;
+	return true;
+}
+
+
+
+
+
+/** The values parsed out of a single log line by the grammar fields. */
+struct ParsedLogLine
+{
+	// The timestamp, decoded by the generic path:
+	int m_Year, m_Month, m_Day, m_Hour, m_Minute, m_Second;
+
+	// The timestamp decoded by the fast path, valid only if m_HasMSecs:
+	qint64 m_MSecs;
+	bool m_HasMSecs;
+
+	LogFile::LogLevel m_LogLevel;
+	const char * m_Component;  // Points into the parsed line, m_ComponentLength bytes; interned by LogFile
+	size_t m_ComponentLength;
+	std::string m_SubComponent;
+	quint64 m_ThreadID;
+
+	/** The start of the message text within the line. */
+	const char * m_MessageBegin;
+
+	// One-entry cache of the start of the day of the last timestamp decoded by the fast path, kept between lines:
+	int m_CachedDay;  // yyyyMMdd, -1 if nothing cached yet
+	qint64 m_CachedDayMSecs;
+
+
+	ParsedLogLine():
+		m_CachedDay(-1),
+		m_CachedDayMSecs(0)
+	{
+		reset();
+	}
+
+
+	/** Resets the values before parsing a new line. */
+	void reset()
+	{
+		m_Year = 0;
+		m_Month = 0;
+		m_Day = 0;
+		m_Hour = 0;
+		m_Minute = 0;
+		m_Second = 0;
+		m_HasMSecs = false;
+		m_LogLevel = LogFile::LogLevel::llUnknown;
+		m_Component = nullptr;
+		m_ComponentLength = 0;
+		m_SubComponent.clear();
+		m_ThreadID = 0;
+		m_MessageBegin = nullptr;
+	}
+
+
+	/** Returns the parsed timestamp, in msec since epoch.
+	The timestamps are treated as UTC, so that no time zone conversion is needed.
+	An invalid date (not caught by the grammar) gives the epoch. */
+	qint64 time() const
+	{
+		if (m_HasMSecs)
+		{
+			return m_MSecs;
+		}
+		QDate date(m_Year, m_Month, m_Day);
+		if (!date.isValid())
+		{
+			return 0;
+		}
+		return (date.toJulianDay() - JULIAN_DAY_OF_EPOCH) * 86400 * 1000 + ((m_Hour * 60 + m_Minute) * 60 + m_Second) * 1000;
+	}
+
+
+	/** Fast path for the timestamp: decodes the fixed-width timestamp at a_Line (at least 20 bytes available)
+	and checks the separator after it at once, using the cached start of the day, if possible.
+	Returns false if a_Line doesn't start with a valid timestamp in the usual format. */
+	bool tryDecodeFixedTimestamp(const char * a_Line)
+	{
+		int year, month, day, hour, minute, second;
+		auto separator = a_Line[19];
+		if (
+			((separator >= '0') && (separator <= '9')) ||
+			!decodeFixedTimestamp(a_Line, year, month, day, hour, minute, second) ||
+			(hour > 23) || (minute > 59) || (second > 59)
+		)
+		{
+			return false;
+		}
+		auto dayKey = (year * 100 + month) * 100 + day;
+		if (dayKey != m_CachedDay)
+		{
+			QDate date(year, month, day);
+			if (!date.isValid())
+			{
+				return false;
+			}
+			m_CachedDay = dayKey;
+			m_CachedDayMSecs = (date.toJulianDay() - JULIAN_DAY_OF_EPOCH) * 86400 * 1000;
+		}
+		m_Year = year;
+		m_Month = month;
+		m_Day = day;
+		m_Hour = hour;
+		m_Minute = minute;
+		m_Second = second;
+		m_MSecs = m_CachedDayMSecs + ((hour * 60 + minute) * 60 + second) * 1000;
+		m_HasMSecs = true;
+		return true;
+	}
+};
+
+
+
+
+
+/** Parses a sequence of typed fields, in order; succeeds only if all the fields succeed.
+FirstField is the first field of the sequence (the timestamp), parseLeading() parses only the first few fields,
+both are used by the lazy parse mode. */
+template <typename... Fields>
+struct LogGrammar;
+
+template <>
+struct LogGrammar<>
+{
+	static bool parse(LogLineCursor & a_Cursor, ParsedLogLine & a_Line)
+	{
+		Q_UNUSED(a_Cursor);
+		Q_UNUSED(a_Line);
+		return true;
+	}
+
+	static bool parseLeading(LogLineCursor & a_Cursor, ParsedLogLine & a_Line, int a_NumFields)
+	{
+		Q_UNUSED(a_NumFields);
+		return parse(a_Cursor, a_Line);
+	}
+};
+
+template <typename Field, typename... Rest>
+struct LogGrammar<Field, Rest...>
+{
+	typedef Field FirstField;
+
+	static bool parse(LogLineCursor & a_Cursor, ParsedLogLine & a_Line)
+	{
+		return Field::parse(a_Cursor, a_Line) && LogGrammar<Rest...>::parse(a_Cursor, a_Line);
+	}
+
+	/** Parses only the first a_NumFields fields (or all of them, if there are fewer). */
+	static bool parseLeading(LogLineCursor & a_Cursor, ParsedLogLine & a_Line, int a_NumFields)
+	{
+		if (a_NumFields <= 0)
+		{
+			return true;
+		}
+		return Field::parse(a_Cursor, a_Line) && LogGrammar<Rest...>::parseLeading(a_Cursor, a_Line, a_NumFields - 1);
+	}
+};
+
+
+
+
+
+/** "2017-01-13 04:55:53" and a single separator character after it.
+Also accepts numbers of other widths and other separators, except that the year needs to be followed by a dash. */
+struct TimestampField
+{
+	static bool parse(LogLineCursor & a_Cursor, ParsedLogLine & a_Line)
+	{
+		if ((a_Cursor.m_End - a_Cursor.m_Pos >= 20) && a_Line.tryDecodeFixedTimestamp(a_Cursor.m_Pos))
+		{
+			a_Cursor.m_Pos += 20;
+			return true;
+		}
+		// Generic path, numbers of any width:
+		if (!parseNumber(a_Cursor, a_Line.m_Year) || (*a_Cursor.m_Pos != '-'))
+		{
+			return false;
+		}
+		a_Cursor.m_Pos += 1;
+		return (
+			parseNumberAndSeparator(a_Cursor, a_Line.m_Month) &&
+			parseNumberAndSeparator(a_Cursor, a_Line.m_Day) &&
+			parseNumberAndSeparator(a_Cursor, a_Line.m_Hour) &&
+			parseNumberAndSeparator(a_Cursor, a_Line.m_Minute) &&
+			parseNumberAndSeparator(a_Cursor, a_Line.m_Second)
+		);
+	}
+
+	/** Parses a (possibly empty) decimal number. Returns false if there's no character after it in the line. */
+	static bool parseNumber(LogLineCursor & a_Cursor, int & a_Value)
+	{
+		for (auto & pos = a_Cursor.m_Pos; pos < a_Cursor.m_End; ++pos)
+		{
+			auto ch = *pos;
+			if ((ch < '0') || (ch > '9'))
+			{
+				return true;
+			}
+			a_Value = a_Value * 10 + ch - '0';
+		}
+		return false;
+	}
+
+	/** Parses a (possibly empty) decimal number and the single separator character after it.
+	Returns false if there's no separator in the line. */
+	static bool parseNumberAndSeparator(LogLineCursor & a_Cursor, int & a_Value)
+	{
+		if (!parseNumber(a_Cursor, a_Value))
+		{
+			return false;
+		}
+		a_Cursor.m_Pos += 1;
+		return true;
+	}
+};
+
+
+
+
+
+/** A log level word followed by a space ("Debug: ", "Status: "); the level is given by the word's first character. */
+struct LevelWordField
+{
+	static bool parse(LogLineCursor & a_Cursor, ParsedLogLine & a_Line)
+	{
+		if (a_Cursor.m_Pos == a_Cursor.m_End)
+		{
+			return false;
+		}
+		a_Line.m_LogLevel = logLevelFromChar(*a_Cursor.m_Pos++);
+		return skipPast(a_Cursor, ' ');
+	}
+};
+
+
+
+
+
+/** Log level letter(s) followed by the opening bracket ("T ["). Spaces are ignored, the last letter counts. */
+struct LevelLettersField
+{
+	static bool parse(LogLineCursor & a_Cursor, ParsedLogLine & a_Line)
+	{
+		while (a_Cursor.m_Pos < a_Cursor.m_End)
+		{
+			auto ch = *a_Cursor.m_Pos++;
+			if (ch == '[')
+			{
+				return true;
+			}
+			if (ch != ' ')
+			{
+				a_Line.m_LogLevel = logLevelFromChar(ch);
+			}
+		}
+		return false;
+	}
+};
+
+
+
+
+
+/** The component (module) name followed by a space. */
+struct ComponentField
+{
+	static bool parse(LogLineCursor & a_Cursor, ParsedLogLine & a_Line)
+	{
+		auto begin = a_Cursor.m_Pos;
+		if (!skipPast(a_Cursor, ' '))
+		{
+			return false;
+		}
+		a_Line.m_Component = begin;
+		a_Line.m_ComponentLength = static_cast<size_t>(a_Cursor.m_Pos - 1 - begin);
+		return true;
+	}
+};
+
+
+
+
+
+/** Any word followed by a space, ignored ("[Thread "). */
+struct SkipWordField
+{
+	static bool parse(LogLineCursor & a_Cursor, ParsedLogLine & a_Line)
+	{
+		Q_UNUSED(a_Line);
+		return skipPast(a_Cursor, ' ');
+	}
+};
+
+
+
+
+
+/** The thread ID number in the specified radix (10 or 16), up to the next space (not consumed).
+Only the digits count, any other characters (brackets, punctuation) are ignored. */
+template <int Radix>
+struct ThreadIDField
+{
+	static bool parse(LogLineCursor & a_Cursor, ParsedLogLine & a_Line)
+	{
+		auto & pos = a_Cursor.m_Pos;
+		#ifdef HAS_SSE2
+			// Decode the hex digits at once, the generic loop continues after them:
+			if ((Radix == 16) && (a_Cursor.m_Limit - pos >= 17))
+			{
+				quint64 threadID;
+				auto numDigits = decodeHexRun(pos, threadID);
+				if (numDigits > 0)
+				{
+					a_Line.m_ThreadID = threadID;
+					pos += numDigits;
+				}
+			}
+		#endif
+		for (; pos < a_Cursor.m_End; ++pos)
+		{
+			auto ch = *pos;
+			quint64 v;
+			if (ch == ' ')
+			{
+				return true;
+			}
+			if (toDigitValue(ch, Radix, v))
+			{
+				a_Line.m_ThreadID = a_Line.m_ThreadID * Radix + v;
+			}
+		}
+		return false;
+	}
+};
+
+
+
+
+
+/** A single specific separator character. */
+template <char Separator>
+struct SeparatorField
+{
+	static bool parse(LogLineCursor & a_Cursor, ParsedLogLine & a_Line)
+	{
+		Q_UNUSED(a_Line);
+		if ((a_Cursor.m_Pos == a_Cursor.m_End) || (*a_Cursor.m_Pos != Separator))
+		{
+			return false;
+		}
+		a_Cursor.m_Pos += 1;
+		return true;
+	}
+};
+
+
+
+
+
+/** The optional sub-component tag at the start of the message text ("CStepTx: "), an identifier followed by a colon
+and a space (or the end of the line). Consumes nothing, the tag stays a part of the message text; always succeeds. */
+struct SubComponentField
+{
+	/** The maximum length of the tag; longer identifiers are considered a part of the text. */
+	static const size_t MAX_LENGTH = 64;
+
+	static bool parse(LogLineCursor & a_Cursor, ParsedLogLine & a_Line)
+	{
+		auto begin = a_Cursor.m_Pos;
+		auto end = begin + std::min<size_t>(static_cast<size_t>(a_Cursor.m_End - begin), MAX_LENGTH + 1);
+		if ((begin == end) || !isIdentifierStart(*begin))
+		{
+			return true;
+		}
+		auto p = begin + 1;
+		while ((p < end) && isIdentifierChar(*p))
+		{
+			++p;
+		}
+		if (
+			(p == end) || (*p != ':') ||                                  // No colon, or the identifier is too long
+			((p + 1 < a_Cursor.m_End) && (p[1] != ' '))                   // Not followed by a space ("http://...")
+		)
+		{
+			return true;
+		}
+		a_Line.m_SubComponent.assign(begin, static_cast<size_t>(p - begin));
+		return true;
+	}
+
+	static bool isIdentifierStart(char a_Char)
+	{
+		return (
+			((a_Char >= 'a') && (a_Char <= 'z')) ||
+			((a_Char >= 'A') && (a_Char <= 'Z')) ||
+			(a_Char == '_')
+		);
+	}
+
+	static bool isIdentifierChar(char a_Char)
+	{
+		return (isIdentifierStart(a_Char) || ((a_Char >= '0') && (a_Char <= '9')));
+	}
+};
+
+
+
+
+
+/** The message text, the rest of the line. Needs to be the last field of every grammar. */
+struct MessageField
+{
+	static bool parse(LogLineCursor & a_Cursor, ParsedLogLine & a_Line)
+	{
+		a_Line.m_MessageBegin = a_Cursor.m_Pos;
+		return true;
+	}
+};
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Log formats:
+
+/*
+Each plain text log format is a struct with the following members:
+	- typedef LogGrammar<...> Grammar: the fields of a line that starts a new message; the first field needs to be
+		TimestampField, in the lazy parse mode the lines with a usual timestamp are recognized by the first field alone
+	- static const LogFile::SourceType SOURCE_TYPE: the source type of the parsed files; if stUnknown, the source
+		identification from the file path is used and the type is identified from the messages after parsing
+	- static bool matchesSample(const char * a_Sample, size_t a_SampleSize): returns true if the sample (first N bytes
+		of the data, starting with a valid timestamp) is in this format
+To add a new format, declare it here, add it to FileParser::TextFormat and to the list in FileParser::textFormats().
+*/
+
+
+
+
+
+/** The MDM / VAH format. Typical line:
+2017-01-14 22:45:58 T [29819] mdm message
+The message text includes the space that separates it from the thread ID. */
+struct MDMVAHLogFormat
+{
+	typedef LogGrammar<
+		TimestampField,
+		LevelLettersField,
+		ThreadIDField<10>,
+		MessageField
+	> Grammar;
+
+	static const LogFile::SourceType SOURCE_TYPE = LogFile::SourceType::stMDMVAH;
+
+	static bool matchesSample(const char * a_Sample, size_t a_SampleSize)
+	{
+		// VAH format always has a space as the 21st character
+		return ((a_SampleSize > 21) && (a_Sample[21] == ' '));
+	}
+};
+
+
+
+
+
+/** The ERA format. Typical line:
+2017-01-13 04:55:53 Debug: CReplicationModule [Thread 7f43937fe700]: CStepTx: Remote peer signalized...
+The "CStepTx" tag, if present, is extracted as the message's sub-component. */
+struct EraLogFormat
+{
+	typedef LogGrammar<
+		TimestampField,
+		LevelWordField,
+		ComponentField,
+		SkipWordField,
+		ThreadIDField<16>,
+		SeparatorField<' '>,
+		SubComponentField,
+		MessageField
+	> Grammar;
+
+	static const LogFile::SourceType SOURCE_TYPE = LogFile::SourceType::stUnknown;
+
+	static bool matchesSample(const char * a_Sample, size_t a_SampleSize)
+	{
+		// Any other log starting with a timestamp
+		Q_UNUSED(a_Sample);
+		Q_UNUSED(a_SampleSize);
+		return true;
+	}
+};
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// PlainTextLogParser:
+
+/** Decodes the message headers skipped by PlainTextLogParser in the lazy parse mode, using the same Format. */
+template <typename Format>
+class PlainTextHeaderDecoder:
+	public LogFile::HeaderDecoder
+{
+public:
+
+	// LogFile::HeaderDecoder overrides:
+	virtual void decodeHeader(
+		const char * a_Text, size_t a_Length,
+		LogFile::LogLevel & a_LogLevel,
+		const char *& a_Module, size_t & a_ModuleLength,
+		std::string & a_SubComponent,
+		quint64 & a_ThreadID,
+		size_t & a_HeaderLength
+	) override
+	{
+		auto end = a_Text + a_Length;
+		LogLineCursor cursor = {a_Text, findEOL(a_Text, end), end};
+		m_ParsedLine.reset();
+		if (!Format::Grammar::parse(cursor, m_ParsedLine))
+		{
+			// The line has only been recognized by its timestamp, the rest of the header is malformed.
+			// Keep everything after the timestamp as the message text:
+			cursor.m_Pos = a_Text;
+			m_ParsedLine.reset();
+			Format::Grammar::FirstField::parse(cursor, m_ParsedLine);
+			m_ParsedLine.m_MessageBegin = cursor.m_Pos;
+		}
+		a_LogLevel = m_ParsedLine.m_LogLevel;
+		a_Module = m_ParsedLine.m_Component;
+		a_ModuleLength = m_ParsedLine.m_ComponentLength;
+		a_SubComponent = m_ParsedLine.m_SubComponent;
+		a_ThreadID = m_ParsedLine.m_ThreadID;
+		a_HeaderLength = static_cast<size_t>(m_ParsedLine.m_MessageBegin - a_Text);
+	}
+
+
+protected:
+
+	/** The values parsed from the current header; kept between the calls to reuse the allocated memory. */
+	ParsedLogLine m_ParsedLine;
+};
+
+
+
+
+
+/** Parses log data stream formatted in the plain text log format described by the Format struct (see above).
+The text is split into lines, each line is parsed using Format::Grammar. A line split between two blocks is collected
+in m_PartialLine first, so that the grammar always sees complete lines.
+In the lazy parse mode only the first field of the grammar (the timestamp) is parsed for the usual lines, the rest
+of the header is decoded by PlainTextHeaderDecoder once the LogFile needs it. */
+template <typename Format>
+class PlainTextLogParser:
+	public LogTextParser
+{
+public:
+	PlainTextLogParser(FileParser & a_FileParser, TextBufferPtr a_CompleteText):
+		m_FileParser(a_FileParser),
+		m_LogFile(new LogFile(
+			a_FileParser.m_FileName, a_FileParser.m_InnerFileName,
+			Format::SOURCE_TYPE,
+			(Format::SOURCE_TYPE == LogFile::SourceType::stUnknown) ? a_FileParser.m_SourceIdentification : QString(),
+			a_CompleteText,
+			a_FileParser.m_Generation
+		)),
+		m_BlockStart(0),
+		m_LastEOL(0),
+		m_PartialLineStart(0),
+		m_HasJustFinishedLine(true),
+		m_LinesBeforeAbortCheck(1000),
+		m_IsLazy(a_FileParser.m_ShouldParseLazily),
+		m_IsPublishingProgressively(false),
+		m_HasPublished(false)
+	{
+		if (m_IsLazy)
+		{
+			m_LogFile->setHeaderDecoder(std::unique_ptr<LogFile::HeaderDecoder>(new PlainTextHeaderDecoder<Format>));
+		}
+	}
+
+
+	// TextParser overrides:
+
+	virtual bool processBlock(const char * a_Buf, size_t a_Length) override
+	{
+		auto end = a_Buf + a_Length;
+		auto lineStart = a_Buf;
+		if (!m_PartialLine.empty())
+		{
+			// Complete the line continued from the previous block:
+			auto eol = findEOL(lineStart, end);
+			m_PartialLine.append(lineStart, static_cast<size_t>(eol - lineStart));
+			if (eol == end)
+			{
+				m_BlockStart += a_Length;
+				return true;
+			}
+			auto line = m_PartialLine.data();
+			auto lineEnd = line + m_PartialLine.size();
+			if (!processLine(line, lineEnd, lineEnd, m_PartialLineStart, m_BlockStart + static_cast<size_t>(eol - a_Buf)))
+			{
+				return false;
+			}
+			m_PartialLine.clear();
+			lineStart = eol + 1;
+		}
+
+		while (lineStart < end)
+		{
+			auto eol = findEOL(lineStart, end);
+			if (eol == end)
+			{
+				// The line continues in the next block, keep its part:
+				m_PartialLineStart = m_BlockStart + static_cast<size_t>(lineStart - a_Buf);
+				m_PartialLine.assign(lineStart, static_cast<size_t>(end - lineStart));
+				break;
+			}
+			if ((eol == lineStart) && m_HasJustFinishedLine)
+			{
+				// This was a CRLF, skip
+				m_HasJustFinishedLine = false;
+				lineStart = eol + 1;
+				continue;
+			}
+			if (!processLine(
+				lineStart, eol, end,
+				m_BlockStart + static_cast<size_t>(lineStart - a_Buf),
+				m_BlockStart + static_cast<size_t>(eol - a_Buf)
+			))
+			{
+				return false;
+			}
+			lineStart = eol + 1;
+		}
+
+		m_BlockStart += a_Length;
+		return true;
+	}
+
+
+	virtual bool finish() override
+	{
+		if (!finishChunk())
+		{
+			return false;
+		}
+		if (Format::SOURCE_TYPE == LogFile::SourceType::stUnknown)
+		{
+			if (m_HasPublished)
+			{
+				// The source was identified from the first batch, identify it from all the messages; the UI then
+				// applies the result (Session::appendLogFile()) and moves the file if the source changed:
+				m_LogFile->reidentifySource();
+			}
+			else
+			{
+				m_LogFile->tryIdentifySource();
+			}
+		}
+		m_LogFile->publishMessages(true);
+		m_FileParser.reportFileParsed(m_LogFile);
+		return true;
+	}
+
+
+	// LogTextParser overrides:
+
+	virtual void startAt(size_t a_Pos) override
+	{
+		m_BlockStart = a_Pos;
+		m_LastEOL = a_Pos;
+	}
+
+
+	virtual LogFilePtr logFile() const override
+	{
+		return m_LogFile;
+	}
+
+
+	virtual bool finishChunk() override
+	{
+		// Ran out of data to parse, process the last line that has no EOL:
+		if (m_PartialLine.empty())
+		{
+			return true;
+		}
+		auto line = m_PartialLine.data();
+		auto lineEnd = line + m_PartialLine.size();
+		auto res = processLine(line, lineEnd, lineEnd, m_PartialLineStart, m_BlockStart);
+		m_PartialLine.clear();
+		return res;
+	}
+
+
+	virtual void continueLogFile(LogFilePtr a_LogFile) override
+	{
+		// Continue as if the LogFile's text has just been parsed by this parser. The last message ends at its last EOL:
+		m_LogFile = a_LogFile;
+		auto numMessages = m_LogFile->numAddedMessages();
+		const auto & text = m_LogFile->getCompleteText();
+		auto textSize = text.size();
+		m_BlockStart = textSize;
+		m_LastEOL = textSize;
+		m_PartialLine.clear();
+		if (numMessages == 0)
+		{
+			m_HasJustFinishedLine = false;
+			return;
+		}
+		auto lastMessage = m_LogFile->message(numMessages - 1);
+		m_LastEOL = lastMessage.m_TextStart + lastMessage.m_TextLength;
+		m_HasJustFinishedLine = (m_LastEOL + 1 == textSize);  // An empty line right after a single EOL is a split CRLF
+		if (m_LastEOL < textSize)
+		{
+			return;
+		}
+
+		// The text ends with a line without EOL, which may be still being written. If it was taken as a continuation,
+		// take it back and keep it as the partial line, so that it gets parsed once complete. If it started
+		// the last message, its header is complete and the rest of the line gets appended to the message:
+		std::string helper;
+		auto msgText = text.span(lastMessage.m_TextStart, lastMessage.m_TextLength, helper);
+		auto lineStart = lastMessage.m_TextLength;
+		while ((lineStart > 0) && (msgText[lineStart - 1] != '\n') && (msgText[lineStart - 1] != '\r'))
+		{
+			lineStart -= 1;
+		}
+		if (lineStart == 0)
+		{
+			return;
+		}
+		auto prevEOL = lineStart - 1;
+		while ((prevEOL > 0) && ((msgText[prevEOL - 1] == '\n') || (msgText[prevEOL - 1] == '\r')))
+		{
+			prevEOL -= 1;
+		}
+		m_PartialLineStart = lastMessage.m_TextStart + lineStart;
+		m_PartialLine.assign(msgText + lineStart, lastMessage.m_TextLength - lineStart);
+		m_LastEOL = lastMessage.m_TextStart + prevEOL;
+		m_LogFile->trimLastMessage(m_LastEOL);
+	}
+
+
+	virtual void startPublishingProgressively() override
+	{
+		m_IsPublishingProgressively = true;
+		m_SinceLastPublish.start();
+	}
+
+
+	virtual void publishMessages() override
+	{
+		if (m_LogFile->numUnpublishedMessages() <= 1)
+		{
+			// Nothing to publish, the last message is held back until it is complete
+			return;
+		}
+		if (!m_HasPublished)
+		{
+			// The UI sorts the file by its source once it receives it, so the source is identified from the first batch:
+			if (Format::SOURCE_TYPE == LogFile::SourceType::stUnknown)
+			{
+				m_LogFile->tryIdentifySource();
+			}
+			m_HasPublished = true;
+		}
+		m_LogFile->publishMessages(false);
+		m_FileParser.reportMessagesPublished(m_LogFile);
+		m_SinceLastPublish.start();
+	}
+
+
+	/** Returns true if the line (a_Line to a_End, without the EOL) starts a new message.
+	The memory up to a_Limit is readable. */
+	static bool isMessageLine(const char * a_Line, const char * a_End, const char * a_Limit)
+	{
+		LogLineCursor cursor = {a_Line, a_End, a_Limit};
+		ParsedLogLine parsedLine;
+		return Format::Grammar::parse(cursor, parsedLine);
+	}
+
+
+protected:
+
+	/** The FileParser instance that has created this helper.
+	Used for detecting abortion and to report the parsed files. */
+	FileParser & m_FileParser;
+
+	/** The LogFile into which the messages are added. */
+	LogFilePtr m_LogFile;
+
+	/** The values parsed from the current line. */
+	ParsedLogLine m_ParsedLine;
+
+	/** The start of the line that continues in the next block, collected from the blocks so far. */
+	std::string m_PartialLine;
+
+	// Stored state of the parser between the blocks, all positions are absolute within the complete text:
+	size_t m_BlockStart;  // Position of the currently processed block's first byte
+	size_t m_LastEOL;
+	size_t m_PartialLineStart;
+	bool m_HasJustFinishedLine;
+	int m_LinesBeforeAbortCheck;
+
+	/** If true, only the timestamps are parsed, see FileParser::setShouldParseLazily(). */
+	bool m_IsLazy;
+
+	/** If true, the messages are published in batches while parsing, see startPublishingProgressively(). */
+	bool m_IsPublishingProgressively;
+
+	/** True once any messages have been published by publishMessages(). */
+	bool m_HasPublished;
+
+	/** Measures the time since the last batch of messages was published. */
+	QElapsedTimer m_SinceLastPublish;
+
+
+	/** Returns true if the line starts a new message, in the lazy parse mode; parses the timestamp into m_ParsedLine.
+	A line starting with a timestamp in the usual fixed format and a valid log level field after it is taken
+	as a message right away, any other line is checked using the whole grammar. */
+	bool isLazyMessageLine(const LogLineCursor & a_Cursor)
+	{
+		auto cursor = a_Cursor;
+		if (!Format::Grammar::parseLeading(cursor, m_ParsedLine, LAZY_NUM_FIELDS))
+		{
+			return false;
+		}
+		if (m_ParsedLine.m_HasMSecs)
+		{
+			return true;
+		}
+		cursor = a_Cursor;
+		m_ParsedLine.reset();
+		return Format::Grammar::parse(cursor, m_ParsedLine);
+	}
+
+
+	/** Processes a single complete line, a_Line to a_End (without the EOL), either adds a message or a continuation.
+	The memory up to a_Limit is readable. a_LineStart and a_EOLPos are the absolute positions of the line and its EOL.
+	Returns true on success, false on failure. */
+	bool processLine(const char * a_Line, const char * a_End, const char * a_Limit, size_t a_LineStart, size_t a_EOLPos)
+	{
+		// Check whether an abort is requested from the UI thread:
+		if (m_LinesBeforeAbortCheck > 0)
+		{
+			m_LinesBeforeAbortCheck -= 1;
+		}
+		else
+		{
+			m_LinesBeforeAbortCheck = 1000;
+			if (m_FileParser.m_ShouldAbort.load())  // This check is a bit expensive, don't do it too often
+			{
+				return false;
+			}
+			if (
+				m_IsPublishingProgressively &&
+				(
+					(m_LogFile->numUnpublishedMessages() >= PUBLISH_BATCH_SIZE) ||
+					m_SinceLastPublish.hasExpired(PUBLISH_INTERVAL_MSEC)
+				)
+			)
+			{
+				publishMessages();
+			}
+		}
+
+		LogLineCursor cursor = {a_Line, a_End, a_Limit};
+		m_ParsedLine.reset();
+		if (m_IsLazy)
+		{
+			if (isLazyMessageLine(cursor))
+			{
+				// Store the whole line, the header gets decoded later:
+				m_LogFile->addUndecodedMessage(m_ParsedLine.time(), a_LineStart, a_EOLPos - a_LineStart);
+			}
+			else if (!m_LogFile->appendContinuationToLastMessage(a_EOLPos - m_LastEOL))
+			{
+				return false;
+			}
+
+			// The message begin isn't known without decoding the header, so the whole line is scanned for the tokens.
+			// Deferring the scan to LogFile::decodeHeaders() would leave the undecoded blocks out of the TokenIndex,
+			// so the cross-file token search would miss them. The price is the header's thread ID, a hex run
+			// the scan stops at on each line:
+			m_LogFile->addTokens(a_Line, a_End);
+		}
+		else if (Format::Grammar::parse(cursor, m_ParsedLine))
+		{
+			auto messageBegin = a_LineStart + static_cast<size_t>(m_ParsedLine.m_MessageBegin - a_Line);
+			m_LogFile->addMessage(
+				m_ParsedLine.time(),
+				m_ParsedLine.m_LogLevel,
+				m_ParsedLine.m_Component, m_ParsedLine.m_ComponentLength,
+				m_ParsedLine.m_SubComponent,
+				m_ParsedLine.m_ThreadID,
+				messageBegin, a_EOLPos - messageBegin
+			);
+			m_LogFile->addTokens(m_ParsedLine.m_MessageBegin, a_End);
+		}
+		else
+		{
+			// We have a continuation:
+			if (!m_LogFile->appendContinuationToLastMessage(a_EOLPos - m_LastEOL))
+			{
+				return false;
+			}
+			m_LogFile->addTokens(a_Line, a_End);
+		}
+		m_LastEOL = a_EOLPos;
+		m_HasJustFinishedLine = true;
+		return true;
+	}
+};
+
+
+
+
+
+/** Creates a new PlainTextLogParser for the specified format. */
+template <typename Format>
+static LogTextParser * createPlainTextLogParser(FileParser & a_FileParser, TextBufferPtr a_CompleteText)
+{
+	return new PlainTextLogParser<Format>(a_FileParser, a_CompleteText);
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// FileParser::TextFormatDescription:
+
+/** Describes a single plain text log format known to FileParser. */
+struct FileParser::TextFormatDescription
+{
+	/** The identifier of the format. */
+	TextFormat m_TextFormat;
+
+	/** The human-readable name of the format, used in the messages. */
+	const char * m_Name;
+
+	/** Returns true if the sample (first N bytes of the data, starting with a valid timestamp) is in this format. */
+	bool (* m_MatchesSample)(const char * a_Sample, size_t a_SampleSize);
+
+	/** Returns true if the line (a_Line to a_End, without the EOL) starts a new message.
+	The memory up to a_Limit is readable. */
+	bool (* m_IsMessageLine)(const char * a_Line, const char * a_End, const char * a_Limit);
+
+	/** Creates a new parser of the format, storing the messages into a new LogFile with the specified complete text. */
+	LogTextParser * (* m_CreateParser)(FileParser & a_FileParser, TextBufferPtr a_CompleteText);
+};
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// TarParser:
+
+/** Parses a TAR archive data stream, each member file into a separate LogFile.
+The archive data is pushed in blocks as any other text, each member's data is passed on to a parser for its format
+as soon as it arrives, so the archive can be processed while it is being decompressed. The LogFiles reference
+their part of the archive's complete text, no copy of the data is made.
+Members that are compressed themselves (GZIP, ZIP) are collected and parsed once complete. */
+class TarParser:
+	public TextParser
+{
+public:
+
+	/** Size of the TAR records (headers and data padding). */
+	static const size_t RECORD_SIZE = 512;
+
+	/** The maximum number of bytes reserved up front for collecting a compressed member's data.
+	The declared size comes from the (possibly corrupt) header, larger members grow the buffer as their data arrives. */
+	static const size_t MAX_COLLECT_RESERVE = 64 * 1024 * 1024;
+
+
+	/** Creates a new parser for the specified archive data.
+	a_IsContiguous specifies whether a_CompleteText is already complete and contiguous, so that compressed members
+	can be parsed directly from it, without collecting their data. */
+	TarParser(FileParser & a_FileParser, TextBufferPtr a_CompleteText, bool a_IsContiguous):
+		m_State(sHeader),
+		m_MemberKind(mkSkip),
+		m_FileParser(a_FileParser),
+		m_CompleteText(a_CompleteText),
+		m_IsContiguous(a_IsContiguous),
+		m_Pos(0),
+		m_HeaderUsed(0),
+		m_MemberStart(0),
+		m_MemberSize(0),
+		m_MemberRemaining(0),
+		m_PaddingRemaining(0),
+		m_NextMemberSize(-1)
+	{
+	}
+
+
+	/** Returns true if the data starts with a valid TAR header. */
+	static bool isTarHeader(const char * a_Data, size_t a_Size)
+	{
+		if (a_Size < RECORD_SIZE)
+		{
+			return false;
+		}
+		if (isZeroRecord(a_Data))
+		{
+			// An empty archive is valid, but useless; a zero record is more likely to be something else
+			return false;
+		}
+		return hasValidChecksum(a_Data);
+	}
+
+
+	// TextParser overrides:
+
+	virtual bool processBlock(const char * a_Buf, size_t a_Length) override
+	{
+		while (a_Length > 0)
+		{
+			size_t len = 0;
+			switch (m_State)
+			{
+				case sHeader:
+				{
+					len = std::min(a_Length, RECORD_SIZE - m_HeaderUsed);
+					memcpy(m_Header + m_HeaderUsed, a_Buf, len);
+					m_HeaderUsed += len;
+					if (m_HeaderUsed == RECORD_SIZE)
+					{
+						m_HeaderUsed = 0;
+						if (!processHeader(m_Pos + len))
+						{
+							return false;
+						}
+					}
+					break;
+				}
+				case sMemberData:
+				{
+					len = static_cast<size_t>(std::min<quint64>(a_Length, m_MemberRemaining));
+					processMemberData(a_Buf, len);
+					m_MemberRemaining -= len;
+					if (m_MemberRemaining == 0)
+					{
+						finishMember();
+						m_State = (m_PaddingRemaining > 0) ? sPadding : sHeader;
+					}
+					break;
+				}
+				case sPadding:
+				{
+					len = std::min(a_Length, m_PaddingRemaining);
+					m_PaddingRemaining -= len;
+					if (m_PaddingRemaining == 0)
+					{
+						m_State = sHeader;
+					}
+					break;
+				}
+			}
+			a_Buf += len;
+			a_Length -= len;
+			m_Pos += len;
+			if (m_FileParser.m_ShouldAbort.load())
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+
+	virtual bool finish() override
+	{
+		if (m_State == sMemberData)
+		{
+			// The archive is truncated, process whatever is there of the last member:
+			m_MemberSize -= m_MemberRemaining;
+			if (m_MemberKind != mkParsing)
+			{
+				m_MemberText = std::make_shared<SubTextBuffer>(m_CompleteText, m_MemberStart, static_cast<size_t>(m_MemberSize));
+			}
+			finishMember();
+		}
+		return true;
+	}
+
+
+protected:
+
+	/** The state of the parser: what the next byte of the data is. */
+	enum
+	{
+		sHeader,
+		sMemberData,
+		sPadding,
+	} m_State;
+
+	/** What is done with the data of the current member. */
+	enum
+	{
+		mkDetecting,   // Collecting a sample of a file for detecting its format
+		mkParsing,     // Passing a file's data to m_MemberParser
+		mkCollecting,  // Collecting a compressed file's data into m_MemberData
+		mkLongName,    // Collecting the GNU long name of the next member into m_MemberData
+		mkPaxHeader,   // Collecting the PAX extended header of the next member into m_MemberData
+		mkSkip,        // Ignoring the data
+	} m_MemberKind;
+
+	/** The FileParser instance that has created this helper.
+	Used for detecting abortion, creating the member parsers and reporting errors. */
+	FileParser & m_FileParser;
+
+	/** The complete text of the archive. */
+	TextBufferPtr m_CompleteText;
+
+	/** If true, m_CompleteText is complete and contiguous. */
+	bool m_IsContiguous;
+
+	/** The position of the next byte to be processed, within m_CompleteText. */
+	size_t m_Pos;
+
+	/** The header being received. */
+	char m_Header[RECORD_SIZE];
+
+	/** Number of bytes of m_Header already received. */
+	size_t m_HeaderUsed;
+
+	/** The name of the current member. */
+	QString m_MemberName;
+
+	/** The position of the current member's data within m_CompleteText. */
+	size_t m_MemberStart;
+
+	/** The size of the current member's data. */
+	quint64 m_MemberSize;
+
+	/** The number of bytes of the current member's data yet to be processed. */
+	quint64 m_MemberRemaining;
+
+	/** The number of padding bytes after the current member's data yet to be skipped. */
+	size_t m_PaddingRemaining;
+
+	/** The data of the current member that is being collected (see m_MemberKind). */
+	std::string m_MemberData;
+
+	/** The text of the current member (part of m_CompleteText). */
+	TextBufferPtr m_MemberText;
+
+	/** The parser of the current member's text, if mkParsing. */
+	std::unique_ptr<TextParser> m_MemberParser;
+
+	/** The name for the next member, overriding its header (from a GNU long name or a PAX header). */
+	QString m_NextMemberName;
+
+	/** The size for the next member, overriding its header (from a PAX header), or -1 if not overridden. */
+	qint64 m_NextMemberSize;
+
+
+	/** Returns true if the record consists of zero bytes only (end of archive marker). */
+	static bool isZeroRecord(const char * a_Record)
+	{
+		for (size_t i = 0; i < RECORD_SIZE; i++)
+		{
+			if (a_Record[i] != 0)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+
+	/** Returns true if the header's checksum field matches its contents.
+	Both the standard (unsigned) and the historic (signed) sums are accepted. */
+	static bool hasValidChecksum(const char * a_Header)
+	{
+		quint64 checksum;
+		if (!parseNumber(a_Header + 148, 8, checksum))
+		{
+			return false;
+		}
+		quint64 unsignedSum = 0;
+		qint64 signedSum = 0;
+		for (size_t i = 0; i < RECORD_SIZE; i++)
+		{
+			auto ch = ((i >= 148) && (i < 156)) ? ' ' : a_Header[i];  // The checksum field itself counts as spaces
+			unsignedSum += static_cast<unsigned char>(ch);
+			signedSum += static_cast<signed char>(ch);
+		}
+		return ((checksum == unsignedSum) || (static_cast<qint64>(checksum) == signedSum));
+	}
+
+
+	/** Parses a numeric header field: octal, space- or NUL-terminated, or GNU base-256 if the highest bit is set.
+	Returns true on success, false if the field is not a valid number. */
+	static bool parseNumber(const char * a_Field, size_t a_Size, quint64 & a_Value)
+	{
+		a_Value = 0;
+		if ((a_Field[0] & 0x80) != 0)
+		{
+			// GNU base-256 encoding, big endian:
+			a_Value = static_cast<unsigned char>(a_Field[0]) & 0x7f;
+			for (size_t i = 1; i < a_Size; i++)
+			{
+				a_Value = (a_Value << 8) | static_cast<unsigned char>(a_Field[i]);
+			}
+			return true;
+		}
+		size_t i = 0;
+		while ((i < a_Size) && (a_Field[i] == ' '))
+		{
+			i += 1;
+		}
+		bool hasDigits = false;
+		for (; i < a_Size; i++)
+		{
+			auto ch = a_Field[i];
+			if ((ch < '0') || (ch > '7'))
+			{
+				return hasDigits && ((ch == ' ') || (ch == 0));
+			}
+			a_Value = a_Value * 8 + static_cast<quint64>(ch - '0');
+			hasDigits = true;
+		}
+		return hasDigits;
+	}
+
+
+	/** Returns the contents of a NUL-terminated (or full-length) header string field. */
+	static QString headerString(const char * a_Field, size_t a_MaxSize)
+	{
+		return QString::fromUtf8(a_Field, static_cast<int>(strnlen(a_Field, a_MaxSize)));
+	}
+
+
+	/** Processes the complete header in m_Header, sets up the processing of the member's data.
+	a_DataStart is the position of the member's data within m_CompleteText.
+	Returns true on success, false if the header is invalid. */
+	bool processHeader(size_t a_DataStart)
+	{
+		if (isZeroRecord(m_Header))
+		{
+			// End-of-archive marker, just skip it
+			return true;
+		}
+		quint64 size;
+		if (!hasValidChecksum(m_Header) || !parseNumber(m_Header + 124, 12, size))
+		{
+			emit m_FileParser.parseFailed(QObject::tr("Invalid TAR header"));
+			return false;
+		}
+
+		// Get the member's name and size, either from the header, or from the preceding extension member:
+		if (m_NextMemberSize >= 0)
+		{
+			size = static_cast<quint64>(m_NextMemberSize);
+		}
+		if (size > static_cast<quint64>(std::numeric_limits<size_t>::max() - a_DataStart - RECORD_SIZE))
+		{
+			// Base-256 sizes go up to 2^63, such a member couldn't be addressed within the text:
+			emit m_FileParser.parseFailed(QObject::tr("Invalid TAR member size"));
+			return false;
+		}
+		if (!m_NextMemberName.isEmpty())
+		{
+			m_MemberName = m_NextMemberName;
+		}
+		else
+		{
+			m_MemberName = headerString(m_Header, 100);
+			auto prefix = headerString(m_Header + 345, 155);
+			if ((memcmp(m_Header + 257, "ustar", 5) == 0) && !prefix.isEmpty())
+			{
+				m_MemberName = prefix + "/" + m_MemberName;
+			}
+		}
+		m_MemberStart = a_DataStart;
+		m_MemberSize = size;
+		m_MemberRemaining = size;
+		m_PaddingRemaining = static_cast<size_t>((RECORD_SIZE - size % RECORD_SIZE) % RECORD_SIZE);
+		m_MemberData.clear();
+
+		// Decide what to do with the data based on the member type:
+		auto type = m_Header[156];
+		switch (type)
+		{
+			case 0:
+			case '0':
+			case '7':
+			{
+				// A regular file, empty ones are not worth parsing
+				m_MemberKind = (size > 0) ? mkDetecting : mkSkip;
+				m_NextMemberName.clear();
+				m_NextMemberSize = -1;
+				break;
+			}
+			case 'L':
+			{
+				m_MemberKind = mkLongName;
+				break;
+			}
+			case 'x':
+			{
+				m_MemberKind = mkPaxHeader;
+				break;
+			}
+			default:
+			{
+				// Folders, links, global headers etc., nothing to parse
+				m_MemberKind = mkSkip;
+				m_NextMemberName.clear();
+				m_NextMemberSize = -1;
+				break;
+			}
+		}
+
+		if (size > 0)
+		{
+			m_State = sMemberData;
+		}
+		else
+		{
+			finishMember();
+			m_State = sHeader;
+		}
+		return true;
+	}
+
+
+	/** Processes the next part of the current member's data. */
+	void processMemberData(const char * a_Data, size_t a_Length)
+	{
+		switch (m_MemberKind)
+		{
+			case mkDetecting:
+			{
+				static const size_t DETECTION_SAMPLE_SIZE = 1000;
+				m_MemberData.append(a_Data, a_Length);
+				if ((m_MemberData.size() >= DETECTION_SAMPLE_SIZE) || (m_MemberData.size() == m_MemberSize))
+				{
+					startMember();
+				}
+				break;
+			}
+			case mkParsing:
+			{
+				if (!m_MemberParser->processBlock(a_Data, a_Length))
+				{
+					emit m_FileParser.parseFailed(QObject::tr("Log parser error in %1").arg(m_MemberName));
+					m_MemberParser.reset();
+					m_MemberKind = mkSkip;
+				}
+				break;
+			}
+			case mkCollecting:
+			case mkLongName:
+			case mkPaxHeader:
+			{
+				m_MemberData.append(a_Data, a_Length);
+				break;
+			}
+			case mkSkip:
+			{
+				break;
+			}
+		}
+	}
+
+
+	/** Detects the format of the current member from the sample collected in m_MemberData and starts its parsing. */
+	void startMember()
+	{
+		m_MemberText = std::make_shared<SubTextBuffer>(m_CompleteText, m_MemberStart, static_cast<size_t>(m_MemberSize));
+		auto textFormat = FileParser::detectTextFormat(m_MemberData.data(), m_MemberData.size());
+		if (textFormat != FileParser::tfUnknown)
+		{
+			m_FileParser.m_InnerFileName = m_MemberName;
+			m_MemberParser = m_FileParser.createTextParser(textFormat, m_MemberText);
+			m_MemberKind = mkParsing;
+			processMemberData(m_MemberData.data(), m_MemberData.size());
+			m_MemberData.clear();
+			return;
+		}
+
+		// Compressed members need their complete data for parsing:
+		auto sample = m_MemberData.data();
+		auto sampleSize = m_MemberData.size();
+		bool isGZip = (sampleSize >= 2) && (sample[0] == 0x1f) && (static_cast<unsigned char>(sample[1]) == 0x8b);
+		if (isGZip || ZipArchive::hasZipSignature(sample, sampleSize))
+		{
+			m_MemberKind = mkCollecting;
+			if (m_IsContiguous)
+			{
+				// No need to collect, the data will be parsed directly from m_CompleteText
+				m_MemberData.clear();
+			}
+			else
+			{
+				m_MemberData.reserve(static_cast<size_t>(std::min<quint64>(m_MemberSize, MAX_COLLECT_RESERVE)));
+			}
+			return;
+		}
+
+		emit m_FileParser.failedToRecognize(QObject::tr("Did not match any known format: %1").arg(m_MemberName));
+		m_MemberData.clear();
+		m_MemberKind = mkSkip;
+	}
+
+
+	/** Finishes the processing of the current member, after all its data has been processed. */
+	void finishMember()
+	{
+		if (m_MemberKind == mkDetecting)
+		{
+			// The member is smaller than the detection sample:
+			startMember();
+		}
+		switch (m_MemberKind)
+		{
+			case mkParsing:
+			{
+				if (!m_MemberParser->finish())
+				{
+					emit m_FileParser.parseFailed(QObject::tr("Log parser error in %1").arg(m_MemberName));
+				}
+				break;
+			}
+			case mkCollecting:
+			{
+				m_FileParser.m_InnerFileName = m_MemberName;
+				if (m_IsContiguous)
+				{
+					m_FileParser.parseContents(m_MemberText);
+				}
+				else
+				{
+					m_FileParser.parseContents(std::make_shared<StringTextBuffer>(std::move(m_MemberData)));
+				}
+				break;
+			}
+			case mkLongName:
+			{
+				m_NextMemberName = QString::fromUtf8(m_MemberData.data(), static_cast<int>(strnlen(m_MemberData.data(), m_MemberData.size())));
+				break;
+			}
+			case mkPaxHeader:
+			{
+				processPaxHeader();
+				break;
+			}
+			case mkDetecting:
+			case mkSkip:
+			{
+				break;
+			}
+		}
+		m_MemberParser.reset();
+		m_MemberText.reset();
+		m_MemberData.clear();
+		m_MemberKind = mkSkip;
+	}
+
+
+	/** Processes the PAX extended header in m_MemberData, stores the overrides for the next member.
+	The header consists of "<length> <key>=<value>\n" records. */
+	void processPaxHeader()
+	{
+		size_t pos = 0;
+		auto size = m_MemberData.size();
+		while (pos < size)
+		{
+			// Parse the record length:
+			size_t recordLength = 0;
+			auto i = pos;
+			while ((i < size) && (m_MemberData[i] >= '0') && (m_MemberData[i] <= '9'))
+			{
+				recordLength = recordLength * 10 + static_cast<size_t>(m_MemberData[i] - '0');
+				i += 1;
+			}
+			if ((recordLength == 0) || (recordLength > size - pos) || (i >= size) || (m_MemberData[i] != ' '))
+			{
+				// Invalid record, ignore the rest
+				return;
+			}
+
+			// Split the record into the key and value, without the trailing LF:
+			auto record = m_MemberData.substr(i + 1, pos + recordLength - i - 2);
+			auto eq = record.find('=');
+			if (eq != std::string::npos)
+			{
+				auto key = record.substr(0, eq);
+				auto value = record.substr(eq + 1);
+				if (key == "path")
+				{
+					m_NextMemberName = QString::fromUtf8(value.data(), static_cast<int>(value.size()));
+				}
+				else if (key == "size")
+				{
+					quint64 memberSize = 0;
+					for (auto ch: value)
+					{
+						if ((ch < '0') || (ch > '9'))
+						{
+							break;
+						}
+						memberSize = memberSize * 10 + static_cast<quint64>(ch - '0');
+					}
+					m_NextMemberSize = static_cast<qint64>(memberSize);
+				}
+			}
+			pos += recordLength;
+		}
+	}
+};
+
+const size_t TarParser::RECORD_SIZE;
+const size_t TarParser::MAX_COLLECT_RESERVE;
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// GZipTextSink:
+
+/** Receives the decompressed data of a GZIP (or raw deflate) stream, in order.
+Stores the data as the text of the resulting LogFile (or only indexes it, for big files), detects the text format
+from the initial data and passes all the data on to the parser for that format. */
+class GZipTextSink:
+	public ParallelInflater::Receiver
+{
+public:
+
+	/** Creates a new sink for the decompressed data of the specified compressed data.
+	Small data is stored decompressed, big data stays compressed and gets indexed for random access. */
+	GZipTextSink(FileParser & a_FileParser, TextBufferPtr a_CompressedData, bool a_IsRawDeflate):
+		m_FileParser(a_FileParser),
+		m_Size(0),
+		m_IsHoldingReports(false)
+	{
+		static const size_t MIN_INDEXED_SIZE = 64 * 1024;
+		if (a_CompressedData->size() < MIN_INDEXED_SIZE)
+		{
+			m_BlockText = std::make_shared<BlockTextBuffer>();
+			m_Text = m_BlockText;
+		}
+		else
+		{
+			m_IndexedText = std::make_shared<GZipIndexedTextBuffer>(a_CompressedData, a_IsRawDeflate);
+			m_Text = m_IndexedText;
+		}
+	}
+
+
+	~GZipTextSink()
+	{
+		// Even if the parsing failed, no more data gets appended now:
+		markComplete();
+	}
+
+
+	/** Adds an index checkpoint at the start of a GZIP member starting at the specified compressed position. */
+	void addMemberStart(size_t a_CompressedPos)
+	{
+		if (m_IndexedText != nullptr)
+		{
+			m_IndexedText->addMemberStartCheckpoint(a_CompressedPos, m_Size);
+		}
+	}
+
+
+	/** Adds an index checkpoint at the current position, if it is far enough from the previous one.
+	To be called only at deflate block boundaries, the parameters are the same as for GZipIndexedTextBuffer::addCheckpoint(). */
+	virtual void addCheckpoint(size_t a_CompressedPos, int a_Bits, const char * a_Window, size_t a_WindowSize) override
+	{
+		if (
+			(m_IndexedText != nullptr) &&
+			(m_Size - m_IndexedText->lastCheckpointPos() >= GZipIndexedTextBuffer::CHECKPOINT_SPAN)
+		)
+		{
+			m_IndexedText->addCheckpoint(a_CompressedPos, a_Bits, m_Size, a_Window, a_WindowSize);
+		}
+	}
+
+
+	/** Stores and parses the next part of the decompressed data.
+	Returns true on success, false on failure (already reported through the FileParser's signals). */
+	virtual bool write(const char * a_Data, size_t a_Size) override
+	{
+		m_Size += a_Size;
+		if (m_BlockText != nullptr)
+		{
+			m_BlockText->append(a_Data, a_Size);
+		}
+		else
+		{
+			m_IndexedText->setSize(m_Size);
+		}
+
+		if (m_Parser == nullptr)
+		{
+			// Collect the sample for detecting the format:
+			static const size_t DETECTION_SAMPLE_SIZE = 1000;
+			m_Sample.append(a_Data, a_Size);
+			if (m_Sample.size() < DETECTION_SAMPLE_SIZE)
+			{
+				return true;
+			}
+			return startParser();
+		}
+		return processBlock(a_Data, a_Size);
+	}
+
+
+	/** Finishes the parsing, after all the data has been written.
+	Returns true on success, false on failure (already reported through the FileParser's signals). */
+	bool finish()
+	{
+		if ((m_Parser == nullptr) && !startParser())
+		{
+			return false;
+		}
+		if (m_BlockText != nullptr)
+		{
+			m_BlockText->shrinkToFit();
+		}
+		auto res = m_Parser->finish();
+		markComplete();
+		return res;
+	}
+
+
+protected:
+
+	/** The FileParser instance that has created this helper. */
+	FileParser & m_FileParser;
+
+	/** The text of the resulting LogFile, either m_BlockText or m_IndexedText. */
+	TextBufferPtr m_Text;
+
+	/** The text storing the decompressed data, if the data is small. */
+	std::shared_ptr<BlockTextBuffer> m_BlockText;
+
+	/** The text indexing the compressed data, if the data is big. */
+	std::shared_ptr<GZipIndexedTextBuffer> m_IndexedText;
+
+	/** The total size of the decompressed data written so far. */
+	size_t m_Size;
+
+	/** The initial part of the decompressed data, collected for the format detection. */
+	std::string m_Sample;
+
+	/** The parser for the detected format, nullptr until detected. */
+	std::unique_ptr<TextParser> m_Parser;
+
+	/** True if the reports of the parsed files are held back in m_FileParser (see FileParser::holdReports()).
+	The members of a TAR archive are parsed while the text keeps growing, other threads must not read it until complete. */
+	bool m_IsHoldingReports;
+
+
+	/** Marks the text as complete, no more data is appended to it, and reports the files held back meanwhile.
+	Does nothing if already called. */
+	void markComplete()
+	{
+		if (m_IndexedText != nullptr)
+		{
+			m_IndexedText->setComplete();
+		}
+		if (m_IsHoldingReports)
+		{
+			m_IsHoldingReports = false;
+			m_FileParser.releaseReports();
+		}
+	}
+
+
+	/** Detects the format from m_Sample, creates the parser and parses the sample.
+	Returns true on success, false on failure (already reported). */
+	bool startParser()
+	{
+		if (TarParser::isTarHeader(m_Sample.data(), m_Sample.size()))
+		{
+			m_Parser.reset(new TarParser(m_FileParser, m_Text, false));
+			m_FileParser.holdReports();
+			m_IsHoldingReports = true;
+		}
+		else
+		{
+			auto textFormat = FileParser::detectTextFormat(m_Sample.data(), m_Sample.size());
+			if (textFormat == FileParser::tfUnknown)
+			{
+				emit m_FileParser.failedToRecognize(QObject::tr("Did not match any known format"));
+				return false;
+			}
+			m_Parser = m_FileParser.createTextParser(textFormat, m_Text);
+		}
+		std::string sample;
+		std::swap(sample, m_Sample);
+		return processBlock(sample.data(), sample.size());
+	}
+
+
+	/** Passes the data to the parser.
+	Returns true on success, false on failure (already reported). */
+	bool processBlock(const char * a_Data, size_t a_Size)
+	{
+		if (!m_Parser->processBlock(a_Data, a_Size))
+		{
+			emit m_FileParser.parseFailed(QObject::tr("Log parser error"));
+			return false;
+		}
+		return true;
+	}
+};
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// GZipInflateBudget, GZipMember, GZipMemberInflateTask:
+
+struct GZipMember;
+
+/** Limits the decompressed data held by the GZIP members that are inflated ahead of the one being parsed.
+Shared by all the member inflating tasks of a single file, a task waits for the budget before adding another piece
+of the decompressed data to its member. The member being parsed doesn't use the budget (the consumer drains it
+instead), so that the members ahead of it can never block it. */
+class GZipInflateBudget
+{
+public:
+
+	/** The maximum total size of the decompressed data held by the members ahead of the one being parsed. */
+	static const size_t MAX_SIZE = 256 * 1024 * 1024;
+
+
+	GZipInflateBudget():
+		m_Size(0)
+	{
+	}
+
+
+	/** Reserves a_Size bytes for the next piece of data of the specified member, waits while over the limit.
+	Returns true if reserved, false if the member doesn't need the budget anymore (being parsed, or aborted). */
+	bool reserve(const GZipMember & a_Member, size_t a_Size);
+
+	/** Returns the specified number of reserved bytes back to the budget. */
+	void release(size_t a_Size)
+	{
+		if (a_Size == 0)
+		{
+			return;
+		}
+		QMutexLocker lock(&m_Mtx);
+		assert(m_Size >= a_Size);
+		m_Size -= a_Size;
+		m_Changed.wakeAll();
+	}
+
+	/** Wakes up the tasks waiting for the budget, so that they re-check the state of their members. */
+	void notify()
+	{
+		QMutexLocker lock(&m_Mtx);
+		m_Changed.wakeAll();
+	}
+
+
+protected:
+
+	/** The total size of the data reserved so far. Protected by m_Mtx. */
+	size_t m_Size;
+
+	/** Protects m_Size. */
+	QMutex m_Mtx;
+
+	/** Signalled when the reserved size or the state of the members changes. */
+	QWaitCondition m_Changed;
+};
+
+const size_t GZipInflateBudget::MAX_SIZE;
+
+typedef std::shared_ptr<GZipInflateBudget> GZipInflateBudgetPtr;
+
+
+
+
+
+/** A single (candidate) member of a multi-member GZIP file, inflated in a separate thread.
+The decompressed data is handed over to the consumer in pieces, as soon as they are inflated, so that the whole member
+is never held in memory. The pieces of the members ahead of the one being parsed are limited by the GZipInflateBudget,
+the pieces of the member being parsed by MAX_CONSUMED_BACKLOG. */
+struct GZipMember
+{
+	/** A piece of the decompressed data.
+	If the piece ends at a deflate block boundary, the boundary is stored with it, so that an index checkpoint can be made. */
+	struct Piece
+	{
+		std::string m_Data;
+		bool m_HasBoundary;
+		size_t m_CompressedPos;  // Position of the boundary in the compressed data, valid only if m_HasBoundary
+		int m_Bits;              // Number of the unused bits at m_CompressedPos, valid only if m_HasBoundary
+
+		Piece():
+			m_HasBoundary(false),
+			m_CompressedPos(0),
+			m_Bits(0)
+		{
+		}
+	};
+
+
+	/** The maximum size of the pieces waiting for the consumer, once it parses the member. */
+	static const size_t MAX_CONSUMED_BACKLOG = 16 * 1024 * 1024;
+
+
+	/** Position of the member's header in the compressed data. */
+	size_t m_Start;
+
+	/** Position right after the member's trailer in the compressed data. Valid only if m_IsValid. */
+	size_t m_End;
+
+	/** True if the member was inflated successfully, including the trailer CRC and ISIZE check.
+	Valid only once m_IsFinished. */
+	bool m_IsValid;
+
+	/** True once the inflating task has finished. Protected by m_Mtx. */
+	bool m_IsFinished;
+
+	/** The pieces inflated but not yet taken by the consumer. Protected by m_Mtx. */
+	std::deque<Piece> m_Pieces;
+
+	/** The total size of m_Pieces. Protected by m_Mtx. */
+	size_t m_PiecesSize;
+
+	/** The number of bytes of m_Pieces reserved from m_Budget. Protected by m_Mtx. */
+	size_t m_BudgetedSize;
+
+	/** Set once the consumer starts parsing the member's data; the member no longer uses m_Budget. */
+	std::atomic<bool> m_IsBeingConsumed;
+
+	/** Set by the consumer if the member is no longer needed (a false candidate, or parsing aborted). */
+	std::atomic<bool> m_ShouldAbort;
+
+	/** The budget shared by all the members of the file. */
+	GZipInflateBudgetPtr m_Budget;
+
+	/** Protects the state shared between the inflating task and the consumer. */
+	QMutex m_Mtx;
 
-	// Init the ZLIB ungzipper:
-	z_stream zlibStream;
-	memset(&zlibStream, 0, sizeof(zlibStream));
-	auto zr = inflateInit2(&zlibStream, 31);  // Force GZIP decoding
-	if (zr != Z_OK)
+	/** Signalled when a piece is added or taken, when the inflating finishes and when the member is aborted. */
+	QWaitCondition m_Changed;
+
+
+	GZipMember(size_t a_Start, GZipInflateBudgetPtr a_Budget):
+		m_Start(a_Start),
+		m_End(0),
+		m_IsValid(false),
+		m_IsFinished(false),
+		m_PiecesSize(0),
+		m_BudgetedSize(0),
+		m_IsBeingConsumed(false),
+		m_ShouldAbort(false),
+		m_Budget(a_Budget)
 	{
-		qDebug("%s: uncompression initialization failed: %d (\"%s\").", __FUNCTION__, zr, zlibStream.msg);
-		return std::string();
 	}
-	zlibStream.next_in = const_cast<Bytef *>(reinterpret_cast<const Bytef *>(a_Data));
-	zlibStream.avail_in = static_cast<uInt>(a_DataSize);
+
+
+	~GZipMember()
+	{
+		m_Budget->release(m_BudgetedSize);
+	}
+
+
+	/** Adds the next piece of the decompressed data, called by the inflating task.
+	Waits for the budget, or for the consumer to take the previous pieces. Returns false if aborted meanwhile. */
+	bool addPiece(Piece && a_Piece)
+	{
+		auto size = a_Piece.m_Data.size();
+		auto isBudgeted = m_Budget->reserve(*this, size);
+		QMutexLocker lock(&m_Mtx);
+		if (isBudgeted)
+		{
+			m_BudgetedSize += size;
+		}
+		while (
+			m_IsBeingConsumed.load() &&
+			(m_PiecesSize > 0) && (m_PiecesSize + size > MAX_CONSUMED_BACKLOG) &&
+			!m_ShouldAbort.load()
+		)
+		{
+			m_Changed.wait(&m_Mtx);
+		}
+		if (m_ShouldAbort.load())
+		{
+			return false;
+		}
+		m_PiecesSize += size;
+		m_Pieces.push_back(std::move(a_Piece));
+		m_Changed.wakeAll();
+		return true;
+	}
+
+
+	/** Marks the inflating as finished, called by the inflating task. */
+	void finish(bool a_IsValid)
+	{
+		QMutexLocker lock(&m_Mtx);
+		m_IsValid = a_IsValid;
+		m_IsFinished = true;
+		m_Changed.wakeAll();
+	}
+
+
+	/** Marks the member as being parsed, its pieces are taken by the consumer from now on. */
+	void startConsuming()
+	{
+		m_IsBeingConsumed = true;
+		m_Budget->notify();
+	}
+
+
+	/** Takes the next piece of the decompressed data, called by the consumer. Waits until the piece is inflated.
+	Returns false if there are no more pieces (the inflating has finished, see m_IsValid). */
+	bool takePiece(Piece & a_Piece)
+	{
+		size_t toRelease;
+		{
+			QMutexLocker lock(&m_Mtx);
+			while (m_Pieces.empty() && !m_IsFinished)
+			{
+				m_Changed.wait(&m_Mtx);
+			}
+			if (m_Pieces.empty())
+			{
+				return false;
+			}
+			a_Piece = std::move(m_Pieces.front());
+			m_Pieces.pop_front();
+			auto size = a_Piece.m_Data.size();
+			m_PiecesSize -= size;
+			toRelease = std::min(size, m_BudgetedSize);
+			m_BudgetedSize -= toRelease;
+			m_Changed.wakeAll();
+		}
+		m_Budget->release(toRelease);
+		return true;
+	}
+
+
+	/** Aborts the inflating, wakes up the task if it is waiting. */
+	void abort()
+	{
+		m_ShouldAbort = true;
+		{
+			QMutexLocker lock(&m_Mtx);
+			m_Changed.wakeAll();
+		}
+		m_Budget->notify();
+	}
+};
+
+const size_t GZipMember::MAX_CONSUMED_BACKLOG;
+
+typedef std::shared_ptr<GZipMember> GZipMemberPtr;
+
+
+
+
+
+bool GZipInflateBudget::reserve(const GZipMember & a_Member, size_t a_Size)
+{
+	QMutexLocker lock(&m_Mtx);
 	while (true)
 	{
-		zlibStream.next_out = reinterpret_cast<Bytef *>(buf);
-		zlibStream.avail_out = sizeof(buf);
-		zr = inflate(&zlibStream, Z_SYNC_FLUSH);
-		switch (zr)
+		if (a_Member.m_IsBeingConsumed.load() || a_Member.m_ShouldAbort.load())
 		{
-			case Z_OK:
+			return false;
+		}
+		if ((m_Size == 0) || (m_Size + a_Size <= MAX_SIZE))
+		{
+			m_Size += a_Size;
+			return true;
+		}
+		m_Changed.wait(&m_Mtx);
+	}
+}
+
+
+
+
+
+/** Inflates a single GZIP member starting at a candidate position, handing the data over through the GZipMember. */
+class GZipMemberInflateTask:
+	public QRunnable
+{
+public:
+	GZipMemberInflateTask(TextBufferPtr a_CompressedData, GZipMemberPtr a_Member):
+		m_CompressedData(a_CompressedData),
+		m_Member(a_Member)
+	{
+	}
+
+
+	virtual void run() override
+	{
+		m_Member->finish(inflateMember());
+	}
+
+
+protected:
+
+	/** The complete compressed data. */
+	TextBufferPtr m_CompressedData;
+
+	/** The member to inflate and to hand the data over through. */
+	GZipMemberPtr m_Member;
+
+
+	/** Inflates the member, adding the data to it in pieces.
+	Returns true if the whole member was inflated successfully, false on failure or abort. */
+	bool inflateMember()
+	{
+		z_stream zlibStream;
+		memset(&zlibStream, 0, sizeof(zlibStream));
+		if (inflateInit2(&zlibStream, 31) != Z_OK)  // Force GZIP decoding
+		{
+			return false;
+		}
+
+		// The pieces are cut at the block boundaries at least CHECKPOINT_SPAN apart,
+		// or anywhere if the blocks are huge, to keep the pieces small:
+		static const size_t CHUNK_SIZE = 64 * 1024;
+		static const size_t MIN_PIECE_SIZE = GZipIndexedTextBuffer::CHECKPOINT_SPAN;
+		static const size_t MAX_PIECE_SIZE = 4 * GZipIndexedTextBuffer::CHECKPOINT_SPAN;
+		auto compressed = reinterpret_cast<const Bytef *>(m_CompressedData->data());
+		auto compressedSize = m_CompressedData->size();
+		auto inPos = m_Member->m_Start;
+		GZipMember::Piece piece;
+		piece.m_Data.reserve(MIN_PIECE_SIZE + CHUNK_SIZE);
+		bool res = false;
+		while (!m_Member->m_ShouldAbort.load())
+		{
+			// Feed the input in pieces, avail_in is too small for huge files:
+			if ((zlibStream.avail_in == 0) && (inPos < compressedSize))
 			{
-				// Decompressed a chunk, append it to the output data:
-				res.append(buf, sizeof(buf) - zlibStream.avail_out);
+				auto len = std::min<size_t>(compressedSize - inPos, 1024 * 1024 * 1024);
+				zlibStream.next_in = const_cast<Bytef *>(compressed + inPos);
+				zlibStream.avail_in = static_cast<uInt>(len);
+				inPos += len;
+			}
+			auto used = piece.m_Data.size();
+			piece.m_Data.resize(used + CHUNK_SIZE);
+			zlibStream.next_out = reinterpret_cast<Bytef *>(&piece.m_Data[used]);
+			zlibStream.avail_out = static_cast<uInt>(CHUNK_SIZE);
+			auto zr = inflate(&zlibStream, Z_BLOCK);
+			piece.m_Data.resize(used + CHUNK_SIZE - zlibStream.avail_out);
+			if (zr == Z_STREAM_END)
+			{
+				m_Member->m_End = inPos - zlibStream.avail_in;
+				res = piece.m_Data.empty() || m_Member->addPiece(std::move(piece));
 				break;
 			}
-			case Z_STREAM_END:
+			if (zr != Z_OK)
 			{
-				// Decompressed all data, append any leftovers and return the whole thing:
-				res.append(buf, sizeof(buf) - zlibStream.avail_out);
-				inflateEnd(&zlibStream);
-				return res;
+				// Not a valid member (a false candidate), or truncated
+				break;
 			}
-			default:
+			bool isAtBlockBoundary = ((zlibStream.data_type & 128) != 0) && ((zlibStream.data_type & 64) == 0);
+			auto size = piece.m_Data.size();
+			if ((isAtBlockBoundary && (size >= MIN_PIECE_SIZE)) || (size >= MAX_PIECE_SIZE))
 			{
-				// Error
-				qDebug("%s: uncompression failed: %d (\"%s\").", __FUNCTION__, zr, zlibStream.msg);
-				inflateEnd(&zlibStream);
-				return std::string();
+				piece.m_HasBoundary = isAtBlockBoundary;
+				piece.m_CompressedPos = inPos - zlibStream.avail_in;
+				piece.m_Bits = zlibStream.data_type & 7;
+				if (!m_Member->addPiece(std::move(piece)))
+				{
+					break;
+				}
+				piece = GZipMember::Piece();
+				piece.m_Data.reserve(MIN_PIECE_SIZE + CHUNK_SIZE);
 			}
 		}
-	}  // while (true)
-	// Should not get here, the loop above only has a return, no break
-	assert(!"Invalid code path");
-	return std::string();
+		inflateEnd(&zlibStream);
+		return res;
+	}
+};
+
+
+
+
+
+/** Returns the positions in the data that look like the start of a GZIP member (magic, deflate method, valid flags,
+known compression level and OS values).
+Some of the positions may be false candidates inside the compressed data, these are weeded out by inflating. */
+static std::vector<size_t> findGZipMemberCandidates(const char * a_Data, size_t a_Size)
+{
+	static const size_t MIN_MEMBER_SIZE = 20;  // 10 bytes header, 2 bytes empty deflate, 8 bytes trailer
+	std::vector<size_t> res;
+	if (a_Size < MIN_MEMBER_SIZE)
+	{
+		return res;
+	}
+	auto data = reinterpret_cast<const unsigned char *>(a_Data);
+	auto end = data + a_Size - MIN_MEMBER_SIZE + 1;
+	auto pos = data;
+	while ((pos = static_cast<const unsigned char *>(memchr(pos, 0x1f, static_cast<size_t>(end - pos)))) != nullptr)
+	{
+		if (
+			(pos[1] == 0x8b) && (pos[2] == 8) &&                  // Magic and deflate method
+			((pos[3] & 0xe0) == 0) &&                              // Reserved flags
+			((pos[8] == 0) || (pos[8] == 2) || (pos[8] == 4)) &&   // Extra flags (compression level)
+			((pos[9] <= 13) || (pos[9] == 255))                    // OS
+		)
+		{
+			res.push_back(static_cast<size_t>(pos - data));
+		}
+		pos += 1;
+	}
+	return res;
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// TextChunk, TextChunkParseTask:
+
+/** A part of a big plaintext log file, parsed separately in its own thread. */
+struct TextChunk
+{
+	/** The parser used for the chunk, its LogFile receives the chunk's messages. */
+	std::unique_ptr<LogTextParser> m_Parser;
+
+	/** Position of the chunk's first byte within the complete text (start of a message line). */
+	size_t m_Start;
+
+	/** Position right after the chunk's last byte within the complete text. */
+	size_t m_End;
+
+	/** True if the chunk was parsed successfully. */
+	bool m_IsSuccess;
+
+	/** Released once the parsing task has finished. */
+	QSemaphore m_Done;
+
+
+	TextChunk(std::unique_ptr<LogTextParser> && a_Parser, size_t a_Start):
+		m_Parser(std::move(a_Parser)),
+		m_Start(a_Start),
+		m_End(a_Start),
+		m_IsSuccess(false)
+	{
+		m_Parser->startAt(a_Start);
+	}
+};
+
+typedef std::shared_ptr<TextChunk> TextChunkPtr;
+
+
+
+
+
+/** Parses a single TextChunk of the complete text. */
+class TextChunkParseTask:
+	public QRunnable
+{
+public:
+	TextChunkParseTask(const char * a_CompleteText, TextChunkPtr a_Chunk):
+		m_CompleteText(a_CompleteText),
+		m_Chunk(a_Chunk)
+	{
+	}
+
+
+	virtual void run() override
+	{
+		m_Chunk->m_IsSuccess = (
+			m_Chunk->m_Parser->processBlock(m_CompleteText + m_Chunk->m_Start, m_Chunk->m_End - m_Chunk->m_Start) &&
+			m_Chunk->m_Parser->finishChunk()
+		);
+		m_Chunk->m_Done.release();
+	}
+
+
+protected:
+
+	/** The complete text, the chunk is a part of it. */
+	const char * m_CompleteText;
+
+	/** The chunk to parse. */
+	TextChunkPtr m_Chunk;
+};
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// FileParser:
+
+FileParser::FileParser(std::atomic<bool> & a_ShouldAbort):
+	m_ShouldAbort(a_ShouldAbort),
+	m_ShouldCompressText(false),
+	m_ShouldParseLazily(false),
+	m_Generation(0),
+	m_NumReportHolds(0)
+{
+}
+
+
+
+
+void FileParser::parse(const QString & a_FileName)
+{
+	parse(a_FileName, openFile(a_FileName));
+}
+
+
+
+
+
+void FileParser::parse(const QString & a_FileName, TextBufferPtr a_Contents)
+{
+	m_FileName = a_FileName;
+	m_InnerFileName.clear();
+	m_SourceIdentification.clear();
+	if (a_Contents == nullptr)
+	{
+		emit parseFailed(tr("Cannot open file %1 for reading").arg(a_FileName));
+	}
+	else
+	{
+		parseContents(a_Contents);
+	}
+	emit parsedAllFiles();
+}
+
+
+
+
+
+FileParser::~FileParser()
+{
+}
+
+
+
+
+
+TextBufferPtr FileParser::openFile(const QString & a_FileName, bool a_ShouldMap)
+{
+	std::unique_ptr<QFile> f(new QFile(a_FileName));
+	if (!f->open(QFile::ReadOnly))
+	{
+		return nullptr;
+	}
+	if (!a_ShouldMap)
+	{
+		return std::make_shared<StringTextBuffer>(readWholeStream(*f));
+	}
+	return mapWholeFile(std::move(f));
+}
+
+
+
+
+
+bool FileParser::startFollowing(LogFilePtr a_LogFile, const char * a_Sample, size_t a_SampleSize)
+{
+	if (a_LogFile->getCompleteText().isCompressed())
+	{
+		return false;
+	}
+	auto textFormat = detectTextFormat(a_Sample, a_SampleSize);
+	if (textFormat == tfUnknown)
+	{
+		return false;
+	}
+
+	// The parser's own LogFile is replaced with a_LogFile right away, so it needs no text:
+	m_FollowParser = createTextParser(textFormat, nullptr);
+	m_FollowParser->continueLogFile(a_LogFile);
+	return true;
+}
+
+
+
+
+
+bool FileParser::parseAppendedData(const char * a_Data, size_t a_Size)
+{
+	assert(m_FollowParser != nullptr);
+	auto logFile = m_FollowParser->logFile();
+	logFile->appendText(a_Data, a_Size);
+	if (!m_FollowParser->processBlock(a_Data, a_Size))
+	{
+		return false;
+	}
+
+	// The follow-up parsing runs in the thread that reads the LogFile, so even the last message can be published:
+	logFile->publishMessages(true);
+	return true;
+}
+
+
+
+
+
+void FileParser::parseZipEntry(const QString & a_FileName, ZipArchivePtr a_Archive, size_t a_EntryIndex)
+{
+	m_FileName = a_FileName;
+	m_InnerFileName.clear();
+	m_SourceIdentification.clear();
+	parseZipEntryContents(*a_Archive, a_Archive->entries()[a_EntryIndex]);
+	emit parsedAllFiles();
+}
+
+
+
+
+
+bool FileParser::parseContents(TextBufferPtr a_Contents)
+{
+	// Try to recognize format based on the initial data in the stream:
+	auto handler = getFormatHandler(*a_Contents);
+	if (!handler)
+	{
+		return false;
+	}
+	return handler(a_Contents);
 }
 
 
 
 
 
-////////////////////////////////////////////////////////////////////////////////
-// PlainTextMDMVAHParser:
-
-/** Parses log data stream formatted in an MDM / VAH format. */
-class PlainTextMDMVAHParser
+std::function<bool (TextBufferPtr)> FileParser::getFormatHandler(const TextBuffer & a_Contents)
 {
-public:
-	PlainTextMDMVAHParser(
-		FileParser & a_FileParser,
-		const QString & a_FileName,
-		const QString & a_InnerFileName,
-		std::string && a_CompleteText
-	):
-		m_FileParser(a_FileParser),
-		m_LogFile(new LogFile(
-			a_FileName, a_InnerFileName, LogFile::SourceType::stMDMVAH, "", std::move(a_CompleteText)
-		))
+	auto contents = a_Contents.data();
+	if (a_Contents.size() < 2)
 	{
+		emit failedToRecognize(tr("Not enough data present in the file"));
+		return nullptr;
 	}
 
-
-	/** Parses the contents stored in m_LogFile into messages
-	Returns true on success, false on failure. */
-	bool parseContents()
+	// Test for GZIP header:
+	if ((contents[0] == 0x1f) && (static_cast<unsigned char>(contents[1]) == 0x8b))
 	{
-		resetAfterLine();
-		const auto & completeText = m_LogFile->getCompleteText();
-		if (!parseBuf(completeText.c_str(), completeText.size()))
+		return [this](TextBufferPtr a_HContents)
 		{
-			return false;
-		}
-		emit m_FileParser.finishedParsingFile(m_LogFile);
-		return true;
+			return this->parseGZipContents(a_HContents);
+		};
 	}
 
-
-protected:
-
-	/** Internal state of the parser. */
-	enum
+	// Test for ZIP header:
+	if (ZipArchive::hasZipSignature(contents, a_Contents.size()))
 	{
-		sYear,
-		sMonth,
-		sDay,
-		sHour,
-		sMinute,
-		sSecond,
-		sLogLevel,
-		sThreadID,
-		sMessage,
-		sContinuation,
-	} m_State;
-
-	/** The FileParser instance that has created this helper.
-	Used for detecting abortion and to report the parsed files. */
-	FileParser & m_FileParser;
-
-	/** The LogFile into which the messages are added. */
-	LogFilePtr m_LogFile;
-
-	// Stored state of the parser for the current line:
-	int m_CurrentYear, m_CurrentMonth, m_CurrentDay, m_CurrentHour, m_CurrentMinute, m_CurrentSecond;
-	quint64 m_CurrentThreadID;
-	LogFile::LogLevel m_CurrentLogLevel;
-	bool m_HasJustFinishedLine;
+		return [this](TextBufferPtr a_HContents)
+		{
+			return this->parseZipContents(a_HContents);
+		};
+	}
 
+	// Test for TAR header:
+	if (TarParser::isTarHeader(contents, a_Contents.size()))
+	{
+		return [this](TextBufferPtr a_HContents)
+		{
+			return this->parseTarContents(a_HContents);
+		};
+	}
 
-	/** Translates the loglevel indicator character into the internal loglevel value. */
-	LogFile::LogLevel logLevelFromChar(char a_Indicator)
+	// Test for plain text formats:
+	auto textFormat = detectTextFormat(contents, a_Contents.size());
+	if (textFormat != tfUnknown)
 	{
-		switch (a_Indicator)
+		return [this, textFormat](TextBufferPtr a_HContents)
 		{
-			case 'f':
-			case 'F':
-			{
-				return LogFile::LogLevel::llFatal;
-			}
-			case 'c':
-			case 'C':
-			{
-				return LogFile::LogLevel::llCritical;
-			}
-			case 'e':
-			case 'E':
-			{
-				return LogFile::LogLevel::llError;
-			}
-			case 'w':
-			case 'W':
-			{
-				return LogFile::LogLevel::llWarning;
-			}
-			case 'i':
-			case 'I':
-			{
-				return LogFile::LogLevel::llInformation;
-			}
-			case 'd':
-			case 'D':
-			{
-				return LogFile::LogLevel::llDebug;
-			}
-			case 't':
-			case 'T':
-			{
-				return LogFile::LogLevel::llTrace;
-			}
-			case 's':
-			case 'S':
-			{
-				return LogFile::LogLevel::llStatus;
-			}
-			default:
-			{
-				return LogFile::LogLevel::llUnknown;
-			}
-		}
+			return this->parseTextContents(textFormat, a_HContents);
+		};
 	}
 
+	emit failedToRecognize(tr("Did not match any known format"));
+	return nullptr;
+}
 
 
-	/** Resets the parser state after parsing a line. */
-	void resetAfterLine()
-	{
-		m_CurrentYear = 0;
-		m_CurrentMonth = 0;
-		m_CurrentDay = 0;
-		m_CurrentHour = 0;
-		m_CurrentMinute = 0;
-		m_CurrentSecond = 0;
-		m_CurrentThreadID = 0;
-		m_State = sYear;
-		m_HasJustFinishedLine = true;
-	}
 
 
 
-	/** Processes the specified logfile contents buffer. */
-	bool parseBuf(const char * a_Buf, size_t a_Length)
+FileParser::TextFormat FileParser::detectTextFormat(const char * a_Sample, size_t a_SampleSize)
+{
+	// Test if most characters within the first 1000 bytes are plain letters / CR / LF / SP / HT
+	size_t numPlainText = 0;
+	auto size = std::min<size_t>(a_SampleSize, 1000);
+	for (size_t i = 0; i < size; i++)
+	{
+		auto v = a_Sample[i];
+		if (
+			(v == 0x09) ||  // HT
+			(v == 0x0a) ||  // LF
+			(v == 0x0d) ||  // CR
+			((v >= 32) && (v < 127))
+		)
+		{
+			numPlainText = numPlainText + 1;
+		}
+	}
+	if ((size - numPlainText < size / 50) && (a_SampleSize > 21))  // Less than 2 % "weird" characters
 	{
-		int linesBeforeAbortCheck = 1000;
-		size_t lastEOL = 0;
-		size_t lastContinuationBegin = 0;
-		size_t lastMessageBegin = 0;
-		for (size_t i = 0; i < a_Length; ++i)
+		// Check that the first line starts with a date
+		static const QString format = "yyyy-MM-dd HH:mm:ss";
+		auto dateTimeString = QString::fromUtf8(a_Sample, 19);
+		QDateTime dateTime = QDateTime::fromString(dateTimeString, format);
+		if (dateTime.isValid())
 		{
-			auto ch = a_Buf[i];
-			if ((ch == '\n') || (ch == '\r'))
+			// Use the first known format that matches the sample:
+			for (const auto & textFormat: textFormats())
 			{
-				if (linesBeforeAbortCheck > 0)
-				{
-					linesBeforeAbortCheck -= 1;
-				}
-				else
-				{
-					linesBeforeAbortCheck = 1000;
-					if (m_FileParser.m_ShouldAbort.load())  // This check is a bit expensive, don't do it too often
-					{
-						return false;
-					}
-				}
-				if (m_HasJustFinishedLine)
-				{
-					// This was a CRLF, skip
-					m_HasJustFinishedLine = false;
-					continue;
-				}
-				// Process end-of-line - either add message or add continuation:
-				if (m_State == sMessage)
+				if (textFormat.m_MatchesSample(a_Sample, a_SampleSize))
 				{
-					// We have parsed a full message, add it now:
-					QDateTime dt(
-						QDate(m_CurrentYear, m_CurrentMonth, m_CurrentDay),
-						QTime(m_CurrentHour, m_CurrentMinute, m_CurrentSecond)
-					);
-					m_LogFile->addMessage(
-						std::move(dt),
-						m_CurrentLogLevel,
-						std::string(),
-						m_CurrentThreadID,
-						lastMessageBegin, i - lastMessageBegin
-					);
-				}
-				else
-				{
-					// We have a continuation:
-					if (!m_LogFile->appendContinuationToLastMessage(i - lastContinuationBegin))
-					{
-						return false;
-					}
+					return textFormat.m_TextFormat;
 				}
-				lastEOL = i;
-				resetAfterLine();
-				continue;
 			}
-			m_HasJustFinishedLine = false;
+		}
+	}
+	return tfUnknown;
+}
 
-			switch (m_State)
-			{
-				case sYear:
-				{
-					if ((ch >= '0') && (ch <= '9'))
-					{
-						m_CurrentYear = m_CurrentYear * 10 + ch - '0';
-					}
-					else
-					{
-						if (ch == '-')
-						{
-							m_State = sMonth;
-						}
-						else
-						{
-							lastContinuationBegin = lastEOL;
-							m_State = sContinuation;
-						}
-					}
-					break;
-				}  // case sYear
 
-				case sMonth:
-				{
-					if ((ch >= '0') && (ch <= '9'))
-					{
-						m_CurrentMonth = m_CurrentMonth * 10 + ch - '0';
-					}
-					else
-					{
-						m_State = sDay;
-					}
-					break;
-				}  // case sMonth
 
-				case sDay:
-				{
-					if ((ch >= '0') && (ch <= '9'))
-					{
-						m_CurrentDay = m_CurrentDay * 10 + ch - '0';
-					}
-					else
-					{
-						m_State = sHour;
-					}
-					break;
-				}  // case sDay
 
-				case sHour:
-				{
-					if ((ch >= '0') && (ch <= '9'))
-					{
-						m_CurrentHour = m_CurrentHour * 10 + ch - '0';
-					}
-					else
-					{
-						m_State = sMinute;
-					}
-					break;
-				}  // case sHour
 
-				case sMinute:
-				{
-					if ((ch >= '0') && (ch <= '9'))
-					{
-						m_CurrentMinute = m_CurrentMinute * 10 + ch - '0';
-					}
-					else
-					{
-						m_State = sSecond;
-					}
-					break;
-				}  // case sMinute
+const std::vector<FileParser::TextFormatDescription> & FileParser::textFormats()
+{
+	// The formats are detected in this order:
+	static const std::vector<TextFormatDescription> formats =
+	{
+		{
+			tfMDMVAH, "MDM / VAH",
+			&MDMVAHLogFormat::matchesSample,
+			&PlainTextLogParser<MDMVAHLogFormat>::isMessageLine,
+			&createPlainTextLogParser<MDMVAHLogFormat>
+		},
+		{
+			tfEra, "ERA",
+			&EraLogFormat::matchesSample,
+			&PlainTextLogParser<EraLogFormat>::isMessageLine,
+			&createPlainTextLogParser<EraLogFormat>
+		},
+	};
+	return formats;
+}
 
-				case sSecond:
-				{
-					if ((ch >= '0') && (ch <= '9'))
-					{
-						m_CurrentSecond = m_CurrentSecond * 10 + ch - '0';
-					}
-					else
-					{
-						m_State = sLogLevel;
-					}
-					break;
-				}  // case sSecond
 
-				case sLogLevel:
-				{
-					if (ch == '[')
-					{
-						m_State = sThreadID;
-					}
-					else if (ch == ' ')
-					{
-						// Do nothing
-					}
-					else
-					{
-						m_CurrentLogLevel = logLevelFromChar(ch);
-					}
-					break;
-				}  // sLogLevel
 
-				case sThreadID:
-				{
-					if (ch == ']')
-					{
-						// Do nothing yet
-					}
-					else if (ch == ' ')
-					{
-						lastMessageBegin = i;
-						m_State = sMessage;
-					}
-					if ((ch >= '0') && (ch <= '9'))
-					{
-						m_CurrentThreadID = m_CurrentThreadID * 10 + static_cast<quint64>(ch - '0');
-					}
-				}  // sThreadID
 
-				case sMessage: break;  // Nothing needed here
-				case sContinuation: break;  // Nothing needed here
-			}  // swith (ch)
-		}  // for i - a_Buf[]
 
-		// Ran out of data to parse, add anything left over:
-		switch (m_State)
+const FileParser::TextFormatDescription & FileParser::textFormatDescription(TextFormat a_TextFormat)
+{
+	for (const auto & textFormat: textFormats())
+	{
+		if (textFormat.m_TextFormat == a_TextFormat)
 		{
-			case sMessage:
-			{
-				QDateTime dt(
-					QDate(m_CurrentYear, m_CurrentMonth, m_CurrentDay),
-					QTime(m_CurrentHour, m_CurrentMinute, m_CurrentSecond)
-				);
-				m_LogFile->addMessage(
-					std::move(dt),
-					m_CurrentLogLevel,
-					std::string(),
-					m_CurrentThreadID,
-					lastMessageBegin, a_Length - lastMessageBegin
-				);
-				break;
-			}
-			case sContinuation:
-			{
-				if (!m_LogFile->appendContinuationToLastMessage(a_Length - lastMessageBegin))
-				{
-					return false;
-				}
-				break;
-			}
-			default:
-			{
-				break;
-			}
+			return textFormat;
 		}
-		return true;
 	}
-};
+	assert(!"Unknown text format");
+	return textFormats().front();
+}
 
 
 
 
 
-////////////////////////////////////////////////////////////////////////////////
-// PlainTextEraParser:
+std::unique_ptr<LogTextParser> FileParser::createTextParser(TextFormat a_TextFormat, TextBufferPtr a_CompleteText)
+{
+	return std::unique_ptr<LogTextParser>(textFormatDescription(a_TextFormat).m_CreateParser(*this, a_CompleteText));
+}
 
-/** Parses log data stream formatted in an ERA format. */
-class PlainTextEraParser
+
+
+
+
+bool FileParser::parseZipContents(TextBufferPtr a_Contents)
 {
-public:
-	PlainTextEraParser(
-		FileParser & a_FileParser,
-		const QString & a_FileName,
-		const QString & a_InnerFileName,
-		const QString & a_SourceIdentification,
-		std::string && a_CompleteText
-	):
-		m_FileParser(a_FileParser),
-		m_LogFile(new LogFile(
-			a_FileName, a_InnerFileName,
-			LogFile::SourceType::stUnknown, a_SourceIdentification,
-			std::move(a_CompleteText)
-		))
+	ZipArchivePtr archive;
+	try
 	{
+		archive = std::make_shared<ZipArchive>(a_Contents);
+	}
+	catch (const EFileReadError &)
+	{
+		emit parseFailed(tr("Invalid ZIP archive"));
+		return false;
 	}
 
-
-	/** Parses m_LogFile's m_CompleteText into messages within that LogFile.
-	Returns true on success, false on failure. */
-	bool parseContents()
+	// If there's someone to parse the entries in parallel, hand them over:
+	if (isSignalConnected(QMetaMethod::fromSignal(&FileParser::foundZipEntry)))
 	{
-		resetAfterLine();
-		const auto & completeText = m_LogFile->getCompleteText();
-		if (!processBuf(completeText.c_str(), completeText.size()))
+		for (size_t i = 0; i < archive->entries().size(); i++)
 		{
-			return false;
+			emit foundZipEntry(m_FileName, m_Generation, archive, i);
 		}
-		m_LogFile->tryIdentifySource();
-		emit m_FileParser.finishedParsingFile(m_LogFile);
 		return true;
 	}
 
-
-protected:
-
-	/** Internal state of the parser. */
-	enum
+	// Parse the entries sequentially:
+	bool res = true;
+	for (const auto & entry: archive->entries())
 	{
-		sYear,
-		sMonth,
-		sDay,
-		sHour,
-		sMinute,
-		sSecond,
-		sLogLevel,
-		sLogLevelIgnore,  // Second and next characters from the LogLevel
-		sComponent,
-		sComponentIgnore,  // Whitespace and symbols after Component, before ThreadID
-		sThreadID,
-		sMessage,
-		sContinuation,
-	} m_State;
-
-	/** The FileParser instance that has created this helper.
-	Used for detecting abortion and to report the parsed files. */
-	FileParser & m_FileParser;
+		if (m_ShouldAbort.load())
+		{
+			return false;
+		}
+		res = parseZipEntryContents(*archive, entry) && res;
+	}
+	return res;
+}
 
-	/** The LogFile into which the messages are added. */
-	LogFilePtr m_LogFile;
 
-	// Stored state of the parser for the current line:
-	int m_CurrentYear, m_CurrentMonth, m_CurrentDay, m_CurrentHour, m_CurrentMinute, m_CurrentSecond;
-	quint64 m_CurrentThreadID;
-	LogFile::LogLevel m_CurrentLogLevel;
-	std::string m_CurrentComponent;
 
 
 
-	/** Resets the parser state after parsing a line. */
-	void resetAfterLine()
+bool FileParser::parseZipEntryContents(const ZipArchive & a_Archive, const ZipArchive::Entry & a_Entry)
+{
+	if (a_Entry.m_FileName.endsWith("/") || (a_Entry.m_UncompressedSize == 0))
+	{
+		// A folder or an empty file, nothing to parse
+		return true;
+	}
+	m_InnerFileName = a_Entry.m_FileName;
+	if (a_Entry.m_IsEncrypted)
 	{
-		m_CurrentYear = 0;
-		m_CurrentMonth = 0;
-		m_CurrentDay = 0;
-		m_CurrentHour = 0;
-		m_CurrentMinute = 0;
-		m_CurrentSecond = 0;
-		m_CurrentThreadID = 0;
-		m_State = sYear;
+		emit parseFailed(tr("ZIP entry %1 is encrypted").arg(a_Entry.m_FileName));
+		return false;
 	}
-
-
-
-	/** Translates the loglevel indicator character into the internal loglevel value. */
-	LogFile::LogLevel logLevelFromChar(char a_Indicator)
+	TextBufferPtr data;
+	try
 	{
-		switch (a_Indicator)
-		{
-			case 'f':
-			case 'F':
-			{
-				return LogFile::LogLevel::llFatal;
-			}
-			case 'c':
-			case 'C':
-			{
-				return LogFile::LogLevel::llCritical;
-			}
-			case 'e':
-			case 'E':
-			{
-				return LogFile::LogLevel::llError;
-			}
-			case 'w':
-			case 'W':
-			{
-				return LogFile::LogLevel::llWarning;
-			}
-			case 'i':
-			case 'I':
-			{
-				return LogFile::LogLevel::llInformation;
-			}
-			case 'd':
-			case 'D':
-			{
-				return LogFile::LogLevel::llDebug;
-			}
-			case 't':
-			case 'T':
-			{
-				return LogFile::LogLevel::llTrace;
-			}
-			case 's':
-			case 'S':
-			{
-				return LogFile::LogLevel::llStatus;
-			}
-			default:
+		data = a_Archive.entryData(a_Entry);
+	}
+	catch (const EFileReadError &)
+	{
+		emit parseFailed(tr("Invalid ZIP entry %1").arg(a_Entry.m_FileName));
+		return false;
+	}
+	switch (a_Entry.m_CompressionMethod)
+	{
+		case ZipArchive::cmStored:  return parseContents(data);
+		case ZipArchive::cmDeflate: return parseGZipContents(data, true);
+	}
+	emit failedToRecognize(tr("Unsupported compression method %1 of ZIP entry %2")
+		.arg(a_Entry.m_CompressionMethod)
+		.arg(a_Entry.m_FileName)
+	);
+	return false;
+}
+
+
+
+
+
+bool FileParser::parseGZipContents(TextBufferPtr a_Contents, bool a_IsRawDeflate)
+{
+	Stopwatch sw(a_IsRawDeflate ? "Deflate + parsing" : "GZIP + parsing");
+	GZipTextSink sink(*this, a_Contents, a_IsRawDeflate);
+
+	// Files concatenated from multiple GZIP members can have their members inflated in parallel.
+	// Files with only a few huge members (or a single member with a false candidate inside) are better served
+	// by the speculative parallel inflating of a single member below; the serial decompression handles multiple
+	// members as well:
+	if (!a_IsRawDeflate)
+	{
+		static const size_t MAX_AVG_PARALLEL_MEMBER_SIZE = 64 * 1024 * 1024;
+		auto candidates = findGZipMemberCandidates(a_Contents->data(), a_Contents->size());
+		if ((candidates.size() > 1) && (a_Contents->size() / candidates.size() <= MAX_AVG_PARALLEL_MEMBER_SIZE))
+		{
+			return inflateGZipMembersInParallel(a_Contents, candidates, sink) && sink.finish();
+		}
+
+		// A big single member can still be inflated in parallel, by speculatively decoding from block starts:
+		if ((candidates.size() <= 1) && ParallelInflater::isWorthIt(a_Contents->size()))
+		{
+			sink.addMemberStart(0);
+			switch (ParallelInflater(a_Contents, m_ShouldAbort).inflate(sink))
 			{
-				return LogFile::LogLevel::llUnknown;
+				case ParallelInflater::rSuccess:        return sink.finish();
+				case ParallelInflater::rReceiverFailed: return false;  // Already reported by the sink
+				case ParallelInflater::rAborted:        return false;
+				case ParallelInflater::rDataError:      break;
 			}
+			emit parseFailed(tr("GZIP decompression failed"));
+			return false;
 		}
 	}
 
+	return inflateGZipSerially(a_Contents, 0, a_IsRawDeflate, sink) && sink.finish();
+}
+
+
+
 
-	/** Converts a hex number character to its value.
-	Returns true on success, false if the input is not a valid hex number char. */
-	static bool toHexCharValue(char a_HexChar, quint64 & a_OutValue)
+
+bool FileParser::inflateGZipSerially(
+	TextBufferPtr a_Contents,
+	size_t a_StartPos,
+	bool a_IsRawDeflate,
+	GZipTextSink & a_Sink
+)
+{
+	// Init the ZLIB ungzipper:
+	z_stream zlibStream;
+	memset(&zlibStream, 0, sizeof(zlibStream));
+	auto zr = inflateInit2(&zlibStream, a_IsRawDeflate ? -15 : 31);  // Force GZIP decoding, unless raw
+	if (zr != Z_OK)
 	{
-		switch (a_HexChar)
-		{
-			case '0': a_OutValue =  0; return true;
-			case '1': a_OutValue =  1; return true;
-			case '2': a_OutValue =  2; return true;
-			case '3': a_OutValue =  3; return true;
-			case '4': a_OutValue =  4; return true;
-			case '5': a_OutValue =  5; return true;
-			case '6': a_OutValue =  6; return true;
-			case '7': a_OutValue =  7; return true;
-			case '8': a_OutValue =  8; return true;
-			case '9': a_OutValue =  9; return true;
-			case 'a': a_OutValue = 10; return true;
-			case 'b': a_OutValue = 11; return true;
-			case 'c': a_OutValue = 12; return true;
-			case 'd': a_OutValue = 13; return true;
-			case 'e': a_OutValue = 14; return true;
-			case 'f': a_OutValue = 15; return true;
-			case 'A': a_OutValue = 10; return true;
-			case 'B': a_OutValue = 11; return true;
-			case 'C': a_OutValue = 12; return true;
-			case 'D': a_OutValue = 13; return true;
-			case 'E': a_OutValue = 14; return true;
-			case 'F': a_OutValue = 15; return true;
-		}
+		qDebug("%s: uncompression initialization failed: %d (\"%s\").", __FUNCTION__, zr, zlibStream.msg);
+		emit parseFailed(tr("Cannot initialize GZIP decompression"));
 		return false;
 	}
+	auto compressed = reinterpret_cast<const Bytef *>(a_Contents->data());
+	auto compressedSize = a_Contents->size();
+	auto inPos = a_StartPos;
+	a_Sink.addMemberStart(a_StartPos);
+
+	// Decompress in fixed-size chunks and pass each chunk to the sink as soon as it is decompressed.
+	// The chunks are decompressed into a buffer that always keeps the preceding window (for the index checkpoints):
+	static const size_t CHUNK_SIZE = 64 * 1024;
+	static const size_t WINDOW_SIZE = GZipIndexedTextBuffer::WINDOW_SIZE;
+	static const size_t BUFFER_SIZE = WINDOW_SIZE + CHUNK_SIZE;
+	std::unique_ptr<char[]> buffer(new char[BUFFER_SIZE]);
+	size_t bufferUsed = 0;  // Number of valid bytes in buffer (the most recently decompressed data)
+	bool isFinished = false;
+	while (!isFinished)
+	{
+		// Make space for the next chunk, keep the window:
+		if (bufferUsed + CHUNK_SIZE > BUFFER_SIZE)
+		{
+			memmove(buffer.get(), buffer.get() + bufferUsed - WINDOW_SIZE, WINDOW_SIZE);
+			bufferUsed = WINDOW_SIZE;
+		}
 
+		// Feed the input in pieces, avail_in is too small for huge files:
+		if ((zlibStream.avail_in == 0) && (inPos < compressedSize))
+		{
+			auto len = std::min<size_t>(compressedSize - inPos, 1024 * 1024 * 1024);
+			zlibStream.next_in = const_cast<Bytef *>(compressed + inPos);
+			zlibStream.avail_in = static_cast<uInt>(len);
+			inPos += len;
+		}
 
-	/** Processes a single line from the input.
-	Returns true if the line is processed successfully, false on failure. */
-	bool processBuf(const char * a_Buf, size_t a_Length)
-	{
-		/*
-		Typical line:
-		2017-01-13 04:55:53 Debug: CReplicationModule [Thread 7f43937fe700]: CStepTx: Remote peer signalized...
-		*/
-		int linesBeforeAbortCheck = 1000;
-		size_t lastEOL = 0;
-		size_t lastMessageBegin = 0;
-		size_t lastComponentBegin = 0;
-		bool hasJustFinishedLine = true;
-		for (size_t i = 0; i < a_Length; ++i)
+		// Decompress, stop at deflate block boundaries so that checkpoints can be made:
+		auto out = buffer.get() + bufferUsed;
+		zlibStream.next_out = reinterpret_cast<Bytef *>(out);
+		zlibStream.avail_out = static_cast<uInt>(BUFFER_SIZE - bufferUsed);
+		auto availOutBefore = zlibStream.avail_out;
+		zr = inflate(&zlibStream, Z_BLOCK);
+		auto numDecompressed = availOutBefore - zlibStream.avail_out;
+		bufferUsed += numDecompressed;
+		if (!a_Sink.write(out, numDecompressed))
+		{
+			inflateEnd(&zlibStream);
+			return false;
+		}
+		switch (zr)
 		{
-			auto ch = a_Buf[i];
-			if ((ch == '\n') || (ch == '\r'))
+			case Z_OK:
 			{
-				if (hasJustFinishedLine)
+				bool isAtBlockBoundary = ((zlibStream.data_type & 128) != 0) && ((zlibStream.data_type & 64) == 0);
+				if (isAtBlockBoundary)
 				{
-					// This was a CRLF, skip
-					hasJustFinishedLine = false;
-					continue;
-				}
-
-				// Check whether an abort is requested from the UI thread:
-				if (linesBeforeAbortCheck > 0)
-				{
-					linesBeforeAbortCheck -= 1;
+					auto windowSize = std::min(bufferUsed, WINDOW_SIZE);
+					a_Sink.addCheckpoint(
+						inPos - zlibStream.avail_in, zlibStream.data_type & 7,
+						buffer.get() + bufferUsed - windowSize, windowSize
+					);
 				}
-				else
+				break;
+			}
+			case Z_STREAM_END:
+			{
+				// If another GZIP member follows, continue decompressing it:
+				auto memberEnd = inPos - zlibStream.avail_in;
+				if (
+					!a_IsRawDeflate &&
+					(compressedSize - memberEnd >= 2) &&
+					(compressed[memberEnd] == 0x1f) && (compressed[memberEnd + 1] == 0x8b)
+				)
 				{
-					linesBeforeAbortCheck = 1000;
-					if (m_FileParser.m_ShouldAbort.load())  // This check is a bit expensive, don't do it too often
-					{
-						return false;
-					}
+					inflateReset(&zlibStream);
+					a_Sink.addMemberStart(memberEnd);
+					break;
 				}
-
-				// Process end-of-line - either add message or add continuation:
-				if (m_State == sMessage)
+				if (memberEnd < compressedSize)
 				{
-					// We have parsed a full message, add it now:
-					QDateTime dt(
-						QDate(m_CurrentYear, m_CurrentMonth, m_CurrentDay),
-						QTime(m_CurrentHour, m_CurrentMinute, m_CurrentSecond)
-					);
-					m_LogFile->addMessage(
-						std::move(dt),
-						m_CurrentLogLevel,
-						std::move(m_CurrentComponent),
-						m_CurrentThreadID,
-						lastMessageBegin, i - lastMessageBegin
+					qDebug("%s: Ignoring %llu bytes of trailing garbage after the GZIP data.",
+						__FUNCTION__, static_cast<unsigned long long>(compressedSize - memberEnd)
 					);
 				}
-				else
-				{
-					// We have a continuation:
-					if (!m_LogFile->appendContinuationToLastMessage(i - lastEOL))
-					{
-						return false;
-					}
-				}
-				lastEOL = i;
-				resetAfterLine();
-				hasJustFinishedLine = true;
-				continue;
+				isFinished = true;
+				break;
 			}
-			hasJustFinishedLine = false;
-
-			switch (m_State)
+			default:
 			{
-				case sYear:
-				{
-					if ((ch >= '0') && (ch <= '9'))
-					{
-						m_CurrentYear = m_CurrentYear * 10 + ch - '0';
-					}
-					else
-					{
-						if (ch == '-')
-						{
-							m_State = sMonth;
-						}
-						else
-						{
-							m_State = sContinuation;
-						}
-					}
-					break;
-				}  // case sYear
-
-				case sMonth:
-				{
-					if ((ch >= '0') && (ch <= '9'))
-					{
-						m_CurrentMonth = m_CurrentMonth * 10 + ch - '0';
-					}
-					else
-					{
-						m_State = sDay;
-					}
-					break;
-				}  // case sMonth
-
-				case sDay:
-				{
-					if ((ch >= '0') && (ch <= '9'))
-					{
-						m_CurrentDay = m_CurrentDay * 10 + ch - '0';
-					}
-					else
-					{
-						m_State = sHour;
-					}
-					break;
-				}  // case sDay
-
-				case sHour:
-				{
-					if ((ch >= '0') && (ch <= '9'))
-					{
-						m_CurrentHour = m_CurrentHour * 10 + ch - '0';
-					}
-					else
-					{
-						m_State = sMinute;
-					}
-					break;
-				}  // case sHour
-
-				case sMinute:
-				{
-					if ((ch >= '0') && (ch <= '9'))
-					{
-						m_CurrentMinute = m_CurrentMinute * 10 + ch - '0';
-					}
-					else
-					{
-						m_State = sSecond;
-					}
-					break;
-				}  // case sMinute
-
-				case sSecond:
-				{
-					if ((ch >= '0') && (ch <= '9'))
-					{
-						m_CurrentSecond = m_CurrentSecond * 10 + ch - '0';
-					}
-					else
-					{
-						m_State = sLogLevel;
-					}
-					break;
-				}  // case sSecond
-
-				case sLogLevel:
-				{
-					m_CurrentLogLevel = logLevelFromChar(ch);
-					m_State = sLogLevelIgnore;
-					break;
-				}  // sLogLevel
-
-				case sLogLevelIgnore:
-				{
-					if (ch == ' ')
-					{
-						lastComponentBegin = i + 1;
-						m_State = sComponent;
-					}
-					break;
-				}  // sLogLevelIgnore
+				qDebug("%s: uncompression failed: %d (\"%s\").", __FUNCTION__, zr, zlibStream.msg);
+				inflateEnd(&zlibStream);
+				emit parseFailed(tr("GZIP decompression failed"));
+				return false;
+			}
+		}
+	}
+	inflateEnd(&zlibStream);
+	return true;
+}
 
-				case sComponent:
-				{
-					if (ch == ' ')
-					{
-						m_CurrentComponent.assign(a_Buf + lastComponentBegin, i - lastComponentBegin);
-						m_State = sComponentIgnore;
-					}
-					break;
-				}  // sComponent
 
-				case sComponentIgnore:
-				{
-					if (ch == ' ')
-					{
-						m_State = sThreadID;
-					}
-					break;
-				}  // sComponentIgnore
 
-				case sThreadID:
-				{
-					quint64 v;
-					if (ch == ']')
-					{
-						// Do nothing yet
-					}
-					else if (ch == ' ')
-					{
-						lastMessageBegin = i + 1;
-						m_State = sMessage;
-					}
-					else if (toHexCharValue(ch, v))
-					{
-						m_CurrentThreadID = m_CurrentThreadID * 16 + v;
-					}
-				}  // sThreadID
 
-				case sMessage: break;  // Nothing needed here
-				case sContinuation: break;  // Nothing needed here
-			}  // swith (ch)
-		}  // for i - a_Buf[]
 
-		// Ran out of data to parse, append any leftovers:
-		switch (m_State)
+bool FileParser::inflateGZipMembersInParallel(
+	TextBufferPtr a_Contents,
+	const std::vector<size_t> & a_Candidates,
+	GZipTextSink & a_Sink
+)
+{
+	// Each candidate is inflated in a separate task on the global thread pool (so that there's no deadlock waiting
+	// for tasks queued behind this one in the BackgroundParser's pool). Only a limited number of candidates is
+	// in flight at any time, and the data they inflate ahead of the member being parsed is limited by a shared budget,
+	// so that the memory used doesn't depend on the member sizes:
+	auto & threadPool = *QThreadPool::globalInstance();
+	auto maxInFlight = static_cast<size_t>(std::max(2, QThread::idealThreadCount()));
+	auto budget = std::make_shared<GZipInflateBudget>();
+	std::deque<GZipMemberPtr> inFlight;
+	size_t nextCandidate = 0;
+	auto abortInFlight = [&inFlight]()
+	{
+		for (auto & member: inFlight)
+		{
+			member->abort();
+		}
+	};
+
+	// The real members form a chain: the first one starts at 0 and each next one starts right after the previous
+	// one's trailer (verified by zlib against the CRC and ISIZE fields). Candidates off the chain are discarded:
+	size_t pos = 0;
+	auto size = a_Contents->size();
+	auto data = a_Contents->data();
+	while (pos < size)
+	{
+		while ((inFlight.size() < maxInFlight) && (nextCandidate < a_Candidates.size()))
 		{
-			case sMessage:
+			auto member = std::make_shared<GZipMember>(a_Candidates[nextCandidate], budget);
+			threadPool.start(new GZipMemberInflateTask(a_Contents, member));
+			inFlight.push_back(member);
+			nextCandidate += 1;
+		}
+		if (inFlight.empty() || (inFlight.front()->m_Start > pos))
+		{
+			abortInFlight();
+
+			// A member whose header didn't pass the candidate filter (such as an unusual OS value) is still decoded:
+			if ((size - pos >= 2) && (data[pos] == '\x1f') && (data[pos + 1] == '\x8b'))
 			{
-				QDateTime dt(
-					QDate(m_CurrentYear, m_CurrentMonth, m_CurrentDay),
-					QTime(m_CurrentHour, m_CurrentMinute, m_CurrentSecond)
-				);
-				m_LogFile->addMessage(
-					std::move(dt),
-					m_CurrentLogLevel,
-					std::move(m_CurrentComponent),
-					m_CurrentThreadID,
-					lastMessageBegin, a_Length - lastMessageBegin
-				);
+				return inflateGZipSerially(a_Contents, pos, false, a_Sink);
 			}
-			case sContinuation:
+			qDebug("%s: Ignoring %llu bytes of trailing garbage after the GZIP data.",
+				__FUNCTION__, static_cast<unsigned long long>(size - pos)
+			);
+			return true;
+		}
+		auto member = inFlight.front();
+		if (member->m_Start < pos)
+		{
+			// A false candidate inside an already processed member:
+			member->abort();
+			inFlight.pop_front();
+			continue;
+		}
+
+		// Pass the member's data to the sink as it gets inflated, with the checkpoints at the block boundaries:
+		member->startConsuming();
+		a_Sink.addMemberStart(member->m_Start);
+		GZipMember::Piece piece;
+		while (member->takePiece(piece))
+		{
+			if (m_ShouldAbort.load() || !a_Sink.write(piece.m_Data.data(), piece.m_Data.size()))
 			{
-				// We have a continuation:
-				if (!m_LogFile->appendContinuationToLastMessage(a_Length - lastEOL))
-				{
-					return false;
-				}
-				break;
+				abortInFlight();
+				return false;
 			}
-			default:
+			if (piece.m_HasBoundary)
 			{
-				break;
+				auto windowSize = std::min(piece.m_Data.size(), GZipIndexedTextBuffer::WINDOW_SIZE);
+				a_Sink.addCheckpoint(
+					piece.m_CompressedPos, piece.m_Bits,
+					piece.m_Data.data() + piece.m_Data.size() - windowSize, windowSize
+				);
 			}
 		}
-		return true;
+		inFlight.pop_front();
+		if (!member->m_IsValid)
+		{
+			qDebug("%s: uncompression of the member at %llu failed.", __FUNCTION__, static_cast<unsigned long long>(pos));
+			abortInFlight();
+			emit parseFailed(tr("GZIP decompression failed"));
+			return false;
+		}
+		pos = member->m_End;
 	}
-};
-
+	abortInFlight();
+	return true;
+}
 
 
 
 
-////////////////////////////////////////////////////////////////////////////////
-// FileParser:
 
-FileParser::FileParser(std::atomic<bool> & a_ShouldAbort):
-	m_ShouldAbort(a_ShouldAbort)
+bool FileParser::parseTarContents(TextBufferPtr a_Contents)
 {
+	Stopwatch sw("TAR parsing");
+	TarParser parser(*this, a_Contents, true);
+	return (parser.processBlock(a_Contents->data(), a_Contents->size()) && parser.finish());
 }
 
 
 
 
-void FileParser::parse(const QString & a_FileName)
+
+bool FileParser::parseTextContents(TextFormat a_TextFormat, TextBufferPtr a_Contents)
 {
-	m_FileName = a_FileName;
-	m_InnerFileName.clear();
-	m_SourceIdentification.clear();
-	QFile f(a_FileName);
-	if (!f.open(QFile::ReadOnly))
+	static const size_t MIN_PARALLEL_SIZE = 32 * 1024 * 1024;
+	if ((a_Contents->size() >= MIN_PARALLEL_SIZE) && (QThread::idealThreadCount() > 1))
 	{
-		emit parseFailed(tr("Cannot open file %1 for reading").arg(a_FileName));
+		return parseTextContentsInParallel(a_TextFormat, a_Contents);
 	}
-	else
+
+	auto parser = createTextParser(a_TextFormat, a_Contents);
+	if (canPublishProgressively())
 	{
-		auto contents = readWholeStream(f);
-		parseContents(std::move(contents));
+		parser->startPublishingProgressively();
 	}
-	emit parsedAllFiles();
+	auto formatName = textFormatDescription(a_TextFormat).m_Name;
+	Stopwatch sw(QString("%1 parsing").arg(formatName));
+	if (!parser->processBlock(a_Contents->data(), a_Contents->size()) || !parser->finish())
+	{
+		emit parseFailed(tr("%1 log parser error").arg(formatName));
+		return false;
+	}
+	return true;
 }
 
 
 
 
 
-bool FileParser::parseContents(std::string && a_Contents)
+void FileParser::reportFileParsed(LogFilePtr a_LogFile)
 {
-	// Try to recognize format based on the initial data in the stream:
-	auto handler = getFormatHandler(a_Contents);
-	if (!handler)
+	if (m_NumReportHolds > 0)
 	{
-		return false;
+		m_HeldBackFiles.push_back(a_LogFile);
+		return;
+	}
+	if (m_ShouldCompressText)
+	{
+		Stopwatch sw("Compressing text");
+		a_LogFile->compressText();
 	}
-	return handler(std::move(a_Contents));
+	emit finishedParsingFile(a_LogFile);
 }
 
 
 
 
 
-std::function<bool (std::string &&)> FileParser::getFormatHandler(const std::string & a_Contents)
+void FileParser::reportMessagesPublished(LogFilePtr a_LogFile)
 {
-	if (a_Contents.size() < 2)
-	{
-		emit failedToRecognize(tr("Not enough data present in the file"));
-		return nullptr;
-	}
+	emit publishedMessages(a_LogFile);
+}
 
-	// Test for GZIP header:
-	if ((a_Contents[0] == 0x1f) && (static_cast<unsigned char>(a_Contents[1]) == 0x8b))
-	{
-		return [this](std::string && a_HContents)
-		{
-			return this->parseGZipContents(std::move(a_HContents));
-		};
-	}
 
-	// Test if most characters within the first 1000 bytes are plain letters / CR / LF / SP / HT
-	size_t numPlainText = 0;
-	auto size = std::min<size_t>(a_Contents.size(), 1000);
-	for (size_t i = 0; i < size; i++)
+
+
+
+void FileParser::releaseReports()
+{
+	assert(m_NumReportHolds > 0);
+	m_NumReportHolds -= 1;
+	if (m_NumReportHolds > 0)
 	{
-		auto v = a_Contents[i];
-		if (
-			(v == 0x09) ||  // HT
-			(v == 0x0a) ||  // LF
-			(v == 0x0d) ||  // CR
-			((v >= 32) && (v < 127))
-		)
-		{
-			numPlainText = numPlainText + 1;
-		}
+		return;
 	}
-	if (size - numPlainText < size / 50)  // Less than 2 % "weird" characters
+	std::vector<LogFilePtr> heldBack;
+	std::swap(heldBack, m_HeldBackFiles);
+	for (const auto & logFile: heldBack)
 	{
-		// Check that the first line starts with a date
-		static const QString format = "yyyy-MM-dd HH:mm:ss";
-		auto dateTimeString = QString::fromStdString(a_Contents.substr(0, 19));
-		QDateTime dateTime = QDateTime::fromString(dateTimeString, format);
-		if (dateTime.isValid())
-		{
-			// Decide between the MDM/VAH format and ERA format
-			// VAH format always has a space as the 21st character
-			if (a_Contents[21] == ' ')
-			{
-				return [this](std::string && a_HContents)
-				{
-					return this->parseTextContentsMDMVAH(std::move(a_HContents));
-				};
-			}
-			else
-			{
-				return [this](std::string && a_HContents)
-				{
-					return this->parseTextContentsEra(std::move(a_HContents));
-				};
-			}
-		}
+		reportFileParsed(logFile);
 	}
-
-	emit failedToRecognize(tr("Did not match any known format"));
-	return nullptr;
 }
 
 
 
 
 
-bool FileParser::parseGZipContents(std::string && a_Contents)
+bool FileParser::parseTextContentsInParallel(TextFormat a_TextFormat, TextBufferPtr a_Contents)
 {
-	Stopwatch sw("GZIP + parsing");
-	return parseContents(ungzipString(a_Contents.data(), a_Contents.size()));
-}
-
-
-
+	auto formatName = textFormatDescription(a_TextFormat).m_Name;
+	Stopwatch sw(QString("Parallel %1 parsing").arg(formatName));
+
+	// Split the text into roughly equal chunks, each starting at a message line after the nominal split position.
+	// A nominal split with no message line before the next one is dropped (its chunk is merged with the previous one):
+	static const size_t MIN_CHUNK_SIZE = 8 * 1024 * 1024;
+	auto data = a_Contents->data();
+	auto size = a_Contents->size();
+	auto numChunks = std::max<size_t>(1, std::min(static_cast<size_t>(QThread::idealThreadCount()), size / MIN_CHUNK_SIZE));
+	std::vector<TextChunkPtr> chunks;
+	chunks.push_back(std::make_shared<TextChunk>(createTextParser(a_TextFormat, a_Contents), 0));
+	for (size_t i = 1; i < numChunks; i++)
+	{
+		auto nominalEnd = size * (i + 1) / numChunks;
+		auto searchFrom = std::max(size * i / numChunks, chunks.back()->m_Start + 1) - 1;  // The EOL preceding the line
+		while (searchFrom < nominalEnd)
+		{
+			// Same EOLs as the parsers use, including the CR-only ones (the LF of a CRLF then yields an empty line):
+			auto eol = findEOL(data + searchFrom, data + nominalEnd);
+			if (eol == data + nominalEnd)
+			{
+				break;
+			}
+			auto pos = static_cast<size_t>(eol - data) + 1;
+			if ((pos < size) && isMessageLineStart(a_TextFormat, a_Contents, pos))
+			{
+				chunks.back()->m_End = pos;
+				chunks.push_back(std::make_shared<TextChunk>(createTextParser(a_TextFormat, a_Contents), pos));
+				break;
+			}
+			searchFrom = pos;
+		}
+	}
+	chunks.back()->m_End = size;
 
+	// Parse the first chunk in this thread, the rest in the global thread pool (so that there's no deadlock waiting
+	// for tasks queued behind this one in the BackgroundParser's pool):
+	auto & threadPool = *QThreadPool::globalInstance();
+	for (size_t i = 1; i < chunks.size(); i++)
+	{
+		threadPool.start(new TextChunkParseTask(data, chunks[i]));
+	}
+	// The first chunk publishes its messages progressively, the rest are published as they are joined:
+	auto & firstChunk = *chunks[0];
+	auto isPublishingProgressively = canPublishProgressively();
+	if (isPublishingProgressively)
+	{
+		firstChunk.m_Parser->startPublishingProgressively();
+	}
+	bool res = firstChunk.m_Parser->processBlock(data, firstChunk.m_End);
 
-bool FileParser::parseTextContentsMDMVAH(std::string && a_Contents)
-{
-	PlainTextMDMVAHParser parser(*this, m_FileName, m_InnerFileName, std::move(a_Contents));
-	Stopwatch sw("MDM / VAH parsing");
-	if (!parser.parseContents())
+	// Join the chunks in order. All the tasks need to finish before returning, they use this FileParser:
+	auto logFile = firstChunk.m_Parser->logFile();
+	for (size_t i = 1; i < chunks.size(); i++)
+	{
+		auto & chunk = *chunks[i];
+		chunk.m_Done.acquire();
+		res = res && chunk.m_IsSuccess;
+		if (res)
+		{
+			logFile->appendMessagesFrom(*chunk.m_Parser->logFile());
+			if (isPublishingProgressively)
+			{
+				firstChunk.m_Parser->publishMessages();
+			}
+		}
+		chunk.m_Parser.reset();
+	}
+	if (!res || !firstChunk.m_Parser->finish())
 	{
-		emit parseFailed(tr("MDM / VAH log parser error"));
+		emit parseFailed(tr("%1 log parser error").arg(formatName));
 		return false;
 	}
 	return true;
@@ -1039,14 +3442,15 @@ bool FileParser::parseTextContentsMDMVAH(std::string && a_Contents)
 
 
 
-bool FileParser::parseTextContentsEra(std::string && a_Contents)
+bool FileParser::isMessageLineStart(TextFormat a_TextFormat, TextBufferPtr a_Contents, size_t a_Pos)
 {
-	PlainTextEraParser parser(*this, m_FileName, m_InnerFileName, m_SourceIdentification, std::move(a_Contents));
-	Stopwatch sw("ERA parsing");
-	if (parser.parseContents())
+	// Only complete lines are considered:
+	auto data = a_Contents->data();
+	auto end = data + a_Contents->size();
+	auto eol = findEOL(data + a_Pos, end);
+	if (eol == end)
 	{
-		return true;
+		return false;
 	}
-	emit parseFailed(tr("ERA log parser error"));
-	return false;
+	return textFormatDescription(a_TextFormat).m_IsMessageLine(data + a_Pos, eol, end);
 }
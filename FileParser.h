@@ -15,9 +15,13 @@
 
 #include <functional>
 #include <atomic>
+#include <memory>
+#include <vector>
 
 #include <QObject>
 #include "Session.h"
+#include "TextBuffer.h"
+#include "ZipArchive.h"
 
 
 
@@ -25,6 +29,10 @@
 
 // fwd:
 class QIODevice;
+class TextParser;
+class LogTextParser;
+class GZipTextSink;
+template <typename Format> class PlainTextLogParser;
 
 
 
@@ -47,9 +55,50 @@ public:
 	a_ShouldAbort is a shared variable that indicates whether the parsing should be aborted (from another thread). */
 	FileParser(std::atomic<bool> & a_ShouldAbort);
 
+	~FileParser();
+
+	/** Sets whether the text of the parsed files should be kept in memory compressed.
+	Trades CPU time when displaying the messages for lower memory usage. */
+	void setShouldCompressText(bool a_ShouldCompressText) { m_ShouldCompressText = a_ShouldCompressText; }
+
+	/** Sets whether the plain text logs should be parsed lazily: only the message boundaries and timestamps
+	are parsed, the rest of the message headers is decoded by LogFile once needed.
+	A line is taken as a new message based on its timestamp and log level only, so a line with a valid timestamp
+	and level but a malformed rest of the header (a rare case) starts a new message in the lazy mode, while the full
+	parse appends it to the previous message. Such a message keeps all of its text after the timestamp as the message. */
+	void setShouldParseLazily(bool a_ShouldParseLazily) { m_ShouldParseLazily = a_ShouldParseLazily; }
+
+	/** Sets the generation of the parsed disk file, given to all the LogFiles created from now on
+	(see Session::fileGeneration()). */
+	void setGeneration(quint64 a_Generation) { m_Generation = a_Generation; }
+
 	/** Parses the specified file and emits the signals relevant to the parsing. */
 	void parse(const QString & a_FileName);
 
+	/** Parses the contents of the a_FileName disk file, already opened using openFile(), and emits the signals
+	relevant to the parsing. If a_Contents is nullptr (the file couldn't be opened), emits parseFailed(). */
+	void parse(const QString & a_FileName, TextBufferPtr a_Contents);
+
+	/** Opens the specified disk file and makes its contents available as a TextBuffer.
+	The file is memory-mapped if possible, unless a_ShouldMap is false; then it is read into memory (a file that is
+	followed may get truncated by log rotation, which would make the reads from its mapping fail).
+	Returns nullptr if the file cannot be opened. Doesn't emit any signals, so it can be called from any thread. */
+	static TextBufferPtr openFile(const QString & a_FileName, bool a_ShouldMap = true);
+
+	/** Parses the specified entry of the ZIP archive read from the a_FileName disk file,
+	and emits the signals relevant to the parsing. */
+	void parseZipEntry(const QString & a_FileName, ZipArchivePtr a_Archive, size_t a_EntryIndex);
+
+	/** Prepares for parsing the data appended to a plain text disk file after the specified LogFile was parsed
+	from it, continuing after the LogFile's last message. a_Sample is the beginning of the disk file, used to detect
+	its format. Returns false if the file cannot be followed: it isn't a plain text log, or its text is compressed. */
+	bool startFollowing(LogFilePtr a_LogFile, const char * a_Sample, size_t a_SampleSize);
+
+	/** Parses the data appended to the followed file (see startFollowing()): appends it to the LogFile's text and adds
+	the new messages to the LogFile, publishing them. A line that has no EOL yet is kept until the rest of it arrives.
+	To be called from the thread that reads the LogFile. Returns true on success, false on failure. */
+	bool parseAppendedData(const char * a_Data, size_t a_Size);
+
 signals:
 
 	/** Emitted when there is an error while parsing. */
@@ -58,22 +107,44 @@ signals:
 	/** Emitted when the data format is not recognized. */
 	void failedToRecognize(const QString & a_Details);
 
-	/** Emitted after a single file (out of possibly a multi-file archive) has been parsed successfully. */
+	/** Emitted after a single file (out of possibly a multi-file archive) has been parsed successfully.
+	If the file's messages have been published progressively, publishedMessages() has already been emitted for it. */
 	void finishedParsingFile(LogFilePtr a_Data);
 
+	/** Emitted while parsing a big plain text file, each time another batch of its messages is published
+	(LogFile::publishMessages()), so that the messages parsed so far can be displayed. The LogFile keeps getting
+	more messages until finishedParsingFile() is emitted for it. */
+	void publishedMessages(LogFilePtr a_LogFile);
+
 	/** Emitted after all files have been processed. */
 	void parsedAllFiles();
 
+	/** Emitted for each entry of a ZIP archive, so that the entries can be parsed in parallel.
+	The receiver (connected using a direct connection) takes over the parsing of the entry, typically by calling
+	parseZipEntry() on a new FileParser with the same generation (a_Generation, see setGeneration()) in another thread.
+	If the signal is not connected, the entries are parsed sequentially by this parser instead. */
+	void foundZipEntry(const QString & a_FileName, quint64 a_Generation, ZipArchivePtr a_Archive, size_t a_EntryIndex);
+
 
 protected:
 
-	friend class PlainTextMDMVAHParser;  // Needs access to m_ShouldAbort and reportFileParsed()
-	friend class PlainTextEraParser;     // Needs access to m_ShouldAbort and reportFileParsed()
+	template <typename Format> friend class PlainTextLogParser;  // Needs access to m_ShouldAbort, the file names and the reporting
+	friend class TarParser;              // Needs access to m_ShouldAbort, m_InnerFileName and the format detection
+	friend class GZipTextSink;           // Needs access to the format detection and the parser creation
 
 
 	/** When set to true (by another thread), parsing will be aborted at the nearest opportunity. */
 	std::atomic<bool> & m_ShouldAbort;
 
+	/** If true, the text of the parsed files is compressed before the LogFile is reported. */
+	bool m_ShouldCompressText;
+
+	/** If true, the plain text logs are parsed lazily, see setShouldParseLazily(). */
+	bool m_ShouldParseLazily;
+
+	/** The generation of the parsed disk file, see setGeneration(). */
+	quint64 m_Generation;
+
 	/** Name of the disk file that is currently being parsed. */
 	QString m_FileName;
 
@@ -84,29 +155,127 @@ protected:
 	May be obtained from the file path. */
 	QString m_SourceIdentification;
 
+	/** The parser that continues parsing the followed LogFile, see startFollowing(). */
+	std::unique_ptr<LogTextParser> m_FollowParser;
+
+	/** While positive, reportFileParsed() holds the parsed LogFiles back in m_HeldBackFiles instead of reporting them.
+	Used while the text of the parsed files is still being appended to (the members of a TAR archive inside GZIP data,
+	see GZipTextSink), so that no other thread reads the text before it stops growing. */
+	int m_NumReportHolds;
+
+	/** The LogFiles parsed while m_NumReportHolds was positive, reported once it drops back to zero. */
+	std::vector<LogFilePtr> m_HeldBackFiles;
+
+
+	/** The plain text log formats that can be parsed. */
+	enum TextFormat
+	{
+		tfUnknown,
+		tfMDMVAH,
+		tfEra,
+	};
+
+	/** Describes a single plain text log format: its name, detection and parser.
+	Defined in FileParser.cpp, together with the grammar of each format. */
+	struct TextFormatDescription;
+
 
 	/** Attempts to detect the format of the data in the sample (first N bytes of the file).
 	Returns the handler to use for the file, nullptr if not known. */
-	std::function<bool(std::string &&)> getFormatHandler(const std::string & a_Contents);
+	std::function<bool(TextBufferPtr)> getFormatHandler(const TextBuffer & a_Contents);
 
 	/** Parses the specified data stream into LogFile instances, emits each via finishedParsingFile.
 	Returns true on success, false on failure. */
-	bool parseContents(std::string && a_Contents);
+	bool parseContents(TextBufferPtr a_Contents);
+
+	/** Detects the plain text log format based on the sample (first N bytes of the data).
+	Returns tfUnknown if the data is not in any known plain text format. */
+	static TextFormat detectTextFormat(const char * a_Sample, size_t a_SampleSize);
+
+	/** Returns the descriptions of all the known plain text log formats, in the order in which they are detected. */
+	static const std::vector<TextFormatDescription> & textFormats();
+
+	/** Returns the description of the specified known plain text log format. */
+	static const TextFormatDescription & textFormatDescription(TextFormat a_TextFormat);
+
+	/** Creates a parser for the specified text format that stores the messages into a new LogFile
+	with the specified complete text. */
+	std::unique_ptr<LogTextParser> createTextParser(TextFormat a_TextFormat, TextBufferPtr a_CompleteText);
+
+	/** Parses the specified ZIP archive, each entry into a separate LogFile.
+	Only the central directory is read here, the entries are either handed over through foundZipEntry(),
+	or parsed sequentially using parseZipEntryContents().
+	Returns true on success, false on failure. */
+	bool parseZipContents(TextBufferPtr a_Contents);
+
+	/** Parses the data of the specified ZIP archive entry.
+	Returns true on success, false on failure. */
+	bool parseZipEntryContents(const ZipArchive & a_Archive, const ZipArchive::Entry & a_Entry);
 
 	/** Parses the specified GZIP data stream into the specified Session.
+	The data is decompressed in chunks and each chunk is parsed as soon as it is decompressed.
+	Unless the data is small, the decompressed data is not kept, instead the resulting LogFile keeps the compressed
+	data and an index into it, and decompresses the parts of the text on demand.
+	If the decompressed data is a TAR archive, its members are parsed as they are decompressed.
+	All the members of a multi-member GZIP file are decompressed, in parallel if possible.
+	If a_IsRawDeflate is true, the data is a raw deflate stream without the GZIP headers (ZIP archive entries).
+	Returns true on success, false on failure. */
+	bool parseGZipContents(TextBufferPtr a_Contents, bool a_IsRawDeflate = false);
+
+	/** Inflates the GZIP (or raw deflate, if a_IsRawDeflate is true) data from a_StartPos on, passes it to a_Sink.
+	Continues across the GZIP members that follow each other. Doesn't finish a_Sink.
+	Returns true on success, false on failure (already reported). */
+	bool inflateGZipSerially(
+		TextBufferPtr a_Contents,
+		size_t a_StartPos,
+		bool a_IsRawDeflate,
+		GZipTextSink & a_Sink
+	);
+
+	/** Inflates the members of a multi-member GZIP file in parallel, passes their data to a_Sink in order.
+	If a member doesn't match any candidate, the rest of the data is inflated serially.
+	a_Candidates are the positions in a_Contents that look like member headers, sorted.
 	Returns true on success, false on failure. */
-	bool parseGZipContents(std::string && a_Contents);
+	bool inflateGZipMembersInParallel(
+		TextBufferPtr a_Contents,
+		const std::vector<size_t> & a_Candidates,
+		GZipTextSink & a_Sink
+	);
+
+	/** Parses the specified TAR archive data, each member into a separate LogFile.
+	The resulting LogFiles keep a reference to a_Contents, no copy of the data is made.
+	Returns true on success, false on failure. */
+	bool parseTarContents(TextBufferPtr a_Contents);
 
-	/** Parses the specified plaintext data stream in MDM/VAH format into the specified Session.
+	/** Parses the specified plaintext data stream in the specified format into the specified Session.
+	The resulting LogFile keeps a reference to a_Contents, no copy of the data is made.
 	Returns true on success, false on failure. */
-	bool parseTextContentsMDMVAH(std::string && a_Contents);
+	bool parseTextContents(TextFormat a_TextFormat, TextBufferPtr a_Contents);
 
-	/** Parses the specified plaintext data stream in ERA format into the specified Session.
+	/** Parses the specified (contiguous) plaintext data in chunks, each chunk in a separate thread, and joins the
+	results into a single LogFile. The chunks are split only at the lines that start a new message.
 	Returns true on success, false on failure. */
-	bool parseTextContentsEra(std::string && a_Contents);
+	bool parseTextContentsInParallel(TextFormat a_TextFormat, TextBufferPtr a_Contents);
+
+	/** Returns true if the line starting at the specified position of the (contiguous) text starts a new message,
+	as opposed to being a continuation of the previous message, in the specified format. */
+	bool isMessageLineStart(TextFormat a_TextFormat, TextBufferPtr a_Contents, size_t a_Pos);
+
+	/** Returns true if the plain text files parsed as a whole may publish their messages while being parsed.
+	Not possible if the text gets compressed, or the headers decoded, after parsing, since these modify the LogFile. */
+	bool canPublishProgressively() const { return !m_ShouldCompressText && !m_ShouldParseLazily; }
 
 	/** Emits the finishedParsingFile signal with the specified log file data and the stored metadata. */
 	void reportFileParsed(LogFilePtr a_LogFile);
+
+	/** Emits the publishedMessages signal for the specified log file that is still being parsed. */
+	void reportMessagesPublished(LogFilePtr a_LogFile);
+
+	/** Makes reportFileParsed() hold the LogFiles back until the matching releaseReports() call. Nestable. */
+	void holdReports() { m_NumReportHolds += 1; }
+
+	/** Ends the hold started by holdReports(); once no hold is left, reports all the LogFiles held back. */
+	void releaseReports();
 };
 
 
@@ -0,0 +1,390 @@
+// FolderWatcher.cpp
+
+// Implements the FolderWatcher class that keeps the session in sync with the log files in watched folders
+
+
+
+
+
+#include "FolderWatcher.h"
+#include <algorithm>
+#include <vector>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRunnable>
+#include "BackgroundParser.h"
+
+#ifdef _MSC_VER
+	// When compiling in MSVC on Windows, use Qt-provided zlib (there's no system-zlib)
+	#include <QtZlib/zlib.h>
+#else
+	// Use system-zlib everywhere else:
+	#include <zlib.h>
+#endif
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+/** Task executed inside FolderWatcher's scan thread to scan a single folder. */
+class FolderScanTask:
+	public QRunnable
+{
+public:
+	FolderScanTask(FolderWatcher & a_FolderWatcher, const QString & a_FolderPath):
+		m_FolderWatcher(a_FolderWatcher),
+		m_FolderPath(a_FolderPath)
+	{
+	}
+
+
+	virtual void run() override
+	{
+		m_FolderWatcher.scanFolder(m_FolderPath);
+	}
+
+
+protected:
+
+	FolderWatcher & m_FolderWatcher;
+	QString m_FolderPath;
+};
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+/** Task executed inside FolderWatcher's scan thread to rescan all the watched folders. */
+class FolderPollTask:
+	public QRunnable
+{
+public:
+	FolderPollTask(FolderWatcher & a_FolderWatcher):
+		m_FolderWatcher(a_FolderWatcher)
+	{
+	}
+
+
+	virtual void run() override
+	{
+		m_FolderWatcher.pollAllFolders();
+	}
+
+
+protected:
+
+	FolderWatcher & m_FolderWatcher;
+};
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// FolderWatcher:
+
+const int FolderWatcher::RESCAN_DELAY_MSEC;
+const int FolderWatcher::POLL_INTERVAL_MSEC;
+const qint64 FolderWatcher::FINGERPRINT_SAMPLE_SIZE;
+
+
+
+
+
+FolderWatcher::FolderWatcher():
+	m_IsPolling(false)
+{
+	// A single scan thread, so that the manifest needs no locking:
+	m_ScanThreadPool.setMaxThreadCount(1);
+
+	m_RescanTimer.setSingleShot(true);
+	m_RescanTimer.setInterval(RESCAN_DELAY_MSEC);
+	m_PollTimer.setSingleShot(true);
+	m_PollTimer.setInterval(POLL_INTERVAL_MSEC);
+	connect(&m_Watcher,     &QFileSystemWatcher::directoryChanged, this, &FolderWatcher::directoryChanged);
+	connect(&m_RescanTimer, &QTimer::timeout,                      this, &FolderWatcher::rescanChangedFolders);
+	connect(&m_PollTimer,   &QTimer::timeout,                      this, &FolderWatcher::startPoll);
+	connect(this, &FolderWatcher::folderAppeared,    this, &FolderWatcher::addWatchedFolder,    Qt::QueuedConnection);
+	connect(this, &FolderWatcher::folderDisappeared, this, &FolderWatcher::removeWatchedFolder, Qt::QueuedConnection);
+	connect(this, &FolderWatcher::pollFinished,      this, &FolderWatcher::schedulePoll,        Qt::QueuedConnection);
+}
+
+
+
+
+
+FolderWatcher::~FolderWatcher()
+{
+	m_ScanThreadPool.clear();
+	m_ScanThreadPool.waitForDone();
+}
+
+
+
+
+
+void FolderWatcher::watch(const QString & a_FolderPath)
+{
+	auto folderPath = QDir::cleanPath(a_FolderPath);
+	m_ScanThreadPool.start(new FolderScanTask(*this, folderPath));
+	if (!m_IsPolling)
+	{
+		m_IsPolling = true;
+		schedulePoll();
+	}
+}
+
+
+
+
+
+void FolderWatcher::scanFolder(const QString & a_FolderPath)
+{
+	QDir folder(a_FolderPath);
+	if (!folder.exists())
+	{
+		removeFolderTree(a_FolderPath);
+		return;
+	}
+	auto itr = m_Manifest.find(a_FolderPath);
+	if (itr == m_Manifest.end())
+	{
+		itr = m_Manifest.insert(std::make_pair(a_FolderPath, FolderManifest())).first;
+		emit folderAppeared(a_FolderPath);
+	}
+
+	// Compare the files to the manifest:
+	auto & folderManifest = itr->second;
+	std::set<QString> presentFiles;
+	for (const auto & fi: folder.entryInfoList(BackgroundParser::logFileNameFilters(), QDir::Files | QDir::Hidden | QDir::System))
+	{
+		presentFiles.insert(fi.fileName());
+		updateFile(folderManifest, a_FolderPath, fi);
+	}
+	for (auto fileItr = folderManifest.begin(); fileItr != folderManifest.end();)
+	{
+		if (presentFiles.find(fileItr->first) == presentFiles.end())
+		{
+			emit fileRemoved(a_FolderPath + "/" + fileItr->first);
+			fileItr = folderManifest.erase(fileItr);
+		}
+		else
+		{
+			++fileItr;
+		}
+	}
+
+	// Compare the subfolders to the manifest, scan the new ones (not the symlinked ones, they may form a loop):
+	std::set<QString> presentFolders;
+	for (const auto & folderName: folder.entryList(QStringList(), QDir::AllDirs | QDir::NoDotAndDotDot | QDir::NoSymLinks | QDir::Hidden | QDir::System))
+	{
+		auto subfolderPath = a_FolderPath + "/" + folderName;
+		presentFolders.insert(subfolderPath);
+		if (m_Manifest.find(subfolderPath) == m_Manifest.end())
+		{
+			scanFolder(subfolderPath);
+		}
+	}
+	std::vector<QString> removedFolders;
+	auto prefix = a_FolderPath + "/";
+	for (auto subItr = m_Manifest.lower_bound(prefix); subItr != m_Manifest.end(); ++subItr)
+	{
+		const auto & subfolderPath = subItr->first;
+		if (!subfolderPath.startsWith(prefix))
+		{
+			break;
+		}
+		if (
+			(subfolderPath.indexOf('/', prefix.size()) < 0) &&  // Only the direct subfolders
+			(presentFolders.find(subfolderPath) == presentFolders.end())
+		)
+		{
+			removedFolders.push_back(subfolderPath);
+		}
+	}
+	for (const auto & subfolderPath: removedFolders)
+	{
+		removeFolderTree(subfolderPath);
+	}
+}
+
+
+
+
+
+void FolderWatcher::pollAllFolders()
+{
+	// Scanning a folder may remove other folders from the manifest (a vanished subtree), skip those:
+	std::vector<QString> folderPaths;
+	for (const auto & folder: m_Manifest)
+	{
+		folderPaths.push_back(folder.first);
+	}
+	for (const auto & folderPath: folderPaths)
+	{
+		if (m_Manifest.find(folderPath) != m_Manifest.end())
+		{
+			scanFolder(folderPath);
+		}
+	}
+	emit pollFinished();
+}
+
+
+
+
+
+void FolderWatcher::updateFile(FolderManifest & a_FolderManifest, const QString & a_FolderPath, const QFileInfo & a_FileInfo)
+{
+	auto size = a_FileInfo.size();
+	if (size == 0)
+	{
+		// Nothing to parse yet (the file is probably just being created), pick it up once it has some data:
+		return;
+	}
+	auto modificationTime = a_FileInfo.lastModified().toMSecsSinceEpoch();
+	auto fileName = a_FolderPath + "/" + a_FileInfo.fileName();
+	auto itr = a_FolderManifest.find(a_FileInfo.fileName());
+	if (itr == a_FolderManifest.end())
+	{
+		a_FolderManifest[a_FileInfo.fileName()] = {size, modificationTime, fingerprint(fileName, size)};
+		emit fileChanged(fileName);
+		return;
+	}
+
+	auto & entry = itr->second;
+	if ((entry.m_Size == size) && (entry.m_ModificationTime == modificationTime))
+	{
+		// Unchanged
+		return;
+	}
+
+	// Only touched files (a sync setting the modification time) keep their fingerprint, they aren't re-parsed:
+	auto newFingerprint = fingerprint(fileName, size);
+	auto hasChanged = ((entry.m_Size != size) || (entry.m_Fingerprint != newFingerprint));
+	entry.m_Size = size;
+	entry.m_ModificationTime = modificationTime;
+	entry.m_Fingerprint = newFingerprint;
+	if (hasChanged)
+	{
+		emit fileChanged(fileName);
+	}
+}
+
+
+
+
+
+void FolderWatcher::removeFolderTree(const QString & a_FolderPath)
+{
+	auto prefix = a_FolderPath + "/";
+	for (auto itr = m_Manifest.lower_bound(a_FolderPath); itr != m_Manifest.end();)
+	{
+		const auto & folderPath = itr->first;
+		if ((folderPath != a_FolderPath) && !folderPath.startsWith(prefix))
+		{
+			// (There may be sibling folders with names that sort in between, such as "a-b" between "a" and "a/b")
+			if (folderPath.startsWith(a_FolderPath))
+			{
+				++itr;
+				continue;
+			}
+			break;
+		}
+		for (const auto & file: itr->second)
+		{
+			emit fileRemoved(folderPath + "/" + file.first);
+		}
+		emit folderDisappeared(folderPath);
+		itr = m_Manifest.erase(itr);
+	}
+}
+
+
+
+
+
+quint32 FolderWatcher::fingerprint(const QString & a_FileName, qint64 a_Size)
+{
+	auto crc = crc32(0, nullptr, 0);
+	QFile f(a_FileName);
+	if (!f.open(QFile::ReadOnly))
+	{
+		return static_cast<quint32>(crc);
+	}
+	auto head = f.read(FINGERPRINT_SAMPLE_SIZE);
+	crc = crc32(crc, reinterpret_cast<const Bytef *>(head.constData()), static_cast<uInt>(head.size()));
+	if (a_Size > FINGERPRINT_SAMPLE_SIZE)
+	{
+		f.seek(std::max(a_Size - FINGERPRINT_SAMPLE_SIZE, FINGERPRINT_SAMPLE_SIZE));
+		auto tail = f.read(FINGERPRINT_SAMPLE_SIZE);
+		crc = crc32(crc, reinterpret_cast<const Bytef *>(tail.constData()), static_cast<uInt>(tail.size()));
+	}
+	return static_cast<quint32>(crc);
+}
+
+
+
+
+
+void FolderWatcher::directoryChanged(const QString & a_FolderPath)
+{
+	m_ChangedFolders.insert(a_FolderPath);
+	if (!m_RescanTimer.isActive())
+	{
+		m_RescanTimer.start();
+	}
+}
+
+
+
+
+
+void FolderWatcher::rescanChangedFolders()
+{
+	for (const auto & folderPath: m_ChangedFolders)
+	{
+		m_ScanThreadPool.start(new FolderScanTask(*this, folderPath));
+	}
+	m_ChangedFolders.clear();
+}
+
+
+
+
+
+void FolderWatcher::startPoll()
+{
+	m_ScanThreadPool.start(new FolderPollTask(*this));
+}
+
+
+
+
+
+void FolderWatcher::schedulePoll()
+{
+	m_PollTimer.start();
+}
+
+
+
+
+
+void FolderWatcher::addWatchedFolder(const QString & a_FolderPath)
+{
+	m_Watcher.addPath(a_FolderPath);
+}
+
+
+
+
+
+void FolderWatcher::removeWatchedFolder(const QString & a_FolderPath)
+{
+	m_Watcher.removePath(a_FolderPath);
+}
@@ -0,0 +1,177 @@
+// FolderWatcher.h
+
+// Declares the FolderWatcher class that keeps the session in sync with the log files in watched folders
+
+
+
+
+
+#ifndef FOLDERWATCHER_H
+#define FOLDERWATCHER_H
+
+
+
+
+
+#include <map>
+#include <set>
+
+#include <QObject>
+#include <QFileSystemWatcher>
+#include <QThreadPool>
+#include <QTimer>
+
+
+
+
+
+// fwd:
+class QFileInfo;
+
+
+
+
+
+/** Watches folder trees for log files that appear, change or disappear, such as a collection share that gets
+synced periodically.
+A manifest of all the log files in the trees (size, modification time and a content fingerprint) is kept, so that
+only the files that are new or whose content has actually changed are reported for parsing (fileChanged()),
+and the files that have disappeared are reported for retracting from the session (fileRemoved()).
+The folders are watched using QFileSystemWatcher (inotify on Linux), a change in a folder triggers a rescan of that
+folder only. A file modified in place doesn't change its folder on Linux, and watching each file could exhaust
+the inotify watches on big collections, so all the folders are also rescanned every POLL_INTERVAL_MSEC. Such a rescan
+only compares the files' sizes and modification times to the manifest, the fingerprint is computed only for the files
+that differ. Symlinked subfolders are not followed, so that a symlink loop can't recurse forever.
+The scans run in a single background thread, which is the only one accessing the manifest. */
+class FolderWatcher:
+	public QObject
+{
+	Q_OBJECT
+	typedef QObject Super;
+
+
+public:
+
+	/** The time for which the changes to the folders are collected before they are rescanned.
+	A sync typically touches many files in a row, they are then processed together. */
+	static const int RESCAN_DELAY_MSEC = 500;
+
+	/** The time between the end of a rescan of all the folders (picking up the files modified in place)
+	and the start of the next one. */
+	static const int POLL_INTERVAL_MSEC = 10000;
+
+	/** The number of bytes from the beginning and from the end of a file used for its content fingerprint. */
+	static const qint64 FINGERPRINT_SAMPLE_SIZE = 64 * 1024;
+
+
+	FolderWatcher();
+
+	~FolderWatcher();
+
+	/** Starts watching the specified folder tree. All the log files currently in it are reported as new. */
+	void watch(const QString & a_FolderPath);
+
+
+signals:
+
+	/** Emitted when a log file appears in a watched folder, or when its content changes.
+	The file's LogFiles in the session, if any, are outdated and the file is to be parsed (again). */
+	void fileChanged(const QString & a_FileName);
+
+	/** Emitted when a log file disappears from a watched folder, its LogFiles are to be removed from the session. */
+	void fileRemoved(const QString & a_FileName);
+
+	/** Emitted from the scan thread when a new folder is found, so that it gets watched in the owner thread. */
+	void folderAppeared(const QString & a_FolderPath);
+
+	/** Emitted from the scan thread when a watched folder disappears. */
+	void folderDisappeared(const QString & a_FolderPath);
+
+	/** Emitted from the scan thread when a rescan of all the folders has finished, so that the next one
+	gets scheduled in the owner thread. */
+	void pollFinished();
+
+
+protected:
+
+	friend class FolderScanTask;  // Needs access to scanFolder()
+	friend class FolderPollTask;  // Needs access to pollAllFolders()
+
+	/** A single log file recorded in the manifest. */
+	struct ManifestEntry
+	{
+		qint64 m_Size;
+		qint64 m_ModificationTime;  // In msec since epoch
+		quint32 m_Fingerprint;
+	};
+
+	/** The log files recorded in the manifest, in a single folder, by their file name (without the path). */
+	typedef std::map<QString, ManifestEntry> FolderManifest;
+
+
+	/** The manifest of all the watched folders (including the subfolders), by their path.
+	Accessed only from the scan thread. */
+	std::map<QString, FolderManifest> m_Manifest;
+
+	/** Runs the folder scans, one at a time. */
+	QThreadPool m_ScanThreadPool;
+
+	/** Watches all the folders in m_Manifest for changes. */
+	QFileSystemWatcher m_Watcher;
+
+	/** Collects the changes to the folders for RESCAN_DELAY_MSEC before rescanning them. */
+	QTimer m_RescanTimer;
+
+	/** Schedules the next rescan of all the folders, POLL_INTERVAL_MSEC after the previous one has finished. */
+	QTimer m_PollTimer;
+
+	/** True once the periodic rescans of all the folders have been started (by the first watch()). */
+	bool m_IsPolling;
+
+	/** The folders that have changed since the last rescan. */
+	std::set<QString> m_ChangedFolders;
+
+
+	/** Scans the specified folder, compares it to the manifest and reports the differences.
+	New subfolders are scanned recursively. Called in the scan thread only. */
+	void scanFolder(const QString & a_FolderPath);
+
+	/** Rescans all the folders in the manifest, then emits pollFinished(). Called in the scan thread only. */
+	void pollAllFolders();
+
+	/** Updates the manifest entry of a single log file found in a scanned folder, reports it if new or changed. */
+	void updateFile(FolderManifest & a_FolderManifest, const QString & a_FolderPath, const QFileInfo & a_FileInfo);
+
+	/** Removes the specified folder and all its subfolders from the manifest, reports all their files as removed. */
+	void removeFolderTree(const QString & a_FolderPath);
+
+	/** Returns the fingerprint of the specified file's contents (CRC-32 of its beginning and end). */
+	static quint32 fingerprint(const QString & a_FileName, qint64 a_Size);
+
+
+protected slots:
+
+	/** Emitted by m_Watcher when a watched folder changes (an entry is added, removed, renamed or touched). */
+	void directoryChanged(const QString & a_FolderPath);
+
+	/** Emitted by m_RescanTimer, starts rescanning the changed folders. */
+	void rescanChangedFolders();
+
+	/** Emitted by m_PollTimer, starts rescanning all the folders. */
+	void startPoll();
+
+	/** Starts m_PollTimer for the next rescan of all the folders, once the previous one has finished (pollFinished()). */
+	void schedulePoll();
+
+	/** Adds the folder found by a scan to m_Watcher. */
+	void addWatchedFolder(const QString & a_FolderPath);
+
+	/** Removes the folder that has disappeared from m_Watcher. */
+	void removeWatchedFolder(const QString & a_FolderPath);
+};
+
+
+
+
+
+#endif // FOLDERWATCHER_H
@@ -8,8 +8,18 @@
 
 #include "LogFile.h"
 #include <assert.h>
+#include <algorithm>
 #include <QFileInfo>
 #include "Exceptions.h"
+#include "Stopwatch.h"
+
+
+
+
+
+const size_t LogFile::HEADER_DECODE_BLOCK_SIZE;
+const size_t LogFile::MAX_TEXT_LENGTH;
+const quint64 LogFile::MAX_TEXT_SIZE;
 
 
 
@@ -19,13 +29,20 @@ LogFile::LogFile(const QString & a_FileName,
 	const QString & a_InnerFileName,
 	SourceType a_SourceType,
 	const QString & a_SourceIdentifier,
-	std::string && a_CompleteText
+	TextBufferPtr a_CompleteText,
+	quint64 a_Generation
 ):
 	m_FileName(a_FileName),
 	m_InnerFileName(a_InnerFileName),
 	m_SourceType(a_SourceType),
+	m_ReidentifiedSourceType(SourceType::stUnknown),
 	m_SourceIdentifier(a_SourceIdentifier),
-	m_CompleteText(std::move(a_CompleteText))
+	m_Generation(a_Generation),
+	m_CompleteText(a_CompleteText),
+	m_LastThreadID(0),
+	m_LastThreadIdentifier(-1),
+	m_NumThreadIndexedMessages(0),
+	m_NumUndecodedHeaderBlocks(0)
 {
 	constructDisplayName();
 }
@@ -33,21 +50,27 @@ LogFile::LogFile(const QString & a_FileName,
 
 
 
+
 void LogFile::addMessage(
-	QDateTime && a_DateTime,
+	qint64 a_Time,
 	LogLevel a_LogLevel,
-	const std::string & a_Module,
+	const char * a_Module, size_t a_ModuleLength,
+	const std::string & a_SubComponent,
 	quint64 a_ThreadID,
 	size_t a_TextStart, size_t a_TextLength
 )
 {
-	assert(a_TextStart + a_TextLength <= m_CompleteText.size());
-	auto moduleIdx = moduleToIdentifier(a_Module);
-	m_Messages.emplace_back(
-		std::move(a_DateTime),
+	assert(a_TextStart + a_TextLength <= m_CompleteText->size());
+	auto moduleIdx = ModuleNames::get().intern(a_Module, a_ModuleLength);
+	auto subComponentIdx = subComponentToIdentifier(a_SubComponent);
+	auto threadIdx = threadIDToIdentifier(a_ThreadID);
+	checkTimeOrder(a_Time);
+	pushMessage(
+		a_Time,
 		a_LogLevel,
 		moduleIdx,
-		a_ThreadID,
+		subComponentIdx,
+		threadIdx,
 		a_TextStart, a_TextLength
 	);
 }
@@ -55,13 +78,106 @@ void LogFile::addMessage(
 
 
 
+void LogFile::addUndecodedMessage(qint64 a_Time, size_t a_TextStart, size_t a_TextLength)
+{
+	assert(a_TextStart + a_TextLength <= m_CompleteText->size());
+	if (m_Times.size() % HEADER_DECODE_BLOCK_SIZE == 0)
+	{
+		// Starting a new block:
+		m_IsHeaderBlockDecoded.push_back(false);
+		m_NumUndecodedHeaderBlocks += 1;
+	}
+	checkTimeOrder(a_Time);
+	pushMessage(
+		a_Time,
+		LogLevel::llUnknown,
+		-1,
+		-1,
+		-1,
+		a_TextStart, a_TextLength
+	);
+}
+
+
+
+
+
+void LogFile::decodeHeaders(size_t a_MessageIndex)
+{
+	auto block = a_MessageIndex / HEADER_DECODE_BLOCK_SIZE;
+	if ((block >= m_IsHeaderBlockDecoded.size()) || m_IsHeaderBlockDecoded[block])
+	{
+		return;
+	}
+	assert(m_HeaderDecoder != nullptr);
+
+	// Decode the whole block:
+	std::string helper, subComponent;
+	auto end = std::min(m_Times.size(), (block + 1) * HEADER_DECODE_BLOCK_SIZE);
+	for (auto i = block * HEADER_DECODE_BLOCK_SIZE; i < end; ++i)
+	{
+		// All the messages of an undecoded block were added by addUndecodedMessage(), directly or joined from
+		// the parallel chunks by appendMessagesFrom(): all the chunks of a file are parsed in the same mode,
+		// and the followed files, whose messages get appended later, are never parsed lazily:
+		assert(m_ModuleIdentifiers[i] < 0);
+		auto textStart = messageTextStart(i);
+		auto textLength = messageTextLength(i);
+		auto logLevel = LogLevel::llUnknown;
+		const char * module = nullptr;
+		size_t moduleLength = 0;
+		size_t headerLength = 0;
+		quint64 threadID = 0;
+		m_HeaderDecoder->decodeHeader(
+			m_CompleteText->span(textStart, textLength, helper), textLength,
+			logLevel, module, moduleLength, subComponent, threadID, headerLength
+		);
+		assert(headerLength <= textLength);
+		m_LogLevels[i] = static_cast<quint8>(logLevel);
+		m_ModuleIdentifiers[i] = static_cast<qint16>(ModuleNames::get().intern(module, moduleLength));
+		m_SubComponentIdentifiers[i] = subComponentToIdentifier(subComponent);
+		m_ThreadIdentifiers[i] = threadIDToIdentifier(threadID);
+		setMessageText(i, textStart + headerLength, textLength - headerLength);
+	}
+	m_IsHeaderBlockDecoded[block] = true;
+	m_NumUndecodedHeaderBlocks -= 1;
+
+	// Once everything is decoded, the decoder is no longer needed:
+	if (m_NumUndecodedHeaderBlocks == 0)
+	{
+		m_IsHeaderBlockDecoded.clear();
+		m_HeaderDecoder.reset();
+	}
+}
+
+
+
+
+
+void LogFile::decodeAllHeaders()
+{
+	if (!hasUndecodedHeaders())
+	{
+		return;
+	}
+	Stopwatch sw("Decoding message headers");
+	for (size_t i = 0; i < m_Times.size(); i += HEADER_DECODE_BLOCK_SIZE)
+	{
+		decodeHeaders(i);
+	}
+}
+
+
+
+
+
 bool LogFile::appendContinuationToLastMessage(size_t a_AddLength)
 {
-	if (m_Messages.empty())
+	if (m_Times.empty())
 	{
 		return false;
 	}
-	m_Messages.back().m_TextLength += a_AddLength;
+	auto & length = m_TextLengths.back();
+	length = static_cast<quint32>(std::min<size_t>(length + a_AddLength, MAX_TEXT_LENGTH));
 	return true;
 }
 
@@ -69,13 +185,269 @@ bool LogFile::appendContinuationToLastMessage(size_t a_AddLength)
 
 
 
-const LogFile::Message & LogFile::getMessageByIndex(size_t a_Index) const
+void LogFile::addTokens(const char * a_Text, const char * a_End)
+{
+	assert(!m_Times.empty());
+	auto messageIndex = m_Times.size() - 1;
+	LogToken::scan(a_Text, a_End, [this, messageIndex](const LogToken & a_Token)
+		{
+			m_TokenOccurrences.push_back({a_Token, messageIndex});
+		}
+	);
+}
+
+
+
+
+
+void LogFile::trimLastMessage(size_t a_TextEnd)
+{
+	assert(!m_Times.empty());
+	auto index = m_Times.size() - 1;
+	auto textStart = messageTextStart(index);
+	assert(a_TextEnd >= textStart);
+	assert(a_TextEnd <= textStart + messageTextLength(index));
+	setMessageText(index, textStart, a_TextEnd - textStart);
+}
+
+
+
+
+
+void LogFile::appendText(const char * a_Data, size_t a_Size)
+{
+	assert(!m_CompleteText->isCompressed());
+	if (m_AppendedText == nullptr)
+	{
+		m_AppendedText = std::make_shared<AppendedTextBuffer>(m_CompleteText);
+		m_CompleteText = m_AppendedText;
+	}
+	m_AppendedText->append(a_Data, a_Size);
+}
+
+
+
+
+
+void LogFile::appendMessagesFrom(LogFile & a_Other)
 {
-	if (a_Index >= m_Messages.size())
+	assert(m_CompleteText == a_Other.m_CompleteText);
+
+	// Translate the other file's sub-component and thread identifiers into this file's (the module ones are global):
+	std::vector<int> subComponentIdentifiers(a_Other.m_IdentifierToSubComponent.size());
+	for (size_t i = 0; i < subComponentIdentifiers.size(); ++i)
+	{
+		subComponentIdentifiers[i] = subComponentToIdentifier(a_Other.m_IdentifierToSubComponent[i]);
+	}
+	std::vector<int> threadIdentifiers(a_Other.m_IdentifierToThreadID.size());
+	for (size_t i = 0; i < threadIdentifiers.size(); ++i)
 	{
-		throw EIndexOutOfBounds(__FILE__, __LINE__, m_Messages.size(), a_Index);
+		threadIdentifiers[i] = threadIDToIdentifier(a_Other.m_IdentifierToThreadID[i]);
 	}
-	return m_Messages[a_Index];
+
+	// The other file's runs continue after this file's messages:
+	auto base = m_Times.size();
+	if (!a_Other.m_Times.empty())
+	{
+		checkTimeOrder(a_Other.m_Times[0]);
+	}
+	for (size_t i = 0; i < a_Other.m_RunStarts.size(); ++i)
+	{
+		m_RunStarts.push_back(base + a_Other.m_RunStarts[i]);
+	}
+	for (size_t i = 0; i < a_Other.m_TokenOccurrences.size(); ++i)
+	{
+		const auto & occurrence = a_Other.m_TokenOccurrences[i];
+		m_TokenOccurrences.push_back({occurrence.m_Token, base + occurrence.m_MessageIndex});
+	}
+
+	for (size_t i = 0; i < a_Other.m_Times.size(); ++i)
+	{
+		auto msg = a_Other.message(i);
+		if (msg.m_SubComponentIdentifier >= 0)
+		{
+			msg.m_SubComponentIdentifier = subComponentIdentifiers[static_cast<size_t>(msg.m_SubComponentIdentifier)];
+		}
+		if (msg.m_ThreadIdentifier >= 0)
+		{
+			msg.m_ThreadIdentifier = threadIdentifiers[static_cast<size_t>(msg.m_ThreadIdentifier)];
+		}
+		pushMessage(
+			msg.m_Time,
+			msg.m_LogLevel,
+			msg.m_ModuleIdentifier,
+			msg.m_SubComponentIdentifier,
+			msg.m_ThreadIdentifier,
+			msg.m_TextStart, msg.m_TextLength
+		);
+	}
+
+	// The appended undecoded messages (if any) are in blocks that are not decoded yet:
+	auto numBlocks = (m_Times.size() + HEADER_DECODE_BLOCK_SIZE - 1) / HEADER_DECODE_BLOCK_SIZE;
+	if (a_Other.hasUndecodedHeaders() && (numBlocks > m_IsHeaderBlockDecoded.size()))
+	{
+		m_NumUndecodedHeaderBlocks += numBlocks - m_IsHeaderBlockDecoded.size();
+		m_IsHeaderBlockDecoded.resize(numBlocks, false);
+	}
+	a_Other.clearMessages();
+	a_Other.m_RunStarts.clear();
+	a_Other.m_TokenOccurrences.clear();
+	a_Other.m_IsHeaderBlockDecoded.clear();
+	a_Other.m_NumUndecodedHeaderBlocks = 0;
+	a_Other.m_IdentifierToSubComponent.clear();
+	a_Other.m_SubComponentToIdentifier.clear();
+	a_Other.m_IdentifierToThreadID.clear();
+	a_Other.m_ThreadIDToIdentifier.clear();
+	a_Other.m_LastThreadIdentifier = -1;
+}
+
+
+
+
+
+void LogFile::publishMessages(bool a_IsComplete)
+{
+	auto count = m_Times.size();
+	if (!a_IsComplete && (count > 0))
+	{
+		// The last message may still receive continuation lines:
+		count -= 1;
+	}
+	if (count > m_Times.publishedSize())
+	{
+		// Publish the runs first, so that a reader never sees a message without the run it starts:
+		auto numRunStarts = m_RunStarts.size();
+		while ((numRunStarts > 0) && (m_RunStarts[numRunStarts - 1] >= count))
+		{
+			numRunStarts -= 1;
+		}
+		if (numRunStarts > m_RunStarts.publishedSize())
+		{
+			m_RunStarts.publish(numRunStarts);
+		}
+
+		// Publish the time column last, its published size is the message count for the readers:
+		m_LogLevels.publish(count);
+		m_ModuleIdentifiers.publish(count);
+		m_SubComponentIdentifiers.publish(count);
+		m_ThreadIdentifiers.publish(count);
+		m_TextStartsLow.publish(count);
+		m_TextStartsHigh.publish(count);
+		m_TextLengths.publish(count);
+		m_Times.publish(count);
+	}
+
+	// Publish the tokens of the published messages, including the ones added by a follow-up continuation:
+	auto numTokenOccurrences = m_TokenOccurrences.size();
+	while ((numTokenOccurrences > 0) && (m_TokenOccurrences[numTokenOccurrences - 1].m_MessageIndex >= count))
+	{
+		numTokenOccurrences -= 1;
+	}
+	if (numTokenOccurrences > m_TokenOccurrences.publishedSize())
+	{
+		m_TokenOccurrences.publish(numTokenOccurrences);
+	}
+}
+
+
+
+
+
+std::vector<size_t> LogFile::timeOrder(size_t a_Begin, size_t a_End) const
+{
+	assert(a_Begin <= a_End);
+	assert(a_End <= messageCount());
+
+	// Find the runs within the range; a run starting at a_Begin doesn't matter:
+	std::vector<size_t> runBounds;
+	runBounds.push_back(a_Begin);
+	auto numRunStarts = m_RunStarts.publishedSize();
+	size_t lo = 0, hi = numRunStarts;
+	while (lo < hi)
+	{
+		auto mid = lo + (hi - lo) / 2;
+		if (m_RunStarts[mid] <= a_Begin)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+	for (auto i = lo; (i < numRunStarts) && (m_RunStarts[i] < a_End); ++i)
+	{
+		runBounds.push_back(m_RunStarts[i]);
+	}
+	if (runBounds.size() == 1)
+	{
+		// A single run, already sorted
+		return std::vector<size_t>();
+	}
+	runBounds.push_back(a_End);
+
+	// Merge the neighboring runs pairwise until there's a single one left (std::inplace_merge is stable):
+	std::vector<size_t> res(a_End - a_Begin);
+	for (size_t i = 0; i < res.size(); ++i)
+	{
+		res[i] = a_Begin + i;
+	}
+	auto isEarlier = [this](size_t a_Index1, size_t a_Index2)
+	{
+		return (m_Times[a_Index1] < m_Times[a_Index2]);
+	};
+	auto at = [&res, a_Begin](size_t a_Index)
+	{
+		return res.begin() + static_cast<ptrdiff_t>(a_Index - a_Begin);
+	};
+	while (runBounds.size() > 2)
+	{
+		std::vector<size_t> mergedBounds;
+		size_t i = 0;
+		for (; i + 2 < runBounds.size(); i += 2)
+		{
+			std::inplace_merge(at(runBounds[i]), at(runBounds[i + 1]), at(runBounds[i + 2]), isEarlier);
+			mergedBounds.push_back(runBounds[i]);
+		}
+		if (i + 1 < runBounds.size())
+		{
+			// An odd run left over, merged in the next round:
+			mergedBounds.push_back(runBounds[i]);
+		}
+		mergedBounds.push_back(a_End);
+		std::swap(runBounds, mergedBounds);
+	}
+	return res;
+}
+
+
+
+
+
+LogFile::Message LogFile::getMessageByIndex(size_t a_Index) const
+{
+	auto count = messageCount();
+	if (a_Index >= count)
+	{
+		throw EIndexOutOfBounds(__FILE__, __LINE__, count, a_Index);
+	}
+	return message(a_Index);
+}
+
+
+
+
+
+LogFile::Message LogFile::message(size_t a_Index) const
+{
+	return Message(
+		m_Times[a_Index],
+		messageLogLevel(a_Index),
+		m_ModuleIdentifiers[a_Index],
+		m_SubComponentIdentifiers[a_Index],
+		m_ThreadIdentifiers[a_Index],
+		messageTextStart(a_Index), m_TextLengths[a_Index]
+	);
 }
 
 
@@ -87,6 +459,7 @@ void LogFile::tryIdentifySource(void)
 	// If the source type is not known, try to guess it:
 	if (m_SourceType == SourceType::stUnknown)
 	{
+		decodeHeaders(0);
 		m_SourceType = tryIdentifySourceType();
 	}
 }
@@ -95,6 +468,31 @@ void LogFile::tryIdentifySource(void)
 
 
 
+void LogFile::reidentifySource(void)
+{
+	decodeHeaders(0);
+	m_ReidentifiedSourceType.store(tryIdentifySourceType());
+}
+
+
+
+
+
+bool LogFile::applyReidentifiedSource(void)
+{
+	auto sourceType = m_ReidentifiedSourceType.exchange(SourceType::stUnknown);
+	if ((sourceType == SourceType::stUnknown) || (sourceType == m_SourceType))
+	{
+		return false;
+	}
+	m_SourceType = sourceType;
+	return true;
+}
+
+
+
+
+
 bool LogFile::operator < (const LogFile & a_Other) const
 {
 	// If the SourceType differs, use it as comparison result:
@@ -123,12 +521,104 @@ bool LogFile::operator < (const LogFile & a_Other) const
 
 std::string LogFile::identifierToModule(int a_ModuleIdentifier) const
 {
-	auto itr = m_IdentifierToModule.find(a_ModuleIdentifier);
-	if (itr == m_IdentifierToModule.end())
+	return ModuleNames::get().name(a_ModuleIdentifier);
+}
+
+
+
+
+
+std::string LogFile::identifierToSubComponent(int a_SubComponentIdentifier) const
+{
+	if (
+		(a_SubComponentIdentifier < 0) ||
+		(static_cast<size_t>(a_SubComponentIdentifier) >= m_IdentifierToSubComponent.publishedSize())
+	)
 	{
 		return std::string();
 	}
-	return itr->second;
+	return m_IdentifierToSubComponent[static_cast<size_t>(a_SubComponentIdentifier)];
+}
+
+
+
+
+
+int LogFile::findSubComponent(const std::string & a_SubComponent, size_t a_FirstIdentifier) const
+{
+	// The map is written by the parser, only the published names are safe to read from other threads:
+	auto count = m_IdentifierToSubComponent.publishedSize();
+	for (auto i = a_FirstIdentifier; i < count; ++i)
+	{
+		if (m_IdentifierToSubComponent[i] == a_SubComponent)
+		{
+			return static_cast<int>(i);
+		}
+	}
+	return -1;
+}
+
+
+
+
+
+quint64 LogFile::identifierToThreadID(int a_ThreadIdentifier) const
+{
+	if ((a_ThreadIdentifier < 0) || (static_cast<size_t>(a_ThreadIdentifier) >= m_IdentifierToThreadID.publishedSize()))
+	{
+		return 0;
+	}
+	return m_IdentifierToThreadID[static_cast<size_t>(a_ThreadIdentifier)];
+}
+
+
+
+
+
+int LogFile::findThread(quint64 a_ThreadID, size_t a_FirstIdentifier) const
+{
+	// The map is written by the parser, only the published IDs are safe to read from other threads:
+	auto count = m_IdentifierToThreadID.publishedSize();
+	for (auto i = a_FirstIdentifier; i < count; ++i)
+	{
+		if (m_IdentifierToThreadID[i] == a_ThreadID)
+		{
+			return static_cast<int>(i);
+		}
+	}
+	return -1;
+}
+
+
+
+
+
+const std::vector<size_t> & LogFile::threadMessages(int a_ThreadIdentifier)
+{
+	assert(a_ThreadIdentifier >= 0);
+
+	// Add the messages published since the last call to their threads' lists:
+	auto count = messageCount();
+	if (m_NumThreadIndexedMessages < count)
+	{
+		decodeAllHeaders();
+		for (auto i = m_NumThreadIndexedMessages; i < count; ++i)
+		{
+			auto threadIdx = static_cast<size_t>(m_ThreadIdentifiers[i]);
+			if (threadIdx >= m_ThreadMessages.size())
+			{
+				m_ThreadMessages.resize(threadIdx + 1);
+			}
+			m_ThreadMessages[threadIdx].push_back(i);
+		}
+		m_NumThreadIndexedMessages = count;
+	}
+
+	if (static_cast<size_t>(a_ThreadIdentifier) >= m_ThreadMessages.size())
+	{
+		m_ThreadMessages.resize(static_cast<size_t>(a_ThreadIdentifier) + 1);
+	}
+	return m_ThreadMessages[static_cast<size_t>(a_ThreadIdentifier)];
 }
 
 
@@ -137,9 +627,10 @@ std::string LogFile::identifierToModule(int a_ModuleIdentifier) const
 
 QString LogFile::getMessageText(const Message & a_Message) const
 {
-	assert(a_Message.m_TextStart + a_Message.m_TextLength <= m_CompleteText.size());
+	assert(a_Message.m_TextStart + a_Message.m_TextLength <= m_CompleteText->size());
+	std::string helper;
 	return QString::fromUtf8(
-		m_CompleteText.c_str() + a_Message.m_TextStart,
+		m_CompleteText->span(a_Message.m_TextStart, a_Message.m_TextLength, helper),
 		static_cast<int>(a_Message.m_TextLength)
 	);
 }
@@ -148,6 +639,43 @@ QString LogFile::getMessageText(const Message & a_Message) const
 
 
 
+QString LogFile::getMessageText(size_t a_Index) const
+{
+	return getMessageText(message(a_Index));
+}
+
+
+
+
+
+bool LogFile::messageTextContains(size_t a_Index, const std::string & a_Needle) const
+{
+	auto textStart = messageTextStart(a_Index);
+	auto textLength = messageTextLength(a_Index);
+	assert(textStart + textLength <= m_CompleteText->size());
+	std::string helper;
+	auto text = m_CompleteText->span(textStart, textLength, helper);
+	auto end = text + textLength;
+	return (std::search(text, end, a_Needle.begin(), a_Needle.end()) != end);
+}
+
+
+
+
+
+void LogFile::compressText()
+{
+	if (m_CompleteText->isCompressed())
+	{
+		return;
+	}
+	m_CompleteText = std::make_shared<CompressedTextBuffer>(*m_CompleteText);
+}
+
+
+
+
+
 void LogFile::constructDisplayName()
 {
 	QString fn = m_InnerFileName.isEmpty() ? m_FileName : m_InnerFileName;
@@ -162,23 +690,45 @@ void LogFile::constructDisplayName()
 LogFile::SourceType LogFile::tryIdentifySourceType() const
 {
 	// Based on the module names in log messages:
-	// Specific unique modules present in the log indicate the source type:
-	auto end = m_ModuleToIdentifier.end();
-	if (m_ModuleToIdentifier.find("CMultiProxyToMultiAgentConnectorModule") != end)
+	// Specific unique modules present in the log indicate the source type.
+	// The module identifiers are shared by all the files, so look for the modules in this file's (decoded) messages:
+	static const std::pair<const char *, SourceType> indicators[] =
 	{
-		return SourceType::stMultiProxy;
-	}
-	if (m_ModuleToIdentifier.find("CVAHConnectorModule") != end)
+		{"CMultiProxyToMultiAgentConnectorModule", SourceType::stMultiProxy},
+		{"CVAHConnectorModule",                    SourceType::stMultiAgent},
+		{"CMDMConnectorModule",                    SourceType::stMultiAgent},
+		{"CSystemConnectorModule",                 SourceType::stAgent},
+	};
+	const auto & moduleNames = ModuleNames::get();
+	std::vector<int> indicatorIdentifiers;
+	for (const auto & indicator: indicators)
 	{
-		return SourceType::stMultiAgent;
+		indicatorIdentifiers.push_back(moduleNames.find(indicator.first));
 	}
-	if (m_ModuleToIdentifier.find("CMDMConnectorModule") != end)
+	std::vector<bool> isPresent(indicatorIdentifiers.size(), false);
+	auto numMessages = m_Times.size();
+	for (size_t i = 0; i < numMessages; ++i)
 	{
-		return SourceType::stMultiAgent;
+		int module = m_ModuleIdentifiers[i];
+		if (module < 0)
+		{
+			// Not decoded
+			continue;
+		}
+		for (size_t j = 0; j < indicatorIdentifiers.size(); ++j)
+		{
+			if (module == indicatorIdentifiers[j])
+			{
+				isPresent[j] = true;
+			}
+		}
 	}
-	if (m_ModuleToIdentifier.find("CSystemConnectorModule") != end)
+	for (size_t j = 0; j < indicatorIdentifiers.size(); ++j)
 	{
-		return SourceType::stAgent;
+		if (isPresent[j])
+		{
+			return indicators[j].second;
+		}
 	}
 
 	// TODO: Based on the filenames
@@ -191,22 +741,101 @@ LogFile::SourceType LogFile::tryIdentifySourceType() const
 
 
 
-int LogFile::moduleToIdentifier(const std::string & a_ModuleName)
+int LogFile::subComponentToIdentifier(const std::string & a_SubComponentName)
 {
-	auto itr = m_ModuleToIdentifier.find(a_ModuleName);
-	if (itr != m_ModuleToIdentifier.end())
+	if (a_SubComponentName.empty())
+	{
+		return -1;
+	}
+	auto itr = m_SubComponentToIdentifier.find(a_SubComponentName);
+	if (itr != m_SubComponentToIdentifier.end())
 	{
-		// Already known, return the found identifier:
 		return itr->second;
 	}
+	auto identifier = static_cast<int>(m_SubComponentToIdentifier.size());
+	m_SubComponentToIdentifier[a_SubComponentName] = identifier;
+	m_IdentifierToSubComponent.emplace_back(a_SubComponentName);
+	m_IdentifierToSubComponent.publish(m_IdentifierToSubComponent.size());
+	return identifier;
+}
+
+
+
 
-	// Not found, add it to both maps:
-	auto identifier = static_cast<int>(m_ModuleToIdentifier.size());
-	m_ModuleToIdentifier[a_ModuleName] = identifier;
-	m_IdentifierToModule[identifier] = a_ModuleName;
+
+int LogFile::threadIDToIdentifier(quint64 a_ThreadID)
+{
+	if ((m_LastThreadIdentifier >= 0) && (m_LastThreadID == a_ThreadID))
+	{
+		return m_LastThreadIdentifier;
+	}
+	auto itr = m_ThreadIDToIdentifier.find(a_ThreadID);
+	int identifier;
+	if (itr != m_ThreadIDToIdentifier.end())
+	{
+		identifier = itr->second;
+	}
+	else
+	{
+		identifier = static_cast<int>(m_ThreadIDToIdentifier.size());
+		m_ThreadIDToIdentifier[a_ThreadID] = identifier;
+		m_IdentifierToThreadID.emplace_back(a_ThreadID);
+		m_IdentifierToThreadID.publish(m_IdentifierToThreadID.size());
+	}
+	m_LastThreadID = a_ThreadID;
+	m_LastThreadIdentifier = identifier;
 	return identifier;
 }
 
 
 
 
+
+void LogFile::pushMessage(
+	qint64 a_Time,
+	LogLevel a_LogLevel,
+	int a_ModuleIdentifier,
+	int a_SubComponentIdentifier,
+	int a_ThreadIdentifier,
+	size_t a_TextStart, size_t a_TextLength
+)
+{
+	assert(a_ModuleIdentifier < ModuleNames::MAX_IDENTIFIERS);
+	m_Times.push_back(std::move(a_Time));
+	m_LogLevels.push_back(static_cast<quint8>(a_LogLevel));
+	m_ModuleIdentifiers.push_back(static_cast<qint16>(a_ModuleIdentifier));
+	m_SubComponentIdentifiers.push_back(std::move(a_SubComponentIdentifier));
+	m_ThreadIdentifiers.push_back(std::move(a_ThreadIdentifier));
+	m_TextStartsLow.push_back(0);
+	m_TextStartsHigh.push_back(0);
+	m_TextLengths.push_back(0);
+	setMessageText(m_Times.size() - 1, a_TextStart, a_TextLength);
+}
+
+
+
+
+
+void LogFile::setMessageText(size_t a_Index, size_t a_TextStart, size_t a_TextLength)
+{
+	assert(static_cast<quint64>(a_TextStart) <= MAX_TEXT_SIZE);
+	m_TextStartsLow[a_Index] = static_cast<quint32>(a_TextStart);
+	m_TextStartsHigh[a_Index] = static_cast<quint8>(static_cast<quint64>(a_TextStart) >> 32);
+	m_TextLengths[a_Index] = static_cast<quint32>(std::min(a_TextLength, MAX_TEXT_LENGTH));
+}
+
+
+
+
+
+void LogFile::clearMessages()
+{
+	m_Times.clear();
+	m_LogLevels.clear();
+	m_ModuleIdentifiers.clear();
+	m_SubComponentIdentifiers.clear();
+	m_ThreadIdentifiers.clear();
+	m_TextStartsLow.clear();
+	m_TextStartsHigh.clear();
+	m_TextLengths.clear();
+}
@@ -13,11 +13,17 @@
 
 
 
+#include <atomic>
 #include <vector>
 #include <map>
 #include <memory>
+#include <unordered_map>
 
 #include <QDateTime>
+#include "TextBuffer.h"
+#include "AppendOnlyVector.h"
+#include "TokenIndex.h"
+#include "ModuleNames.h"
 
 
 
@@ -53,69 +59,214 @@ public:
 	};
 
 
-	/** Representation of a single line in the log. */
+	/** Representation of a single line in the log.
+	The messages are stored column-wise (see m_Times), this is a copy of a single message's fields assembled by message().
+	The filtering and sorting code reads the individual columns instead (messageTime(), messageLogLevel() etc.). */
 	struct Message
 	{
-		QDateTime m_DateTime;
+		qint64 m_Time;  // The timestamp, in msec since epoch; the logged timestamps are interpreted as UTC
 		LogLevel m_LogLevel;
-		int m_ModuleIdentifier;  // Identifier from LogFile's m_ModuleToIdentifier / m_IdentifierToModule
-		quint64 m_ThreadID;
+		int m_ModuleIdentifier;  // Identifier from ModuleNames, -1 if the header is not decoded yet
+		int m_SubComponentIdentifier;  // Identifier from LogFile's m_SubComponentToIdentifier, -1 if none
+		int m_ThreadIdentifier;  // Identifier from LogFile's m_IdentifierToThreadID, -1 if the header is not decoded yet
 		size_t m_TextStart, m_TextLength;  // Index into LogFile's m_CompleteText
 
 		explicit Message(
-			QDateTime && a_DateTime,
+			qint64 a_Time,
 			LogLevel a_LogLevel,
 			int a_ModuleIdentifier,
-			quint64 a_ThreadID,
+			int a_SubComponentIdentifier,
+			int a_ThreadIdentifier,
 			size_t a_TextStart, size_t a_TextLength
 		):
-			m_DateTime(std::move(a_DateTime)),
+			m_Time(a_Time),
 			m_LogLevel(a_LogLevel),
 			m_ModuleIdentifier(a_ModuleIdentifier),
-			m_ThreadID(a_ThreadID),
+			m_SubComponentIdentifier(a_SubComponentIdentifier),
+			m_ThreadIdentifier(a_ThreadIdentifier),
 			m_TextStart(a_TextStart),
 			m_TextLength(a_TextLength)
 		{
 		}
+
+		/** Returns the timestamp as a QDateTime, for display. The comparisons use m_Time directly. */
+		QDateTime dateTime() const { return QDateTime::fromMSecsSinceEpoch(m_Time, Qt::UTC); }
+	};
+
+
+	/** A token (identifier) found in the text of a message, see LogToken. */
+	struct TokenOccurrence
+	{
+		LogToken m_Token;
+		size_t m_MessageIndex;
+	};
+
+
+	/** Interface for decoding the message headers that were skipped while parsing in the lazy mode.
+	Provided by the parser, so that the decoding uses the same format as the parsing. */
+	class HeaderDecoder
+	{
+	public:
+		virtual ~HeaderDecoder() {}
+
+		/** Decodes the header at the start of a_Text, the a_Length bytes of a message's complete text, header included.
+		Sets the log level, module name (a_ModuleLength bytes at a_Module, within a_Text), sub-component name
+		(empty if none), thread ID and a_HeaderLength, the number of bytes preceding the message text. */
+		virtual void decodeHeader(
+			const char * a_Text, size_t a_Length,
+			LogLevel & a_LogLevel,
+			const char *& a_Module, size_t & a_ModuleLength,
+			std::string & a_SubComponent,
+			quint64 & a_ThreadID,
+			size_t & a_HeaderLength
+		) = 0;
 	};
 
 
-	/** Constructs a new object with the specified properties. */
+	/** The number of messages whose headers are decoded at once, when any of them is needed. */
+	static const size_t HEADER_DECODE_BLOCK_SIZE = 4096;
+
+	/** The maximum length of a message's text, given by the 32-bit length column. Longer texts are cut. */
+	static const size_t MAX_TEXT_LENGTH = 0xffffffffu;
+
+	/** The maximum size of the complete text, given by the 40-bit text start column. */
+	static const quint64 MAX_TEXT_SIZE = 0xffffffffffULL;
+
+
+	/** Constructs a new object with the specified properties.
+	a_Generation is the generation of the disk file's parse that creates the object, see Session::fileGeneration(). */
 	explicit LogFile(const QString & a_FileName,
 		const QString & a_InnerFileName,
 		SourceType a_SourceType,
 		const QString & a_SourceIdentifier,
-		std::string && a_CompleteText
+		TextBufferPtr a_CompleteText,
+		quint64 a_Generation = 0
 	);
 
 	/** Adds a new message to the storage.
-	The message is expected to logically belong after the last message already present. */
-	void addMessage(QDateTime && a_DateTime,
+	The message is expected to logically belong after the last message already present.
+	If its time is earlier than the last message's, it starts a new run (see timeOrder()).
+	a_Time is the timestamp in msec since epoch (UTC).
+	a_Module is the a_ModuleLength bytes of the module name, interned into ModuleNames without copying.
+	a_SubComponent is the tag at the start of the message text ("CStepTx"), empty if the message has none. */
+	void addMessage(qint64 a_Time,
 		LogLevel a_LogLevel,
-		const std::string & a_Module,
+		const char * a_Module, size_t a_ModuleLength,
+		const std::string & a_SubComponent,
 		quint64 a_ThreadID,
 		size_t a_TextStart,
 		size_t a_TextLength
 	);
 
+	/** Adds a new message whose header (log level, module, thread ID) is not decoded yet (lazy parse mode).
+	a_TextStart and a_TextLength specify the complete text of the message, header included.
+	The header is decoded using the decoder set by setHeaderDecoder() once it is needed (decodeHeaders()).
+	The message is expected to logically belong after the last message already present. */
+	void addUndecodedMessage(qint64 a_Time, size_t a_TextStart, size_t a_TextLength);
+
+	/** Sets the decoder used for the headers of the messages added by addUndecodedMessage(). */
+	void setHeaderDecoder(std::unique_ptr<HeaderDecoder> && a_HeaderDecoder) { m_HeaderDecoder = std::move(a_HeaderDecoder); }
+
+	/** Makes sure that the header of the specified message is decoded, together with the rest of its block
+	of HEADER_DECODE_BLOCK_SIZE messages. Does nothing if the header is already decoded.
+	The decoding modifies the message, so this needs to be called from the thread that owns the LogFile. */
+	void decodeHeaders(size_t a_MessageIndex);
+
+	/** Makes sure that the headers of all the messages are decoded. */
+	void decodeAllHeaders();
+
+	/** Returns true if there are any messages whose header hasn't been decoded yet. */
+	bool hasUndecodedHeaders() const { return (m_NumUndecodedHeaderBlocks > 0); }
+
 	/** Appends the specified text to the last message's text.
 	Returns true on success, false if there is no message. */
 	bool appendContinuationToLastMessage(size_t a_AddLength);
 
-	/** Returns the message at the specified index.
-	Throws EIndexOutOfBounds if index is invalid. */
-	const Message & getMessageByIndex(size_t a_Index) const;
-
-	/** Returns the number of messages currently stored. */
-	size_t messageCount(void) const { return m_Messages.size(); }
-
-	/** Returns the (read-only) messages contained within. */
-	const std::vector<Message> & messages(void) const { return m_Messages; }
+	/** Records the tokens found in the specified text (a part of the last message's text) as occurring in the last message.
+	Called by the parsers for each line of the message, so that the identifiers can be indexed (TokenIndex). */
+	void addTokens(const char * a_Text, const char * a_End);
+
+	/** Shortens the last message's text so that it ends at the specified position in the complete text.
+	Used for taking back a continuation line that was incomplete. Only usable in the thread that reads the LogFile. */
+	void trimLastMessage(size_t a_TextEnd);
+
+	/** Appends a copy of the specified data to the complete text, so that the messages parsed from it can be added.
+	Used for the files that grow while being followed. Not usable if the text is compressed. */
+	void appendText(const char * a_Data, size_t a_Size);
+
+	/** Moves all the messages from a_Other to the end of this file's messages, a_Other is left empty.
+	a_Other is expected to be parsed from the text following this file's messages, within the same complete text
+	(used for joining the chunks of a file parsed in parallel). The module, sub-component and thread identifiers are translated. */
+	void appendMessagesFrom(LogFile & a_Other);
+
+	/** Makes the messages added so far readable from other threads, while the parser keeps adding more.
+	Unless a_IsComplete is true, the last message is left out, because it may still receive continuation lines.
+	Once published, a message is not modified by the parser anymore. */
+	void publishMessages(bool a_IsComplete);
+
+	/** Returns the number of messages added, including the ones not published yet. To be called only from the parser's thread. */
+	size_t numAddedMessages(void) const { return m_Times.size(); }
+
+	/** Returns the number of messages added, but not published yet. To be called only from the parser's thread. */
+	size_t numUnpublishedMessages(void) const { return m_Times.size() - m_Times.publishedSize(); }
+
+	/** Returns a copy of the message at the specified index.
+	Throws EIndexOutOfBounds if index is invalid (the message is not published yet). */
+	Message getMessageByIndex(size_t a_Index) const;
+
+	/** Returns the number of messages published so far (all of them once the file is parsed). Thread-safe. */
+	size_t messageCount(void) const { return m_Times.publishedSize(); }
+
+	/** Returns a copy of the message at the specified index, assembled from the columns.
+	Only the first messageCount() messages may be accessed by the threads other than the parser's. */
+	Message message(size_t a_Index) const;
+
+	/** The individual columns of the message at the specified index, without assembling the whole Message.
+	Only the first messageCount() messages may be accessed by the threads other than the parser's. */
+	qint64 messageTime(size_t a_Index) const { return m_Times[a_Index]; }
+	LogLevel messageLogLevel(size_t a_Index) const { return static_cast<LogLevel>(m_LogLevels[a_Index]); }
+	int messageModule(size_t a_Index) const { return m_ModuleIdentifiers[a_Index]; }
+	int messageSubComponent(size_t a_Index) const { return m_SubComponentIdentifiers[a_Index]; }
+	int messageThread(size_t a_Index) const { return m_ThreadIdentifiers[a_Index]; }
+	size_t messageTextStart(size_t a_Index) const
+	{
+		return static_cast<size_t>((static_cast<quint64>(m_TextStartsHigh[a_Index]) << 32) | m_TextStartsLow[a_Index]);
+	}
+	size_t messageTextLength(size_t a_Index) const { return m_TextLengths[a_Index]; }
+
+	/** Returns the tokens found in the messages' texts, in the order of the messages.
+	Only the first publishedSize() occurrences may be accessed by the threads other than the parser's;
+	they belong to the published messages. */
+	const AppendOnlyVector<TokenOccurrence> & tokenOccurrences(void) const { return m_TokenOccurrences; }
+
+	/** Returns the indices of the messages from a_Begin to a_End (published), ordered by their time.
+	The messages with the same time keep their order from the file.
+	Returns an empty vector if the messages in the range are in the time order already, which is the common case.
+	Otherwise (clock jumps, multiple writers) the sorted runs found while parsing are merged, with no comparisons
+	needed within a run. Thread-safe. */
+	std::vector<size_t> timeOrder(size_t a_Begin, size_t a_End) const;
 
 	/** Tries to identify the source type and identifier based on filenames and messages already present.
+	If the message headers haven't been decoded yet, only the first block of messages is considered.
 	Returns true if the source was identified, false if not. */
 	void tryIdentifySource(void);
 
+	/** Identifies the source type again, based on all the messages, once the file is parsed completely.
+	Used for the files whose messages were published while parsing, tryIdentifySource() only saw the first batch then.
+	The result is only stored, so that sourceType() doesn't change under the readers in the UI thread;
+	applyReidentifiedSource() then applies it. To be called from the parser thread. */
+	void reidentifySource(void);
+
+	/** Applies the source type found by reidentifySource(), if any.
+	Returns true if the source type has changed. To be called from the thread that owns the LogFile. */
+	bool applyReidentifiedSource(void);
+
+	/** Returns the name of the disk file from which the log data was read. */
+	const QString & fileName(void) const { return m_FileName; }
+
+	/** Returns the name of the file within the archive (m_FileName), empty if not from an archive. */
+	const QString & innerFileName(void) const { return m_InnerFileName; }
+
 	/** Returns the display name, used in the logfile lists. */
 	const QString & displayName(void) const { return m_DisplayName; }
 
@@ -123,18 +274,61 @@ public:
 
 	const QString & sourceIdentifier(void) const { return m_SourceIdentifier; }
 
+	/** Returns the generation of the disk file's parse that has created the LogFile, see Session::fileGeneration(). */
+	quint64 generation(void) const { return m_Generation; }
+
 	/** Comparison between two logfiles, allows sorting by logfile sourcetype and identifier. */
 	bool operator < (const LogFile & a_Other) const;
 
-	/** Converts the module identifier into the module name.
+	/** Converts the module identifier into the module name (ModuleNames).
 	If no such module is known, returns an empty string. */
 	std::string identifierToModule(int a_ModuleIdentifier) const;
 
+	/** Converts the sub-component identifier into the sub-component name.
+	If no such sub-component is known (including the -1 of the messages without one), returns an empty string. */
+	std::string identifierToSubComponent(int a_SubComponentIdentifier) const;
+
+	/** Returns the identifier of the specified sub-component, or -1 if no published message has it.
+	Only the identifiers from a_FirstIdentifier up are searched, so that a caller that has already searched
+	the first numSubComponents() identifiers can check just the ones added since. Thread-safe. */
+	int findSubComponent(const std::string & a_SubComponent, size_t a_FirstIdentifier = 0) const;
+
+	/** Returns the number of the sub-component identifiers that are readable together with the published messages. */
+	size_t numSubComponents(void) const { return m_IdentifierToSubComponent.publishedSize(); }
+
+	/** Converts the thread identifier into the thread ID as logged.
+	If no such thread is known (including the -1 of the undecoded messages), returns 0. */
+	quint64 identifierToThreadID(int a_ThreadIdentifier) const;
+
+	/** Returns the identifier of the thread with the specified ID, or -1 if no published message has it.
+	Only the identifiers from a_FirstIdentifier up are searched, same as findSubComponent(). Thread-safe. */
+	int findThread(quint64 a_ThreadID, size_t a_FirstIdentifier = 0) const;
+
+	/** Returns the number of the thread identifiers that are readable together with the published messages. */
+	size_t numThreads(void) const { return m_IdentifierToThreadID.publishedSize(); }
+
+	/** Returns the indices of the published messages of the specified thread, in ascending order.
+	The per-thread lists are extended by the messages published since the last call, decoding their headers if needed,
+	so this needs to be called from the thread that owns the LogFile (same as decodeHeaders()).
+	The returned reference is valid until the next call. */
+	const std::vector<size_t> & threadMessages(int a_ThreadIdentifier);
+
 	/** Returns the log message text for the specified message. */
 	QString getMessageText(const Message & a_Message) const;
 
+	/** Returns the log message text for the message at the specified index. */
+	QString getMessageText(size_t a_Index) const;
+
+	/** Returns true if the text of the message at the specified index contains the specified (UTF-8) string. */
+	bool messageTextContains(size_t a_Index, const std::string & a_Needle) const;
+
 	/** Returns the entire unparsed log file data contained within. */
-	const std::string & getCompleteText() const { return m_CompleteText; }
+	const TextBuffer & getCompleteText() const { return *m_CompleteText; }
+
+	/** Replaces the complete text with its block-compressed copy, to save memory.
+	Does nothing if the text is already compressed.
+	To be called only after all the messages have been parsed, before the LogFile is shared with other threads. */
+	void compressText();
 
 protected:
 
@@ -152,24 +346,81 @@ protected:
 	/** Type of the source that produced the log. */
 	SourceType m_SourceType;
 
+	/** The source type found by reidentifySource(), not yet applied to m_SourceType.
+	stUnknown if there is none (nothing new can be learned from a source that is still unknown). */
+	std::atomic<SourceType> m_ReidentifiedSourceType;
+
 	/** Identifier of the source that produced the log.
 	Used especially for MultiAgent to distinguish multiple instances. */
 	QString m_SourceIdentifier;
 
-	/** The complete logfile text. The messages contain indices into this string. */
-	std::string m_CompleteText;
+	/** The generation of the disk file's parse that has created this LogFile, see Session::fileGeneration(). */
+	quint64 m_Generation;
+
+	/** The complete logfile text. The messages contain indices into this buffer.
+	May be either an owned string, a memory-mapped disk file, or compressed data. */
+	TextBufferPtr m_CompleteText;
+
+	/** The individual log messages in the log file, stored column-wise, one item per message in each column,
+	so that a scan over a single field (time, log level) reads only that field's column.
+	Sorted by their original order in the file, which is usually also their time order (see m_RunStarts).
+	Readable from other threads up to the published size while the parser is adding more (publishMessages());
+	m_Times is published last, so its published size is the number of messages readable in all the columns. */
+	AppendOnlyVector<qint64> m_Times;
+	AppendOnlyVector<quint8> m_LogLevels;
+	AppendOnlyVector<qint16> m_ModuleIdentifiers;
+	AppendOnlyVector<qint32> m_SubComponentIdentifiers;
+	AppendOnlyVector<qint32> m_ThreadIdentifiers;
+	AppendOnlyVector<quint32> m_TextStartsLow;  // The lower 32 bits of the text start
+	AppendOnlyVector<quint8> m_TextStartsHigh;  // The upper 8 bits of the text start
+	AppendOnlyVector<quint32> m_TextLengths;
+
+	/** Indices of the messages whose time is earlier than the time of the message before them, in ascending order.
+	Each starts a new run of messages sorted by their time. Empty if all the messages are sorted.
+	The run starts below the published message count are published before the messages themselves. */
+	AppendOnlyVector<size_t> m_RunStarts;
+
+	/** The tokens found in the messages' texts, in the order of the messages.
+	The occurrences in the published messages are published together with the messages. */
+	AppendOnlyVector<TokenOccurrence> m_TokenOccurrences;
+
+	/** Sub-component names, indexed by their identifier numbers; published as soon as added, same as the modules. */
+	AppendOnlyVector<std::string> m_IdentifierToSubComponent;
+
+	/** Map of sub-component names to their respective identifier number. Only accessed by the parser. */
+	std::map<std::string, int> m_SubComponentToIdentifier;
+
+	/** Thread IDs, indexed by the threads' identifier numbers; published as soon as added, same as the modules.
+	The messages store the identifiers, which are dense and half the size of the IDs. */
+	AppendOnlyVector<quint64> m_IdentifierToThreadID;
 
-	/** The individual log messages in the log file.
-	Sorted by their original order in the file (m_DateTime). */
-	std::vector<Message> m_Messages;
+	/** Map of thread IDs to their respective identifier number. Only accessed by the parser. */
+	std::unordered_map<quint64, int> m_ThreadIDToIdentifier;
 
-	/** Map of modules' identifier numbers to module name.
-	Each module is assigned a number which represents the module in each log message. */
-	std::map<int, std::string> m_IdentifierToModule;
+	/** The last thread ID looked up by threadIDToIdentifier() and its identifier (-1 if none yet).
+	The consecutive messages often come from the same thread, this saves the map lookup for them. */
+	quint64 m_LastThreadID;
+	int m_LastThreadIdentifier;
 
-	/** Map of module names to their respective identifier number.
-	Each module is assigned a number which represents the module in each log message. */
-	std::map<std::string, int> m_ModuleToIdentifier;
+	/** For each thread identifier, the indices of the thread's messages, ascending.
+	Built on demand by threadMessages(), from the first m_NumThreadIndexedMessages messages. */
+	std::vector<std::vector<size_t>> m_ThreadMessages;
+
+	/** The number of messages already included in m_ThreadMessages. */
+	size_t m_NumThreadIndexedMessages;
+
+	/** The complete text, if it has been appended to by appendText(); the same object as m_CompleteText then. */
+	std::shared_ptr<AppendedTextBuffer> m_AppendedText;
+
+	/** The decoder for the headers of the messages added by addUndecodedMessage(), nullptr if not used. */
+	std::unique_ptr<HeaderDecoder> m_HeaderDecoder;
+
+	/** For each block of HEADER_DECODE_BLOCK_SIZE messages, true if the headers of the block's messages are decoded.
+	Empty if all the messages were added already decoded. */
+	std::vector<bool> m_IsHeaderBlockDecoded;
+
+	/** The number of false items in m_IsHeaderBlockDecoded. */
+	size_t m_NumUndecodedHeaderBlocks;
 
 
 	/** Sets the DisplayName based on the FileName and InnerFileName. */
@@ -178,9 +429,38 @@ protected:
 	/** Attempts to identify the SourceType based on the filenames and messages already present. */
 	SourceType tryIdentifySourceType() const;
 
-	/** Converts the module name into the identifier number.
-	If such a module is not yet in the maps, adds it and assigns a new identifier. */
-	int moduleToIdentifier(const std::string & a_ModuleName);
+	/** Records a new run start if a message with the specified time, added after the current messages, breaks
+	their time order. To be called before adding the message. */
+	void checkTimeOrder(qint64 a_Time)
+	{
+		if (!m_Times.empty() && (a_Time < m_Times.back()))
+		{
+			m_RunStarts.push_back(m_Times.size());
+		}
+	}
+
+	/** Appends a message to all the columns. */
+	void pushMessage(
+		qint64 a_Time,
+		LogLevel a_LogLevel,
+		int a_ModuleIdentifier,
+		int a_SubComponentIdentifier,
+		int a_ThreadIdentifier,
+		size_t a_TextStart, size_t a_TextLength
+	);
+
+	/** Sets the text start and length of the message at the specified index (not published yet). */
+	void setMessageText(size_t a_Index, size_t a_TextStart, size_t a_TextLength);
+
+	/** Removes all the messages from all the columns. */
+	void clearMessages();
+
+	/** Converts the sub-component name into the identifier number, adding it if not yet known.
+	Returns -1 for an empty name (message without a sub-component). */
+	int subComponentToIdentifier(const std::string & a_SubComponentName);
+
+	/** Converts the thread ID into the identifier number, adding it if not yet known. */
+	int threadIDToIdentifier(quint64 a_ThreadID);
 };
 
 typedef std::shared_ptr<LogFile> LogFilePtr;
@@ -10,13 +10,16 @@
 #include <QDebug>
 #include <QFileDialog>
 #include <QInputDialog>
+#include <QLineEdit>
 #include <QSortFilterProxyModel>
 #include <QMessageBox>
+#include <QSignalBlocker>
 #include <QString>
 #include "ui_MainWindow.h"
 #include "Session.h"
 #include "SessionSourcesModel.h"
 #include "SessionMessagesModel.h"
+#include "MetricsDialog.h"
 
 
 
@@ -24,7 +27,8 @@
 
 MainWindow::MainWindow(QWidget * a_Parent):
 	QMainWindow(a_Parent),
-	m_UI(new Ui::MainWindow)
+	m_UI(new Ui::MainWindow),
+	m_MetricsDialog(nullptr)
 {
 	// Register LogFilePtr so that it can be used in inter-thread signals/slot mechanisms:
 	qRegisterMetaType<LogFilePtr>("LogFilePtr");
@@ -72,6 +76,7 @@ MainWindow::MainWindow(QWidget * a_Parent):
 	m_UI->lvMessages->setColumnWidth(2, 100);
 	m_UI->lvMessages->setColumnWidth(3, 150);
 	m_UI->lvMessages->setColumnWidth(4, 150);
+	m_UI->lvMessages->setColumnWidth(5, 100);
 }
 
 
@@ -95,6 +100,13 @@ void MainWindow::connectSignals()
 	connect(m_UI->actMessagesFind,        SIGNAL(triggered()),   this, SLOT(findMessages()));
 	connect(m_UI->actMessagesFindNext,    SIGNAL(triggered()),   this, SLOT(findNextMessage()));
 	connect(m_UI->actMessagesFilter,      SIGNAL(toggled(bool)), this, SLOT(filterMessages(bool)));
+	connect(m_UI->actMessagesFilterSubComponent, SIGNAL(toggled(bool)), this, SLOT(filterMessagesBySubComponent(bool)));
+	connect(m_UI->actMessagesFilterToken, SIGNAL(toggled(bool)), this, SLOT(filterMessagesByToken(bool)));
+	connect(m_UI->actMessagesFilterThread, SIGNAL(toggled(bool)), this, SLOT(filterMessagesByThread(bool)));
+	connect(m_UI->actMessagesNextInThread, SIGNAL(triggered()),  this, SLOT(nextMessageInThread()));
+	connect(m_UI->actMessagesPrevInThread, SIGNAL(triggered()),  this, SLOT(prevMessageInThread()));
+	connect(m_UI->actMessagesMetrics,     SIGNAL(triggered()),   this, SLOT(showMetrics()));
+	connect(m_UI->lvMessages,             SIGNAL(doubleClicked(const QModelIndex &)), this, SLOT(messageDoubleClicked(const QModelIndex &)));
 	connect(m_UI->actLogLevelFatal,       SIGNAL(toggled(bool)), this, SLOT(logLevelToggled(bool)));
 	connect(m_UI->actLogLevelCritical,    SIGNAL(toggled(bool)), this, SLOT(logLevelToggled(bool)));
 	connect(m_UI->actLogLevelError,       SIGNAL(toggled(bool)), this, SLOT(logLevelToggled(bool)));
@@ -105,6 +117,11 @@ void MainWindow::connectSignals()
 	connect(m_UI->actLogLevelStatus,      SIGNAL(toggled(bool)), this, SLOT(logLevelToggled(bool)));
 	connect(m_UI->actLogLevelUnknown,     SIGNAL(toggled(bool)), this, SLOT(logLevelToggled(bool)));
 	connect(&m_BackgroundParser,          &BackgroundParser::finishedParsingFile, this, &MainWindow::finishedParsingFile);
+	connect(&m_BackgroundParser,          &BackgroundParser::publishedMessages,   this, &MainWindow::publishedMessages);
+	connect(&m_FileFollower,              &FileFollower::appendedMessages,        this, &MainWindow::followedFileAppended);
+	connect(&m_FileFollower,              &FileFollower::fileReplaced,            this, &MainWindow::followedFileReplaced);
+	connect(&m_FolderWatcher,             &FolderWatcher::fileChanged,            this, &MainWindow::watchedFileChanged);
+	connect(&m_FolderWatcher,             &FolderWatcher::fileRemoved,            this, &MainWindow::watchedFileRemoved);
 }
 
 
@@ -117,11 +134,11 @@ void MainWindow::openFile()
 		nullptr,                          // Parent widget
 		tr("Open log files"),             // Title
 		QString(),                        // Initial folder
-		tr("Log file(*.txt *.log *.gz)")  // Filter
+		tr("Log file(*.txt *.log *.gz *.zip *.tar *.tgz)")  // Filter
 	);
 	for (const auto & fileName: fileNames)
 	{
-		m_BackgroundParser.addFile(fileName);
+		m_BackgroundParser.addFile(fileName, m_Session->fileGeneration(fileName));
 	}
 }
 
@@ -132,7 +149,7 @@ void MainWindow::openFile()
 void MainWindow::openFile(const QString & a_FileName)
 {
 	// Parse the file into a new session:
-	m_BackgroundParser.addFile(a_FileName);
+	m_BackgroundParser.addFile(a_FileName, m_Session->fileGeneration(a_FileName));
 }
 
 
@@ -239,6 +256,164 @@ void MainWindow::filterMessages(bool a_StartFiltering)
 
 
 
+void MainWindow::filterMessagesBySubComponent(bool a_StartFiltering)
+{
+	if (!a_StartFiltering)
+	{
+		m_MessagesModel->setSubComponentFilter(QString());
+		return;
+	}
+
+	// Offer the sub-component of the current message:
+	QString subComponent;
+	auto current = m_UI->lvMessages->currentIndex();
+	if (current.isValid())
+	{
+		auto idx = m_MessagesModel->index(current.row(), SessionMessagesModel::colSubComponent);
+		subComponent = m_MessagesModel->data(idx).toString();
+	}
+	subComponent = QInputDialog::getText(
+		this, tr("Filter messages"), tr("Only show messages of sub-component:"), QLineEdit::Normal, subComponent
+	);
+	m_MessagesModel->setSubComponentFilter(subComponent);
+}
+
+
+
+
+
+void MainWindow::filterMessagesByToken(bool a_StartFiltering)
+{
+	if (!a_StartFiltering)
+	{
+		m_MessagesModel->setTokenFilter(QString());
+		return;
+	}
+
+	// Offer the identifiers of the current message, any other can be typed in:
+	bool isOK = false;
+	auto token = QInputDialog::getItem(
+		this, tr("Filter messages"), tr("Only show messages containing identifier:"),
+		currentMessageTokens(), 0, true, &isOK
+	);
+	if (isOK && m_MessagesModel->setTokenFilter(token))
+	{
+		return;
+	}
+	if (isOK)
+	{
+		QMessageBox::warning(
+			this,
+			tr("Filter messages"),
+			tr("\"%1\" is not an identifier. Use a UUID or a hex number of %2 to %3 digits.")
+				.arg(token).arg(LogToken::MIN_HEX_DIGITS).arg(LogToken::MAX_HEX_DIGITS)
+		);
+	}
+
+	// Not filtering, reflect it in the action without re-triggering:
+	QSignalBlocker blocker(m_UI->actMessagesFilterToken);
+	m_UI->actMessagesFilterToken->setChecked(false);
+	m_MessagesModel->setTokenFilter(QString());
+}
+
+
+
+
+
+void MainWindow::filterMessagesByThread(bool a_StartFiltering)
+{
+	if (!a_StartFiltering)
+	{
+		m_MessagesModel->setThreadFilter(QString());
+		return;
+	}
+
+	// Offer the thread of the current message:
+	QString threadID;
+	auto current = m_UI->lvMessages->currentIndex();
+	if (current.isValid())
+	{
+		auto idx = m_MessagesModel->index(current.row(), SessionMessagesModel::colThreadID);
+		threadID = m_MessagesModel->data(idx).toString();
+	}
+	threadID = QInputDialog::getText(
+		this, tr("Filter messages"), tr("Only show messages of thread:"), QLineEdit::Normal, threadID
+	);
+	if (!m_MessagesModel->setThreadFilter(threadID))
+	{
+		QMessageBox::warning(this, tr("Filter messages"), tr("\"%1\" is not a thread ID.").arg(threadID));
+		QSignalBlocker blocker(m_UI->actMessagesFilterThread);
+		m_UI->actMessagesFilterThread->setChecked(false);
+		m_MessagesModel->setThreadFilter(QString());
+	}
+}
+
+
+
+
+
+void MainWindow::nextMessageInThread()
+{
+	auto current = m_UI->lvMessages->currentIndex();
+	if (current.isValid())
+	{
+		selectMessageRow(m_MessagesModel->findThreadNeighbor(current.row(), true));
+	}
+}
+
+
+
+
+
+void MainWindow::prevMessageInThread()
+{
+	auto current = m_UI->lvMessages->currentIndex();
+	if (current.isValid())
+	{
+		selectMessageRow(m_MessagesModel->findThreadNeighbor(current.row(), false));
+	}
+}
+
+
+
+
+
+void MainWindow::showMetrics()
+{
+	if (m_MetricsDialog == nullptr)
+	{
+		m_MetricsDialog = new MetricsDialog(m_Session, m_MessagesModel, this);
+	}
+	m_MetricsDialog->show();
+	m_MetricsDialog->raise();
+	m_MetricsDialog->activateWindow();
+}
+
+
+
+
+
+void MainWindow::messageDoubleClicked(const QModelIndex & a_Index)
+{
+	Q_UNUSED(a_Index);  // Same as the current index
+
+	auto tokens = currentMessageTokens();
+	if (tokens.size() != 1)
+	{
+		// Let the user choose, re-checking the action asks even when already filtering:
+		m_UI->actMessagesFilterToken->setChecked(false);
+		m_UI->actMessagesFilterToken->setChecked(true);
+		return;
+	}
+	QSignalBlocker blocker(m_UI->actMessagesFilterToken);
+	m_UI->actMessagesFilterToken->setChecked(true);
+	m_MessagesModel->setTokenFilter(tokens[0]);
+}
+
+
+
+
+
 void MainWindow::sourceItemChanged(QStandardItem * a_Item)
 {
 	// Update the Messages model based on whether this item's source is enabled or not:
@@ -277,6 +452,23 @@ void MainWindow::parseFailed(const QString & a_Details)
 
 
 void MainWindow::finishedParsingFile(LogFilePtr a_Data)
+{
+	if (!m_Session->appendLogFile(a_Data))
+	{
+		// Parsed from an outdated version of a watched file
+		return;
+	}
+	if (m_BackgroundParser.shouldFollowFiles())
+	{
+		m_FileFollower.follow(a_Data);
+	}
+}
+
+
+
+
+
+void MainWindow::publishedMessages(LogFilePtr a_Data)
 {
 	m_Session->appendLogFile(a_Data);
 }
@@ -285,6 +477,45 @@ void MainWindow::finishedParsingFile(LogFilePtr a_Data)
 
 
 
+void MainWindow::followedFileAppended(LogFilePtr a_Data)
+{
+	m_Session->updateLogFile(a_Data);
+}
+
+
+
+
+
+void MainWindow::followedFileReplaced(const QString & a_FileName)
+{
+	m_BackgroundParser.addFile(a_FileName, m_Session->fileGeneration(a_FileName));
+}
+
+
+
+
+
+void MainWindow::watchedFileChanged(const QString & a_FileName)
+{
+	m_FileFollower.stopFollowing(a_FileName);
+	m_Session->removeLogFiles(a_FileName);  // Also outdates the parses of the file still pending
+	m_BackgroundParser.addFile(a_FileName, m_Session->fileGeneration(a_FileName));
+}
+
+
+
+
+
+void MainWindow::watchedFileRemoved(const QString & a_FileName)
+{
+	m_FileFollower.stopFollowing(a_FileName);
+	m_Session->removeLogFiles(a_FileName);
+}
+
+
+
+
+
 void MainWindow::logLevelToggled(bool a_IsChecked)
 {
 	auto logLevel = static_cast<LogFile::LogLevel>(sender()->property("LogLevel").toInt());
@@ -295,3 +526,46 @@ void MainWindow::logLevelToggled(bool a_IsChecked)
 
 
 
+
+
+
+
+
+void MainWindow::selectMessageRow(int a_Row)
+{
+	if (a_Row < 0)
+	{
+		return;
+	}
+	auto idx = m_MessagesModel->index(a_Row, 0);
+	auto br = m_MessagesModel->index(a_Row, SessionMessagesModel::colMax - 1);
+	m_UI->lvMessages->selectionModel()->setCurrentIndex(idx, QItemSelectionModel::NoUpdate);
+	m_UI->lvMessages->selectionModel()->select(QItemSelection(idx, br), QItemSelectionModel::ClearAndSelect);
+	m_UI->lvMessages->scrollTo(idx, QAbstractItemView::PositionAtCenter);
+}
+
+
+
+
+
+QStringList MainWindow::currentMessageTokens() const
+{
+	QStringList res;
+	auto current = m_UI->lvMessages->currentIndex();
+	if (!current.isValid())
+	{
+		return res;
+	}
+	auto idx = m_MessagesModel->index(current.row(), SessionMessagesModel::colText);
+	auto text = m_MessagesModel->data(idx).toString().toUtf8();
+	LogToken::scan(text.constData(), text.constData() + text.size(), [&res](const LogToken & a_Token)
+		{
+			auto token = a_Token.toString();
+			if (!res.contains(token))
+			{
+				res.append(token);
+			}
+		}
+	);
+	return res;
+}
@@ -8,6 +8,8 @@
 #include <memory>
 #include <QMainWindow>
 #include "BackgroundParser.h"
+#include "FileFollower.h"
+#include "FolderWatcher.h"
 
 
 
@@ -17,6 +19,7 @@
 class Session;
 class SessionSourcesModel;
 class SessionMessagesModel;
+class MetricsDialog;
 class QStandardItem;
 typedef std::shared_ptr<Session> SessionPtr;
 
@@ -45,12 +48,20 @@ public:
 
 	BackgroundParser & getBackgroundParser() { return m_BackgroundParser; }
 
+	FolderWatcher & getFolderWatcher() { return m_FolderWatcher; }
+
 private:
 	std::unique_ptr<Ui::MainWindow> m_UI;
 
 	/** The log file parser. */
 	BackgroundParser m_BackgroundParser;
 
+	/** Follows the parsed files that are still being written to, if requested (BackgroundParser::shouldFollowFiles()). */
+	FileFollower m_FileFollower;
+
+	/** Keeps the session in sync with the watched folders. */
+	FolderWatcher m_FolderWatcher;
+
 
 	/** Connects all UI signals for this window. */
 	void connectSignals();
@@ -74,9 +85,34 @@ public slots:
 	/** Opens the Filter messages dialog for filtering messages, or clears the current message filter (toggle). */
 	void filterMessages(bool a_StartFiltering);
 
+	/** Asks for the sub-component to filter the messages by, or clears the current sub-component filter (toggle).
+	The sub-component of the selected message is offered. */
+	void filterMessagesBySubComponent(bool a_StartFiltering);
+
+	/** Asks for the identifier (UUID or long hex number) to filter the messages by, across all the log files,
+	or clears the current identifier filter (toggle). The identifiers found in the selected message are offered. */
+	void filterMessagesByToken(bool a_StartFiltering);
+
+	/** Asks for the thread ID to filter the messages by, or clears the current thread filter (toggle).
+	The thread of the selected message is offered. */
+	void filterMessagesByThread(bool a_StartFiltering);
+
+	/** Selects the next message of the same thread (and LogFile) as the current message. */
+	void nextMessageInThread();
+
+	/** Selects the previous message of the same thread (and LogFile) as the current message. */
+	void prevMessageInThread();
+
+	/** Shows the (modeless) dialog for extracting numeric metrics from the messages and viewing their statistics. */
+	void showMetrics();
+
 
 protected slots:
 
+	/** Emitted by lvMessages when a message is double-clicked.
+	Filters the messages by the message's identifier, asking which one if it has several (or none). */
+	void messageDoubleClicked(const QModelIndex & a_Index);
+
 	/** Emitted by m_SourcesModel when one of its items is changed. */
 	void sourceItemChanged(QStandardItem * a_Item);
 
@@ -86,10 +122,32 @@ protected slots:
 	/** Emitted by FileParser when there's an error while parsing. */
 	void parseFailed(const QString & a_Details);
 
-	/** Emitted by BackgroundParser when it parses an entire file. */
+	/** Emitted by BackgroundParser when it parses an entire file.
+	Adds the file to the session (unless outdated meanwhile, see Session::appendLogFile()), or announces its new
+	messages; starts following the file if requested. */
 	void finishedParsingFile(LogFilePtr a_Data
 	);
 
+	/** Emitted by BackgroundParser when it publishes another batch of a big file's messages while parsing it.
+	Adds the file to the session, or announces its new messages. */
+	void publishedMessages(LogFilePtr a_Data);
+
+	/** Emitted by FileFollower when it adds the messages appended to a followed file.
+	Announces the new messages, if the file is still in the session. */
+	void followedFileAppended(LogFilePtr a_Data);
+
+	/** Emitted by FileFollower when a followed file has been rotated and there's a new file at its path.
+	Parses the new file (with the file's current generation, see Session::fileGeneration()). */
+	void followedFileReplaced(const QString & a_FileName);
+
+	/** Emitted by FolderWatcher when a file in a watched folder is new or has changed.
+	Stops following the file, removes its outdated LogFiles from the session and parses the file. */
+	void watchedFileChanged(const QString & a_FileName);
+
+	/** Emitted by FolderWatcher when a file disappears from a watched folder.
+	Stops following the file and removes its LogFiles from the session. */
+	void watchedFileRemoved(const QString & a_FileName);
+
 	/** Emitted when a LogLevel action is toggled, modifies the filter.
 	Uses sender() to recognize which loglevel to toggle - therefore protected. */
 	void logLevelToggled(bool a_IsChecked);
@@ -110,9 +168,19 @@ protected:
 	Used for FindNext functionality in findMessage() and findNextMessage(). */
 	QString m_FindText;
 
+	/** The metrics dialog, created on first use and kept (hidden) between the uses, together with the extracted values.
+	Owned by this window as its Qt child. */
+	MetricsDialog * m_MetricsDialog;
+
 
 	/** Returns the filenames of all log files in the specified folder (recursive). */
 	QStringList getFolderLogFiles(const QString & a_FolderPath);
+
+	/** Selects the specified row in lvMessages, making it the current one and scrolling it into view. */
+	void selectMessageRow(int a_Row);
+
+	/** Returns the identifiers (LogToken) found in the text of the current message, without duplicates. */
+	QStringList currentMessageTokens() const;
 };
 
 
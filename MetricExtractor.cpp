@@ -0,0 +1,602 @@
+// MetricExtractor.cpp
+
+// Implements the MetricExtractor class that extracts the numbers from the message texts into numeric columns
+
+
+
+
+
+#include "MetricExtractor.h"
+#include <algorithm>
+#include <assert.h>
+#include <cmath>
+#include <QRunnable>
+#include <QSemaphore>
+#include "LogFile.h"
+#include "Session.h"
+#include "Stopwatch.h"
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// MetricHistogram:
+
+const int MetricHistogram::SUB_BUCKET_BITS;
+const int MetricHistogram::SUB_BUCKET_COUNT;
+
+/** Added to the binary exponent of a value, so that the bucket keys of all the finite doubles are positive. */
+static const int EXPONENT_BIAS = 1100;
+
+
+
+
+
+MetricHistogram::MetricHistogram():
+	m_Count(0),
+	m_Min(0),
+	m_Max(0),
+	m_Sum(0)
+{
+}
+
+
+
+
+
+void MetricHistogram::add(double a_Value)
+{
+	if (m_Count == 0)
+	{
+		m_Min = a_Value;
+		m_Max = a_Value;
+	}
+	else
+	{
+		m_Min = std::min(m_Min, a_Value);
+		m_Max = std::max(m_Max, a_Value);
+	}
+	m_Count += 1;
+	m_Sum += a_Value;
+	m_Buckets[bucketKey(a_Value)] += 1;
+}
+
+
+
+
+
+double MetricHistogram::percentile(double a_Percent) const
+{
+	if (m_Count == 0)
+	{
+		return 0;
+	}
+	if (a_Percent <= 0)
+	{
+		return m_Min;
+	}
+	if (a_Percent >= 100)
+	{
+		return m_Max;
+	}
+
+	// Find the bucket containing the value of the requested rank:
+	auto rank = std::max<quint64>(1, static_cast<quint64>(std::ceil(a_Percent / 100 * m_Count)));
+	quint64 cumulative = 0;
+	for (const auto & bucket: m_Buckets)
+	{
+		cumulative += bucket.second;
+		if (cumulative >= rank)
+		{
+			return std::min(std::max(bucketValue(bucket.first), m_Min), m_Max);
+		}
+	}
+	return m_Max;
+}
+
+
+
+
+
+int MetricHistogram::bucketKey(double a_Value)
+{
+	if (a_Value == 0)
+	{
+		return 0;
+	}
+	int exponent;
+	auto mantissa = std::frexp(std::abs(a_Value), &exponent);  // In [0.5, 1)
+	auto subBucket = std::min(static_cast<int>((mantissa - 0.5) * 2 * SUB_BUCKET_COUNT), SUB_BUCKET_COUNT - 1);
+	auto key = (exponent + EXPONENT_BIAS) * SUB_BUCKET_COUNT + subBucket + 1;
+	return (a_Value > 0) ? key : -key;
+}
+
+
+
+
+
+double MetricHistogram::bucketValue(int a_Key)
+{
+	if (a_Key == 0)
+	{
+		return 0;
+	}
+	auto index = std::abs(a_Key) - 1;
+	auto exponent = index / SUB_BUCKET_COUNT - EXPONENT_BIAS;
+	auto subBucket = index % SUB_BUCKET_COUNT;
+	auto mantissa = 0.5 + (subBucket + 0.5) / (2 * SUB_BUCKET_COUNT);
+	auto value = std::ldexp(mantissa, exponent);
+	return (a_Key > 0) ? value : -value;
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// MetricDefinition:
+
+bool MetricDefinition::parse(const QString & a_Line, MetricDefinition & a_Definition)
+{
+	auto separator = a_Line.indexOf('=');
+	if (separator < 0)
+	{
+		return false;
+	}
+	auto name = a_Line.left(separator).trimmed();
+	auto pattern = a_Line.mid(separator + 1).trimmed();
+	auto placeholder = pattern.indexOf("{}");
+	if (name.isEmpty() || (placeholder <= 0) || (pattern.indexOf("{}", placeholder + 2) >= 0))
+	{
+		// No name, no prefix, or not exactly one placeholder
+		return false;
+	}
+	a_Definition.m_Name = name;
+	a_Definition.m_Prefix = pattern.left(placeholder).toStdString();
+	a_Definition.m_Suffix = pattern.mid(placeholder + 2).toStdString();
+	return true;
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+/** Task executed in the global thread pool to extract the metrics from a single chunk of a LogFile's messages. */
+class MetricExtractionTask:
+	public QRunnable
+{
+public:
+	MetricExtractionTask(
+		const std::vector<MetricDefinition> & a_Definitions,
+		const LogFile & a_LogFile,
+		size_t a_Begin, size_t a_End,
+		std::vector<MetricExtractor::Column> & a_Columns,
+		QSemaphore & a_Done
+	):
+		m_Definitions(a_Definitions),
+		m_LogFile(a_LogFile),
+		m_Begin(a_Begin),
+		m_End(a_End),
+		m_Columns(a_Columns),
+		m_Done(a_Done)
+	{
+	}
+
+
+	virtual void run() override
+	{
+		MetricExtractor::extractChunk(m_Definitions, m_LogFile, m_Begin, m_End, m_Columns);
+		m_Done.release();
+	}
+
+
+protected:
+
+	const std::vector<MetricDefinition> & m_Definitions;
+	const LogFile & m_LogFile;
+	size_t m_Begin;
+	size_t m_End;
+
+	/** The columns to which the extracted values are stored, one per definition. */
+	std::vector<MetricExtractor::Column> & m_Columns;
+
+	/** Released once the task is done. */
+	QSemaphore & m_Done;
+};
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// MetricExtractor:
+
+const size_t MetricExtractor::CHUNK_SIZE;
+
+
+
+
+
+MetricExtractor::MetricExtractor(SessionPtr a_Session):
+	m_Session(a_Session)
+{
+}
+
+
+
+
+
+MetricExtractor::~MetricExtractor()
+{
+}
+
+
+
+
+
+void MetricExtractor::setDefinitions(std::vector<MetricDefinition> && a_Definitions)
+{
+	m_Definitions = std::move(a_Definitions);
+	m_Files.clear();
+}
+
+
+
+
+
+void MetricExtractor::update()
+{
+	Stopwatch sw("Extracting metrics");
+
+	// Drop the LogFiles no longer in the session:
+	std::map<const LogFile *, FileColumns> files;
+	for (const auto & logFile: m_Session->logFiles())
+	{
+		auto itr = m_Files.find(logFile.get());
+		if (itr != m_Files.end())
+		{
+			files[logFile.get()] = std::move(itr->second);
+		}
+		else
+		{
+			auto & fc = files[logFile.get()];
+			fc.m_LogFile = logFile;
+			fc.m_NumExtractedMessages = 0;
+			fc.m_Columns.resize(m_Definitions.size());
+		}
+	}
+	std::swap(files, m_Files);
+	if (m_Definitions.empty())
+	{
+		return;
+	}
+
+	// Split the new messages into chunks:
+	struct Chunk
+	{
+		FileColumns * m_File;
+		size_t m_Begin, m_End;
+		std::vector<Column> m_Columns;
+	};
+	std::vector<Chunk> chunks;
+	for (auto & f: m_Files)
+	{
+		auto & fc = f.second;
+		auto count = fc.m_LogFile->messageCount();
+		if (fc.m_NumExtractedMessages >= count)
+		{
+			continue;
+		}
+
+		// The message texts are known only after the headers are decoded:
+		fc.m_LogFile->decodeAllHeaders();
+		for (auto begin = fc.m_NumExtractedMessages; begin < count; begin += CHUNK_SIZE)
+		{
+			chunks.push_back({&fc, begin, std::min(begin + CHUNK_SIZE, count), std::vector<Column>(m_Definitions.size())});
+		}
+		fc.m_NumExtractedMessages = count;
+	}
+
+	// Extract all the chunks in parallel:
+	QSemaphore done;
+	for (auto & chunk: chunks)
+	{
+		m_ThreadPool.start(new MetricExtractionTask(
+			m_Definitions, *chunk.m_File->m_LogFile, chunk.m_Begin, chunk.m_End, chunk.m_Columns, done
+		));
+	}
+	done.acquire(static_cast<int>(chunks.size()));
+
+	// Join the chunks in order:
+	for (auto & chunk: chunks)
+	{
+		for (size_t i = 0; i < m_Definitions.size(); ++i)
+		{
+			appendColumn(chunk.m_File->m_Columns[i], std::move(chunk.m_Columns[i]));
+		}
+	}
+}
+
+
+
+
+
+bool MetricExtractor::isInteger(size_t a_MetricIndex) const
+{
+	for (const auto & f: m_Files)
+	{
+		if (!f.second.m_Columns[a_MetricIndex].m_IsInteger)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+
+
+
+bool MetricExtractor::timeRange(qint64 & a_From, qint64 & a_To) const
+{
+	bool hasAny = false;
+	for (const auto & f: m_Files)
+	{
+		for (const auto & column: f.second.m_Columns)
+		{
+			if (column.m_Times.empty())
+			{
+				continue;
+			}
+			if (!hasAny)
+			{
+				a_From = column.m_Times.front();
+				a_To = column.m_Times.back();
+				hasAny = true;
+				continue;
+			}
+			a_From = std::min(a_From, column.m_Times.front());
+			a_To = std::max(a_To, column.m_Times.back());
+		}
+	}
+	return hasAny;
+}
+
+
+
+
+
+template <typename Callback>
+void MetricExtractor::forEachValue(
+	size_t a_MetricIndex,
+	qint64 a_From, qint64 a_To,
+	const MessageFilter & a_Filter,
+	Callback a_Callback
+) const
+{
+	assert(a_MetricIndex < m_Definitions.size());
+	for (const auto & f: m_Files)
+	{
+		const auto & logFile = *f.second.m_LogFile;
+		const auto & column = f.second.m_Columns[a_MetricIndex];
+		const auto & times = column.m_Times;
+
+		// The window is found by a binary search, there's no need to touch the values outside of it:
+		auto begin = static_cast<size_t>(std::lower_bound(times.begin(), times.end(), a_From) - times.begin());
+		auto end   = static_cast<size_t>(std::upper_bound(times.begin(), times.end(), a_To)   - times.begin());
+		for (auto i = begin; i < end; ++i)
+		{
+			if (!a_Filter || a_Filter(logFile, column.m_MessageIndices[i]))
+			{
+				a_Callback(times[i], column.m_Values[i]);
+			}
+		}
+	}
+}
+
+
+
+
+
+MetricHistogram MetricExtractor::summarize(
+	size_t a_MetricIndex,
+	qint64 a_From, qint64 a_To,
+	const MessageFilter & a_Filter
+) const
+{
+	MetricHistogram res;
+	forEachValue(a_MetricIndex, a_From, a_To, a_Filter,
+		[&res](qint64 a_Time, double a_Value)
+		{
+			Q_UNUSED(a_Time);
+			res.add(a_Value);
+		}
+	);
+	return res;
+}
+
+
+
+
+
+std::vector<MetricExtractor::Bin> MetricExtractor::bin(
+	size_t a_MetricIndex,
+	qint64 a_From, qint64 a_To,
+	size_t a_NumBins,
+	const MessageFilter & a_Filter
+) const
+{
+	std::vector<Bin> res(a_NumBins, Bin{0, 0, 0});
+	if ((a_NumBins == 0) || (a_To < a_From))
+	{
+		return res;
+	}
+	auto span = static_cast<double>(a_To - a_From + 1);
+	forEachValue(a_MetricIndex, a_From, a_To, a_Filter,
+		[&](qint64 a_Time, double a_Value)
+		{
+			auto idx = std::min(static_cast<size_t>((a_Time - a_From) / span * a_NumBins), a_NumBins - 1);
+			auto & b = res[idx];
+			if (b.m_Count == 0)
+			{
+				b.m_Min = a_Value;
+				b.m_Max = a_Value;
+			}
+			else
+			{
+				b.m_Min = std::min(b.m_Min, a_Value);
+				b.m_Max = std::max(b.m_Max, a_Value);
+			}
+			b.m_Count += 1;
+		}
+	);
+	return res;
+}
+
+
+
+
+
+void MetricExtractor::extractChunk(
+	const std::vector<MetricDefinition> & a_Definitions,
+	const LogFile & a_LogFile,
+	size_t a_Begin, size_t a_End,
+	std::vector<Column> & a_Columns
+)
+{
+	assert(a_Columns.size() == a_Definitions.size());
+	const auto & text = a_LogFile.getCompleteText();
+	std::string helper;
+	for (auto i = a_Begin; i < a_End; ++i)
+	{
+		auto textLength = a_LogFile.messageTextLength(i);
+		auto msgText = text.span(a_LogFile.messageTextStart(i), textLength, helper);
+		for (size_t d = 0; d < a_Definitions.size(); ++d)
+		{
+			double value;
+			bool isInteger;
+			if (!findValue(a_Definitions[d], msgText, textLength, value, isInteger))
+			{
+				continue;
+			}
+			auto & column = a_Columns[d];
+			column.m_MessageIndices.push_back(i);
+			column.m_Times.push_back(a_LogFile.messageTime(i));
+			column.m_Values.push_back(value);
+			column.m_IsInteger = column.m_IsInteger && isInteger;
+		}
+	}
+}
+
+
+
+
+
+bool MetricExtractor::findValue(
+	const MetricDefinition & a_Definition,
+	const char * a_Text, size_t a_Length,
+	double & a_Value, bool & a_IsInteger
+)
+{
+	const auto & prefix = a_Definition.m_Prefix;
+	const auto & suffix = a_Definition.m_Suffix;
+	auto end = a_Text + a_Length;
+	for (
+		auto found = std::search(a_Text, end, prefix.begin(), prefix.end());
+		found != end;
+		found = std::search(found + 1, end, prefix.begin(), prefix.end())
+	)
+	{
+		// Parse the number: optional minus sign, digits, optional fraction:
+		auto p = found + prefix.size();
+		auto isNegative = ((p < end) && (*p == '-'));
+		if (isNegative)
+		{
+			++p;
+		}
+		auto digitsStart = p;
+		double value = 0;
+		while ((p < end) && (*p >= '0') && (*p <= '9'))
+		{
+			value = value * 10 + (*p - '0');
+			++p;
+		}
+		if (p == digitsStart)
+		{
+			continue;
+		}
+		auto isInteger = true;
+		if ((p + 1 < end) && (*p == '.') && (p[1] >= '0') && (p[1] <= '9'))
+		{
+			isInteger = false;
+			++p;
+			double scale = 0.1;
+			while ((p < end) && (*p >= '0') && (*p <= '9'))
+			{
+				value += (*p - '0') * scale;
+				scale /= 10;
+				++p;
+			}
+		}
+
+		// Check the suffix:
+		if (static_cast<size_t>(end - p) < suffix.size() || !std::equal(suffix.begin(), suffix.end(), p))
+		{
+			continue;
+		}
+		a_Value = isNegative ? -value : value;
+		a_IsInteger = isInteger;
+		return true;
+	}
+	return false;
+}
+
+
+
+
+
+void MetricExtractor::appendColumn(Column & a_Dst, Column && a_Src)
+{
+	if (a_Src.m_Values.empty())
+	{
+		return;
+	}
+	a_Dst.m_IsInteger = a_Dst.m_IsInteger && a_Src.m_IsInteger;
+	auto mid = a_Dst.m_Times.size();
+	a_Dst.m_MessageIndices.insert(a_Dst.m_MessageIndices.end(), a_Src.m_MessageIndices.begin(), a_Src.m_MessageIndices.end());
+	a_Dst.m_Times.insert(a_Dst.m_Times.end(), a_Src.m_Times.begin(), a_Src.m_Times.end());
+	a_Dst.m_Values.insert(a_Dst.m_Values.end(), a_Src.m_Values.begin(), a_Src.m_Values.end());
+	if (std::is_sorted(a_Dst.m_Times.begin() + static_cast<std::ptrdiff_t>(mid > 0 ? mid - 1 : 0), a_Dst.m_Times.end()))
+	{
+		// The usual case, the messages are in the time order
+		return;
+	}
+
+	// Re-sort the whole column by the time, keeping the file order of the values with the same time:
+	std::vector<size_t> order(a_Dst.m_Times.size());
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		order[i] = i;
+	}
+	const auto & times = a_Dst.m_Times;
+	std::stable_sort(order.begin(), order.end(),
+		[&times](size_t a_Idx1, size_t a_Idx2)
+		{
+			return (times[a_Idx1] < times[a_Idx2]);
+		}
+	);
+	Column sorted;
+	sorted.m_IsInteger = a_Dst.m_IsInteger;
+	sorted.m_MessageIndices.reserve(order.size());
+	sorted.m_Times.reserve(order.size());
+	sorted.m_Values.reserve(order.size());
+	for (auto idx: order)
+	{
+		sorted.m_MessageIndices.push_back(a_Dst.m_MessageIndices[idx]);
+		sorted.m_Times.push_back(a_Dst.m_Times[idx]);
+		sorted.m_Values.push_back(a_Dst.m_Values[idx]);
+	}
+	a_Dst = std::move(sorted);
+}
@@ -0,0 +1,267 @@
+// MetricExtractor.h
+
+// Declares the MetricExtractor class that extracts the numbers from the message texts into numeric columns
+
+
+
+
+
+#ifndef METRICEXTRACTOR_H
+#define METRICEXTRACTOR_H
+
+
+
+
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <QString>
+#include <QThreadPool>
+
+
+
+
+
+// fwd:
+class LogFile;
+class Session;
+typedef std::shared_ptr<LogFile> LogFilePtr;
+typedef std::shared_ptr<Session> SessionPtr;
+
+
+
+
+
+/** Histogram of numeric values for the percentile summaries, with a bounded relative error (HDR histogram style).
+Each power of two is split into SUB_BUCKET_COUNT linear buckets, so that each value is represented with a relative
+error below 1 / SUB_BUCKET_COUNT, regardless of its magnitude. Only the non-empty buckets are stored.
+The values are added one by one, without being stored; the exact count, minimum, maximum and sum are kept, too. */
+class MetricHistogram
+{
+public:
+
+	/** The number of bits of the mantissa used for selecting the bucket within a power of two. */
+	static const int SUB_BUCKET_BITS = 7;
+
+	/** The number of buckets within each power of two. */
+	static const int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+
+
+	MetricHistogram();
+
+	/** Adds a single value. */
+	void add(double a_Value);
+
+	/** Returns the number of values added. */
+	quint64 count() const { return m_Count; }
+
+	/** Returns the minimum of the values added, 0 if none. */
+	double min() const { return (m_Count > 0) ? m_Min : 0; }
+
+	/** Returns the maximum of the values added, 0 if none. */
+	double max() const { return (m_Count > 0) ? m_Max : 0; }
+
+	/** Returns the mean of the values added, 0 if none. */
+	double mean() const { return (m_Count > 0) ? m_Sum / m_Count : 0; }
+
+	/** Returns the value below or at which the specified percentage (0 - 100) of the values lie.
+	The value is the midpoint of its bucket, clamped to the exact minimum and maximum. Returns 0 if empty. */
+	double percentile(double a_Percent) const;
+
+
+protected:
+
+	/** The number of values in each non-empty bucket, by the bucket key (see bucketKey()). */
+	std::map<int, quint64> m_Buckets;
+
+	quint64 m_Count;
+	double m_Min;
+	double m_Max;
+	double m_Sum;
+
+
+	/** Returns the key of the bucket containing the specified value.
+	The keys are ordered the same way as the values: negative for negative values, 0 for zero. */
+	static int bucketKey(double a_Value);
+
+	/** Returns the value representing the bucket of the specified key (its midpoint). */
+	static double bucketValue(int a_Key);
+};
+
+
+
+
+
+/** A single metric to be extracted from the message texts: the number between the specified prefix and suffix texts,
+such as "took {} ms". */
+struct MetricDefinition
+{
+	/** The name of the metric, as displayed. */
+	QString m_Name;
+
+	/** The (UTF-8) text that precedes the number. Never empty, it is what the messages are searched for. */
+	std::string m_Prefix;
+
+	/** The (UTF-8) text that needs to follow the number, may be empty. */
+	std::string m_Suffix;
+
+
+	/** Parses the definition from a single line in the "Name = prefix {} suffix" format.
+	Returns true on success, false if the line is not a valid definition. */
+	static bool parse(const QString & a_Line, MetricDefinition & a_Definition);
+};
+
+
+
+
+
+/** Extracts the metrics, numbers found in the message texts, from all the LogFiles in the session, into numeric
+columns keyed by the message. The texts are scanned only once: the extraction processes only the messages published
+since the last extraction, the summaries and the plots are then computed out of the columns alone, for any time window
+and message filter. The extraction runs in parallel, each LogFile is split into chunks processed in the extractor's own
+thread pool; the global one is shared with the parsing, whose queued tasks the UI thread would have to wait out.
+All the functions are to be called from the thread that owns the LogFiles (the UI thread). */
+class MetricExtractor
+{
+public:
+
+	/** The number of messages in a single chunk processed by a single extraction task. */
+	static const size_t CHUNK_SIZE = 64 * 1024;
+
+
+	/** A function that returns true for the messages (given by their LogFile and index) to be included. */
+	typedef std::function<bool(const LogFile &, size_t)> MessageFilter;
+
+	/** Summary of the values in a single bin of a plot. */
+	struct Bin
+	{
+		quint64 m_Count;
+		double m_Min;
+		double m_Max;
+	};
+
+
+	explicit MetricExtractor(SessionPtr a_Session);
+
+	~MetricExtractor();
+
+	/** Sets the metrics to extract. All the values extracted so far are dropped, the next update() extracts anew. */
+	void setDefinitions(std::vector<MetricDefinition> && a_Definitions);
+
+	/** Returns the metrics being extracted. */
+	const std::vector<MetricDefinition> & definitions() const { return m_Definitions; }
+
+	/** Extracts the metrics from all the messages published since the last update, in all the session's LogFiles.
+	The values of the LogFiles that are no longer in the session are dropped. Blocks until done. */
+	void update();
+
+	/** Returns true if all the values of the specified metric extracted so far are integers. */
+	bool isInteger(size_t a_MetricIndex) const;
+
+	/** Returns the time range (msec since epoch) of all the values extracted so far, of all the metrics.
+	Returns false if there are no values. */
+	bool timeRange(qint64 & a_From, qint64 & a_To) const;
+
+	/** Returns the histogram of the values of the specified metric with the time between a_From and a_To
+	(msec since epoch, inclusive), whose messages pass the specified filter. */
+	MetricHistogram summarize(size_t a_MetricIndex, qint64 a_From, qint64 a_To, const MessageFilter & a_Filter) const;
+
+	/** Splits the time between a_From and a_To (msec since epoch, inclusive) into a_NumBins equal parts and returns
+	the summary of the values of the specified metric in each part, whose messages pass the specified filter. */
+	std::vector<Bin> bin(
+		size_t a_MetricIndex,
+		qint64 a_From, qint64 a_To,
+		size_t a_NumBins,
+		const MessageFilter & a_Filter
+	) const;
+
+
+protected:
+
+	friend class MetricExtractionTask;  // Needs access to Column and extractChunk()
+
+	/** The values of a single metric extracted from a single LogFile, sorted by their time. */
+	struct Column
+	{
+		/** The index of the message from which each value has been extracted. */
+		std::vector<size_t> m_MessageIndices;
+
+		/** The time of the message from which each value has been extracted, in msec since epoch. Ascending. */
+		std::vector<qint64> m_Times;
+
+		/** The values. */
+		std::vector<double> m_Values;
+
+		/** True if all the values are integers. */
+		bool m_IsInteger;
+
+		Column(): m_IsInteger(true) {}
+	};
+
+	/** The values extracted from a single LogFile. */
+	struct FileColumns
+	{
+		/** The LogFile, kept alive until the next update() finds it removed from the session. */
+		LogFilePtr m_LogFile;
+
+		/** The number of the LogFile's messages that have been processed. */
+		size_t m_NumExtractedMessages;
+
+		/** The column for each metric, in the order of m_Definitions. */
+		std::vector<Column> m_Columns;
+	};
+
+
+	/** The session whose LogFiles are processed. */
+	SessionPtr m_Session;
+
+	/** The metrics to extract. */
+	std::vector<MetricDefinition> m_Definitions;
+
+	/** The values extracted so far, for each LogFile processed. */
+	std::map<const LogFile *, FileColumns> m_Files;
+
+	/** The threads that extract the chunks in update(). Used by nothing else, so that the extraction never waits for
+	the tasks of the other stages (parsing) to finish. */
+	QThreadPool m_ThreadPool;
+
+
+	/** Extracts the metrics from the messages from a_Begin to a_End of the specified LogFile into a_Columns.
+	Called from the extraction tasks, in parallel. */
+	static void extractChunk(
+		const std::vector<MetricDefinition> & a_Definitions,
+		const LogFile & a_LogFile,
+		size_t a_Begin, size_t a_End,
+		std::vector<Column> & a_Columns
+	);
+
+	/** Searches the text for the specified metric. Returns true and sets a_Value and a_IsInteger if found. */
+	static bool findValue(
+		const MetricDefinition & a_Definition,
+		const char * a_Text, size_t a_Length,
+		double & a_Value, bool & a_IsInteger
+	);
+
+	/** Appends the values of a_Src (extracted from the messages following a_Dst's) to a_Dst, keeping it sorted. */
+	static void appendColumn(Column & a_Dst, Column && a_Src);
+
+	/** Calls a_Callback(time, value) for each value of the specified metric with the time between a_From and a_To
+	(inclusive) whose message passes the filter. */
+	template <typename Callback>
+	void forEachValue(
+		size_t a_MetricIndex,
+		qint64 a_From, qint64 a_To,
+		const MessageFilter & a_Filter,
+		Callback a_Callback
+	) const;
+};
+
+
+
+
+
+#endif // METRICEXTRACTOR_H
@@ -0,0 +1,117 @@
+// MetricPlot.cpp
+
+// Implements the MetricPlot class representing the widget that plots the values of a metric over time
+
+
+
+
+
+#include "MetricPlot.h"
+#include <algorithm>
+#include <QDateTime>
+#include <QPainter>
+#include <QPaintEvent>
+
+
+
+
+
+/** The space reserved for the axis labels, in pixels. */
+static const int LABEL_WIDTH = 80;
+static const int LABEL_HEIGHT = 20;
+
+
+
+
+
+MetricPlot::MetricPlot(QWidget * a_Parent):
+	Super(a_Parent),
+	m_From(0),
+	m_To(0)
+{
+	setMinimumSize(300, 150);
+}
+
+
+
+
+
+void MetricPlot::setData(std::vector<MetricExtractor::Bin> && a_Bins, qint64 a_From, qint64 a_To)
+{
+	m_Bins = std::move(a_Bins);
+	m_From = a_From;
+	m_To = a_To;
+	update();
+}
+
+
+
+
+
+void MetricPlot::paintEvent(QPaintEvent * a_Event)
+{
+	Q_UNUSED(a_Event);
+
+	QPainter painter(this);
+	painter.fillRect(rect(), Qt::white);
+
+	// Find the value range:
+	bool hasAny = false;
+	double minValue = 0, maxValue = 0;
+	for (const auto & b: m_Bins)
+	{
+		if (b.m_Count == 0)
+		{
+			continue;
+		}
+		minValue = hasAny ? std::min(minValue, b.m_Min) : b.m_Min;
+		maxValue = hasAny ? std::max(maxValue, b.m_Max) : b.m_Max;
+		hasAny = true;
+	}
+	if (!hasAny)
+	{
+		painter.drawText(rect(), Qt::AlignCenter, tr("No values in the time window"));
+		return;
+	}
+
+	// Draw the axes and their labels:
+	QRect plotRect(LABEL_WIDTH, 0, width() - LABEL_WIDTH - 1, height() - LABEL_HEIGHT - 1);
+	painter.setPen(Qt::gray);
+	painter.drawRect(plotRect);
+	painter.setPen(Qt::black);
+	auto valueLabelRect = QRect(0, 0, LABEL_WIDTH - 4, LABEL_HEIGHT);
+	painter.drawText(valueLabelRect, Qt::AlignRight | Qt::AlignTop, QString::number(maxValue));
+	valueLabelRect.moveBottom(plotRect.bottom());
+	painter.drawText(valueLabelRect, Qt::AlignRight | Qt::AlignBottom, QString::number(minValue));
+	static const QString dateTimeFormat = "yyyy-MM-dd HH:mm:ss";
+	auto timeLabelRect = QRect(plotRect.left(), plotRect.bottom(), plotRect.width(), LABEL_HEIGHT);
+	painter.drawText(timeLabelRect, Qt::AlignLeft | Qt::AlignVCenter,
+		QDateTime::fromMSecsSinceEpoch(m_From, Qt::UTC).toString(dateTimeFormat)
+	);
+	painter.drawText(timeLabelRect, Qt::AlignRight | Qt::AlignVCenter,
+		QDateTime::fromMSecsSinceEpoch(m_To, Qt::UTC).toString(dateTimeFormat)
+	);
+
+	// Draw each bin as a line from its minimum to its maximum:
+	auto valueRange = maxValue - minValue;
+	auto toY = [&](double a_Value)
+	{
+		if (valueRange <= 0)
+		{
+			return plotRect.center().y();
+		}
+		return plotRect.bottom() - static_cast<int>((a_Value - minValue) / valueRange * plotRect.height());
+	};
+	painter.setPen(Qt::darkBlue);
+	auto numBins = static_cast<double>(m_Bins.size());
+	for (size_t i = 0; i < m_Bins.size(); ++i)
+	{
+		const auto & b = m_Bins[i];
+		if (b.m_Count == 0)
+		{
+			continue;
+		}
+		auto x = plotRect.left() + static_cast<int>((i + 0.5) / numBins * plotRect.width());
+		painter.drawLine(x, toY(b.m_Min), x, toY(b.m_Max));
+	}
+}
@@ -0,0 +1,58 @@
+// MetricPlot.h
+
+// Declares the MetricPlot class representing the widget that plots the values of a metric over time
+
+
+
+
+
+#ifndef METRICPLOT_H
+#define METRICPLOT_H
+
+
+
+
+
+#include <QWidget>
+#include "MetricExtractor.h"
+
+
+
+
+
+/** Plots the values of a single metric over time, as summarized into bins by MetricExtractor::bin().
+Each bin is drawn as a vertical line spanning its minimum and maximum, so that the outliers stay visible
+regardless of how many values fall into a single bin. */
+class MetricPlot:
+	public QWidget
+{
+	Q_OBJECT
+	typedef QWidget Super;
+
+
+public:
+
+	explicit MetricPlot(QWidget * a_Parent = nullptr);
+
+	/** Sets the bins to plot, covering the time from a_From to a_To (msec since epoch), and repaints. */
+	void setData(std::vector<MetricExtractor::Bin> && a_Bins, qint64 a_From, qint64 a_To);
+
+
+protected:
+
+	/** The bins to plot, equally spaced over the time from m_From to m_To. */
+	std::vector<MetricExtractor::Bin> m_Bins;
+
+	/** The time range covered by m_Bins, in msec since epoch. */
+	qint64 m_From, m_To;
+
+
+	// QWidget overrides:
+	virtual void paintEvent(QPaintEvent * a_Event) override;
+};
+
+
+
+
+
+#endif // METRICPLOT_H
@@ -0,0 +1,273 @@
+// MetricsDialog.cpp
+
+// Implements the MetricsDialog class representing the UI for extracting numeric metrics and viewing their statistics
+
+
+
+
+
+#include "MetricsDialog.h"
+#include <QDateTimeEdit>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QMessageBox>
+#include <QPlainTextEdit>
+#include <QPushButton>
+#include <QSignalBlocker>
+#include <QTableWidget>
+#include <QVBoxLayout>
+#include "MetricPlot.h"
+#include "SessionMessagesModel.h"
+
+
+
+
+
+/** The percentiles shown in the summary table, after the count and before the maximum and mean. */
+static const double SUMMARY_PERCENTILES[] = {50, 90, 99, 99.9};
+
+
+
+
+
+const size_t MetricsDialog::NUM_PLOT_BINS;
+
+
+
+
+
+MetricsDialog::MetricsDialog(
+	SessionPtr a_Session,
+	std::shared_ptr<SessionMessagesModel> a_MessagesModel,
+	QWidget * a_Parent
+):
+	Super(a_Parent),
+	m_MessagesModel(a_MessagesModel),
+	m_Extractor(a_Session),
+	m_HasTimeWindow(false)
+{
+	setWindowTitle(tr("Metrics"));
+
+	m_Definitions = new QPlainTextEdit(this);
+	m_Definitions->setPlaceholderText(tr("One metric per line, the number marked by {}, such as:\nDuration = took {} ms"));
+	m_Definitions->setMaximumHeight(100);
+	auto btnExtract = new QPushButton(tr("&Extract"), this);
+	btnExtract->setToolTip(tr("Extracts the metrics from the messages added since the last extraction"));
+	auto btnWholeRange = new QPushButton(tr("&Whole range"), this);
+
+	static const QString dateTimeFormat = "yyyy-MM-dd HH:mm:ss";
+	m_From = new QDateTimeEdit(this);
+	m_To = new QDateTimeEdit(this);
+	for (auto edit: {m_From, m_To})
+	{
+		edit->setTimeSpec(Qt::UTC);
+		edit->setDisplayFormat(dateTimeFormat);
+	}
+
+	m_Summary = new QTableWidget(this);
+	QStringList headers;
+	headers << tr("Metric") << tr("Count") << tr("Min");
+	for (auto percentile: SUMMARY_PERCENTILES)
+	{
+		headers << tr("P%1").arg(percentile);
+	}
+	headers << tr("Max") << tr("Mean");
+	m_Summary->setColumnCount(headers.size());
+	m_Summary->setHorizontalHeaderLabels(headers);
+	m_Summary->setEditTriggers(QAbstractItemView::NoEditTriggers);
+	m_Summary->setSelectionBehavior(QAbstractItemView::SelectRows);
+	m_Summary->setSelectionMode(QAbstractItemView::SingleSelection);
+	m_Summary->verticalHeader()->hide();
+
+	m_Plot = new MetricPlot(this);
+
+	// Lay out the widgets:
+	auto definitionsLayout = new QHBoxLayout;
+	definitionsLayout->addWidget(m_Definitions);
+	definitionsLayout->addWidget(btnExtract, 0, Qt::AlignTop);
+	auto windowLayout = new QHBoxLayout;
+	windowLayout->addWidget(new QLabel(tr("From:"), this));
+	windowLayout->addWidget(m_From);
+	windowLayout->addWidget(new QLabel(tr("To:"), this));
+	windowLayout->addWidget(m_To);
+	windowLayout->addWidget(btnWholeRange);
+	windowLayout->addStretch();
+	auto layout = new QVBoxLayout(this);
+	layout->addLayout(definitionsLayout);
+	layout->addLayout(windowLayout);
+	layout->addWidget(m_Summary);
+	layout->addWidget(m_Plot, 1);
+	resize(800, 600);
+
+	connect(btnExtract,    &QPushButton::clicked,             this, &MetricsDialog::extractMetrics);
+	connect(btnWholeRange, &QPushButton::clicked,             this, &MetricsDialog::resetTimeWindow);
+	connect(m_From,        &QDateTimeEdit::dateTimeChanged,   this, &MetricsDialog::refresh);
+	connect(m_To,          &QDateTimeEdit::dateTimeChanged,   this, &MetricsDialog::refresh);
+	connect(m_Summary,     &QTableWidget::currentCellChanged, this, &MetricsDialog::refreshPlot);
+}
+
+
+
+
+
+MetricsDialog::~MetricsDialog()
+{
+}
+
+
+
+
+
+void MetricsDialog::extractMetrics()
+{
+	// Apply the definitions, if they have changed:
+	auto definitionsText = m_Definitions->toPlainText();
+	if (definitionsText != m_AppliedDefinitions)
+	{
+		std::vector<MetricDefinition> definitions;
+		QStringList invalidLines;
+		for (const auto & line: definitionsText.split('\n'))
+		{
+			if (line.trimmed().isEmpty())
+			{
+				continue;
+			}
+			MetricDefinition def;
+			if (!MetricDefinition::parse(line, def))
+			{
+				invalidLines << line;
+				continue;
+			}
+			definitions.push_back(std::move(def));
+		}
+		if (!invalidLines.isEmpty())
+		{
+			QMessageBox::warning(
+				this,
+				tr("Metrics"),
+				tr("The following metric definitions are invalid and will be ignored:\n%1").arg(invalidLines.join("\n"))
+			);
+		}
+		m_Extractor.setDefinitions(std::move(definitions));
+		m_AppliedDefinitions = definitionsText;
+		m_HasTimeWindow = false;
+	}
+
+	m_Extractor.update();
+	m_Summary->setRowCount(static_cast<int>(m_Extractor.definitions().size()));
+	if (!m_HasTimeWindow)
+	{
+		resetTimeWindow();
+	}
+	else
+	{
+		refresh();
+	}
+}
+
+
+
+
+
+void MetricsDialog::refresh()
+{
+	const auto & definitions = m_Extractor.definitions();
+	auto from = windowFrom();
+	auto to = windowTo();
+	auto filter = messageFilter();
+	for (size_t i = 0; i < definitions.size(); ++i)
+	{
+		auto summary = m_Extractor.summarize(i, from, to, filter);
+		auto isInteger = m_Extractor.isInteger(i);
+		auto formatValue = [isInteger](double a_Value)
+		{
+			return isInteger ? QString::number(qRound64(a_Value)) : QString::number(a_Value);
+		};
+		QStringList values;
+		values << definitions[i].m_Name << QString::number(summary.count()) << formatValue(summary.min());
+		for (auto percentile: SUMMARY_PERCENTILES)
+		{
+			values << formatValue(summary.percentile(percentile));
+		}
+		values << formatValue(summary.max()) << QString::number(summary.mean());
+		for (int col = 0; col < values.size(); ++col)
+		{
+			m_Summary->setItem(static_cast<int>(i), col, new QTableWidgetItem(values[col]));
+		}
+	}
+	if ((m_Summary->currentRow() < 0) && !definitions.empty())
+	{
+		m_Summary->setCurrentCell(0, 0);  // Refreshes the plot through currentCellChanged
+		return;
+	}
+	refreshPlot();
+}
+
+
+
+
+
+void MetricsDialog::refreshPlot()
+{
+	auto row = m_Summary->currentRow();
+	auto from = windowFrom();
+	auto to = windowTo();
+	if ((row < 0) || (static_cast<size_t>(row) >= m_Extractor.definitions().size()))
+	{
+		m_Plot->setData(std::vector<MetricExtractor::Bin>(), from, to);
+		return;
+	}
+	m_Plot->setData(m_Extractor.bin(static_cast<size_t>(row), from, to, NUM_PLOT_BINS, messageFilter()), from, to);
+}
+
+
+
+
+
+void MetricsDialog::resetTimeWindow()
+{
+	qint64 from, to;
+	m_HasTimeWindow = m_Extractor.timeRange(from, to);
+	if (m_HasTimeWindow)
+	{
+		// Set both ends at once, without refreshing after each:
+		QSignalBlocker blockFrom(m_From);
+		QSignalBlocker blockTo(m_To);
+		m_From->setDateTime(QDateTime::fromMSecsSinceEpoch(from, Qt::UTC));
+		m_To->setDateTime(QDateTime::fromMSecsSinceEpoch(to, Qt::UTC));
+	}
+	refresh();
+}
+
+
+
+
+
+MetricExtractor::MessageFilter MetricsDialog::messageFilter() const
+{
+	auto model = m_MessagesModel;
+	return [model](const LogFile & a_LogFile, size_t a_MessageIndex)
+	{
+		return model->isMessageShown(a_LogFile, a_MessageIndex);
+	};
+}
+
+
+
+
+
+qint64 MetricsDialog::windowFrom() const
+{
+	return m_From->dateTime().toMSecsSinceEpoch();
+}
+
+
+
+
+
+qint64 MetricsDialog::windowTo() const
+{
+	// The edit shows whole seconds only, include the whole last second:
+	return m_To->dateTime().toMSecsSinceEpoch() + 999;
+}
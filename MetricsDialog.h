@@ -0,0 +1,110 @@
+// MetricsDialog.h
+
+// Declares the MetricsDialog class representing the UI for extracting numeric metrics and viewing their statistics
+
+
+
+
+
+#ifndef METRICSDIALOG_H
+#define METRICSDIALOG_H
+
+
+
+
+
+#include <memory>
+#include <QDialog>
+#include "MetricExtractor.h"
+
+
+
+
+
+// fwd:
+class QDateTimeEdit;
+class QPlainTextEdit;
+class QTableWidget;
+class MetricPlot;
+class SessionMessagesModel;
+
+
+
+
+
+/** Dialog where the user defines the numeric metrics to extract from the message texts (MetricExtractor), and views
+their percentile summaries and the plot of their values over time, within a time window and the current message filter.
+Changing the time window recomputes the statistics from the extracted values only, the texts are not scanned again.
+The dialog is modeless, so that the message filter can be changed while it is open. */
+class MetricsDialog:
+	public QDialog
+{
+	Q_OBJECT
+	typedef QDialog Super;
+
+
+public:
+
+	/** The number of bins into which the time window is split for the plot. */
+	static const size_t NUM_PLOT_BINS = 1024;
+
+
+	MetricsDialog(SessionPtr a_Session, std::shared_ptr<SessionMessagesModel> a_MessagesModel, QWidget * a_Parent = nullptr);
+
+	~MetricsDialog();
+
+
+public slots:
+
+	/** Applies the metric definitions (if they have changed, all the values are extracted anew), extracts the metrics
+	from the messages published since the last extraction and refreshes the statistics. */
+	void extractMetrics();
+
+	/** Recomputes the statistics and the plot for the current time window and message filter. */
+	void refresh();
+
+
+protected slots:
+
+	/** Recomputes the plot of the currently selected metric. */
+	void refreshPlot();
+
+	/** Sets the time window to the whole time range of the extracted values. */
+	void resetTimeWindow();
+
+
+protected:
+
+	/** The model whose filter is applied to the messages of the extracted values. */
+	std::shared_ptr<SessionMessagesModel> m_MessagesModel;
+
+	/** The extracted values. */
+	MetricExtractor m_Extractor;
+
+	/** The text of the definitions applied to m_Extractor. */
+	QString m_AppliedDefinitions;
+
+	/** True if the time window has been set (to the range of the values), false if there were no values yet. */
+	bool m_HasTimeWindow;
+
+	// The UI widgets, owned by the dialog:
+	QPlainTextEdit * m_Definitions;
+	QDateTimeEdit * m_From;
+	QDateTimeEdit * m_To;
+	QTableWidget * m_Summary;
+	MetricPlot * m_Plot;
+
+
+	/** Returns the filter passing the messages shown by m_MessagesModel. */
+	MetricExtractor::MessageFilter messageFilter() const;
+
+	/** Returns the time window set by the user, in msec since epoch. */
+	qint64 windowFrom() const;
+	qint64 windowTo() const;
+};
+
+
+
+
+
+#endif // METRICSDIALOG_H
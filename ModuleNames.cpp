@@ -0,0 +1,145 @@
+// ModuleNames.cpp
+
+// Implements the ModuleNames class representing the process-wide table of the module names and their identifiers
+
+
+
+
+
+#include "ModuleNames.h"
+#include <assert.h>
+#include <string.h>
+#include <QMutexLocker>
+
+
+
+
+
+const int ModuleNames::MAX_IDENTIFIERS;
+const char ModuleNames::OVERFLOW_NAME[] = "(other modules)";
+const size_t ModuleNames::NUM_SLOTS;
+
+
+
+
+
+ModuleNames::ModuleNames()
+{
+	for (auto & slot: m_Slots)
+	{
+		slot.store(0, std::memory_order_relaxed);
+	}
+}
+
+
+
+
+
+ModuleNames & ModuleNames::get()
+{
+	static ModuleNames * instance = new ModuleNames;
+	return *instance;
+}
+
+
+
+
+
+int ModuleNames::intern(const char * a_Name, size_t a_Length)
+{
+	// Most of the names are already known, look them up without locking:
+	auto hash = hashName(a_Name, a_Length);
+	size_t slot;
+	auto identifier = lookup(a_Name, a_Length, hash, slot);
+	if (identifier >= 0)
+	{
+		return identifier;
+	}
+
+	// Not found, look up again under the lock, another thread may have added the name meanwhile:
+	QMutexLocker lock(&m_Mtx);
+	identifier = lookup(a_Name, a_Length, hash, slot);
+	if (identifier >= 0)
+	{
+		return identifier;
+	}
+
+	// Past the limit of the identifiers, all the new names share the overflow identifier:
+	auto numNames = m_Names.size();
+	if (numNames >= static_cast<size_t>(MAX_IDENTIFIERS - 1))
+	{
+		if (numNames == static_cast<size_t>(MAX_IDENTIFIERS - 1))
+		{
+			m_Names.emplace_back(OVERFLOW_NAME);
+			m_Names.publish(m_Names.size());
+		}
+		return MAX_IDENTIFIERS - 1;
+	}
+
+	// Add the name, publishing it before its slot:
+	identifier = static_cast<int>(numNames);
+	m_Names.emplace_back(a_Name, a_Length);
+	m_Names.publish(m_Names.size());
+	m_Slots[slot].store(identifier + 1, std::memory_order_release);
+	return identifier;
+}
+
+
+
+
+
+int ModuleNames::find(const std::string & a_Name) const
+{
+	size_t slot;
+	return lookup(a_Name.data(), a_Name.size(), hashName(a_Name.data(), a_Name.size()), slot);
+}
+
+
+
+
+
+std::string ModuleNames::name(int a_Identifier) const
+{
+	if ((a_Identifier < 0) || (static_cast<size_t>(a_Identifier) >= m_Names.publishedSize()))
+	{
+		return std::string();
+	}
+	return m_Names[static_cast<size_t>(a_Identifier)];
+}
+
+
+
+
+
+size_t ModuleNames::hashName(const char * a_Name, size_t a_Length)
+{
+	// FNV-1a:
+	quint64 hash = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < a_Length; ++i)
+	{
+		hash ^= static_cast<unsigned char>(a_Name[i]);
+		hash *= 0x100000001b3ULL;
+	}
+	return static_cast<size_t>(hash ^ (hash >> 32));
+}
+
+
+
+
+
+int ModuleNames::lookup(const char * a_Name, size_t a_Length, size_t a_Hash, size_t & a_Slot) const
+{
+	for (a_Slot = a_Hash & (NUM_SLOTS - 1);; a_Slot = (a_Slot + 1) & (NUM_SLOTS - 1))
+	{
+		auto value = m_Slots[a_Slot].load(std::memory_order_acquire);
+		if (value == 0)
+		{
+			return -1;
+		}
+		const auto & name = m_Names[static_cast<size_t>(value - 1)];
+		if ((name.size() == a_Length) && ((a_Length == 0) || (memcmp(name.data(), a_Name, a_Length) == 0)))
+		{
+			return value - 1;
+		}
+	}
+}
@@ -0,0 +1,95 @@
+// ModuleNames.h
+
+// Declares the ModuleNames class representing the process-wide table of the module names and their identifiers
+
+
+
+
+
+#ifndef MODULENAMES_H
+#define MODULENAMES_H
+
+
+
+
+
+#include <atomic>
+#include <string>
+#include <QMutex>
+#include "AppendOnlyVector.h"
+
+
+
+
+
+/** The table of all the module names found in the log files, assigning each a small identifier (interning).
+There's a single table for the whole process, shared by all the LogFiles of the session, so that a module identifier
+means the same module in every file and the files can be compared and filtered by the identifiers.
+The parsers intern the names straight from the text they parse, without copying them into a string first.
+Looking up a name that is already known (the common case, there are only a few hundred distinct modules) is lock-free;
+only adding a new name locks. The names are never removed. Thread-safe. */
+class ModuleNames
+{
+public:
+
+	/** The maximum number of distinct module identifiers, given by the 16-bit module column of LogFile.
+	The modules beyond the limit share the last identifier, OVERFLOW_NAME. */
+	static const int MAX_IDENTIFIERS = 0x7fff;
+
+	/** The name of the identifier shared by the modules beyond MAX_IDENTIFIERS. */
+	static const char OVERFLOW_NAME[];
+
+
+	/** Returns the single instance of the table.
+	The instance is never destroyed, so that the LogFiles destroyed during the app shutdown can still use it. */
+	static ModuleNames & get();
+
+	/** Returns the identifier of the module name given by the a_Length bytes at a_Name, adding the name if not yet known. */
+	int intern(const char * a_Name, size_t a_Length);
+
+	/** Returns the identifier of the specified module name, or -1 if the name is not known. */
+	int find(const std::string & a_Name) const;
+
+	/** Returns the name of the module with the specified identifier.
+	If no such module is known (including the -1 of the undecoded messages), returns an empty string. */
+	std::string name(int a_Identifier) const;
+
+	/** Returns the number of the identifiers assigned so far. */
+	size_t count() const { return m_Names.publishedSize(); }
+
+
+protected:
+
+	/** The number of the hash table slots, a power of two. Twice the maximum number of the names, so that the table
+	is never more than half full and the probe sequences stay short. */
+	static const size_t NUM_SLOTS = 0x10000;
+
+
+	/** The names, indexed by their identifiers. Appended only while holding m_Mtx, each name is published
+	before its slot in m_Slots, so that a reader finding the slot can read the name. */
+	AppendOnlyVector<std::string> m_Names;
+
+	/** The open-addressing hash table of the names, linear probing.
+	Each slot holds the identifier of the name plus one, or 0 if the slot is empty.
+	The slots only change from empty to taken, so the readers don't need any locking. */
+	std::atomic<int> m_Slots[NUM_SLOTS];
+
+	/** Serializes the adding of the names. */
+	QMutex m_Mtx;
+
+
+	ModuleNames();
+
+	/** Returns the hash of the a_Length bytes at a_Name. */
+	static size_t hashName(const char * a_Name, size_t a_Length);
+
+	/** Looks up the name, without locking. Returns its identifier, or -1 if not found.
+	a_Slot is set to the slot where the probe ended, either the name's slot, or the empty slot where it would go. */
+	int lookup(const char * a_Name, size_t a_Length, size_t a_Hash, size_t & a_Slot) const;
+};
+
+
+
+
+
+#endif // MODULENAMES_H
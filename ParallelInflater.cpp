@@ -0,0 +1,1137 @@
+// ParallelInflater.cpp
+
+// Implements the ParallelInflater class that decompresses big single-member GZIP data using multiple threads
+
+
+
+
+
+#include "ParallelInflater.h"
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+#include <QtDebug>
+
+#ifdef _MSC_VER
+	// When compiling in MSVC on Windows, use Qt-provided zlib (there's no system-zlib)
+	#include <QtZlib/zlib.h>
+#else
+	// Use system-zlib everywhere else:
+	#include <zlib.h>
+#endif
+
+
+
+
+
+/** The size of the deflate window. */
+static const size_t WINDOW_SIZE = 32 * 1024;
+
+/** The minimum distance between two block boundaries reported as checkpoints, in bytes of decompressed data. */
+static const size_t CHECKPOINT_SPAN = GZipIndexedTextBuffer::CHECKPOINT_SPAN;
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// HuffmanTable:
+
+/** Decoding table for a single deflate Huffman code.
+Codes up to FAST_BITS long are decoded using a single lookup, longer codes bit-by-bit (canonical decoding). */
+struct HuffmanTable
+{
+	static const int MAX_BITS = 15;
+	static const int FAST_BITS = 10;
+
+	/** Lookup table indexed by the next FAST_BITS bits of the input: (symbol << 4) | length, 0 if not a short code. */
+	quint16 m_Fast[1 << FAST_BITS];
+
+	/** Number of codes of each length. */
+	quint16 m_Count[MAX_BITS + 1];
+
+	/** The symbols, ordered by their code. */
+	quint16 m_Symbol[288];
+
+
+	/** Builds the table from the code lengths of the symbols.
+	If a_IsStrict is true, only complete codes are accepted (except for a single code, valid for distances).
+	Returns false if the lengths don't form a valid code. */
+	bool build(const quint8 * a_Lengths, int a_NumSymbols, bool a_IsStrict)
+	{
+		memset(m_Count, 0, sizeof(m_Count));
+		for (int i = 0; i < a_NumSymbols; i++)
+		{
+			m_Count[a_Lengths[i]] += 1;
+		}
+		auto numCodes = a_NumSymbols - m_Count[0];
+		m_Count[0] = 0;
+		int left = 1;
+		for (int len = 1; len <= MAX_BITS; len++)
+		{
+			left = (left << 1) - m_Count[len];
+			if (left < 0)
+			{
+				// Over-subscribed
+				return false;
+			}
+		}
+		if (a_IsStrict && (left > 0) && !((numCodes == 1) && (m_Count[1] == 1)))
+		{
+			// Incomplete
+			return false;
+		}
+
+		// Sort the symbols by their code, assign the codes and fill in the fast table:
+		quint16 offsets[MAX_BITS + 2];
+		offsets[1] = 0;
+		for (int len = 1; len <= MAX_BITS; len++)
+		{
+			offsets[len + 1] = offsets[len] + m_Count[len];
+		}
+		quint16 nextCode[MAX_BITS + 1];
+		int code = 0;
+		for (int len = 1; len <= MAX_BITS; len++)
+		{
+			code = (code + m_Count[len - 1]) << 1;
+			nextCode[len] = static_cast<quint16>(code);
+		}
+		memset(m_Fast, 0, sizeof(m_Fast));
+		for (int sym = 0; sym < a_NumSymbols; sym++)
+		{
+			int len = a_Lengths[sym];
+			if (len == 0)
+			{
+				continue;
+			}
+			m_Symbol[offsets[len]++] = static_cast<quint16>(sym);
+			int symCode = nextCode[len]++;
+			if (len <= FAST_BITS)
+			{
+				// The codes are stored MSB-first in an LSB-first stream, the table index needs the reversed code:
+				int reversed = 0;
+				for (int i = 0; i < len; i++)
+				{
+					reversed = (reversed << 1) | ((symCode >> i) & 1);
+				}
+				for (int i = reversed; i < (1 << FAST_BITS); i += (1 << len))
+				{
+					m_Fast[i] = static_cast<quint16>((sym << 4) | len);
+				}
+			}
+		}
+		return true;
+	}
+};
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SpeculativeDecoder:
+
+/** Deflate decoder that can start at any block boundary without knowing the preceding window.
+Bytes copied from the unknown window are output as placeholders (256 + position within the window). As soon as
+there are no placeholders within the last window's worth of data, no more can appear, so from then on the output
+is stored as plain bytes. */
+class SpeculativeDecoder
+{
+public:
+
+	/** The decoded data with placeholders, 16-bit symbols. */
+	std::vector<quint16> m_Head;
+
+	/** The decoded data after m_Head, plain bytes. Starts with a copy of the last WINDOW_SIZE bytes of m_Head. */
+	std::string m_Tail;
+
+	/** True once the output has switched from m_Head to m_Tail. */
+	bool m_IsInTail;
+
+	/** If true, the decoder accepts only text (ASCII) literals and only complete Huffman codes (for finding block starts). */
+	bool m_IsStrict;
+
+
+	SpeculativeDecoder(const unsigned char * a_Data, size_t a_Size):
+		m_IsInTail(false),
+		m_IsStrict(false),
+		m_Data(a_Data),
+		m_Size(a_Size),
+		m_BytePos(0),
+		m_BitBuf(0),
+		m_BitCount(0),
+		m_PadBits(0),
+		m_LastPlaceholder(0),
+		m_HasPlaceholder(false)
+	{
+	}
+
+
+	/** Positions the decoder at the specified bit of the data and clears the output. */
+	void seek(size_t a_BitPos)
+	{
+		m_BytePos = a_BitPos / 8;
+		m_BitBuf = 0;
+		m_BitCount = 0;
+		m_PadBits = 0;
+		refill();
+		consume(static_cast<int>(a_BitPos % 8));
+		m_Head.clear();
+		m_Tail.clear();
+		m_IsInTail = false;
+		m_HasPlaceholder = false;
+	}
+
+
+	/** Returns the current position in the data, in bits. */
+	size_t bitPos() const
+	{
+		return m_BytePos * 8 + m_PadBits - static_cast<size_t>(m_BitCount);
+	}
+
+
+	/** Returns the number of bytes decoded so far. */
+	size_t outputSize() const
+	{
+		return m_IsInTail ? (m_Head.size() + m_Tail.size() - WINDOW_SIZE) : m_Head.size();
+	}
+
+
+	/** Decodes a single block, including its header.
+	Returns true on success, sets a_IsFinal if the block was the final one. Returns false on invalid data. */
+	bool decodeBlock(bool & a_IsFinal)
+	{
+		refill();
+		a_IsFinal = (bits(1) != 0);
+		auto type = bits(2);
+		if (m_IsStrict && ((type != 2) || a_IsFinal))
+		{
+			// Only dynamic non-final blocks are considered when searching for a block start
+			return false;
+		}
+		bool res;
+		switch (type)
+		{
+			case 0:  res = decodeStoredBlock(); break;
+			case 1:  res = decodeFixedBlock(); break;
+			case 2:  res = decodeDynamicBlock(); break;
+			default: return false;
+		}
+		if (!res || (bitPos() > m_Size * 8))
+		{
+			// Invalid data, or ran past the end of the data
+			return false;
+		}
+		if (!m_IsInTail)
+		{
+			switchToTailIfPossible();
+		}
+		return true;
+	}
+
+
+protected:
+
+	/** The complete compressed data. */
+	const unsigned char * m_Data;
+
+	/** The size of m_Data. */
+	size_t m_Size;
+
+	/** Position of the next byte of m_Data to be read into m_BitBuf. */
+	size_t m_BytePos;
+
+	/** The bits read from the data but not consumed yet, LSB first. */
+	quint64 m_BitBuf;
+
+	/** The number of valid bits in m_BitBuf. */
+	int m_BitCount;
+
+	/** The number of zero bits added to m_BitBuf past the end of the data. */
+	size_t m_PadBits;
+
+	/** The position of the last placeholder in m_Head, valid only if m_HasPlaceholder. */
+	size_t m_LastPlaceholder;
+
+	/** True if there is a placeholder in m_Head. */
+	bool m_HasPlaceholder;
+
+	/** The Huffman tables for the current block. */
+	HuffmanTable m_LitLen, m_Dist;
+
+
+	/** Fills m_BitBuf with at least 56 bits, pads with zeros past the end of data. */
+	void refill()
+	{
+		while (m_BitCount <= 56)
+		{
+			if (m_BytePos < m_Size)
+			{
+				m_BitBuf |= static_cast<quint64>(m_Data[m_BytePos]) << m_BitCount;
+				m_BytePos += 1;
+			}
+			else
+			{
+				m_PadBits += 8;
+			}
+			m_BitCount += 8;
+		}
+	}
+
+
+	/** Consumes the specified number of bits. */
+	void consume(int a_NumBits)
+	{
+		m_BitBuf >>= a_NumBits;
+		m_BitCount -= a_NumBits;
+	}
+
+
+	/** Reads the specified number of bits (up to 32, the caller needs to ensure they're available). */
+	unsigned bits(int a_NumBits)
+	{
+		auto res = static_cast<unsigned>(m_BitBuf & ((1ull << a_NumBits) - 1));
+		consume(a_NumBits);
+		return res;
+	}
+
+
+	/** Decodes a single symbol using the specified table. Returns -1 if the code is invalid.
+	There must be at least MAX_BITS bits available in m_BitBuf. */
+	int decodeSymbol(const HuffmanTable & a_Table)
+	{
+		auto entry = a_Table.m_Fast[m_BitBuf & ((1 << HuffmanTable::FAST_BITS) - 1)];
+		if (entry != 0)
+		{
+			consume(entry & 15);
+			return entry >> 4;
+		}
+
+		// Long code, decode bit by bit:
+		int code = 0, first = 0, index = 0;
+		for (int len = 1; len <= HuffmanTable::MAX_BITS; len++)
+		{
+			code |= static_cast<int>(bits(1));
+			int count = a_Table.m_Count[len];
+			if (code - count < first)
+			{
+				return a_Table.m_Symbol[index + (code - first)];
+			}
+			index += count;
+			first += count;
+			first <<= 1;
+			code <<= 1;
+		}
+		return -1;
+	}
+
+
+	/** Outputs a single literal byte. */
+	void putLiteral(unsigned a_Byte)
+	{
+		if (m_IsInTail)
+		{
+			m_Tail.push_back(static_cast<char>(a_Byte));
+		}
+		else
+		{
+			m_Head.push_back(static_cast<quint16>(a_Byte));
+		}
+	}
+
+
+	/** Copies the specified number of bytes from the specified distance back in the output.
+	Returns false if the distance is invalid. */
+	bool copyMatch(unsigned a_Length, unsigned a_Distance)
+	{
+		if (m_IsInTail)
+		{
+			// The tail always starts with a full window, the distance is always valid:
+			auto pos = m_Tail.size();
+			m_Tail.resize(pos + a_Length);
+			auto dst = &m_Tail[pos];
+			auto src = dst - a_Distance;
+			for (unsigned i = 0; i < a_Length; i++)
+			{
+				dst[i] = src[i];
+			}
+			return true;
+		}
+
+		for (unsigned i = 0; i < a_Length; i++)
+		{
+			auto size = m_Head.size();
+			if (a_Distance <= size)
+			{
+				auto value = m_Head[size - a_Distance];
+				if (value >= 256)
+				{
+					m_LastPlaceholder = size;
+					m_HasPlaceholder = true;
+				}
+				m_Head.push_back(value);
+			}
+			else
+			{
+				// Reference into the unknown window:
+				m_LastPlaceholder = size;
+				m_HasPlaceholder = true;
+				m_Head.push_back(static_cast<quint16>(256 + WINDOW_SIZE - (a_Distance - size)));
+			}
+		}
+		return true;
+	}
+
+
+	/** If the last window's worth of m_Head has no placeholders, switches the output to m_Tail. */
+	void switchToTailIfPossible()
+	{
+		auto size = m_Head.size();
+		if ((size < WINDOW_SIZE) || (m_HasPlaceholder && (size - m_LastPlaceholder <= WINDOW_SIZE)))
+		{
+			return;
+		}
+		m_Tail.reserve(std::max<size_t>(m_Tail.capacity(), 4 * WINDOW_SIZE));
+		for (size_t i = size - WINDOW_SIZE; i < size; i++)
+		{
+			m_Tail.push_back(static_cast<char>(m_Head[i]));
+		}
+		m_IsInTail = true;
+	}
+
+
+	/** Decodes the data of a stored block. */
+	bool decodeStoredBlock()
+	{
+		consume(m_BitCount % 8);
+		refill();
+		auto len = bits(16);
+		auto nlen = bits(16);
+		if (len != (~nlen & 0xffff))
+		{
+			return false;
+		}
+		for (unsigned i = 0; i < len; i++)
+		{
+			refill();
+			auto ch = bits(8);
+			if (m_IsStrict && !isTextChar(ch))
+			{
+				return false;
+			}
+			putLiteral(ch);
+		}
+		return true;
+	}
+
+
+	/** Decodes the data of a block compressed with the fixed Huffman codes. */
+	bool decodeFixedBlock()
+	{
+		static HuffmanTable fixedLitLen, fixedDist;
+		static bool isInitialized = [&]()
+		{
+			quint8 lengths[288];
+			for (int i = 0; i < 144; i++) lengths[i] = 8;
+			for (int i = 144; i < 256; i++) lengths[i] = 9;
+			for (int i = 256; i < 280; i++) lengths[i] = 7;
+			for (int i = 280; i < 288; i++) lengths[i] = 8;
+			fixedLitLen.build(lengths, 288, false);
+			for (int i = 0; i < 30; i++) lengths[i] = 5;
+			fixedDist.build(lengths, 30, false);
+			return true;
+		}();
+		Q_UNUSED(isInitialized);
+		return decodeCompressedData(fixedLitLen, fixedDist);
+	}
+
+
+	/** Reads the dynamic Huffman codes and decodes the data of the block. */
+	bool decodeDynamicBlock()
+	{
+		static const quint8 CODE_LENGTH_ORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+		refill();
+		auto numLitLen = bits(5) + 257;
+		auto numDist = bits(5) + 1;
+		auto numCodeLen = bits(4) + 4;
+		if ((numLitLen > 286) || (numDist > 30))
+		{
+			return false;
+		}
+
+		// Read the code length code:
+		quint8 lengths[286 + 30];
+		memset(lengths, 0, 19);
+		refill();
+		for (unsigned i = 0; i < numCodeLen; i++)
+		{
+			lengths[CODE_LENGTH_ORDER[i]] = static_cast<quint8>(bits(3));
+		}
+		HuffmanTable codeLen;
+		if (!codeLen.build(lengths, 19, true))
+		{
+			return false;
+		}
+
+		// Read the literal / length and distance code lengths:
+		unsigned idx = 0;
+		while (idx < numLitLen + numDist)
+		{
+			refill();
+			auto sym = decodeSymbol(codeLen);
+			if (sym < 0)
+			{
+				return false;
+			}
+			if (sym < 16)
+			{
+				lengths[idx++] = static_cast<quint8>(sym);
+				continue;
+			}
+			quint8 value = 0;
+			unsigned repeat;
+			switch (sym)
+			{
+				case 16:
+				{
+					if (idx == 0)
+					{
+						return false;
+					}
+					value = lengths[idx - 1];
+					repeat = 3 + bits(2);
+					break;
+				}
+				case 17: repeat = 3 + bits(3); break;
+				default: repeat = 11 + bits(7); break;
+			}
+			if (idx + repeat > numLitLen + numDist)
+			{
+				return false;
+			}
+			memset(lengths + idx, value, repeat);
+			idx += repeat;
+		}
+		if (lengths[256] == 0)
+		{
+			// No end-of-block code
+			return false;
+		}
+		if (
+			!m_LitLen.build(lengths, static_cast<int>(numLitLen), m_IsStrict) ||
+			!m_Dist.build(lengths + numLitLen, static_cast<int>(numDist), m_IsStrict)
+		)
+		{
+			return false;
+		}
+		return decodeCompressedData(m_LitLen, m_Dist);
+	}
+
+
+	/** Decodes the Huffman-compressed data of a block, up to and including the end-of-block code. */
+	bool decodeCompressedData(const HuffmanTable & a_LitLen, const HuffmanTable & a_Dist)
+	{
+		static const quint16 LENGTH_BASE[29] = {
+			3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+		};
+		static const quint8 LENGTH_EXTRA[29] = {
+			0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+		};
+		static const quint16 DIST_BASE[30] = {
+			1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+			1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+		};
+		static const quint8 DIST_EXTRA[30] = {
+			0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+		};
+
+		while (true)
+		{
+			refill();
+			if (m_PadBits > 64)
+			{
+				// Ran past the end of the data
+				return false;
+			}
+			auto sym = decodeSymbol(a_LitLen);
+			if (sym < 256)
+			{
+				if (sym < 0)
+				{
+					return false;
+				}
+				if (m_IsStrict && !isTextChar(static_cast<unsigned>(sym)))
+				{
+					return false;
+				}
+				putLiteral(static_cast<unsigned>(sym));
+				continue;
+			}
+			if (sym == 256)
+			{
+				return true;
+			}
+			sym -= 257;
+			if (sym >= 29)
+			{
+				return false;
+			}
+			auto length = LENGTH_BASE[sym] + bits(LENGTH_EXTRA[sym]);
+			auto distSym = decodeSymbol(a_Dist);
+			if ((distSym < 0) || (distSym >= 30))
+			{
+				return false;
+			}
+			auto distance = DIST_BASE[distSym] + bits(DIST_EXTRA[distSym]);
+			if (!copyMatch(length, distance))
+			{
+				return false;
+			}
+		}
+	}
+
+
+	/** Returns true if the byte is a plain text character (used for rejecting false block starts). */
+	static bool isTextChar(unsigned a_Byte)
+	{
+		return ((a_Byte >= 32) && (a_Byte < 127)) || (a_Byte == '\n') || (a_Byte == '\r') || (a_Byte == '\t');
+	}
+};
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// ParallelInflaterChunk, ChunkInflateTask:
+
+/** A single chunk of the compressed data, decoded speculatively in a separate thread. */
+struct ParallelInflaterChunk
+{
+	/** A block boundary within the chunk, usable as an index checkpoint. */
+	struct BlockBoundary
+	{
+		size_t m_BitPos;
+		size_t m_OutputPos;  // Relative to the chunk's start
+	};
+
+
+	/** Position of the chunk in the compressed data, in bytes. The search for the block start begins here. */
+	size_t m_SearchStart;
+
+	/** Position where the next chunk begins, in bytes. The decoding stops at the first block boundary past it. */
+	size_t m_SearchEnd;
+
+	/** True if a block start was found and the data decoded successfully from there. */
+	bool m_IsValid;
+
+	/** The bit position of the block where the decoding started. */
+	size_t m_StartBitPos;
+
+	/** The bit position of the block boundary where the decoding ended. */
+	size_t m_EndBitPos;
+
+	/** True if the chunk contains the final block. */
+	bool m_IsFinal;
+
+	/** The decoded data (see SpeculativeDecoder). */
+	std::vector<quint16> m_Head;
+	std::string m_Tail;
+	bool m_IsInTail;
+
+	/** The block boundaries usable as index checkpoints, at least CHECKPOINT_SPAN apart. */
+	std::vector<BlockBoundary> m_BlockBoundaries;
+
+	/** Set by the consumer if the chunk is no longer needed. */
+	std::atomic<bool> m_ShouldAbort;
+
+	/** Released once the decoding task has finished. */
+	QSemaphore m_Done;
+
+
+	ParallelInflaterChunk(size_t a_SearchStart, size_t a_SearchEnd):
+		m_SearchStart(a_SearchStart),
+		m_SearchEnd(a_SearchEnd),
+		m_IsValid(false),
+		m_StartBitPos(0),
+		m_EndBitPos(0),
+		m_IsFinal(false),
+		m_IsInTail(false),
+		m_ShouldAbort(false)
+	{
+	}
+};
+
+typedef std::shared_ptr<ParallelInflaterChunk> ParallelInflaterChunkPtr;
+
+
+
+
+
+/** Finds the block start in a chunk and decodes the chunk from there. */
+class ChunkInflateTask:
+	public QRunnable
+{
+public:
+	ChunkInflateTask(TextBufferPtr a_CompressedData, ParallelInflaterChunkPtr a_Chunk):
+		m_CompressedData(a_CompressedData),
+		m_Chunk(a_Chunk)
+	{
+	}
+
+
+	virtual void run() override
+	{
+		auto data = reinterpret_cast<const unsigned char *>(m_CompressedData->data());
+		SpeculativeDecoder decoder(data, m_CompressedData->size());
+		if (findBlockStart(decoder))
+		{
+			decodeChunk(decoder);
+		}
+		m_Chunk->m_Done.release();
+	}
+
+
+protected:
+
+	/** The complete compressed data. */
+	TextBufferPtr m_CompressedData;
+
+	/** The chunk to process and to store the results into. */
+	ParallelInflaterChunkPtr m_Chunk;
+
+
+	/** Searches for the first position in the chunk where a dynamic block producing text starts.
+	Returns true if found, the position is stored in the chunk. */
+	bool findBlockStart(SpeculativeDecoder & a_Decoder)
+	{
+		auto endBit = m_Chunk->m_SearchEnd * 8;
+		a_Decoder.m_IsStrict = true;
+		for (auto bitPos = m_Chunk->m_SearchStart * 8; bitPos < endBit; bitPos++)
+		{
+			if (((bitPos & 0xffff) == 0) && m_Chunk->m_ShouldAbort.load())
+			{
+				return false;
+			}
+			a_Decoder.seek(bitPos);
+			bool isFinal;
+			if (a_Decoder.decodeBlock(isFinal))
+			{
+				m_Chunk->m_StartBitPos = bitPos;
+				a_Decoder.m_IsStrict = false;
+				return true;
+			}
+		}
+		return false;
+	}
+
+
+	/** Decodes the chunk from the found block start up to the first block boundary past the chunk's end. */
+	void decodeChunk(SpeculativeDecoder & a_Decoder)
+	{
+		a_Decoder.seek(m_Chunk->m_StartBitPos);
+		auto endBit = m_Chunk->m_SearchEnd * 8;
+		size_t lastBoundary = 0;
+		bool isFinal = false;
+		while (!isFinal && !m_Chunk->m_ShouldAbort.load())
+		{
+			if (!a_Decoder.decodeBlock(isFinal))
+			{
+				return;
+			}
+			auto bitPos = a_Decoder.bitPos();
+			if (isFinal || (bitPos >= endBit))
+			{
+				m_Chunk->m_EndBitPos = bitPos;
+				m_Chunk->m_IsFinal = isFinal;
+				m_Chunk->m_Head = std::move(a_Decoder.m_Head);
+				m_Chunk->m_Tail = std::move(a_Decoder.m_Tail);
+				m_Chunk->m_IsInTail = a_Decoder.m_IsInTail;
+				m_Chunk->m_IsValid = true;
+				return;
+			}
+			auto outputPos = a_Decoder.outputSize();
+			if (outputPos - lastBoundary >= CHECKPOINT_SPAN)
+			{
+				m_Chunk->m_BlockBoundaries.push_back({bitPos, outputPos});
+				lastBoundary = outputPos;
+			}
+		}
+	}
+};
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// ParallelInflater:
+
+const size_t ParallelInflater::CHUNK_SIZE;
+
+
+
+
+
+ParallelInflater::ParallelInflater(TextBufferPtr a_CompressedData, std::atomic<bool> & a_ShouldAbort):
+	m_CompressedData(a_CompressedData),
+	m_ShouldAbort(a_ShouldAbort),
+	m_Receiver(nullptr),
+	m_Crc(0),
+	m_TotalSize(0)
+{
+	assert(m_CompressedData->data() != nullptr);  // The compressed data needs to be contiguous
+}
+
+
+
+
+
+ParallelInflater::Result ParallelInflater::inflate(Receiver & a_Receiver)
+{
+	m_Receiver = &a_Receiver;
+	m_Window.clear();
+	m_Crc = crc32(0, nullptr, 0);
+	m_TotalSize = 0;
+	auto deflateStart = skipGZipHeader();
+	if (deflateStart == 0)
+	{
+		return rDataError;
+	}
+
+	// Queue the chunks for speculative decoding, a limited number at a time to limit the memory used.
+	// The first chunk is decoded serially right here, while the others are being decoded in the thread pool:
+	auto size = m_CompressedData->size();
+	auto & threadPool = *QThreadPool::globalInstance();
+	auto maxInFlight = static_cast<size_t>(std::max(2, QThread::idealThreadCount()));
+	std::deque<ParallelInflaterChunkPtr> inFlight;
+	size_t nextChunkStart = deflateStart + CHUNK_SIZE;
+	auto abortInFlight = [&inFlight]()
+	{
+		for (auto & chunk: inFlight)
+		{
+			chunk->m_ShouldAbort = true;
+		}
+	};
+
+	size_t bitPos = deflateStart * 8;
+	bool isFinished = false;
+	while (!isFinished)
+	{
+		while ((inFlight.size() < maxInFlight) && (nextChunkStart < size))
+		{
+			auto chunkEnd = std::min(nextChunkStart + CHUNK_SIZE, size);
+			auto chunk = std::make_shared<ParallelInflaterChunk>(nextChunkStart, chunkEnd);
+			threadPool.start(new ChunkInflateTask(m_CompressedData, chunk));
+			inFlight.push_back(chunk);
+			nextChunkStart = chunkEnd;
+		}
+
+		// Decompress serially up to the next chunk's nominal start (or to the end, if there are no more chunks):
+		auto targetBitPos = inFlight.empty() ? size * 8 : inFlight.front()->m_SearchStart * 8;
+		if (bitPos < targetBitPos)
+		{
+			auto res = inflateSerially(bitPos, targetBitPos, isFinished);
+			if (res != rSuccess)
+			{
+				abortInFlight();
+				return res;
+			}
+			if (isFinished)
+			{
+				break;
+			}
+		}
+		if (inFlight.empty())
+		{
+			// Ran out of data without reaching the end of the stream
+			return rDataError;
+		}
+
+		// Use the next chunk, if its speculative start matches the current position:
+		auto chunk = inFlight.front();
+		inFlight.pop_front();
+		if (bitPos >= chunk->m_SearchEnd * 8)
+		{
+			// The serial decompression has already passed the whole chunk
+			chunk->m_ShouldAbort = true;
+			continue;
+		}
+		chunk->m_Done.acquire();
+		if (m_ShouldAbort.load())
+		{
+			abortInFlight();
+			return rAborted;
+		}
+		if (!chunk->m_IsValid || (chunk->m_StartBitPos != bitPos))
+		{
+			// No block start found in the chunk, or the serial decompression ended on a different boundary,
+			// the chunk's data will be decompressed serially in the next round
+			continue;
+		}
+		auto res = deliverChunk(*chunk);
+		if (res != rSuccess)
+		{
+			abortInFlight();
+			return res;
+		}
+		bitPos = chunk->m_EndBitPos;
+		isFinished = chunk->m_IsFinal;
+	}
+	abortInFlight();
+	return checkTrailer(bitPos) ? rSuccess : rDataError;
+}
+
+
+
+
+
+size_t ParallelInflater::skipGZipHeader() const
+{
+	auto data = reinterpret_cast<const unsigned char *>(m_CompressedData->data());
+	auto size = m_CompressedData->size();
+	if ((size < 18) || (data[0] != 0x1f) || (data[1] != 0x8b) || (data[2] != 8))
+	{
+		return 0;
+	}
+	auto flags = data[3];
+	size_t pos = 10;
+	if ((flags & 4) != 0)  // FEXTRA
+	{
+		pos += 2 + static_cast<size_t>(data[pos] | (data[pos + 1] << 8));
+	}
+	if ((flags & 8) != 0)  // FNAME
+	{
+		while ((pos < size) && (data[pos] != 0))
+		{
+			pos += 1;
+		}
+		pos += 1;
+	}
+	if ((flags & 16) != 0)  // FCOMMENT
+	{
+		while ((pos < size) && (data[pos] != 0))
+		{
+			pos += 1;
+		}
+		pos += 1;
+	}
+	if ((flags & 2) != 0)  // FHCRC
+	{
+		pos += 2;
+	}
+	return (pos < size) ? pos : 0;
+}
+
+
+
+
+
+bool ParallelInflater::deliver(const char * a_Data, size_t a_Size)
+{
+	if (a_Size == 0)
+	{
+		return true;
+	}
+	m_Crc = crc32(m_Crc, reinterpret_cast<const Bytef *>(a_Data), static_cast<uInt>(a_Size));
+	m_TotalSize += a_Size;
+	if (a_Size >= WINDOW_SIZE)
+	{
+		m_Window.assign(a_Data + a_Size - WINDOW_SIZE, WINDOW_SIZE);
+	}
+	else
+	{
+		m_Window.append(a_Data, a_Size);
+		if (m_Window.size() > WINDOW_SIZE)
+		{
+			m_Window.erase(0, m_Window.size() - WINDOW_SIZE);
+		}
+	}
+	return m_Receiver->write(a_Data, a_Size);
+}
+
+
+
+
+
+void ParallelInflater::deliverCheckpoint(size_t a_BitPos)
+{
+	// zlib's inflatePrime() takes the bits of the partial byte preceding the first full byte of the block:
+	auto byteOffset = a_BitPos / 8;
+	auto bitOffset = static_cast<int>(a_BitPos % 8);
+	auto compressedPos = (bitOffset == 0) ? byteOffset : byteOffset + 1;
+	auto bits = (bitOffset == 0) ? 0 : 8 - bitOffset;
+	m_Receiver->addCheckpoint(compressedPos, bits, m_Window.data(), m_Window.size());
+}
+
+
+
+
+
+ParallelInflater::Result ParallelInflater::inflateSerially(size_t & a_BitPos, size_t a_TargetBitPos, bool & a_IsFinished)
+{
+	auto compressed = reinterpret_cast<const Bytef *>(m_CompressedData->data());
+	auto compressedSize = m_CompressedData->size();
+
+	// Initialize the decompression at the bit position, with the known window:
+	z_stream zlibStream;
+	memset(&zlibStream, 0, sizeof(zlibStream));
+	if (inflateInit2(&zlibStream, -15) != Z_OK)
+	{
+		return rDataError;
+	}
+	auto inPos = a_BitPos / 8;
+	auto bitOffset = static_cast<int>(a_BitPos % 8);
+	if (bitOffset > 0)
+	{
+		inflatePrime(&zlibStream, 8 - bitOffset, compressed[inPos] >> bitOffset);
+		inPos += 1;
+	}
+	if (!m_Window.empty())
+	{
+		inflateSetDictionary(&zlibStream, reinterpret_cast<const Bytef *>(m_Window.data()), static_cast<uInt>(m_Window.size()));
+	}
+
+	static const size_t CHUNK = 256 * 1024;
+	std::unique_ptr<char[]> buffer(new char[CHUNK]);
+	size_t sinceCheckpoint = 0;
+	auto result = rSuccess;
+	while (true)
+	{
+		if ((zlibStream.avail_in == 0) && (inPos < compressedSize))
+		{
+			auto len = std::min<size_t>(compressedSize - inPos, 1024 * 1024 * 1024);
+			zlibStream.next_in = const_cast<Bytef *>(compressed + inPos);
+			zlibStream.avail_in = static_cast<uInt>(len);
+			inPos += len;
+		}
+		zlibStream.next_out = reinterpret_cast<Bytef *>(buffer.get());
+		zlibStream.avail_out = static_cast<uInt>(CHUNK);
+		auto zr = ::inflate(&zlibStream, Z_BLOCK);
+		auto numDecompressed = CHUNK - zlibStream.avail_out;
+		if (!deliver(buffer.get(), numDecompressed))
+		{
+			result = rReceiverFailed;
+			break;
+		}
+		sinceCheckpoint += numDecompressed;
+		if (zr == Z_STREAM_END)
+		{
+			a_BitPos = (inPos - zlibStream.avail_in) * 8;
+			a_IsFinished = true;
+			break;
+		}
+		if (zr != Z_OK)
+		{
+			qDebug("%s: uncompression failed: %d (\"%s\").", __FUNCTION__, zr, zlibStream.msg);
+			result = rDataError;
+			break;
+		}
+		bool isAtBlockBoundary = ((zlibStream.data_type & 128) != 0) && ((zlibStream.data_type & 64) == 0);
+		if (isAtBlockBoundary)
+		{
+			// data_type has the number of unused bits in the last byte consumed:
+			auto bitPos = (inPos - zlibStream.avail_in) * 8 - static_cast<size_t>(zlibStream.data_type & 7);
+			if (sinceCheckpoint >= CHECKPOINT_SPAN)
+			{
+				deliverCheckpoint(bitPos);
+				sinceCheckpoint = 0;
+			}
+			if (bitPos >= a_TargetBitPos)
+			{
+				a_BitPos = bitPos;
+				break;
+			}
+		}
+		if (m_ShouldAbort.load())
+		{
+			result = rAborted;
+			break;
+		}
+	}
+	inflateEnd(&zlibStream);
+	return result;
+}
+
+
+
+
+
+ParallelInflater::Result ParallelInflater::deliverChunk(ParallelInflaterChunk & a_Chunk)
+{
+	// Resolve the placeholders in the head, using the window preceding the chunk:
+	std::string window(WINDOW_SIZE - m_Window.size(), '\0');
+	window.append(m_Window);
+	std::string data;
+	data.resize(a_Chunk.m_Head.size());
+	for (size_t i = 0, size = a_Chunk.m_Head.size(); i < size; i++)
+	{
+		auto value = a_Chunk.m_Head[i];
+		data[i] = (value < 256) ? static_cast<char>(value) : window[value - 256];
+	}
+	a_Chunk.m_Head.clear();
+	a_Chunk.m_Head.shrink_to_fit();
+	if (a_Chunk.m_IsInTail)
+	{
+		// The tail starts with a copy of the last window of the head:
+		data.append(a_Chunk.m_Tail, WINDOW_SIZE, std::string::npos);
+		a_Chunk.m_Tail.clear();
+		a_Chunk.m_Tail.shrink_to_fit();
+	}
+
+	// Deliver the data, with the checkpoints at the block boundaries:
+	size_t written = 0;
+	for (const auto & boundary: a_Chunk.m_BlockBoundaries)
+	{
+		if (!deliver(data.data() + written, boundary.m_OutputPos - written))
+		{
+			return rReceiverFailed;
+		}
+		written = boundary.m_OutputPos;
+		deliverCheckpoint(boundary.m_BitPos);
+	}
+	if (!deliver(data.data() + written, data.size() - written))
+	{
+		return rReceiverFailed;
+	}
+	return rSuccess;
+}
+
+
+
+
+
+bool ParallelInflater::checkTrailer(size_t a_EndBitPos) const
+{
+	auto data = reinterpret_cast<const unsigned char *>(m_CompressedData->data());
+	auto pos = (a_EndBitPos + 7) / 8;
+	if (pos + 8 > m_CompressedData->size())
+	{
+		qDebug("%s: The GZIP trailer is missing.", __FUNCTION__);
+		return false;
+	}
+	auto readLE32 = [data](size_t a_Pos)
+	{
+		return
+			static_cast<quint32>(data[a_Pos]) |
+			(static_cast<quint32>(data[a_Pos + 1]) << 8) |
+			(static_cast<quint32>(data[a_Pos + 2]) << 16) |
+			(static_cast<quint32>(data[a_Pos + 3]) << 24);
+	};
+	if ((readLE32(pos) != static_cast<quint32>(m_Crc)) || (readLE32(pos + 4) != static_cast<quint32>(m_TotalSize)))
+	{
+		qDebug("%s: The GZIP trailer doesn't match the data.", __FUNCTION__);
+		return false;
+	}
+	if (pos + 8 < m_CompressedData->size())
+	{
+		qDebug("%s: Ignoring %llu bytes after the GZIP member.",
+			__FUNCTION__, static_cast<unsigned long long>(m_CompressedData->size() - pos - 8)
+		);
+	}
+	return true;
+}
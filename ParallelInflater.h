@@ -0,0 +1,136 @@
+// ParallelInflater.h
+
+// Declares the ParallelInflater class that decompresses big single-member GZIP data using multiple threads
+
+
+
+
+
+#ifndef PARALLELINFLATER_H
+#define PARALLELINFLATER_H
+
+
+
+
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "TextBuffer.h"
+
+
+
+
+
+// fwd:
+struct ParallelInflaterChunk;
+
+
+
+
+
+/** Decompresses a single-member GZIP stream using multiple threads, in the manner of pugz.
+The compressed data is split into chunks. In each chunk (but the first one) a deflate block start is found
+speculatively and the chunk is decoded from there on a separate thread, without knowing the preceding window;
+references into the unknown window are kept as placeholders. The chunks are then joined in order and the placeholders
+are resolved using the actual preceding data.
+If the speculation turns out to be wrong (a chunk's start doesn't match the end of the previous one), the data is
+decompressed serially, using zlib, up to the next chunk instead, so the result is always correct.
+Works best for text data, where the false block starts are easy to reject. */
+class ParallelInflater
+{
+public:
+
+	/** Interface for receiving the decompressed data, in order. */
+	class Receiver
+	{
+	public:
+		virtual ~Receiver() {}
+
+		/** Receives the next part of the decompressed data.
+		Returns true to continue, false to abort the decompression. */
+		virtual bool write(const char * a_Data, size_t a_Size) = 0;
+
+		/** Called at the deflate block boundaries, after all the data preceding the boundary has been written.
+		The parameters have the same meaning as in GZipIndexedTextBuffer::addCheckpoint(). */
+		virtual void addCheckpoint(size_t a_CompressedPos, int a_Bits, const char * a_Window, size_t a_WindowSize) = 0;
+	};
+
+
+	/** The result of the decompression. */
+	enum Result
+	{
+		rSuccess,
+		rDataError,
+		rReceiverFailed,
+		rAborted,
+	};
+
+
+	/** The size of the chunks into which the compressed data is split. */
+	static const size_t CHUNK_SIZE = 2 * 1024 * 1024;
+
+
+	/** Creates a new instance for decompressing the specified (contiguous) GZIP data.
+	a_ShouldAbort is a shared variable that indicates whether the decompression should be aborted (from another thread). */
+	ParallelInflater(TextBufferPtr a_CompressedData, std::atomic<bool> & a_ShouldAbort);
+
+	/** Returns true if data of the specified size is big enough for the parallel decompression to pay off. */
+	static bool isWorthIt(size_t a_CompressedSize) { return (a_CompressedSize >= 4 * CHUNK_SIZE); }
+
+	/** Decompresses the data, passes the decompressed data to a_Receiver.
+	The data after the first GZIP member is ignored. */
+	Result inflate(Receiver & a_Receiver);
+
+
+protected:
+
+	/** The complete compressed data. */
+	TextBufferPtr m_CompressedData;
+
+	/** When set to true (by another thread), the decompression is aborted at the nearest opportunity. */
+	std::atomic<bool> & m_ShouldAbort;
+
+	/** The receiver of the decompressed data, valid while inflate() runs. */
+	Receiver * m_Receiver;
+
+	/** The last (up to) 32 KiB of the data passed to the receiver, used as the window for the next chunk. */
+	std::string m_Window;
+
+	/** The CRC32 of all the data passed to the receiver. */
+	unsigned long m_Crc;
+
+	/** The total number of bytes passed to the receiver. */
+	size_t m_TotalSize;
+
+
+	/** Returns the position of the deflate data after the GZIP header, or 0 if the header is invalid. */
+	size_t skipGZipHeader() const;
+
+	/** Passes the data to the receiver, updates the window, CRC and size.
+	Returns false if the receiver failed. */
+	bool deliver(const char * a_Data, size_t a_Size);
+
+	/** Reports a checkpoint at the specified bit position to the receiver, with m_Window as its window.
+	All the data preceding the checkpoint needs to be delivered already. */
+	void deliverCheckpoint(size_t a_BitPos);
+
+	/** Decompresses the data serially using zlib, starting at a_BitPos (a block boundary) with m_Window as the preceding
+	window, until reaching a block boundary at or past a_TargetBitPos, or the end of the stream.
+	Updates a_BitPos to the reached position, sets a_IsFinished if the end of the stream has been reached. */
+	Result inflateSerially(size_t & a_BitPos, size_t a_TargetBitPos, bool & a_IsFinished);
+
+	/** Resolves the placeholders in the chunk's data using m_Window and passes the data to the receiver. */
+	Result deliverChunk(ParallelInflaterChunk & a_Chunk);
+
+	/** Checks the GZIP trailer (CRC32 and ISIZE) after the deflate stream ending at the specified bit position. */
+	bool checkTrailer(size_t a_EndBitPos) const;
+};
+
+
+
+
+
+#endif // PARALLELINFLATER_H
@@ -7,6 +7,7 @@
 
 
 #include "Session.h"
+#include <algorithm>
 
 
 
@@ -21,10 +22,75 @@ Session::Session()
 
 
 
-void Session::appendLogFile(LogFilePtr a_LogFile)
+bool Session::appendLogFile(LogFilePtr a_LogFile)
 {
+	if (std::find(m_LogFiles.begin(), m_LogFiles.end(), a_LogFile) != m_LogFiles.end())
+	{
+		m_TokenIndex.addLogFile(*a_LogFile);
+		emit logFileMessagesAdded(a_LogFile);
+		if (a_LogFile->applyReidentifiedSource())
+		{
+			emit logFileSourceChanged(a_LogFile);
+		}
+		return true;
+	}
+
+	// Ignore the log files parsed from a disk file that has been removed meanwhile:
+	if (a_LogFile->generation() != fileGeneration(a_LogFile->fileName()))
+	{
+		return false;
+	}
+
+	a_LogFile->applyReidentifiedSource();
+	m_TokenIndex.addLogFile(*a_LogFile);
 	m_LogFiles.push_back(a_LogFile);
 	emit logFileAdded(a_LogFile);
+	return true;
+}
+
+
+
+
+
+void Session::updateLogFile(LogFilePtr a_LogFile)
+{
+	if (std::find(m_LogFiles.begin(), m_LogFiles.end(), a_LogFile) == m_LogFiles.end())
+	{
+		return;
+	}
+	m_TokenIndex.addLogFile(*a_LogFile);
+	emit logFileMessagesAdded(a_LogFile);
+}
+
+
+
+
+
+void Session::removeLogFiles(const QString & a_FileName)
+{
+	m_FileGenerations[a_FileName] += 1;
+	for (auto itr = m_LogFiles.begin(); itr != m_LogFiles.end();)
+	{
+		if ((*itr)->fileName() != a_FileName)
+		{
+			++itr;
+			continue;
+		}
+		auto logFile = *itr;  // Keep the LogFile alive while the signal is being processed
+		itr = m_LogFiles.erase(itr);
+		m_TokenIndex.removeLogFile(logFile.get());
+		emit logFileRemoved(logFile);
+	}
+}
+
+
+
+
+
+quint64 Session::fileGeneration(const QString & a_FileName) const
+{
+	auto itr = m_FileGenerations.find(a_FileName);
+	return (itr == m_FileGenerations.end()) ? 0 : itr->second;
 }
 
 
@@ -36,6 +102,7 @@ void Session::merge(Session & a_Src)
 	for (auto lf: a_Src.m_LogFiles)
 	{
 		m_LogFiles.push_back(lf);
+		m_TokenIndex.addLogFile(*lf);
 		emit logFileAdded(lf);
 	}
 }
@@ -49,7 +116,7 @@ size_t Session::getMessageCount() const
 	size_t res = 0;
 	for (const auto & lf: m_LogFiles)
 	{
-		res += lf->messages().size();
+		res += lf->messageCount();
 	}
 	return res;
 }
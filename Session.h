@@ -9,10 +9,12 @@
 
 
 
+#include <map>
 #include <memory>
 #include <vector>
 #include <QObject>
 #include "LogFile.h"
+#include "TokenIndex.h"
 
 
 
@@ -41,8 +43,28 @@ public:
 		const QString & a_SourceIdentifier = ""
 	);
 
-	/** Adds the specified existing log file data to the collection. */
-	void appendLogFile(LogFilePtr a_LogFile);
+	/** Adds the specified existing log file data to the collection.
+	If the log file is already present (its messages are being published while it is parsed), emits
+	logFileMessagesAdded instead, to announce the messages published since the last call, and applies the source type
+	identified once the file is parsed completely (emitting logFileSourceChanged if it changed).
+	A log file that is outdated, because it wasn't parsed by the latest generation of its disk file (fileGeneration()),
+	is ignored.
+	Returns true if the log file is in the collection, false if it was ignored as outdated. */
+	bool appendLogFile(LogFilePtr a_LogFile);
+
+	/** Announces the messages published in the specified log file since the last call (logFileMessagesAdded).
+	Does nothing if the log file is not in the collection (it has been removed meanwhile). */
+	void updateLogFile(LogFilePtr a_LogFile);
+
+	/** Removes all the log files read from the specified disk file (all the archive members for an archive).
+	Emits logFileRemoved for each of them. Starts a new generation of the disk file, so that the log files of the disk
+	file that are still being parsed (or waiting to be parsed) are outdated, appendLogFile() ignores them. */
+	void removeLogFiles(const QString & a_FileName);
+
+	/** Returns the latest generation of the specified disk file; only the log files parsed with this generation
+	(LogFile::generation()) are added to the collection. Each removeLogFiles() call starts a new generation,
+	a disk file that has never been removed is in generation 0. */
+	quint64 fileGeneration(const QString & a_FileName) const;
 
 	/** Merges the logfiles from the specified session into this session (shallow-copy m_LogFiles).
 	All logfiles are copied, even the "conflicting" ones. */
@@ -51,7 +73,10 @@ public:
 	/** Returns all the log files currently loaded in this session (read-only). */
 	const std::vector<LogFilePtr> & logFiles(void) const { return m_LogFiles; }
 
-	/** Returns the sum of all message counts for all the LogFiles. */
+	/** Returns the index of the identifiers found in the published messages of all the log files. */
+	const TokenIndex & tokenIndex(void) const { return m_TokenIndex; }
+
+	/** Returns the sum of all message counts (published so far) for all the LogFiles. */
 	size_t getMessageCount() const;
 
 protected:
@@ -59,9 +84,27 @@ protected:
 	/** All the log files currently loaded, in no specific order. */
 	std::vector<LogFilePtr> m_LogFiles;
 
+	/** The disk files whose log files have been removed, mapped to their latest generation (see fileGeneration()). */
+	std::map<QString, quint64> m_FileGenerations;
+
+	/** The identifiers found in the published messages of m_LogFiles.
+	Updated before announcing the messages, so that the receivers can already query it. */
+	TokenIndex m_TokenIndex;
+
 signals:
 	/** Emitted after a new LogFile is added to the list. */
 	void logFileAdded(LogFilePtr a_LogFile);
+
+	/** Emitted after more messages have been published in a LogFile already in the list, while it is being parsed. */
+	void logFileMessagesAdded(LogFilePtr a_LogFile);
+
+	/** Emitted after a LogFile is removed from the list. */
+	void logFileRemoved(LogFilePtr a_LogFile);
+
+	/** Emitted after the source type of a LogFile already in the list has changed.
+	The source of a file published while being parsed is identified from its first batch of messages, then again
+	from all of them once the file is parsed completely. */
+	void logFileSourceChanged(LogFilePtr a_LogFile);
 };
 
 
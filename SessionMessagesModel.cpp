@@ -7,6 +7,8 @@
 
 
 #include "SessionMessagesModel.h"
+#include <assert.h>
+#include <algorithm>
 #include <QBrush>
 #include <QDebug>
 #include "Session.h"
@@ -17,18 +19,18 @@
 
 
 
-/** Returns true if the "First" message should go in front of "Second". */
+/** Returns true if the "First" message should go in front of "Second", given the messages' times. */
 static bool isMessageEarlier(
-	const LogFile::Message & a_FirstMsg,
+	qint64 a_FirstTime,
 	const LogFile & a_FirstFile,
-	const LogFile::Message & a_SecondMsg,
+	qint64 a_SecondTime,
 	const LogFile & a_SecondFile
 )
 {
 	return (
-		(a_FirstMsg.m_DateTime < a_SecondMsg.m_DateTime) ||
+		(a_FirstTime < a_SecondTime) ||
 		(
-			(a_FirstMsg.m_DateTime == a_SecondMsg.m_DateTime) &&
+			(a_FirstTime == a_SecondTime) &&
 			(a_FirstFile < a_SecondFile)
 		)
 	);
@@ -38,13 +40,14 @@ static bool isMessageEarlier(
 
 
 
-/** Incrementally reports all messages from the specified Session in the sorted order. */
+/** Incrementally reports all messages from the specified Session in the sorted order.
+Only the messages published by the time of construction are reported, even if the LogFiles get more meanwhile.
+The messages of each LogFile are taken in its time order (LogFile::timeOrder()). */
 class SessionMessagesModel::MessageSorter
 {
 public:
 	MessageSorter(Session & a_Session):
 		m_LogFiles(a_Session.logFiles()),
-		// m_LogFilesMessages(initLogFilesMessagesVector()),
 		m_NumLogFiles(a_Session.logFiles().size())
 	{
 		m_Indices.resize(a_Session.logFiles().size());
@@ -52,6 +55,19 @@ public:
 		{
 			i = 0;
 		}
+		m_Ends.reserve(m_NumLogFiles);
+		m_TimeOrders.reserve(m_NumLogFiles);
+		for (const auto & lf: m_LogFiles)
+		{
+			m_Ends.push_back(lf->messageCount());
+			m_TimeOrders.push_back(lf->timeOrder(0, m_Ends.back()));
+		}
+	}
+
+	/** Returns the number of messages reported from the specified LogFile (index into the Session's logFiles()). */
+	size_t numMessages(size_t a_LogFileIndex) const
+	{
+		return m_Ends[a_LogFileIndex];
 	}
 
 	/** Returns the next message in the sorted order.
@@ -63,21 +79,22 @@ public:
 		size_t toIncrement = 0;
 		for (size_t i = 0; i < m_NumLogFiles; ++i)
 		{
-			if (m_Indices[i] >= m_LogFiles[i]->messages().size())
+			if (m_Indices[i] >= m_Ends[i])
 			{
 				// This LogFile is exhausted
 				continue;
 			}
+			auto msgIdx = m_TimeOrders[i].empty() ? m_Indices[i] : m_TimeOrders[i][m_Indices[i]];
 			if (
 				(f == nullptr) ||
 				(isMessageEarlier(
-					f->messages()[idx], *f,
-					m_LogFiles[i]->messages()[m_Indices[i]], *m_LogFiles[i]
+					f->messageTime(idx), *f,
+					m_LogFiles[i]->messageTime(msgIdx), *m_LogFiles[i]
 				))
 			)
 			{
 				f = m_LogFiles[i].get();
-				idx = m_Indices[i];
+				idx = msgIdx;
 				toIncrement = i;
 			}
 		}
@@ -94,31 +111,18 @@ protected:
 	/** The LogFile vector from m_Session. */
 	const std::vector<LogFilePtr> & m_LogFiles;
 
-	/** The messages() objects of each of m_LogFiles, in the same order. */
-	// const std::vector<const std::vector<LogFile::Message> &> m_LogFilesMessages;
-
 	/** Number of LogFilePtr instances in m_LogFiles. */
 	size_t m_NumLogFiles;
 
-	/** Per-LogFile indices for the next message in each file to consider.
-	m_Session.logFiles()[i].messages()[m_Indices[i]] */
+	/** Per-LogFile positions of the next message in each file to consider, in the file's time order.
+	m_Session.logFiles()[i].message(m_TimeOrders[i][m_Indices[i]]) */
 	std::vector<size_t> m_Indices;
 
+	/** Per-LogFile time order of the messages, LogFile::timeOrder(); empty for the files already in the time order. */
+	std::vector<std::vector<size_t>> m_TimeOrders;
 
-	#if 0
-	/** Creates the data that is stored in m_LogFilesMessages by the constructor. */
-	std::vector<const std::vector<LogFile::Message> &> initLogFilesMessagesVector(
-		const std::vector<LogFilePtr> & a_LogFiles
-	)
-	{
-		std::vector<const std::vector<LogFile::Message> &> res;
-		for (const auto & lf: a_LogFiles)
-		{
-			res.push_back(lf->messages());
-		}
-		return res;
-	}
-	#endif
+	/** Per-LogFile number of messages to report, their messageCount() at the time of construction. */
+	std::vector<size_t> m_Ends;
 };
 
 
@@ -129,9 +133,15 @@ protected:
 // SessionMessagesModel:
 
 SessionMessagesModel::SessionMessagesModel(SessionPtr a_Session):
-	m_Session(a_Session)
+	m_Session(a_Session),
+	m_HasTokenFilter(false),
+	m_HasThreadFilter(false),
+	m_ThreadFilter(0)
 {
 	connect(a_Session.get(), SIGNAL(logFileAdded(LogFilePtr)), this, SLOT(sessionLogFileAdded(LogFilePtr)));
+	connect(a_Session.get(), SIGNAL(logFileMessagesAdded(LogFilePtr)), this, SLOT(sessionLogFileMessagesAdded(LogFilePtr)));
+	connect(a_Session.get(), SIGNAL(logFileRemoved(LogFilePtr)), this, SLOT(sessionLogFileRemoved(LogFilePtr)));
+	connect(a_Session.get(), SIGNAL(logFileSourceChanged(LogFilePtr)), this, SLOT(sessionLogFileSourceChanged(LogFilePtr)));
 }
 
 
@@ -179,16 +189,18 @@ QVariant SessionMessagesModel::data(const QModelIndex & a_Index, int a_Role) con
 				// Happens while removing items from the model with the m_MessageRows resized to max
 				return QVariant();
 			}
+			row.m_LogFile->decodeHeaders(row.m_MessageIndex);
 			const auto & logFile = *(row.m_LogFile);
-			const auto & msg = logFile.messages()[row.m_MessageIndex];
+			auto msg = logFile.message(row.m_MessageIndex);
 			static const QString dateTimeFormat = "yyyy-MM-dd HH:mm:ss";
 			static const QString formatSingle = "%1";
 			switch (a_Index.column())
 			{
-				case colDateTime: return msg.m_DateTime.toString(dateTimeFormat);
+				case colDateTime: return msg.dateTime().toString(dateTimeFormat);
 				case colLogLevel: return logLevelToString(msg.m_LogLevel);
-				case colThreadID: return formatSingle.arg(msg.m_ThreadID);
+				case colThreadID: return formatSingle.arg(logFile.identifierToThreadID(msg.m_ThreadIdentifier));
 				case colModule:   return moduleIdentifierToString(logFile, msg.m_ModuleIdentifier);
+				case colSubComponent: return QString::fromStdString(logFile.identifierToSubComponent(msg.m_SubComponentIdentifier));
 				case colText:     return logFile.getMessageText(msg);
 				case colSource:
 				{
@@ -230,11 +242,11 @@ QVariant SessionMessagesModel::data(const QModelIndex & a_Index, int a_Role) con
 			break;
 		}  // case Qt::BackgroundRole
 
-		case ItemRoleMessagePtr:
+		case ItemRoleMessageIndex:
 		{
 			const auto & row = m_MessageRows[a_Index.row()];
-			const auto * msg = &(row.m_LogFile->messages()[row.m_MessageIndex]);
-			return QVariant(reinterpret_cast<qulonglong>(msg));
+			row.m_LogFile->decodeHeaders(row.m_MessageIndex);
+			return QVariant(static_cast<qulonglong>(row.m_MessageIndex));
 			break;
 		}
 
@@ -269,6 +281,7 @@ QVariant SessionMessagesModel::headerData(int a_Section, Qt::Orientation a_Orien
 				"ThreadID",
 				"Source",
 				"Module",
+				"SubComponent",
 				"Message",
 			};
 			if ((a_Section >= 0) && (a_Section < (sizeof(headerStrings) / sizeof(headerStrings[0]))))
@@ -326,6 +339,138 @@ void SessionMessagesModel::setFilterString(const QString & a_FilterString)
 
 
 
+void SessionMessagesModel::setSubComponentFilter(const QString & a_SubComponent)
+{
+	auto requestedSubComponentBA = a_SubComponent.toUtf8();
+	auto requestedSubComponent = std::string(requestedSubComponentBA.data(), static_cast<size_t>(requestedSubComponentBA.size()));
+	if (m_SubComponentFilter == requestedSubComponent)
+	{
+		// Same sub-component, NOP
+		return;
+	}
+	m_SubComponentFilter = requestedSubComponent;
+	m_SubComponentFilterIdentifiers.clear();
+	reFilter();
+}
+
+
+
+
+
+bool SessionMessagesModel::setTokenFilter(const QString & a_Token)
+{
+	if (a_Token.trimmed().isEmpty())
+	{
+		if (!m_HasTokenFilter)
+		{
+			// Already not filtering, NOP
+			return true;
+		}
+		m_HasTokenFilter = false;
+		m_TokenFilterMessages.clear();
+		reFilter();
+		return true;
+	}
+	LogToken token;
+	if (!LogToken::parse(a_Token, token))
+	{
+		return false;
+	}
+	if (m_HasTokenFilter && (m_TokenFilter == token))
+	{
+		// Same token, NOP
+		return true;
+	}
+	m_HasTokenFilter = true;
+	m_TokenFilter = token;
+	reFilter();
+	return true;
+}
+
+
+
+
+
+bool SessionMessagesModel::setThreadFilter(const QString & a_ThreadID)
+{
+	if (a_ThreadID.trimmed().isEmpty())
+	{
+		if (!m_HasThreadFilter)
+		{
+			// Already not filtering, NOP
+			return true;
+		}
+		m_HasThreadFilter = false;
+		reFilter();
+		return true;
+	}
+	bool isOK = false;
+	auto threadID = a_ThreadID.trimmed().toULongLong(&isOK);
+	if (!isOK)
+	{
+		return false;
+	}
+	if (m_HasThreadFilter && (m_ThreadFilter == threadID))
+	{
+		// Same thread, NOP
+		return true;
+	}
+	m_HasThreadFilter = true;
+	m_ThreadFilter = threadID;
+	m_ThreadFilterIdentifiers.clear();
+	reFilter();
+	return true;
+}
+
+
+
+
+
+int SessionMessagesModel::findThreadNeighbor(int a_Row, bool a_IsForward)
+{
+	if ((a_Row < 0) || (static_cast<size_t>(a_Row) >= m_MessageRows.size()))
+	{
+		return -1;
+	}
+	auto logFile = m_MessageRows[a_Row].m_LogFile;
+	auto msgIdx = m_MessageRows[a_Row].m_MessageIndex;
+	logFile->decodeHeaders(msgIdx);
+	const auto & threadMessages = logFile->threadMessages(logFile->messageThread(msgIdx));
+
+	// Walk the thread's messages from the current one, until one is found that is shown, in the requested direction
+	// (within a time-ordered file that's the neighbor in the file; otherwise a few more may need checking):
+	auto itr = std::lower_bound(threadMessages.begin(), threadMessages.end(), msgIdx);
+	assert((itr != threadMessages.end()) && (*itr == msgIdx));
+	if (a_IsForward)
+	{
+		for (++itr; itr != threadMessages.end(); ++itr)
+		{
+			auto row = findRow(MessageRow{logFile, *itr});
+			if (row > a_Row)
+			{
+				return row;
+			}
+		}
+	}
+	else
+	{
+		while (itr != threadMessages.begin())
+		{
+			--itr;
+			auto row = findRow(MessageRow{logFile, *itr});
+			if ((row >= 0) && (row < a_Row))
+			{
+				return row;
+			}
+		}
+	}
+	return -1;
+}
+
+
+
+
+
 void SessionMessagesModel::setLogLevelFilter(LogFile::LogLevel a_LogLevel, bool a_ShouldShow)
 {
 	if (a_ShouldShow)
@@ -363,6 +508,44 @@ void SessionMessagesModel::sessionLogFileAdded(LogFilePtr a_LogFile)
 
 
 
+void SessionMessagesModel::sessionLogFileMessagesAdded(LogFilePtr a_LogFile)
+{
+	insertLogFileMessages(a_LogFile.get());
+}
+
+
+
+
+
+void SessionMessagesModel::sessionLogFileRemoved(LogFilePtr a_LogFile)
+{
+	deleteLogFileMessages(a_LogFile.get());
+	m_DisabledLogFiles.erase(a_LogFile.get());
+	m_SubComponentFilterIdentifiers.erase(a_LogFile.get());
+	m_TokenFilterMessages.erase(a_LogFile.get());
+	m_ThreadFilterIdentifiers.erase(a_LogFile.get());
+}
+
+
+
+
+
+void SessionMessagesModel::sessionLogFileSourceChanged(LogFilePtr a_LogFile)
+{
+	Q_UNUSED(a_LogFile);
+
+	// The file's rows are interleaved with the other files' rows, repaint them all:
+	if (m_MessageRows.empty())
+	{
+		return;
+	}
+	emit dataChanged(index(0, 0), index(static_cast<int>(m_MessageRows.size()) - 1, colMax - 1));
+}
+
+
+
+
+
 bool SessionMessagesModel::isLogFileEnabled(LogFile * a_LogFile) const
 {
 	auto itr = m_DisabledLogFiles.find(a_LogFile);
@@ -398,84 +581,130 @@ QString SessionMessagesModel::logLevelToString(LogFile::LogLevel a_LogLevel)
 
 void SessionMessagesModel::insertLogFileMessages(LogFile * a_LogFile)
 {
+	if (!isLogFileEnabled(a_LogFile))
+	{
+		// The messages get inserted once the logfile is enabled
+		return;
+	}
+	auto & numMerged = m_NumMergedMessages[a_LogFile];
+	auto insEnd = a_LogFile->messageCount();
+	if (numMerged >= insEnd)
+	{
+		return;
+	}
 	Stopwatch sw("Inserting LogFile messages into SessionMessagesModel");
-	MessageRows origRows;
-	std::swap(origRows, m_MessageRows);
-	size_t origSize = origRows.size();
-	size_t insSize = a_LogFile->messages().size();
-	size_t newSize = origSize + insSize;
-	m_MessageRows.resize(newSize);
-	size_t origIdx = 0, insIdx = 0;
-	QModelIndex parentIndex;
-	bool isCoalescingInserts = false;
-	int lastNonInsertIdx = 0;
-	for (size_t i = 0; i < newSize; ++i)
+
+	// The filters need the decoded message headers (log level, sub-component, thread, text boundaries):
+	if (!m_LogLevelHidden.empty() || !m_FilterString.empty() || !m_SubComponentFilter.empty() || m_HasThreadFilter)
 	{
-		if (origIdx >= origSize)
+		a_LogFile->decodeAllHeaders();
+	}
+
+	// Collect the new messages that pass the filter, in their time order:
+	MessageRows insRows;
+	if (isFilteringByIndex())
+	{
+		// Only the messages looked up in the indices are candidates, the rest doesn't need to be looked at:
+		if (m_HasTokenFilter)
 		{
-			// All the original rows have been exhausted, only the new rows remain
-			if (isCoalescingInserts)
-			{
-				beginInsertRows(parentIndex, lastNonInsertIdx, static_cast<int>(i - 1));
-				endInsertRows();
-				isCoalescingInserts = false;
-			}
-			beginInsertRows(parentIndex, static_cast<int>(i), static_cast<int>(newSize));
-			for (size_t j = i; j < newSize; ++j)
-			{
-				m_MessageRows[j].m_LogFile = a_LogFile;
-				m_MessageRows[j].m_MessageIndex = insIdx;
-				insIdx += 1;
-			}
-			endInsertRows();
-			return;
+			m_TokenFilterMessages[a_LogFile] = m_Session->tokenIndex().find(m_TokenFilter, a_LogFile);
 		}
-
-		if (insIdx >= insSize)
+		const auto & candidates = indexedFilterCandidates(*a_LogFile);
+		auto itr = std::lower_bound(candidates.begin(), candidates.end(), numMerged);
+		for (; (itr != candidates.end()) && (*itr < insEnd); ++itr)
 		{
-			// All of the new rows have been exhausted, only the original rows remain
-			if (isCoalescingInserts)
+			if (shouldShowMessage(*a_LogFile, *itr))
 			{
-				beginInsertRows(parentIndex, lastNonInsertIdx, static_cast<int>(i - 1));
-				endInsertRows();
-				isCoalescingInserts = false;
+				insRows.push_back(MessageRow{a_LogFile, *itr});
 			}
-			for (size_t j = i; j < newSize; ++j)
+		}
+		std::sort(insRows.begin(), insRows.end(), isRowInFront);
+	}
+	else
+	{
+		auto timeOrder = a_LogFile->timeOrder(numMerged, insEnd);
+		for (auto i = numMerged; i < insEnd; ++i)
+		{
+			auto msgIdx = timeOrder.empty() ? i : timeOrder[i - numMerged];
+			if (shouldShowMessage(*a_LogFile, msgIdx))
 			{
-				m_MessageRows[j] = origRows[origIdx];
-				origIdx += 1;
+				insRows.push_back(MessageRow{a_LogFile, msgIdx});
 			}
-			return;
 		}
+	}
+	numMerged = insEnd;
+	if (insRows.empty())
+	{
+		return;
+	}
+
+	// The rows in front of the first new message stay in place, only the rest is merged with the new rows.
+	// The batches of a file being parsed usually go after all the existing rows, so that is a plain append:
+	auto mergeStart = m_MessageRows.size();
+	while ((mergeStart > 0) && !isRowInFront(m_MessageRows[mergeStart - 1], insRows.front()))
+	{
+		mergeStart -= 1;
+	}
+	MessageRows origRows(m_MessageRows.begin() + static_cast<ptrdiff_t>(mergeStart), m_MessageRows.end());
+	m_MessageRows.resize(mergeStart);
+	m_MessageRows.reserve(mergeStart + origRows.size() + insRows.size());
 
-		// There are rows in both streams, pick the one with a smaller datetime
-		const auto & msgOrig = origRows[origIdx].m_LogFile->messages()[origRows[origIdx].m_MessageIndex];
-		const auto & msgIns  = a_LogFile->messages()[insIdx];
-		if (isMessageEarlier(msgOrig, *origRows[origIdx].m_LogFile, msgIns, *a_LogFile))
+	// Merge, remembering the runs of consecutive inserted rows for the notifications:
+	std::vector<std::pair<size_t, size_t>> insertedRuns;  // First and last row of each run
+	size_t origIdx = 0, insIdx = 0;
+	while ((origIdx < origRows.size()) || (insIdx < insRows.size()))
+	{
+		if (
+			(insIdx >= insRows.size()) ||
+			((origIdx < origRows.size()) && isRowInFront(origRows[origIdx], insRows[insIdx]))
+		)
 		{
-			// Orig should go in front of Ins
-			if (isCoalescingInserts)
-			{
-				beginInsertRows(parentIndex, lastNonInsertIdx, static_cast<int>(i - 1));
-				endInsertRows();
-				isCoalescingInserts = false;
-			}
-			m_MessageRows[i] = origRows[origIdx];
+			m_MessageRows.push_back(origRows[origIdx]);
 			origIdx += 1;
+			continue;
+		}
+		auto row = m_MessageRows.size();
+		if (!insertedRuns.empty() && (insertedRuns.back().second + 1 == row))
+		{
+			insertedRuns.back().second = row;
 		}
 		else
 		{
-			// Ins should go in front of Orig
-			if (!isCoalescingInserts)
-			{
-				lastNonInsertIdx = static_cast<int>(i);
-				isCoalescingInserts = true;
-			}
-			m_MessageRows[i].m_LogFile = a_LogFile;
-			m_MessageRows[i].m_MessageIndex = insIdx;
-			insIdx += 1;
+			insertedRuns.emplace_back(row, row);
 		}
-	}  // for i
+		m_MessageRows.push_back(insRows[insIdx]);
+		insIdx += 1;
+	}
+
+	// Notify the views, coalescing the consecutive inserted rows:
+	QModelIndex parentIndex;
+	for (const auto & run: insertedRuns)
+	{
+		beginInsertRows(parentIndex, static_cast<int>(run.first), static_cast<int>(run.second));
+		endInsertRows();
+	}
+}
+
+
+
+
+
+bool SessionMessagesModel::isRowInFront(const MessageRow & a_Row, const MessageRow & a_NewRow)
+{
+	if (a_Row.m_LogFile == a_NewRow.m_LogFile)
+	{
+		// The messages from the same logfile with the same time keep their order within the file:
+		auto rowTime = a_Row.m_LogFile->messageTime(a_Row.m_MessageIndex);
+		auto newRowTime = a_Row.m_LogFile->messageTime(a_NewRow.m_MessageIndex);
+		return (
+			(rowTime < newRowTime) ||
+			((rowTime == newRowTime) && (a_Row.m_MessageIndex < a_NewRow.m_MessageIndex))
+		);
+	}
+	return isMessageEarlier(
+		a_Row.m_LogFile->messageTime(a_Row.m_MessageIndex), *a_Row.m_LogFile,
+		a_NewRow.m_LogFile->messageTime(a_NewRow.m_MessageIndex), *a_NewRow.m_LogFile
+	);
 }
 
 
@@ -485,6 +714,7 @@ void SessionMessagesModel::insertLogFileMessages(LogFile * a_LogFile)
 void SessionMessagesModel::deleteLogFileMessages(LogFile * a_LogFile)
 {
 	Stopwatch sw("Deleting LogFile messages from SessionMessagesModel");
+	m_NumMergedMessages.erase(a_LogFile);
 	size_t idx = 0;
 	size_t origSize = m_MessageRows.size();
 	QModelIndex parentIndex;
@@ -536,10 +766,37 @@ void SessionMessagesModel::reFilter()
 	// Re-create the m_MessageRows based on current filter settings
 	// Coalesce insertions and removals for better performance
 	Stopwatch sw("Refiltering");
+
+	// The filters need the decoded message headers (log level, sub-component, thread, text boundaries):
+	if (!m_LogLevelHidden.empty() || !m_FilterString.empty() || !m_SubComponentFilter.empty() || m_HasThreadFilter)
+	{
+		for (const auto & logFile: m_Session->logFiles())
+		{
+			logFile->decodeAllHeaders();
+		}
+	}
+
+	if (isFilteringByIndex())
+	{
+		reFilterByIndex();
+		return;
+	}
+
+	// The files still being parsed may publish more messages meanwhile, those are merged in later:
 	MessageSorter sorter(*m_Session);
+	size_t numMessages = 0;
+	const auto & logFiles = m_Session->logFiles();
+	for (size_t i = 0; i < logFiles.size(); ++i)
+	{
+		numMessages += sorter.numMessages(i);
+		if (isLogFileEnabled(logFiles[i].get()))
+		{
+			m_NumMergedMessages[logFiles[i].get()] = sorter.numMessages(i);
+		}
+	}
 	std::vector<MessageRow> oldRows;  // Remember the current rows
 	std::swap(oldRows, m_MessageRows);
-	m_MessageRows.resize(m_Session->getMessageCount());
+	m_MessageRows.resize(numMessages);
 	size_t oldIdx = 0;  // Index into oldRows[] for the next row to process
 	size_t newIdx = 0;  // Index into m_MessageRows[] for the next row to assign
 	QModelIndex parent;
@@ -552,8 +809,7 @@ void SessionMessagesModel::reFilter()
 	int numCoalesced = 0;
 	for (auto msg = sorter.getNextMessage(); msg.m_LogFile != nullptr; msg = sorter.getNextMessage())
 	{
-		const auto & m = msg.m_LogFile->messages()[msg.m_MessageIndex];
-		if (shouldShowMessage(*msg.m_LogFile, m))
+		if (shouldShowMessage(*msg.m_LogFile, msg.m_MessageIndex))
 		{
 			m_MessageRows[newIdx] = msg;
 			newIdx += 1;
@@ -672,7 +928,97 @@ void SessionMessagesModel::reFilter()
 
 
 
-bool SessionMessagesModel::shouldShowMessage(const LogFile & a_LogFile, const LogFile::Message & a_Message) const
+const std::vector<size_t> & SessionMessagesModel::indexedFilterCandidates(LogFile & a_LogFile)
+{
+	assert(isFilteringByIndex());
+	static const std::vector<size_t> noCandidates;
+	if (m_HasTokenFilter)
+	{
+		// The thread, if filtered, is checked by shouldShowMessage() on the (usually few) messages with the token:
+		auto itr = m_TokenFilterMessages.find(&a_LogFile);
+		return (itr == m_TokenFilterMessages.end()) ? noCandidates : itr->second;
+	}
+	auto threadIdentifier = threadFilterIdentifier(a_LogFile);
+	if (threadIdentifier < 0)
+	{
+		return noCandidates;
+	}
+	return a_LogFile.threadMessages(threadIdentifier);
+}
+
+
+
+
+
+void SessionMessagesModel::reFilterByIndex()
+{
+	// Look up the messages containing the token, across all the files at once:
+	if (m_HasTokenFilter)
+	{
+		m_TokenFilterMessages.clear();
+		for (const auto & posting: m_Session->tokenIndex().find(m_TokenFilter))
+		{
+			m_TokenFilterMessages[posting.first].push_back(posting.second);
+		}
+	}
+
+	// Collect the rows, only the looked up messages need to be filtered and sorted:
+	MessageRows rows;
+	for (const auto & logFile: m_Session->logFiles())
+	{
+		auto lf = logFile.get();
+		if (!isLogFileEnabled(lf))
+		{
+			continue;
+		}
+		auto count = lf->messageCount();
+		m_NumMergedMessages[lf] = count;
+		for (auto msgIdx: indexedFilterCandidates(*lf))
+		{
+			if ((msgIdx < count) && shouldShowMessage(*lf, msgIdx))
+			{
+				rows.push_back(MessageRow{lf, msgIdx});
+			}
+		}
+	}
+	std::sort(rows.begin(), rows.end(), isRowInFront);
+
+	// Replace all the rows; the result is usually tiny compared to the rows it replaces,
+	// so two coalesced notifications are cheaper than matching the old and new rows:
+	QModelIndex parent;
+	if (!m_MessageRows.empty())
+	{
+		beginRemoveRows(parent, 0, static_cast<int>(m_MessageRows.size() - 1));
+		m_MessageRows.clear();
+		endRemoveRows();
+	}
+	if (!rows.empty())
+	{
+		beginInsertRows(parent, 0, static_cast<int>(rows.size() - 1));
+		m_MessageRows = std::move(rows);
+		endInsertRows();
+	}
+}
+
+
+
+
+
+bool SessionMessagesModel::containsTokenFilter(const LogFile & a_LogFile, size_t a_MessageIndex) const
+{
+	auto itr = m_TokenFilterMessages.find(&a_LogFile);
+	if (itr == m_TokenFilterMessages.end())
+	{
+		return false;
+	}
+	return std::binary_search(itr->second.begin(), itr->second.end(), a_MessageIndex);
+}
+
+
+
+
+
+bool SessionMessagesModel::shouldShowMessage(const LogFile & a_LogFile, size_t a_MessageIndex) const
 {
 	// Check the LogFile against the set of disabled ones:
 	if (m_DisabledLogFiles.find(&a_LogFile) != m_DisabledLogFiles.end())
@@ -681,22 +1027,40 @@ bool SessionMessagesModel::shouldShowMessage(const LogFile & a_LogFile, const Lo
 	}
 
 	// Check the LogLevel against the set of disabled ones:
-	if (m_LogLevelHidden.find(a_Message.m_LogLevel) != m_LogLevelHidden.end())
+	if (!m_LogLevelHidden.empty() && (m_LogLevelHidden.find(a_LogFile.messageLogLevel(a_MessageIndex)) != m_LogLevelHidden.end()))
 	{
 		return false;
 	}
 
-	/*
-	// TODO: Check m_FilterString:
+	// Check m_SubComponentFilter, comparing the identifiers:
+	if (!m_SubComponentFilter.empty())
+	{
+		auto subComponentIdentifier = subComponentFilterIdentifier(a_LogFile);
+		if ((subComponentIdentifier < 0) || (a_LogFile.messageSubComponent(a_MessageIndex) != subComponentIdentifier))
+		{
+			return false;
+		}
+	}
+
+	// Check m_ThreadFilter, comparing the identifiers:
+	if (m_HasThreadFilter)
+	{
+		auto threadIdentifier = threadFilterIdentifier(a_LogFile);
+		if ((threadIdentifier < 0) || (a_LogFile.messageThread(a_MessageIndex) != threadIdentifier))
+		{
+			return false;
+		}
+	}
+
+	// Check m_FilterString:
 	if (!m_FilterString.empty())
 	{
-		if (a_LogFile.getMessageTextString(a_Message).find(m_FilterString))
+		if (!a_LogFile.messageTextContains(a_MessageIndex, m_FilterString))
 		{
 			// Doesn't match m_FilterString, discard:
 			return false;
 		}
 	}
-	*/
 
 	return true;
 }
@@ -705,6 +1069,76 @@ bool SessionMessagesModel::shouldShowMessage(const LogFile & a_LogFile, const Lo
 
 
 
+int SessionMessagesModel::findRow(const MessageRow & a_Row) const
+{
+	// The rows are sorted by isRowInFront(); the rows equivalent to a_Row (same time, equal LogFiles) follow the bound:
+	auto itr = std::lower_bound(m_MessageRows.begin(), m_MessageRows.end(), a_Row, isRowInFront);
+	for (; (itr != m_MessageRows.end()) && !isRowInFront(a_Row, *itr); ++itr)
+	{
+		if ((itr->m_LogFile == a_Row.m_LogFile) && (itr->m_MessageIndex == a_Row.m_MessageIndex))
+		{
+			return static_cast<int>(itr - m_MessageRows.begin());
+		}
+	}
+	return -1;
+}
+
+
+
+
+
+int SessionMessagesModel::threadFilterIdentifier(const LogFile & a_LogFile) const
+{
+	auto itr = m_ThreadFilterIdentifiers.find(&a_LogFile);
+	if (itr == m_ThreadFilterIdentifiers.end())
+	{
+		itr = m_ThreadFilterIdentifiers.insert(std::make_pair(&a_LogFile, std::make_pair(-1, size_t(0)))).first;
+	}
+	auto & cached = itr->second;
+	if (cached.first >= 0)
+	{
+		return cached.first;
+	}
+	auto numThreads = a_LogFile.numThreads();
+	if (cached.second < numThreads)
+	{
+		// Search only the threads added since the last search:
+		cached.first = a_LogFile.findThread(m_ThreadFilter, cached.second);
+		cached.second = numThreads;
+	}
+	return cached.first;
+}
+
+
+
+
+
+int SessionMessagesModel::subComponentFilterIdentifier(const LogFile & a_LogFile) const
+{
+	auto itr = m_SubComponentFilterIdentifiers.find(&a_LogFile);
+	if (itr == m_SubComponentFilterIdentifiers.end())
+	{
+		itr = m_SubComponentFilterIdentifiers.insert(std::make_pair(&a_LogFile, std::make_pair(-1, size_t(0)))).first;
+	}
+	auto & cached = itr->second;
+	if (cached.first >= 0)
+	{
+		return cached.first;
+	}
+	auto numSubComponents = a_LogFile.numSubComponents();
+	if (cached.second < numSubComponents)
+	{
+		// Search only the sub-components added since the last search:
+		cached.first = a_LogFile.findSubComponent(m_SubComponentFilter, cached.second);
+		cached.second = numSubComponents;
+	}
+	return cached.first;
+}
+
+
+
+
+
 QString SessionMessagesModel::moduleIdentifierToString(const LogFile & a_LogFile, int a_ModuleIdentifier) const
 {
 	auto moduleName = a_LogFile.identifierToModule(a_ModuleIdentifier);
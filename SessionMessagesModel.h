@@ -13,6 +13,7 @@
 
 
 
+#include <map>
 #include <memory>
 #include <set>
 #include <QAbstractTableModel>
@@ -44,8 +45,9 @@ public:
 		colLogLevel = 1,
 		colThreadID = 2,
 		colSource   = 3,
-		colModule   = 4,
-		colText     = 5,
+		colModule       = 4,
+		colSubComponent = 5,
+		colText         = 6,
 
 		colMax,  // Used for column count
 	};
@@ -53,7 +55,7 @@ public:
 	/** Custom data roles returnable by data(). */
 	enum
 	{
-		ItemRoleMessagePtr = Qt::UserRole + 1,
+		ItemRoleMessageIndex = Qt::UserRole + 1,  // The index of the message within its LogFile
 		ItemRoleLogFilePtr,
 	};
 
@@ -76,6 +78,45 @@ public:
 	/** Returns true if the model is being filtered by m_FilterString. */
 	bool isFilteringByString() const { return !m_FilterString.empty(); }
 
+	/** Sets the sub-component on which to filter; only the messages with this sub-component are shown.
+	An empty name turns the filter off. */
+	void setSubComponentFilter(const QString & a_SubComponent);
+
+	/** Returns true if the model is being filtered by m_SubComponentFilter. */
+	bool isFilteringBySubComponent() const { return !m_SubComponentFilter.empty(); }
+
+	/** Sets the identifier (LogToken) on which to filter; only the messages containing it, in any of the log files,
+	are shown. The messages are looked up in the session's TokenIndex, their texts are not searched.
+	An empty string turns the filter off. Returns false (and leaves the filter unchanged) if the text is not a valid token. */
+	bool setTokenFilter(const QString & a_Token);
+
+	/** Returns true if the model is being filtered by m_TokenFilter. */
+	bool isFilteringByToken() const { return m_HasTokenFilter; }
+
+	/** Sets the thread ID (as displayed) on which to filter; only the messages of threads with this ID are shown.
+	The messages are looked up in the files' per-thread lists (LogFile::threadMessages()).
+	An empty string turns the filter off. Returns false (and leaves the filter unchanged) if the text is not a number. */
+	bool setThreadFilter(const QString & a_ThreadID);
+
+	/** Returns true if the model is being filtered by m_ThreadFilter. */
+	bool isFilteringByThread() const { return m_HasThreadFilter; }
+
+	/** Returns the row of the next (a_IsForward) or previous shown message of the same thread as the message
+	in the specified row, from the same LogFile. Returns -1 if there's no such message.
+	The messages are looked up in the file's per-thread list and their rows found by a binary search,
+	the rows in between are not looked at. */
+	int findThreadNeighbor(int a_Row, bool a_IsForward);
+
+	/** Returns true if the specified message passes the current filter, whether it is merged into the model yet or not.
+	The message's header needs to be decoded. */
+	bool isMessageShown(const LogFile & a_LogFile, size_t a_MessageIndex) const
+	{
+		return (
+			(!m_HasTokenFilter || containsTokenFilter(a_LogFile, a_MessageIndex)) &&
+			shouldShowMessage(a_LogFile, a_MessageIndex)
+		);
+	}
+
 	/** Sets whether the specified LogLevel should be shown or not. */
 	void setLogLevelFilter(LogFile::LogLevel a_LogLevel, bool a_ShouldShow);
 
@@ -88,6 +129,15 @@ protected slots:
 	/** Emitted by m_Session when a new logfile is added to it. */
 	void sessionLogFileAdded(LogFilePtr a_LogFile);
 
+	/** Emitted by m_Session when more messages are published in a logfile that is still being parsed. */
+	void sessionLogFileMessagesAdded(LogFilePtr a_LogFile);
+
+	/** Emitted by m_Session when a logfile is removed from it. */
+	void sessionLogFileRemoved(LogFilePtr a_LogFile);
+
+	/** Emitted by m_Session when the source type of a logfile changes, repaints its source column and background. */
+	void sessionLogFileSourceChanged(LogFilePtr a_LogFile);
+
 
 protected:
 
@@ -118,9 +168,43 @@ protected:
 	/** Specifies the case sensitivity of m_FilterString. */
 	Qt::CaseSensitivity m_FilterCaseSensitive;
 
+	/** If non-empty, only the messages with this sub-component will be shown. */
+	std::string m_SubComponentFilter;
+
+	/** For each LogFile, the identifier of m_SubComponentFilter within the file (-1 if not present)
+	and the number of the file's sub-components searched for it.
+	Lets the filter compare the identifiers instead of the names; a file still being parsed may add the
+	sub-component later, so a missing one is searched for again among the sub-components added since. */
+	mutable std::map<const LogFile *, std::pair<int, size_t>> m_SubComponentFilterIdentifiers;
+
+	/** If true, only the messages containing m_TokenFilter will be shown. */
+	bool m_HasTokenFilter;
+
+	/** The identifier on which to filter, valid only if m_HasTokenFilter is true. */
+	LogToken m_TokenFilter;
+
+	/** For each LogFile, the sorted indices of its messages containing m_TokenFilter, as found in the TokenIndex
+	when the file's messages were last merged. Only the messages listed here are considered for the model
+	while m_HasTokenFilter is true, so that the rest of the messages don't need to be looked at at all. */
+	std::map<const LogFile *, std::vector<size_t>> m_TokenFilterMessages;
+
+	/** If true, only the messages of the threads with the m_ThreadFilter ID will be shown. */
+	bool m_HasThreadFilter;
+
+	/** The thread ID on which to filter, valid only if m_HasThreadFilter is true. */
+	quint64 m_ThreadFilter;
+
+	/** For each LogFile, the identifier of m_ThreadFilter within the file (-1 if not present) and the number
+	of the file's threads searched for it, same as m_SubComponentFilterIdentifiers. */
+	mutable std::map<const LogFile *, std::pair<int, size_t>> m_ThreadFilterIdentifiers;
+
 	/** Indicates which LogLevels are hidden. */
 	std::set<LogFile::LogLevel> m_LogLevelHidden;
 
+	/** For each enabled LogFile, the number of its messages that have been considered for the model so far.
+	The messages of a file that is still being parsed are merged in batches, as they get published. */
+	std::map<const LogFile *, size_t> m_NumMergedMessages;
+
 
 	/** Returns true if the specified LogFile is enabled for display. */
 	bool isLogFileEnabled(LogFile * a_LogFile) const;
@@ -128,21 +212,57 @@ protected:
 	/** Returns the string representation of the specified LogLevel. */
 	static QString logLevelToString(LogFile::LogLevel a_LogLevel);
 
-	/** Inserts all messages from the specified logfile into the model.
+	/** Inserts the messages from the specified logfile, published since the last call, into the model.
+	Only the messages that pass the filter are inserted. Does nothing for a disabled logfile.
 	Insert-sorts the messages into m_MessageRows. Emits appropriate model's item insertion signals. */
 	void insertLogFileMessages(LogFile * a_LogFile);
 
+	/** Returns true if the existing row a_Row should go in front of the newly inserted a_NewRow.
+	The rows are ordered by their time; the rows from the same logfile with the same time keep their order
+	within the file. */
+	static bool isRowInFront(const MessageRow & a_Row, const MessageRow & a_NewRow);
+
 	/** Removes all mesasges originating in the specified logfile from the model.
 	Removes the messages from m_MessageRows, emits appropriate model's item deletion signals. */
 	void deleteLogFileMessages(LogFile * a_LogFile);
 
 	/** Re-evaluates the filter for all messages, inserting and deleting rows as necessary.
-	Filter in this context is the m_FilterString, m_LogLevelHidden and m_DisabledLogFiles combo. */
+	Filter in this context is the m_FilterString, m_SubComponentFilter, m_TokenFilter, m_ThreadFilter, m_LogLevelHidden
+	and m_DisabledLogFiles combo. */
 	void reFilter();
 
-	/** Returns true if the specified message passes the filter.
-	Filter in this context is the m_FilterString, m_LogLevelHidden and m_DisabledLogFiles combo. */
-	bool shouldShowMessage(const LogFile & a_LogFile, const LogFile::Message & a_Message) const;
+	/** Returns true if the filter includes m_TokenFilter or m_ThreadFilter, so that the candidate messages
+	can be looked up in the indices instead of checking all of them. */
+	bool isFilteringByIndex() const { return m_HasTokenFilter || m_HasThreadFilter; }
+
+	/** Returns the sorted indices of the specified file's messages that may pass the filter, as looked up in
+	the indices: m_TokenFilterMessages if filtering by token, the thread's messages otherwise.
+	Only valid while isFilteringByIndex(); the rest of the filter still needs checking (shouldShowMessage()). */
+	const std::vector<size_t> & indexedFilterCandidates(LogFile & a_LogFile);
+
+	/** Re-creates all the rows from the candidate messages looked up in the indices (indexedFilterCandidates()),
+	filtered by the rest of the filter. Used by reFilter() while isFilteringByIndex(). */
+	void reFilterByIndex();
+
+	/** Returns true if the specified message contains m_TokenFilter, according to m_TokenFilterMessages. */
+	bool containsTokenFilter(const LogFile & a_LogFile, size_t a_MessageIndex) const;
+
+	/** Returns true if the message at the specified index in the LogFile passes the filter.
+	Filter in this context is the m_FilterString, m_SubComponentFilter, m_ThreadFilter, m_LogLevelHidden
+	and m_DisabledLogFiles combo. The m_TokenFilter is not checked, the callers only consider the messages
+	from m_TokenFilterMessages instead. Only the message columns needed by the active filters are read. */
+	bool shouldShowMessage(const LogFile & a_LogFile, size_t a_MessageIndex) const;
+
+	/** Returns the index of the specified row in m_MessageRows, using a binary search; -1 if not present. */
+	int findRow(const MessageRow & a_Row) const;
+
+	/** Returns the identifier of m_ThreadFilter within the specified LogFile, -1 if the file has no such thread (yet).
+	Uses and updates m_ThreadFilterIdentifiers. */
+	int threadFilterIdentifier(const LogFile & a_LogFile) const;
+
+	/** Returns the identifier of m_SubComponentFilter within the specified LogFile, -1 if the file has no such
+	sub-component (yet). Uses and updates m_SubComponentFilterIdentifiers. */
+	int subComponentFilterIdentifier(const LogFile & a_LogFile) const;
 
 	/** Returns the module name based on the identifier used in the specified log file. */
 	QString moduleIdentifierToString(const LogFile & a_LogFile, int a_ModuleIdentifier) const;
@@ -37,6 +37,8 @@ SessionSourcesModel::SessionSourcesModel(SessionPtr a_Session):
 
 	// Connect the signals from session:
 	connect(a_Session.get(), SIGNAL(logFileAdded(LogFilePtr)), this, SLOT(sessionLogFileAdded(LogFilePtr)));
+	connect(a_Session.get(), SIGNAL(logFileRemoved(LogFilePtr)), this, SLOT(sessionLogFileRemoved(LogFilePtr)));
+	connect(a_Session.get(), SIGNAL(logFileSourceChanged(LogFilePtr)), this, SLOT(sessionLogFileSourceChanged(LogFilePtr)));
 }
 
 
@@ -52,6 +54,37 @@ void SessionSourcesModel::sessionLogFileAdded(LogFilePtr a_LogFile)
 
 
 
+void SessionSourcesModel::sessionLogFileRemoved(LogFilePtr a_LogFile)
+{
+	removeLogFile(a_LogFile);
+}
+
+
+
+
+
+void SessionSourcesModel::sessionLogFileSourceChanged(LogFilePtr a_LogFile)
+{
+	// The item is still under the parent of the previous source type, look for it under all of them:
+	std::vector<QStandardItem *> parents = {m_RootItemMDMVAH, m_RootItemMultiProxy, m_RootItemAgent, m_RootItemUnknown};
+	for (const auto & uuidItem: m_MultiAgentUUIDItems)
+	{
+		parents.push_back(uuidItem.second);
+	}
+	for (auto parent: parents)
+	{
+		if (removeLogFileItem(parent, a_LogFile.get()))
+		{
+			break;
+		}
+	}
+	addLogFile(a_LogFile);
+}
+
+
+
+
+
 void SessionSourcesModel::addLogFile(LogFilePtr a_LogFile)
 {
 	// Create the item:
@@ -84,6 +117,39 @@ void SessionSourcesModel::addLogFile(LogFilePtr a_LogFile)
 
 
 
+void SessionSourcesModel::removeLogFile(LogFilePtr a_LogFile)
+{
+	auto parent = getLogFileParentItem(a_LogFile.get());
+	if (parent == nullptr)
+	{
+		return;
+	}
+	removeLogFileItem(parent, a_LogFile.get());
+}
+
+
+
+
+
+bool SessionSourcesModel::removeLogFileItem(QStandardItem * a_Parent, LogFile * a_LogFile)
+{
+	auto logFilePtr = QVariant::fromValue(reinterpret_cast<void *>(a_LogFile));
+	auto numChildren = a_Parent->rowCount();
+	for (int i = 0; i < numChildren; ++i)
+	{
+		if (a_Parent->child(i)->data(ItemRoleLogFilePtr) == logFilePtr)
+		{
+			a_Parent->removeRow(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+
+
+
+
 QStandardItem * SessionSourcesModel::getLogFileParentItem(LogFile * a_LogFile)
 {
 	switch (a_LogFile->sourceType())
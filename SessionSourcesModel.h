@@ -66,11 +66,25 @@ protected:
 	/** Adds the specified logfile to the item list. */
 	void addLogFile(LogFilePtr a_LogFile);
 
+	/** Removes the specified logfile's item from the item list. */
+	void removeLogFile(LogFilePtr a_LogFile);
+
+	/** Removes the specified logfile's item from the children of the specified parent item.
+	Returns true if the item was found and removed, false if the parent doesn't contain it. */
+	bool removeLogFileItem(QStandardItem * a_Parent, LogFile * a_LogFile);
+
 protected slots:
 
 	/** Triggered when a LogFile is added to the session. */
 	void sessionLogFileAdded(LogFilePtr a_LogFile);
 
+	/** Triggered when a LogFile is removed from the session. */
+	void sessionLogFileRemoved(LogFilePtr a_LogFile);
+
+	/** Triggered when the source type of a LogFile in the session changes.
+	Moves the LogFile's item under the parent for its new source type. */
+	void sessionLogFileSourceChanged(LogFilePtr a_LogFile);
+
 	/** Returns the item under which the specified LogFile's item should be nested.
 	For MultiAgent logfiles, creates the MultiAgent UUID item, if needed. */
 	QStandardItem * getLogFileParentItem(LogFile * a_LogFile);
@@ -0,0 +1,67 @@
+// Simd.h
+
+// Detects the SIMD instruction sets available to the build and declares the helpers shared by their users
+// HAS_SSE2 is defined if SSE2 is available; the helpers are only declared then
+
+
+
+
+
+#ifndef SIMD_H
+#define SIMD_H
+
+
+
+
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+	#define HAS_SSE2
+	#include <emmintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#endif
+#endif
+
+
+
+
+
+#ifdef HAS_SSE2
+/** Returns the index of the lowest set bit in the (non-zero) value. */
+static inline unsigned lowestSetBit(unsigned a_Value)
+{
+	#ifdef _MSC_VER
+		unsigned long res;
+		_BitScanForward(&res, a_Value);
+		return static_cast<unsigned>(res);
+	#else
+		return static_cast<unsigned>(__builtin_ctz(a_Value));
+	#endif
+}
+
+
+
+
+
+/** Returns the mask of the hex digits among the 16 bytes at a_Data, bit N set if the byte N is a hex digit. */
+static inline unsigned hexDigitMask(const char * a_Data)
+{
+	auto chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a_Data));
+	auto lowerCase = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+	auto isDigit = _mm_and_si128(
+		_mm_cmpgt_epi8(chars, _mm_set1_epi8('0' - 1)),
+		_mm_cmplt_epi8(chars, _mm_set1_epi8('9' + 1))
+	);
+	auto isLetter = _mm_and_si128(
+		_mm_cmpgt_epi8(lowerCase, _mm_set1_epi8('a' - 1)),
+		_mm_cmplt_epi8(lowerCase, _mm_set1_epi8('f' + 1))
+	);
+	return static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(isDigit, isLetter)));
+}
+#endif
+
+
+
+
+
+#endif // SIMD_H
@@ -0,0 +1,768 @@
+// TextBuffer.cpp
+
+// Implements the TextBuffer descendants, representing the storage for a LogFile's complete text
+
+
+
+
+
+#include "TextBuffer.h"
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+#include <list>
+#include <map>
+#include <QMutex>
+#include <QtDebug>
+
+#ifdef _MSC_VER
+	// When compiling in MSVC on Windows, use Qt-provided zlib (there's no system-zlib)
+	#include <QtZlib/zlib.h>
+#else
+	// Use system-zlib everywhere else:
+	#include <zlib.h>
+#endif
+
+#ifdef Q_OS_LINUX
+	#include <fcntl.h>
+#endif
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SegmentCache:
+
+/** Bounded cache of decompressed segments, shared by all the TextBuffers that decompress their data on demand.
+Keeps the most recently used segments, up to MAX_SIZE bytes in total. Thread-safe. */
+class SegmentCache
+{
+public:
+
+	/** Returns the single instance of the cache.
+	The instance is never destroyed, so that TextBuffers destroyed during the app shutdown can still use it. */
+	static SegmentCache & get()
+	{
+		static SegmentCache * instance = new SegmentCache;
+		return *instance;
+	}
+
+
+	/** Returns the cached segment of the specified owner, or nullptr if not cached.
+	Marks the segment as the most recently used. */
+	std::shared_ptr<const std::string> find(const TextBuffer * a_Owner, size_t a_Index)
+	{
+		QMutexLocker lock(&m_Mtx);
+		auto itr = m_Index.find(Key(a_Owner, a_Index));
+		if (itr == m_Index.end())
+		{
+			return nullptr;
+		}
+		m_Entries.splice(m_Entries.begin(), m_Entries, itr->second);
+		return itr->second->m_Data;
+	}
+
+
+	/** Stores the specified segment in the cache, evicting the least recently used segments if over the limit. */
+	void insert(const TextBuffer * a_Owner, size_t a_Index, std::shared_ptr<const std::string> a_Data)
+	{
+		QMutexLocker lock(&m_Mtx);
+		Key key(a_Owner, a_Index);
+		if (m_Index.find(key) != m_Index.end())
+		{
+			// Already inserted by another thread in the meantime
+			return;
+		}
+		m_Size += a_Data->size();
+		m_Entries.push_front(Entry{a_Owner, a_Index, a_Data});
+		m_Index[key] = m_Entries.begin();
+		while ((m_Size > MAX_SIZE) && (m_Entries.size() > 1))
+		{
+			const auto & last = m_Entries.back();
+			m_Size -= last.m_Data->size();
+			m_Index.erase(Key(last.m_Owner, last.m_Index));
+			m_Entries.pop_back();
+		}
+	}
+
+
+	/** Removes all the segments of the specified owner from the cache. */
+	void removeOwner(const TextBuffer * a_Owner)
+	{
+		QMutexLocker lock(&m_Mtx);
+		auto itr = m_Index.lower_bound(Key(a_Owner, 0));
+		while ((itr != m_Index.end()) && (itr->first.first == a_Owner))
+		{
+			m_Size -= itr->second->m_Data->size();
+			m_Entries.erase(itr->second);
+			itr = m_Index.erase(itr);
+		}
+	}
+
+
+protected:
+
+	/** The maximum number of bytes of all the cached segments. */
+	static const size_t MAX_SIZE = 64 * 1024 * 1024;
+
+	/** The identification of a segment: owner and segment index. */
+	typedef std::pair<const TextBuffer *, size_t> Key;
+
+	/** A single cached segment. */
+	struct Entry
+	{
+		const TextBuffer * m_Owner;
+		size_t m_Index;
+		std::shared_ptr<const std::string> m_Data;
+	};
+
+
+	/** The mutex protecting all the member variables against multithreaded access. */
+	QMutex m_Mtx;
+
+	/** The cached segments, the most recently used first. */
+	std::list<Entry> m_Entries;
+
+	/** Map for quick lookup of the segments in m_Entries. */
+	std::map<Key, std::list<Entry>::iterator> m_Index;
+
+	/** The total number of bytes in all the cached segments. */
+	size_t m_Size;
+
+
+	SegmentCache():
+		m_Size(0)
+	{
+	}
+};
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// MappedTextBuffer:
+
+MappedTextBuffer::MappedTextBuffer(std::unique_ptr<QFile> && a_File, const uchar * a_Data, size_t a_Size):
+	m_File(std::move(a_File)),
+	m_Data(reinterpret_cast<const char *>(a_Data)),
+	m_Size(a_Size)
+{
+}
+
+
+
+
+
+MappedTextBuffer::~MappedTextBuffer()
+{
+	if (m_Data != nullptr)
+	{
+		m_File->unmap(const_cast<uchar *>(reinterpret_cast<const uchar *>(m_Data)));
+	}
+}
+
+
+
+
+
+void MappedTextBuffer::prefetch(size_t a_MaxSize, const std::atomic<bool> & a_ShouldAbort) const
+{
+	auto size = std::min(a_MaxSize, m_Size);
+
+	#ifdef Q_OS_LINUX
+		// Tell the kernel the file is read sequentially and start reading it asynchronously:
+		auto fd = m_File->handle();
+		if (fd >= 0)
+		{
+			posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+			posix_fadvise(fd, 0, static_cast<off_t>(size), POSIX_FADV_WILLNEED);
+		}
+	#endif
+
+	// Touch each page of the mapping, so that it gets faulted in by this thread rather than by the parser:
+	static const size_t PAGE_SIZE = 4096;
+	static const size_t ABORT_CHECK_SPAN = 16 * 1024 * 1024;
+	auto data = reinterpret_cast<const volatile char *>(m_Data);
+	for (size_t pos = 0; pos < size; pos += PAGE_SIZE)
+	{
+		if (((pos % ABORT_CHECK_SPAN) == 0) && a_ShouldAbort.load())
+		{
+			return;
+		}
+		static_cast<void>(data[pos]);
+	}
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// BlockTextBuffer:
+
+const size_t BlockTextBuffer::BLOCK_SIZE;
+
+
+
+
+
+BlockTextBuffer::BlockTextBuffer():
+	m_Size(0)
+{
+}
+
+
+
+
+
+char * BlockTextBuffer::appendSpace(size_t & a_Available)
+{
+	auto used = m_Size % BLOCK_SIZE;
+	if ((used == 0) && (m_Size / BLOCK_SIZE == m_Blocks.size()))
+	{
+		// All blocks are full, add a new one:
+		m_Blocks.emplace_back(new char[BLOCK_SIZE]);
+	}
+	a_Available = BLOCK_SIZE - used;
+	return m_Blocks.back().get() + used;
+}
+
+
+
+
+
+void BlockTextBuffer::commit(size_t a_Size)
+{
+	assert(a_Size <= BLOCK_SIZE - m_Size % BLOCK_SIZE);
+	m_Size += a_Size;
+}
+
+
+
+
+
+void BlockTextBuffer::append(const char * a_Data, size_t a_Size)
+{
+	while (a_Size > 0)
+	{
+		size_t available;
+		auto dst = appendSpace(available);
+		auto len = std::min(a_Size, available);
+		memcpy(dst, a_Data, len);
+		commit(len);
+		a_Data += len;
+		a_Size -= len;
+	}
+}
+
+
+
+
+
+void BlockTextBuffer::shrinkToFit()
+{
+	auto used = m_Size % BLOCK_SIZE;
+	if (used == 0)
+	{
+		// The last block is full (or there's no block at all)
+		return;
+	}
+	std::unique_ptr<char[]> lastBlock(new char[used]);
+	memcpy(lastBlock.get(), m_Blocks.back().get(), used);
+	m_Blocks.back() = std::move(lastBlock);
+}
+
+
+
+
+
+const char * BlockTextBuffer::data() const
+{
+	if (m_Blocks.size() != 1)
+	{
+		// Either there is no data, or it is not contiguous:
+		return nullptr;
+	}
+	return m_Blocks[0].get();
+}
+
+
+
+
+
+const char * BlockTextBuffer::span(size_t a_Start, size_t a_Length, std::string & a_Helper) const
+{
+	assert(a_Start + a_Length <= m_Size);
+	if (a_Length == 0)
+	{
+		// The start may be at the end of the last block (or there may be no blocks at all):
+		a_Helper.clear();
+		return a_Helper.data();
+	}
+	auto blockIdx = a_Start / BLOCK_SIZE;
+	auto offset = a_Start % BLOCK_SIZE;
+	if (offset + a_Length <= BLOCK_SIZE)
+	{
+		// The whole span is within a single block:
+		return m_Blocks[blockIdx].get() + offset;
+	}
+
+	// The span crosses block boundaries, assemble it in the helper:
+	a_Helper.clear();
+	a_Helper.reserve(a_Length);
+	while (a_Length > 0)
+	{
+		auto len = std::min(a_Length, BLOCK_SIZE - offset);
+		a_Helper.append(m_Blocks[blockIdx].get() + offset, len);
+		a_Length -= len;
+		blockIdx += 1;
+		offset = 0;
+	}
+	return a_Helper.data();
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// AppendedTextBuffer:
+
+AppendedTextBuffer::AppendedTextBuffer(TextBufferPtr a_Base):
+	m_Base(a_Base)
+{
+}
+
+
+
+
+
+const char * AppendedTextBuffer::data() const
+{
+	if (m_Appended.size() > 0)
+	{
+		// The text is not contiguous
+		return nullptr;
+	}
+	return m_Base->data();
+}
+
+
+
+
+
+const char * AppendedTextBuffer::span(size_t a_Start, size_t a_Length, std::string & a_Helper) const
+{
+	auto baseSize = m_Base->size();
+	assert(a_Start + a_Length <= baseSize + m_Appended.size());
+	if (a_Start + a_Length <= baseSize)
+	{
+		return m_Base->span(a_Start, a_Length, a_Helper);
+	}
+	if (a_Start >= baseSize)
+	{
+		return m_Appended.span(a_Start - baseSize, a_Length, a_Helper);
+	}
+
+	// The span crosses the end of the base text, assemble it in the helper:
+	std::string partHelper;
+	auto baseLength = baseSize - a_Start;
+	a_Helper.assign(m_Base->span(a_Start, baseLength, partHelper), baseLength);
+	a_Helper.append(m_Appended.span(0, a_Length - baseLength, partHelper), a_Length - baseLength);
+	return a_Helper.data();
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// GZipIndexedTextBuffer:
+
+const size_t GZipIndexedTextBuffer::CHECKPOINT_SPAN;
+const size_t GZipIndexedTextBuffer::WINDOW_SIZE;
+
+
+
+
+
+GZipIndexedTextBuffer::GZipIndexedTextBuffer(TextBufferPtr a_CompressedData, bool a_IsRawDeflate):
+	m_CompressedData(a_CompressedData),
+	m_IsRawDeflate(a_IsRawDeflate),
+	m_Size(0),
+	m_IsComplete(false)
+{
+	assert(m_CompressedData->data() != nullptr);  // The compressed data needs to be contiguous
+}
+
+
+
+
+
+GZipIndexedTextBuffer::~GZipIndexedTextBuffer()
+{
+	SegmentCache::get().removeOwner(this);
+}
+
+
+
+
+
+void GZipIndexedTextBuffer::addMemberStartCheckpoint(size_t a_CompressedPos, size_t a_DecompressedPos)
+{
+	m_Checkpoints.push_back(Checkpoint{a_CompressedPos, 0, a_DecompressedPos, true, std::string()});
+}
+
+
+
+
+
+void GZipIndexedTextBuffer::addCheckpoint(
+	size_t a_CompressedPos, int a_Bits,
+	size_t a_DecompressedPos,
+	const char * a_Window, size_t a_WindowSize
+)
+{
+	assert(a_WindowSize <= WINDOW_SIZE);
+
+	// Compress the window, text compresses well and the window is otherwise the biggest memory hog of the index:
+	std::string compressedWindow;
+	auto compressedSize = compressBound(static_cast<uLong>(a_WindowSize));
+	compressedWindow.resize(compressedSize);
+	auto res = compress2(
+		reinterpret_cast<Bytef *>(&compressedWindow[0]), &compressedSize,
+		reinterpret_cast<const Bytef *>(a_Window), static_cast<uLong>(a_WindowSize),
+		Z_BEST_SPEED
+	);
+	if (res != Z_OK)
+	{
+		// Cannot compress the window, skip the checkpoint; the previous checkpoint's segment simply gets longer
+		qDebug("%s: Failed to compress the window: %d", __FUNCTION__, res);
+		return;
+	}
+	compressedWindow.resize(compressedSize);
+	m_Checkpoints.push_back(Checkpoint{a_CompressedPos, a_Bits, a_DecompressedPos, false, std::move(compressedWindow)});
+}
+
+
+
+
+
+size_t GZipIndexedTextBuffer::lastCheckpointPos() const
+{
+	if (m_Checkpoints.empty())
+	{
+		return 0;
+	}
+	return m_Checkpoints.back().m_DecompressedPos;
+}
+
+
+
+
+
+const char * GZipIndexedTextBuffer::span(size_t a_Start, size_t a_Length, std::string & a_Helper) const
+{
+	assert(a_Start + a_Length <= m_Size);
+	a_Helper.clear();
+	if ((a_Length == 0) || m_Checkpoints.empty())
+	{
+		a_Helper.resize(a_Length);
+		return a_Helper.data();
+	}
+	a_Helper.reserve(a_Length);
+
+	// Find the checkpoint preceding a_Start:
+	auto itr = std::upper_bound(m_Checkpoints.begin(), m_Checkpoints.end(), a_Start,
+		[](size_t a_Pos, const Checkpoint & a_Checkpoint)
+		{
+			return (a_Pos < a_Checkpoint.m_DecompressedPos);
+		}
+	);
+	assert(itr != m_Checkpoints.begin());
+	auto idx = static_cast<size_t>(itr - m_Checkpoints.begin()) - 1;
+
+	// Copy the data from the segment(s):
+	auto end = a_Start + a_Length;
+	while ((a_Start < end) && (idx < m_Checkpoints.size()))
+	{
+		auto segment = getSegment(idx);
+		auto offset = a_Start - m_Checkpoints[idx].m_DecompressedPos;
+		if (offset >= segment->size())
+		{
+			// Decompression failed
+			break;
+		}
+		auto len = std::min(end - a_Start, segment->size() - offset);
+		a_Helper.append(segment->data() + offset, len);
+		a_Start += len;
+		idx += 1;
+	}
+	a_Helper.resize(a_Length);  // In case of a decompression error, fill in zeroes
+	return a_Helper.data();
+}
+
+
+
+
+
+std::shared_ptr<const std::string> GZipIndexedTextBuffer::getSegment(size_t a_CheckpointIndex) const
+{
+	auto & cache = SegmentCache::get();
+	auto res = cache.find(this, a_CheckpointIndex);
+	if (res == nullptr)
+	{
+		res = std::make_shared<std::string>(decompressSegment(a_CheckpointIndex));
+
+		// The last segment ends at the current size until the data is complete, it would be cached truncated:
+		if (m_IsComplete || (a_CheckpointIndex + 1 < m_Checkpoints.size()))
+		{
+			cache.insert(this, a_CheckpointIndex, res);
+		}
+	}
+	return res;
+}
+
+
+
+
+
+std::string GZipIndexedTextBuffer::decompressSegment(size_t a_CheckpointIndex) const
+{
+	const auto & checkpoint = m_Checkpoints[a_CheckpointIndex];
+	auto segmentEnd = (a_CheckpointIndex + 1 < m_Checkpoints.size()) ? m_Checkpoints[a_CheckpointIndex + 1].m_DecompressedPos : m_Size;
+	std::string res;
+	res.resize(segmentEnd - checkpoint.m_DecompressedPos);
+	auto compressed = reinterpret_cast<const Bytef *>(m_CompressedData->data());
+	auto compressedSize = m_CompressedData->size();
+
+	// Initialize the decompression at the checkpoint:
+	z_stream zlibStream;
+	memset(&zlibStream, 0, sizeof(zlibStream));
+	if (checkpoint.m_IsMemberStart)
+	{
+		auto zr = inflateInit2(&zlibStream, m_IsRawDeflate ? -15 : 31);  // Force GZIP decoding, unless raw
+		if (zr != Z_OK)
+		{
+			qDebug("%s: uncompression initialization failed: %d.", __FUNCTION__, zr);
+			return std::string();
+		}
+	}
+	else
+	{
+		auto zr = inflateInit2(&zlibStream, -15);  // Raw deflate, the checkpoint is in the middle of the stream
+		if (zr != Z_OK)
+		{
+			qDebug("%s: uncompression initialization failed: %d.", __FUNCTION__, zr);
+			return std::string();
+		}
+		if (checkpoint.m_Bits > 0)
+		{
+			inflatePrime(&zlibStream, checkpoint.m_Bits, compressed[checkpoint.m_CompressedPos - 1] >> (8 - checkpoint.m_Bits));
+		}
+		Bytef window[WINDOW_SIZE];
+		uLongf windowSize = sizeof(window);
+		zr = uncompress(
+			window, &windowSize,
+			reinterpret_cast<const Bytef *>(checkpoint.m_CompressedWindow.data()),
+			static_cast<uLong>(checkpoint.m_CompressedWindow.size())
+		);
+		if (zr != Z_OK)
+		{
+			qDebug("%s: window decompression failed: %d.", __FUNCTION__, zr);
+			inflateEnd(&zlibStream);
+			return std::string();
+		}
+		inflateSetDictionary(&zlibStream, window, static_cast<uInt>(windowSize));
+	}
+
+	// Decompress the segment:
+	auto inPos = checkpoint.m_CompressedPos;
+	zlibStream.next_out = reinterpret_cast<Bytef *>(&res[0]);
+	zlibStream.avail_out = static_cast<uInt>(res.size());
+	while (zlibStream.avail_out > 0)
+	{
+		if ((zlibStream.avail_in == 0) && (inPos < compressedSize))
+		{
+			// Feed the input in pieces, avail_in is too small for huge files:
+			auto len = std::min<size_t>(compressedSize - inPos, 1024 * 1024 * 1024);
+			zlibStream.next_in = const_cast<Bytef *>(compressed + inPos);
+			zlibStream.avail_in = static_cast<uInt>(len);
+			inPos += len;
+		}
+		auto zr = inflate(&zlibStream, Z_NO_FLUSH);
+		if (zr == Z_STREAM_END)
+		{
+			break;
+		}
+		if (zr != Z_OK)
+		{
+			qDebug("%s: uncompression failed: %d (\"%s\").", __FUNCTION__, zr, zlibStream.msg);
+			break;
+		}
+	}
+	res.resize(res.size() - zlibStream.avail_out);
+	inflateEnd(&zlibStream);
+	return res;
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CompressedTextBuffer:
+
+const size_t CompressedTextBuffer::BLOCK_SIZE;
+
+
+
+
+
+CompressedTextBuffer::CompressedTextBuffer(const TextBuffer & a_Source):
+	m_Size(a_Source.size())
+{
+	// Use a single deflate stream for all the blocks, resetting it between them, to avoid re-allocating its state:
+	z_stream zlibStream;
+	memset(&zlibStream, 0, sizeof(zlibStream));
+	auto zr = deflateInit(&zlibStream, Z_BEST_SPEED);  // Logs compress well even on the fastest level
+	if (zr != Z_OK)
+	{
+		qDebug("%s: compression initialization failed: %d.", __FUNCTION__, zr);
+	}
+	auto maxCompressedSize = deflateBound(&zlibStream, BLOCK_SIZE);
+	std::string helper;
+	m_Blocks.reserve((m_Size + BLOCK_SIZE - 1) / BLOCK_SIZE);
+	for (size_t start = 0; start < m_Size; start += BLOCK_SIZE)
+	{
+		auto len = std::min(BLOCK_SIZE, m_Size - start);
+		auto src = a_Source.span(start, len, helper);
+		std::string block;
+		if (zr == Z_OK)
+		{
+			block.resize(maxCompressedSize);
+			deflateReset(&zlibStream);
+			zlibStream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(src));
+			zlibStream.avail_in = static_cast<uInt>(len);
+			zlibStream.next_out = reinterpret_cast<Bytef *>(&block[0]);
+			zlibStream.avail_out = static_cast<uInt>(block.size());
+			if (deflate(&zlibStream, Z_FINISH) == Z_STREAM_END)
+			{
+				block.resize(block.size() - zlibStream.avail_out);
+			}
+			else
+			{
+				block.clear();
+			}
+		}
+		if (block.empty() || (block.size() >= len))
+		{
+			// Cannot compress the block, or it doesn't compress, store it as-is (recognized by its size when decompressing):
+			block.assign(src, len);
+		}
+		else
+		{
+			block.shrink_to_fit();
+		}
+		m_Blocks.push_back(std::move(block));
+	}
+	if (zr == Z_OK)
+	{
+		deflateEnd(&zlibStream);
+	}
+}
+
+
+
+
+
+CompressedTextBuffer::~CompressedTextBuffer()
+{
+	SegmentCache::get().removeOwner(this);
+}
+
+
+
+
+
+size_t CompressedTextBuffer::compressedSize() const
+{
+	size_t res = 0;
+	for (const auto & block: m_Blocks)
+	{
+		res += block.size();
+	}
+	return res;
+}
+
+
+
+
+
+const char * CompressedTextBuffer::span(size_t a_Start, size_t a_Length, std::string & a_Helper) const
+{
+	assert(a_Start + a_Length <= m_Size);
+	a_Helper.clear();
+	a_Helper.reserve(a_Length);
+	auto blockIdx = a_Start / BLOCK_SIZE;
+	auto offset = a_Start % BLOCK_SIZE;
+	auto end = a_Start + a_Length;
+	while (a_Start < end)
+	{
+		auto block = getBlock(blockIdx);
+		if (offset >= block->size())
+		{
+			// Decompression failed
+			break;
+		}
+		auto len = std::min(end - a_Start, block->size() - offset);
+		a_Helper.append(block->data() + offset, len);
+		a_Start += len;
+		blockIdx += 1;
+		offset = 0;
+	}
+	a_Helper.resize(a_Length);  // In case of a decompression error, fill in zeroes
+	return a_Helper.data();
+}
+
+
+
+
+
+std::shared_ptr<const std::string> CompressedTextBuffer::getBlock(size_t a_BlockIndex) const
+{
+	auto & cache = SegmentCache::get();
+	auto res = cache.find(this, a_BlockIndex);
+	if (res != nullptr)
+	{
+		return res;
+	}
+
+	const auto & compressed = m_Blocks[a_BlockIndex];
+	auto blockSize = std::min(BLOCK_SIZE, m_Size - a_BlockIndex * BLOCK_SIZE);
+	std::shared_ptr<std::string> block;
+	if (compressed.size() == blockSize)
+	{
+		// The block is stored uncompressed:
+		block = std::make_shared<std::string>(compressed);
+	}
+	else
+	{
+		block = std::make_shared<std::string>();
+		block->resize(blockSize);
+		uLongf decompressedSize = static_cast<uLongf>(blockSize);
+		auto zr = uncompress(
+			reinterpret_cast<Bytef *>(&(*block)[0]), &decompressedSize,
+			reinterpret_cast<const Bytef *>(compressed.data()), static_cast<uLong>(compressed.size())
+		);
+		if (zr != Z_OK)
+		{
+			qDebug("%s: block decompression failed: %d.", __FUNCTION__, zr);
+			block->clear();
+		}
+	}
+	cache.insert(this, a_BlockIndex, block);
+	return block;
+}
@@ -0,0 +1,406 @@
+// TextBuffer.h
+
+// Declares the TextBuffer class and its descendants, representing the storage for a LogFile's complete text
+
+
+
+
+
+#ifndef TEXTBUFFER_H
+#define TEXTBUFFER_H
+
+
+
+
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <QFile>
+
+
+
+
+
+/** Interface for the storage of the complete text of a single log file.
+The LogFile messages contain indices into this text. */
+class TextBuffer
+{
+public:
+	virtual ~TextBuffer() {}
+
+	/** Returns the pointer to the beginning of the text.
+	May return nullptr if the text is empty, or if it is not stored contiguously (use span() then). */
+	virtual const char * data() const = 0;
+
+	/** Returns the size of the text, in bytes. */
+	virtual size_t size() const = 0;
+
+	/** Returns the pointer to the specified part of the text, as a contiguous block of memory.
+	If the part is not stored contiguously, it is assembled in a_Helper and the returned pointer points into it.
+	The returned pointer is valid until a_Helper is modified. */
+	virtual const char * span(size_t a_Start, size_t a_Length, std::string & a_Helper) const
+	{
+		Q_UNUSED(a_Length);
+		Q_UNUSED(a_Helper);
+		return data() + a_Start;
+	}
+
+	/** Returns true if the text is kept in memory compressed (and so there's no point in compressing it again). */
+	virtual bool isCompressed() const { return false; }
+
+	/** Makes sure that (up to) the first a_MaxSize bytes of the text are in memory, blocking until they are.
+	Used for reading the data ahead of the parser in a separate thread, so that the parser doesn't wait for the disk.
+	Returns early if a_ShouldAbort becomes true. The default does nothing, the data is already in memory. */
+	virtual void prefetch(size_t a_MaxSize, const std::atomic<bool> & a_ShouldAbort) const
+	{
+		Q_UNUSED(a_MaxSize);
+		Q_UNUSED(a_ShouldAbort);
+	}
+};
+
+typedef std::shared_ptr<TextBuffer> TextBufferPtr;
+
+
+
+
+
+/** TextBuffer that owns its text in a std::string.
+Used for data that doesn't exist on the disk as-is (decompressed data etc.). */
+class StringTextBuffer:
+	public TextBuffer
+{
+public:
+	explicit StringTextBuffer(std::string && a_Text):
+		m_Text(std::move(a_Text))
+	{
+	}
+
+	// TextBuffer overrides:
+	virtual const char * data() const override { return m_Text.data(); }
+	virtual size_t size() const override { return m_Text.size(); }
+
+
+protected:
+
+	/** The stored text. */
+	std::string m_Text;
+};
+
+
+
+
+
+/** TextBuffer that represents a part of another TextBuffer, keeping the other one alive.
+Used for the individual entries of archives, without copying their data.
+The part is contiguous only if the parent is contiguous. */
+class SubTextBuffer:
+	public TextBuffer
+{
+public:
+	/** Creates a new instance representing a_Size bytes of a_Parent, starting at a_Start.
+	The parent may still be growing (while decompressing), the part needs to be present only once it is accessed. */
+	SubTextBuffer(TextBufferPtr a_Parent, size_t a_Start, size_t a_Size):
+		m_Parent(a_Parent),
+		m_Start(a_Start),
+		m_Size(a_Size)
+	{
+	}
+
+	// TextBuffer overrides:
+	virtual const char * data() const override
+	{
+		auto parentData = m_Parent->data();
+		return (parentData == nullptr) ? nullptr : parentData + m_Start;
+	}
+
+	virtual size_t size() const override { return m_Size; }
+
+	virtual const char * span(size_t a_Start, size_t a_Length, std::string & a_Helper) const override
+	{
+		return m_Parent->span(m_Start + a_Start, a_Length, a_Helper);
+	}
+
+	virtual bool isCompressed() const override { return m_Parent->isCompressed(); }
+
+
+protected:
+
+	/** The TextBuffer whose part this instance represents. */
+	TextBufferPtr m_Parent;
+
+	/** The position of the represented part in m_Parent. */
+	size_t m_Start;
+
+	/** Size of the represented part, in bytes. */
+	size_t m_Size;
+};
+
+
+
+
+
+/** TextBuffer that uses a read-only memory-mapping of a disk file.
+The data is not copied into the process' heap, the OS can drop the pages under memory pressure
+and read them back from the disk when needed. */
+class MappedTextBuffer:
+	public TextBuffer
+{
+public:
+	/** Creates a new instance that takes ownership of the specified (opened) file and its mapping.
+	a_Data is the mapping of the entire file, as returned by QFile::map(). */
+	MappedTextBuffer(std::unique_ptr<QFile> && a_File, const uchar * a_Data, size_t a_Size);
+
+	virtual ~MappedTextBuffer() override;
+
+	// TextBuffer overrides:
+	virtual const char * data() const override { return m_Data; }
+	virtual size_t size() const override { return m_Size; }
+	virtual void prefetch(size_t a_MaxSize, const std::atomic<bool> & a_ShouldAbort) const override;
+
+
+protected:
+
+	/** The file that is mapped.
+	Needs to be kept open for the entire lifetime of the mapping. */
+	std::unique_ptr<QFile> m_File;
+
+	/** The mapped data. */
+	const char * m_Data;
+
+	/** Size of the mapped data, in bytes. */
+	size_t m_Size;
+};
+
+
+
+
+
+/** TextBuffer that stores the text in fixed-size blocks, filled in sequentially.
+Used for data that is produced incrementally (decompression), so that the storage never needs to be
+reallocated and the already stored data can be processed while more data is being appended. */
+class BlockTextBuffer:
+	public TextBuffer
+{
+public:
+	/** The size of each individual block, in bytes. */
+	static const size_t BLOCK_SIZE = 1024 * 1024;
+
+
+	BlockTextBuffer();
+
+	/** Returns the pointer to the space where new data can be written, and sets a_Available to its size.
+	The space is always within a single block.
+	The data written there becomes part of the text only after a call to commit(). */
+	char * appendSpace(size_t & a_Available);
+
+	/** Appends the specified number of bytes, previously written into the space returned by appendSpace(). */
+	void commit(size_t a_Size);
+
+	/** Appends a copy of the specified data. */
+	void append(const char * a_Data, size_t a_Size);
+
+	/** Releases the unused space at the end of the last block.
+	To be called after all the data has been appended. */
+	void shrinkToFit();
+
+	// TextBuffer overrides:
+	virtual const char * data() const override;
+	virtual size_t size() const override { return m_Size; }
+	virtual const char * span(size_t a_Start, size_t a_Length, std::string & a_Helper) const override;
+
+
+protected:
+
+	/** The blocks of data. All blocks but the last are full (BLOCK_SIZE bytes). */
+	std::vector<std::unique_ptr<char[]>> m_Blocks;
+
+	/** The total number of bytes stored in all m_Blocks. */
+	size_t m_Size;
+};
+
+
+
+
+
+/** TextBuffer consisting of the whole text of another TextBuffer, followed by the data appended later.
+Used for the log files that keep growing while being followed (FileFollower): the originally parsed text stays
+where it is, the data appended to the file since then is stored in blocks. */
+class AppendedTextBuffer:
+	public TextBuffer
+{
+public:
+	/** Creates a new instance that starts with the whole text of a_Base. */
+	explicit AppendedTextBuffer(TextBufferPtr a_Base);
+
+	/** Appends a copy of the specified data. */
+	void append(const char * a_Data, size_t a_Size) { m_Appended.append(a_Data, a_Size); }
+
+	// TextBuffer overrides:
+	virtual const char * data() const override;
+	virtual size_t size() const override { return m_Base->size() + m_Appended.size(); }
+	virtual const char * span(size_t a_Start, size_t a_Length, std::string & a_Helper) const override;
+	virtual bool isCompressed() const override { return m_Base->isCompressed(); }
+
+
+protected:
+
+	/** The text that precedes the appended data. */
+	TextBufferPtr m_Base;
+
+	/** The data appended after m_Base. */
+	BlockTextBuffer m_Appended;
+};
+
+
+
+
+
+/** TextBuffer that keeps the GZIP-compressed (or raw deflate) data and decompresses only the parts that are requested.
+An index of checkpoints into the compressed data is built while the data is first decompressed (and parsed);
+each checkpoint stores the state needed for restarting the decompression at that point (the bit position
+and the preceding 32 KiB window). Requesting a span of the text decompresses the segment between the two
+checkpoints surrounding it; the decompressed segments are kept in a bounded cache shared by all instances. */
+class GZipIndexedTextBuffer:
+	public TextBuffer
+{
+public:
+	/** The (minimum) distance between two consecutive checkpoints, in bytes of the decompressed data. */
+	static const size_t CHECKPOINT_SPAN = 1024 * 1024;
+
+	/** The size of the deflate window that needs to be stored for each checkpoint. */
+	static const size_t WINDOW_SIZE = 32 * 1024;
+
+
+	/** Creates a new instance that decompresses from the specified GZIP data.
+	If a_IsRawDeflate is true, the data is a raw deflate stream without any GZIP headers (ZIP archive entries).
+	The index is empty, it needs to be filled using addCheckpoint() while decompressing the data for the first time. */
+	explicit GZipIndexedTextBuffer(TextBufferPtr a_CompressedData, bool a_IsRawDeflate = false);
+
+	virtual ~GZipIndexedTextBuffer() override;
+
+	/** Adds a checkpoint at the start of a GZIP member or of the raw deflate stream (no window needed, the decompression restarts from scratch). */
+	void addMemberStartCheckpoint(size_t a_CompressedPos, size_t a_DecompressedPos);
+
+	/** Adds a checkpoint at a deflate block boundary inside a GZIP member.
+	a_CompressedPos is the position of the first full byte of the next block in the compressed data, a_Bits is the number
+	of bits of the next block present in the preceding byte (inflate's data_type & 7).
+	a_Window points to the data immediately preceding a_DecompressedPos, up to WINDOW_SIZE bytes. */
+	void addCheckpoint(
+		size_t a_CompressedPos, int a_Bits,
+		size_t a_DecompressedPos,
+		const char * a_Window, size_t a_WindowSize
+	);
+
+	/** Returns the decompressed position of the last checkpoint, or 0 if there is none. */
+	size_t lastCheckpointPos() const;
+
+	/** Sets the size of the decompressed data. Called while decompressing for the first time. */
+	void setSize(size_t a_Size) { m_Size = a_Size; }
+
+	/** Marks the decompressed data as complete, setSize() won't be called anymore.
+	Until then, the last segment may still grow, so it is not cached. */
+	void setComplete() { m_IsComplete = true; }
+
+	// TextBuffer overrides:
+	virtual const char * data() const override { return nullptr; }
+	virtual size_t size() const override { return m_Size; }
+	virtual const char * span(size_t a_Start, size_t a_Length, std::string & a_Helper) const override;
+	virtual bool isCompressed() const override { return true; }
+
+
+protected:
+
+	/** A single point in the compressed data where the decompression can be restarted. */
+	struct Checkpoint
+	{
+		/** Position in the compressed data. */
+		size_t m_CompressedPos;
+
+		/** Number of bits of the next block that are in the byte preceding m_CompressedPos. */
+		int m_Bits;
+
+		/** Position in the decompressed data. */
+		size_t m_DecompressedPos;
+
+		/** If true, the checkpoint is at the start of a GZIP member, no window or bits are used. */
+		bool m_IsMemberStart;
+
+		/** The deflate window preceding this checkpoint, compressed using zlib to save memory. */
+		std::string m_CompressedWindow;
+	};
+
+
+	/** The complete compressed data. */
+	TextBufferPtr m_CompressedData;
+
+	/** If true, m_CompressedData is a raw deflate stream instead of GZIP. */
+	bool m_IsRawDeflate;
+
+	/** The checkpoints, sorted by their position. */
+	std::vector<Checkpoint> m_Checkpoints;
+
+	/** The size of the decompressed data. */
+	size_t m_Size;
+
+	/** True once the decompressed data is complete (setComplete()). */
+	bool m_IsComplete;
+
+
+	/** Returns the decompressed data of the segment starting at the specified checkpoint, using the cache. */
+	std::shared_ptr<const std::string> getSegment(size_t a_CheckpointIndex) const;
+
+	/** Decompresses the data of the segment starting at the specified checkpoint. */
+	std::string decompressSegment(size_t a_CheckpointIndex) const;
+};
+
+
+
+
+
+/** TextBuffer that keeps the text compressed in independent fixed-size blocks.
+Each block is compressed separately using zlib, so any part of the text can be decompressed without touching
+the rest of it. The decompressed blocks are kept in the same bounded cache as GZipIndexedTextBuffer's segments. */
+class CompressedTextBuffer:
+	public TextBuffer
+{
+public:
+	/** The size of each individual block of the uncompressed text, in bytes. */
+	static const size_t BLOCK_SIZE = 64 * 1024;
+
+
+	/** Creates a new instance containing the compressed copy of the specified text. */
+	explicit CompressedTextBuffer(const TextBuffer & a_Source);
+
+	virtual ~CompressedTextBuffer() override;
+
+	/** Returns the total size of the compressed blocks, in bytes. */
+	size_t compressedSize() const;
+
+	// TextBuffer overrides:
+	virtual const char * data() const override { return nullptr; }
+	virtual size_t size() const override { return m_Size; }
+	virtual const char * span(size_t a_Start, size_t a_Length, std::string & a_Helper) const override;
+	virtual bool isCompressed() const override { return true; }
+
+
+protected:
+
+	/** The compressed blocks. All blocks but the last one contain BLOCK_SIZE bytes of the text when decompressed. */
+	std::vector<std::string> m_Blocks;
+
+	/** The size of the uncompressed text. */
+	size_t m_Size;
+
+
+	/** Returns the decompressed data of the specified block, using the cache. */
+	std::shared_ptr<const std::string> getBlock(size_t a_BlockIndex) const;
+};
+
+
+
+
+
+#endif // TEXTBUFFER_H
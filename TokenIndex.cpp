@@ -0,0 +1,321 @@
+// TokenIndex.cpp
+
+// Implements the LogToken struct representing an identifier found in the message texts, and the TokenIndex class
+// representing the session-wide index of the messages containing each identifier
+
+
+
+
+
+#include "TokenIndex.h"
+#include <assert.h>
+#include <algorithm>
+#include <string>
+#include "LogFile.h"
+#include "Simd.h"
+
+
+
+
+
+const int LogToken::MIN_HEX_DIGITS;
+const int LogToken::MAX_HEX_DIGITS;
+const int LogToken::MIN_RUN_DIGITS;
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// LogToken:
+
+/** Returns the token's hex digits, lowercase, without any formatting. */
+static std::string hexDigits(const LogToken & a_Token)
+{
+	static const char digits[] = "0123456789abcdef";
+	std::string res;
+	res.reserve(static_cast<size_t>(a_Token.m_NumDigits));
+	for (int i = a_Token.m_NumDigits - 1; i >= 0; --i)
+	{
+		auto value = (i >= 16) ? a_Token.m_High : a_Token.m_Low;
+		res.push_back(digits[(value >> (4 * (i % 16))) & 0x0f]);
+	}
+	return res;
+}
+
+
+
+
+
+/** Returns the token's hex digits formatted for display; a 32-digit token is formatted as a UUID. */
+static std::string formatToken(const LogToken & a_Token)
+{
+	auto res = hexDigits(a_Token);
+	if (a_Token.m_NumDigits == 32)
+	{
+		// 8-4-4-4-12:
+		res.insert(20, 1, '-');
+		res.insert(16, 1, '-');
+		res.insert(12, 1, '-');
+		res.insert(8, 1, '-');
+	}
+	return res;
+}
+
+
+
+
+
+QString LogToken::toString() const
+{
+	return QString::fromStdString(formatToken(*this));
+}
+
+
+
+
+
+bool LogToken::parse(const QString & a_Text, LogToken & a_Token)
+{
+	auto text = a_Text.trimmed().toLower().toStdString();
+	if (text.compare(0, 2, "0x") == 0)
+	{
+		text.erase(0, 2);
+	}
+
+	// Use the same scanner as the parsers, so that only what would be a token in the messages is accepted:
+	int numTokens = 0;
+	scan(text.data(), text.data() + text.size(), [&](const LogToken & a_Found)
+		{
+			a_Token = a_Found;
+			numTokens += 1;
+		}
+	);
+
+	// The token needs to be the whole text:
+	return (numTokens == 1) && ((text == hexDigits(a_Token)) || (text == formatToken(a_Token)));
+}
+
+
+
+
+
+const char * LogToken::findHexRun(const char * a_Begin, const char * a_End)
+{
+	auto p = a_Begin;
+	#ifdef HAS_SSE2
+		// Bit N of runs is set if the MIN_RUN_DIGITS bytes from N on are all hex digits. Only the first NUM_STARTS
+		// positions have all their bytes within the 32 checked ones, the next 32 bytes are checked from the one after:
+		static const int NUM_STARTS = 32 - MIN_RUN_DIGITS + 1;
+		while (a_End - p >= 32)
+		{
+			auto runs = hexDigitMask(p) | (hexDigitMask(p + 16) << 16);
+			runs &= runs >> 1;
+			runs &= runs >> 2;
+			runs &= runs >> 4;
+			runs &= (1u << NUM_STARTS) - 1;
+			if (runs != 0)
+			{
+				return p + lowestSetBit(runs);
+			}
+			p += NUM_STARTS;
+		}
+	#endif
+	int runLength = 0;
+	for (; p < a_End; ++p)
+	{
+		if (hexValue(*p) < 0)
+		{
+			runLength = 0;
+			continue;
+		}
+		runLength += 1;
+		if (runLength == MIN_RUN_DIGITS)
+		{
+			return p - (MIN_RUN_DIGITS - 1);
+		}
+	}
+	return a_End;
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// TokenIndex:
+
+TokenIndex::TokenIndex():
+	m_NumRemovedLogFiles(0)
+{
+}
+
+
+
+
+
+void TokenIndex::addLogFile(LogFile & a_LogFile)
+{
+	auto itr = m_FileStates.find(&a_LogFile);
+	if (itr == m_FileStates.end())
+	{
+		FileState state = {static_cast<quint32>(m_LogFiles.size()), 0};
+		itr = m_FileStates.insert({&a_LogFile, state}).first;
+		m_LogFiles.push_back(&a_LogFile);
+	}
+	auto & state = itr->second;
+
+	// Index the occurrences published since the last time:
+	const auto & occurrences = a_LogFile.tokenOccurrences();
+	auto count = occurrences.publishedSize();
+	for (auto i = state.m_NumIndexedOccurrences; i < count; ++i)
+	{
+		const auto & occurrence = occurrences[i];
+		assert(occurrence.m_MessageIndex <= 0xffffffffu);
+		auto messageIndex = static_cast<quint32>(occurrence.m_MessageIndex);
+		auto & postings = m_Postings[occurrence.m_Token];
+		if (
+			!postings.empty() &&
+			(postings.back().m_FileIndex == state.m_FileIndex) &&
+			(postings.back().m_MessageIndex == messageIndex)
+		)
+		{
+			// The token is repeated within the same message
+			continue;
+		}
+		postings.push_back({state.m_FileIndex, messageIndex});
+	}
+	state.m_NumIndexedOccurrences = count;
+}
+
+
+
+
+
+void TokenIndex::removeLogFile(const LogFile * a_LogFile)
+{
+	auto itr = m_FileStates.find(a_LogFile);
+	if (itr == m_FileStates.end())
+	{
+		return;
+	}
+	m_LogFiles[itr->second.m_FileIndex] = nullptr;
+	m_FileStates.erase(itr);
+	m_NumRemovedLogFiles += 1;
+
+	// Drop the dead postings once they are likely to be the majority:
+	if (m_NumRemovedLogFiles * 2 > m_LogFiles.size())
+	{
+		compact();
+	}
+}
+
+
+
+
+
+std::vector<std::pair<LogFile *, size_t>> TokenIndex::find(const LogToken & a_Token) const
+{
+	std::vector<std::pair<LogFile *, size_t>> res;
+	auto itr = m_Postings.find(a_Token);
+	if (itr == m_Postings.end())
+	{
+		return res;
+	}
+
+	// The postings of a single file are already in ascending order, only the files may interleave (following):
+	auto postings = itr->second;
+	std::stable_sort(postings.begin(), postings.end(), [](const Posting & a_Posting1, const Posting & a_Posting2)
+		{
+			return (a_Posting1.m_FileIndex < a_Posting2.m_FileIndex);
+		}
+	);
+	res.reserve(postings.size());
+	for (const auto & posting: postings)
+	{
+		auto logFile = m_LogFiles[posting.m_FileIndex];
+		if (logFile == nullptr)
+		{
+			continue;
+		}
+		if (!res.empty() && (res.back().first == logFile) && (res.back().second >= posting.m_MessageIndex))
+		{
+			// A message re-parsed after taking back an incomplete line
+			continue;
+		}
+		res.emplace_back(logFile, posting.m_MessageIndex);
+	}
+	return res;
+}
+
+
+
+
+
+std::vector<size_t> TokenIndex::find(const LogToken & a_Token, const LogFile * a_LogFile) const
+{
+	std::vector<size_t> res;
+	auto itr = m_Postings.find(a_Token);
+	auto fileItr = m_FileStates.find(a_LogFile);
+	if ((itr == m_Postings.end()) || (fileItr == m_FileStates.end()))
+	{
+		return res;
+	}
+	auto fileIndex = fileItr->second.m_FileIndex;
+	for (const auto & posting: itr->second)
+	{
+		if ((posting.m_FileIndex == fileIndex) && (res.empty() || (res.back() < posting.m_MessageIndex)))
+		{
+			res.push_back(posting.m_MessageIndex);
+		}
+	}
+	return res;
+}
+
+
+
+
+
+void TokenIndex::compact()
+{
+	// Renumber the live files:
+	std::vector<quint32> newIndices(m_LogFiles.size(), 0);
+	std::vector<LogFile *> liveFiles;
+	for (size_t i = 0; i < m_LogFiles.size(); ++i)
+	{
+		if (m_LogFiles[i] != nullptr)
+		{
+			newIndices[i] = static_cast<quint32>(liveFiles.size());
+			liveFiles.push_back(m_LogFiles[i]);
+		}
+	}
+	for (auto & state: m_FileStates)
+	{
+		state.second.m_FileIndex = newIndices[state.second.m_FileIndex];
+	}
+
+	// Drop the dead postings, and the tokens left without any:
+	for (auto itr = m_Postings.begin(); itr != m_Postings.end();)
+	{
+		auto & postings = itr->second;
+		size_t numLive = 0;
+		for (const auto & posting: postings)
+		{
+			if (m_LogFiles[posting.m_FileIndex] != nullptr)
+			{
+				postings[numLive] = {newIndices[posting.m_FileIndex], posting.m_MessageIndex};
+				numLive += 1;
+			}
+		}
+		if (numLive == 0)
+		{
+			itr = m_Postings.erase(itr);
+			continue;
+		}
+		postings.resize(numLive);
+		postings.shrink_to_fit();
+		++itr;
+	}
+	m_LogFiles = std::move(liveFiles);
+	m_NumRemovedLogFiles = 0;
+}
@@ -0,0 +1,272 @@
+// TokenIndex.h
+
+// Declares the LogToken struct representing an identifier found in the message texts, and the TokenIndex class
+// representing the session-wide index of the messages containing each identifier
+
+
+
+
+
+#ifndef TOKENINDEX_H
+#define TOKENINDEX_H
+
+
+
+
+
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <QString>
+
+
+
+
+
+// fwd:
+class LogFile;
+
+
+
+
+
+/** An identifier found in a message text that can be used for correlating the messages across the log files:
+a UUID ("0f8fad5b-d9cb-469f-a165-70867728950e") or a long hex number (MIN_HEX_DIGITS to MAX_HEX_DIGITS digits).
+Stored in a compact canonical form, the value of its hex digits and their count, so that the letter case
+and the UUID dashes don't matter. */
+struct LogToken
+{
+	/** The range of the number of hex digits of a token.
+	The shorter hex numbers (thread IDs, addresses, error codes) are too common to identify anything. */
+	static const int MIN_HEX_DIGITS = 16;
+	static const int MAX_HEX_DIGITS = 32;
+
+	/** Every token contains a run of at least this many hex digits (a long hex number, or the first group of a UUID).
+	The scan skips the text without such a run at once. */
+	static const int MIN_RUN_DIGITS = 8;
+
+	/** The value of the hex digits, the lowest 16 digits in m_Low. */
+	quint64 m_High, m_Low;
+
+	/** The number of hex digits, including the leading zeroes. */
+	int m_NumDigits;
+
+
+	bool operator == (const LogToken & a_Other) const
+	{
+		return (m_Low == a_Other.m_Low) && (m_High == a_Other.m_High) && (m_NumDigits == a_Other.m_NumDigits);
+	}
+
+
+	/** Hash function for the unordered containers. */
+	struct Hash
+	{
+		size_t operator () (const LogToken & a_Token) const
+		{
+			auto h = a_Token.m_Low ^ ((a_Token.m_High + static_cast<quint64>(a_Token.m_NumDigits)) * 0x9e3779b97f4a7c15ULL);
+			h ^= h >> 29;
+			h *= 0xbf58476d1ce4e5b9ULL;
+			h ^= h >> 32;
+			return static_cast<size_t>(h);
+		}
+	};
+
+
+	/** Returns the token as lowercase hex digits; a 32-digit token is formatted as a UUID. */
+	QString toString() const;
+
+	/** Parses the token from the specified text (a UUID or a hex number), ignoring the surrounding whitespace.
+	Returns true on success, false if the text is not a valid token. */
+	static bool parse(const QString & a_Text, LogToken & a_Token);
+
+	/** Calls a_Callback(const LogToken &) for each token found in the text from a_Begin to a_End.
+	A token needs to be a whole word, a part of a longer alphanumeric word is not a token.
+	Used by the parsers on each line, so it skips straight to the runs of MIN_RUN_DIGITS hex digits (findHexRun())
+	and looks only at the words containing them, each character only once. */
+	template <typename Callback>
+	static void scan(const char * a_Begin, const char * a_End, Callback a_Callback)
+	{
+		auto p = a_Begin;
+		while (p < a_End)
+		{
+			// Find the next run, go back to the start of its word (the words before p have been processed already):
+			auto run = findHexRun(p, a_End);
+			if (run == a_End)
+			{
+				return;
+			}
+			while ((run > p) && isWordChar(run[-1]))
+			{
+				--run;
+			}
+			p = run;
+
+			// A word starts at p, skip the "0x" prefix of a hex number:
+			if ((*p == '0') && (p + 2 < a_End) && ((p[1] == 'x') || (p[1] == 'X')) && (hexValue(p[2]) >= 0))
+			{
+				p += 2;
+			}
+
+			// Accumulate the word's hex digits, allowing the dashes only where a UUID has them:
+			LogToken token = {0, 0, 0};
+			int numDashes = 0;
+			while (p < a_End)
+			{
+				auto digit = hexValue(*p);
+				if (digit >= 0)
+				{
+					token.m_High = (token.m_High << 4) | (token.m_Low >> 60);
+					token.m_Low = (token.m_Low << 4) | static_cast<quint64>(digit);
+					token.m_NumDigits += 1;
+					++p;
+					continue;
+				}
+				if (
+					(*p == '-') &&
+					(token.m_NumDigits == 8 + 4 * numDashes) &&
+					(numDashes < 4) &&
+					(p + 1 < a_End) &&
+					(hexValue(p[1]) >= 0)
+				)
+				{
+					numDashes += 1;
+					++p;
+					continue;
+				}
+				break;
+			}
+
+			// The token needs to end the word:
+			if ((p < a_End) && isWordChar(*p))
+			{
+				while ((p < a_End) && isWordChar(*p))
+				{
+					++p;
+				}
+				continue;
+			}
+			if (numDashes > 0)
+			{
+				if ((numDashes == 4) && (token.m_NumDigits == 32))
+				{
+					a_Callback(token);
+				}
+			}
+			else if ((token.m_NumDigits >= MIN_HEX_DIGITS) && (token.m_NumDigits <= MAX_HEX_DIGITS))
+			{
+				a_Callback(token);
+			}
+		}
+	}
+
+
+protected:
+
+	/** Returns the start of the first run of MIN_RUN_DIGITS hex digits in the text from a_Begin to a_End,
+	or a_End if there is none. Checks 32 bytes at a time using SSE2, where available. */
+	static const char * findHexRun(const char * a_Begin, const char * a_End);
+
+	/** Returns true if the character can be a part of a word (an identifier). */
+	static bool isWordChar(char a_Char)
+	{
+		return (
+			((a_Char >= '0') && (a_Char <= '9')) ||
+			((a_Char >= 'a') && (a_Char <= 'z')) ||
+			((a_Char >= 'A') && (a_Char <= 'Z')) ||
+			(a_Char == '_')
+		);
+	}
+
+	/** Returns the value of the hex digit, or -1 if the character is not a hex digit. */
+	static int hexValue(char a_Char)
+	{
+		if ((a_Char >= '0') && (a_Char <= '9'))
+		{
+			return a_Char - '0';
+		}
+		if ((a_Char >= 'a') && (a_Char <= 'f'))
+		{
+			return a_Char - 'a' + 10;
+		}
+		if ((a_Char >= 'A') && (a_Char <= 'F'))
+		{
+			return a_Char - 'A' + 10;
+		}
+		return -1;
+	}
+};
+
+
+
+
+
+/** Session-wide index of the messages containing each LogToken, so that all the messages related to an identifier
+can be found across all the log files without scanning their texts.
+The tokens are found by the parsers while scanning the lines (LogFile::tokenOccurrences()); the index only takes over
+the published occurrences. Each token maps to a compact posting list of (file, message index) pairs.
+Not thread-safe, used from the UI thread only (owned by Session). */
+class TokenIndex
+{
+public:
+
+	/** A single message containing a token. */
+	struct Posting
+	{
+		quint32 m_FileIndex;  // Index into m_LogFiles
+		quint32 m_MessageIndex;
+	};
+
+
+	TokenIndex();
+
+	/** Adds the token occurrences of the LogFile published since the last call for the same file.
+	The file is registered on the first call. */
+	void addLogFile(LogFile & a_LogFile);
+
+	/** Removes the LogFile from the index. Its postings are skipped and eventually dropped by compaction. */
+	void removeLogFile(const LogFile * a_LogFile);
+
+	/** Returns the messages containing the token, as (LogFile, message index) pairs, without duplicates,
+	grouped by the LogFile and sorted by the message index within each file. */
+	std::vector<std::pair<LogFile *, size_t>> find(const LogToken & a_Token) const;
+
+	/** Returns the indices of the specified file's messages containing the token, sorted, without duplicates. */
+	std::vector<size_t> find(const LogToken & a_Token, const LogFile * a_LogFile) const;
+
+	/** Returns the number of distinct tokens in the index. */
+	size_t numTokens() const { return m_Postings.size(); }
+
+
+protected:
+
+	/** The indexing state of a single LogFile. */
+	struct FileState
+	{
+		quint32 m_FileIndex;  // Index into m_LogFiles
+		size_t m_NumIndexedOccurrences;  // The number of the file's token occurrences already in the index
+	};
+
+
+	/** The postings of each token, in the order in which they were indexed. */
+	std::unordered_map<LogToken, std::vector<Posting>, LogToken::Hash> m_Postings;
+
+	/** The indexed LogFiles, indexed by Posting::m_FileIndex; nullptr for the removed ones. */
+	std::vector<LogFile *> m_LogFiles;
+
+	/** The state of each indexed LogFile. */
+	std::map<const LogFile *, FileState> m_FileStates;
+
+	/** The number of nullptr items in m_LogFiles. */
+	size_t m_NumRemovedLogFiles;
+
+
+	/** Drops the postings of the removed LogFiles and renumbers the rest. */
+	void compact();
+};
+
+
+
+
+
+#endif // TOKENINDEX_H
@@ -0,0 +1,246 @@
+// ZipArchive.cpp
+
+// Implements the ZipArchive class representing the directory of a ZIP archive and access to its entries
+
+
+
+
+
+#include "ZipArchive.h"
+#include <assert.h>
+#include <algorithm>
+#include "Exceptions.h"
+
+
+
+
+
+/** Signatures of the ZIP records. */
+static const quint32 SIG_LOCAL_HEADER = 0x04034b50;
+static const quint32 SIG_CENTRAL_DIR_HEADER = 0x02014b50;
+static const quint32 SIG_END_OF_CENTRAL_DIR = 0x06054b50;
+static const quint32 SIG_ZIP64_END_OF_CENTRAL_DIR = 0x06064b50;
+static const quint32 SIG_ZIP64_END_OF_CENTRAL_DIR_LOCATOR = 0x07064b50;
+
+/** Sizes of the fixed parts of the ZIP records. */
+static const size_t LOCAL_HEADER_SIZE = 30;
+static const size_t CENTRAL_DIR_HEADER_SIZE = 46;
+static const size_t END_OF_CENTRAL_DIR_SIZE = 22;
+static const size_t ZIP64_END_OF_CENTRAL_DIR_SIZE = 56;
+static const size_t ZIP64_END_OF_CENTRAL_DIR_LOCATOR_SIZE = 20;
+
+/** The ID of the extra field carrying the ZIP64 sizes and offsets. */
+static const quint16 ZIP64_EXTRA_FIELD_ID = 0x0001;
+
+
+
+
+
+/** Reads a little-endian 16-bit value. */
+static quint16 readLE16(const char * a_Data)
+{
+	auto d = reinterpret_cast<const unsigned char *>(a_Data);
+	return static_cast<quint16>(d[0] | (d[1] << 8));
+}
+
+
+
+
+
+/** Reads a little-endian 32-bit value. */
+static quint32 readLE32(const char * a_Data)
+{
+	auto d = reinterpret_cast<const unsigned char *>(a_Data);
+	return
+		static_cast<quint32>(d[0]) |
+		(static_cast<quint32>(d[1]) << 8) |
+		(static_cast<quint32>(d[2]) << 16) |
+		(static_cast<quint32>(d[3]) << 24);
+}
+
+
+
+
+
+/** Reads a little-endian 64-bit value. */
+static quint64 readLE64(const char * a_Data)
+{
+	return static_cast<quint64>(readLE32(a_Data)) | (static_cast<quint64>(readLE32(a_Data + 4)) << 32);
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// ZipArchive:
+
+ZipArchive::ZipArchive(TextBufferPtr a_Data):
+	m_Data(a_Data)
+{
+	assert(m_Data->data() != nullptr);  // The archive data needs to be contiguous
+
+	quint64 dirOffset, dirSize, numEntries;
+	readEndOfCentralDirectory(dirOffset, dirSize, numEntries);
+	readCentralDirectory(dirOffset, dirSize, numEntries);
+}
+
+
+
+
+
+bool ZipArchive::hasZipSignature(const char * a_Data, size_t a_Size)
+{
+	return (
+		(a_Size >= 4) &&
+		((readLE32(a_Data) == SIG_LOCAL_HEADER) || (readLE32(a_Data) == SIG_END_OF_CENTRAL_DIR))  // Empty archive has only the EOCD
+	);
+}
+
+
+
+
+
+TextBufferPtr ZipArchive::entryData(const Entry & a_Entry) const
+{
+	auto data = m_Data->data();
+	auto size = m_Data->size();
+	if (
+		(size < LOCAL_HEADER_SIZE) ||
+		(a_Entry.m_LocalHeaderOffset > size - LOCAL_HEADER_SIZE) ||
+		(readLE32(data + a_Entry.m_LocalHeaderOffset) != SIG_LOCAL_HEADER)
+	)
+	{
+		throw EFileReadError(__FILE__, __LINE__);
+	}
+
+	// The local header has its own name and extra field lengths, which may differ from the central directory:
+	auto header = data + a_Entry.m_LocalHeaderOffset;
+	auto start = a_Entry.m_LocalHeaderOffset + LOCAL_HEADER_SIZE + readLE16(header + 26) + readLE16(header + 28);
+	if ((start > size) || (a_Entry.m_CompressedSize > size - start))
+	{
+		throw EFileReadError(__FILE__, __LINE__);
+	}
+	return std::make_shared<SubTextBuffer>(m_Data, static_cast<size_t>(start), static_cast<size_t>(a_Entry.m_CompressedSize));
+}
+
+
+
+
+
+void ZipArchive::readEndOfCentralDirectory(quint64 & a_DirOffset, quint64 & a_DirSize, quint64 & a_NumEntries) const
+{
+	// Search for the EOCD signature from the end, the record can be followed by a comment of up to 64 KiB:
+	auto data = m_Data->data();
+	auto size = m_Data->size();
+	if (size < END_OF_CENTRAL_DIR_SIZE)
+	{
+		throw EFileReadError(__FILE__, __LINE__);
+	}
+	auto minPos = (size > END_OF_CENTRAL_DIR_SIZE + 65535) ? size - END_OF_CENTRAL_DIR_SIZE - 65535 : 0;
+	auto pos = size - END_OF_CENTRAL_DIR_SIZE;
+	while (readLE32(data + pos) != SIG_END_OF_CENTRAL_DIR)
+	{
+		if (pos == minPos)
+		{
+			throw EFileReadError(__FILE__, __LINE__);
+		}
+		pos -= 1;
+	}
+	auto eocd = data + pos;
+	a_NumEntries = readLE16(eocd + 10);
+	a_DirSize = readLE32(eocd + 12);
+	a_DirOffset = readLE32(eocd + 16);
+
+	// If the archive is ZIP64, the real values are in the ZIP64 EOCD record, pointed to by the locator preceding the EOCD:
+	if (
+		(pos >= ZIP64_END_OF_CENTRAL_DIR_LOCATOR_SIZE) &&
+		(readLE32(eocd - ZIP64_END_OF_CENTRAL_DIR_LOCATOR_SIZE) == SIG_ZIP64_END_OF_CENTRAL_DIR_LOCATOR)
+	)
+	{
+		auto zip64EocdPos = readLE64(eocd - ZIP64_END_OF_CENTRAL_DIR_LOCATOR_SIZE + 8);
+		if (
+			(size < ZIP64_END_OF_CENTRAL_DIR_SIZE) ||
+			(zip64EocdPos > size - ZIP64_END_OF_CENTRAL_DIR_SIZE) ||
+			(readLE32(data + zip64EocdPos) != SIG_ZIP64_END_OF_CENTRAL_DIR)
+		)
+		{
+			throw EFileReadError(__FILE__, __LINE__);
+		}
+		auto zip64Eocd = data + zip64EocdPos;
+		a_NumEntries = readLE64(zip64Eocd + 32);
+		a_DirSize = readLE64(zip64Eocd + 40);
+		a_DirOffset = readLE64(zip64Eocd + 48);
+	}
+
+	if ((a_DirOffset > size) || (a_DirSize > size - a_DirOffset))
+	{
+		throw EFileReadError(__FILE__, __LINE__);
+	}
+}
+
+
+
+
+
+void ZipArchive::readCentralDirectory(quint64 a_DirOffset, quint64 a_DirSize, quint64 a_NumEntries)
+{
+	auto data = m_Data->data() + a_DirOffset;
+	auto end = data + a_DirSize;
+	m_Entries.reserve(static_cast<size_t>(std::min<quint64>(a_NumEntries, a_DirSize / CENTRAL_DIR_HEADER_SIZE)));
+	for (quint64 i = 0; i < a_NumEntries; i++)
+	{
+		if (
+			(static_cast<size_t>(end - data) < CENTRAL_DIR_HEADER_SIZE) ||
+			(readLE32(data) != SIG_CENTRAL_DIR_HEADER)
+		)
+		{
+			throw EFileReadError(__FILE__, __LINE__);
+		}
+		auto flags = readLE16(data + 8);
+		auto nameLength = readLE16(data + 28);
+		auto extraLength = readLE16(data + 30);
+		auto commentLength = readLE16(data + 32);
+		auto recordSize = CENTRAL_DIR_HEADER_SIZE + nameLength + extraLength + commentLength;
+		if (static_cast<size_t>(end - data) < recordSize)
+		{
+			throw EFileReadError(__FILE__, __LINE__);
+		}
+
+		Entry entry;
+		auto name = data + CENTRAL_DIR_HEADER_SIZE;
+		entry.m_FileName = ((flags & 0x0800) != 0) ? QString::fromUtf8(name, nameLength) : QString::fromLatin1(name, nameLength);
+		entry.m_CompressionMethod = readLE16(data + 10);
+		entry.m_IsEncrypted = ((flags & 0x0001) != 0);
+		entry.m_CompressedSize = readLE32(data + 20);
+		entry.m_UncompressedSize = readLE32(data + 24);
+		entry.m_LocalHeaderOffset = readLE32(data + 42);
+
+		// The values that don't fit into 32 bits are in the ZIP64 extra field, in this order, only if needed:
+		auto extra = name + nameLength;
+		auto extraEnd = extra + extraLength;
+		while (extraEnd - extra >= 4)
+		{
+			auto id = readLE16(extra);
+			auto len = readLE16(extra + 2);
+			auto field = extra + 4;
+			extra = field + len;
+			if ((id != ZIP64_EXTRA_FIELD_ID) || (extra > extraEnd))
+			{
+				continue;
+			}
+			auto fieldEnd = extra;
+			for (auto value: {&entry.m_UncompressedSize, &entry.m_CompressedSize, &entry.m_LocalHeaderOffset})
+			{
+				if ((*value == 0xffffffff) && (fieldEnd - field >= 8))
+				{
+					*value = readLE64(field);
+					field += 8;
+				}
+			}
+		}
+
+		m_Entries.push_back(std::move(entry));
+		data += recordSize;
+	}
+}
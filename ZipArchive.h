@@ -0,0 +1,104 @@
+// ZipArchive.h
+
+// Declares the ZipArchive class representing the directory of a ZIP archive and access to its entries
+
+
+
+
+
+#ifndef ZIPARCHIVE_H
+#define ZIPARCHIVE_H
+
+
+
+
+
+#include <memory>
+#include <vector>
+
+#include <QString>
+#include "TextBuffer.h"
+
+
+
+
+
+/** Reads the central directory of a ZIP archive and provides access to the (still compressed) data of its entries.
+The archive data needs to be contiguous in memory (typically a memory-mapped file); the entries reference it without copying.
+Supports ZIP64 archives. Only the "stored" and "deflate" compression methods are supported for the entries. */
+class ZipArchive
+{
+public:
+
+	/** The compression methods of the entries. */
+	enum CompressionMethod
+	{
+		cmStored = 0,
+		cmDeflate = 8,
+	};
+
+
+	/** A single entry (file) in the archive, as described by the central directory. */
+	struct Entry
+	{
+		/** The name (path) of the file inside the archive. */
+		QString m_FileName;
+
+		/** The compression method, as stored in the archive (see CompressionMethod). */
+		int m_CompressionMethod;
+
+		/** If true, the entry is encrypted and cannot be read. */
+		bool m_IsEncrypted;
+
+		/** Size of the entry's data in the archive, in bytes. */
+		quint64 m_CompressedSize;
+
+		/** Size of the entry's data after decompression, in bytes. */
+		quint64 m_UncompressedSize;
+
+		/** Position of the entry's local header in the archive. */
+		quint64 m_LocalHeaderOffset;
+	};
+
+
+	/** Reads the central directory of the specified archive data.
+	Throws an EFileReadError if the data is not a valid ZIP archive. */
+	explicit ZipArchive(TextBufferPtr a_Data);
+
+	/** Returns true if the data starts with a ZIP signature. */
+	static bool hasZipSignature(const char * a_Data, size_t a_Size);
+
+	/** Returns all the entries in the archive, in the order of the central directory. */
+	const std::vector<Entry> & entries() const { return m_Entries; }
+
+	/** Returns the data of the specified entry, as stored in the archive (possibly compressed).
+	Throws an EFileReadError if the entry's local header is invalid. */
+	TextBufferPtr entryData(const Entry & a_Entry) const;
+
+
+protected:
+
+	/** The complete archive data. */
+	TextBufferPtr m_Data;
+
+	/** The entries read from the central directory. */
+	std::vector<Entry> m_Entries;
+
+
+	/** Finds and reads the end-of-central-directory records, returns the position and size of the central directory
+	and the number of its entries.
+	Throws an EFileReadError if not found or invalid. */
+	void readEndOfCentralDirectory(quint64 & a_DirOffset, quint64 & a_DirSize, quint64 & a_NumEntries) const;
+
+	/** Reads the central directory at the specified position into m_Entries.
+	Throws an EFileReadError if invalid. */
+	void readCentralDirectory(quint64 a_DirOffset, quint64 a_DirSize, quint64 a_NumEntries);
+};
+
+typedef std::shared_ptr<ZipArchive> ZipArchivePtr;
+
+
+
+
+
+#endif // ZIPARCHIVE_H
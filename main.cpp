@@ -20,10 +20,36 @@ int main(int argc, char *argv[])
 	w.showMaximized();
 
 	// Command line:
-	// EraLogVis -f <folder1> -f <folder2> <file1> <file2> -f <folder3> ...
+	// EraLogVis [-z] [-l] [-t] -f <folder1> -f <folder2> <file1> <file2> -f <folder3> -w <folder4> ...
+	// -z keeps the text of the files listed after it compressed in memory
+	// -l parses the files listed after it lazily, decoding the message headers only once needed
+	// -t follows all the files, the lines appended to them are parsed and shown as they come (implies no -l)
+	// -w watches the folder, the new and changed log files in it are parsed and the removed ones are dropped
 	auto & backgroundParser = w.getBackgroundParser();
 	for (int i = 1; i < argc; i++)
 	{
+		// Following decides how the files are read, so it must be set before any file is added:
+		if (strcmp(argv[i], "-t") == 0)
+		{
+			backgroundParser.setShouldFollowFiles(true);
+		}
+	}
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-z") == 0)
+		{
+			backgroundParser.setShouldCompressText(true);
+			continue;
+		}
+		if (strcmp(argv[i], "-l") == 0)
+		{
+			backgroundParser.setShouldParseLazily(true);
+			continue;
+		}
+		if (strcmp(argv[i], "-t") == 0)
+		{
+			continue;
+		}
 		if (strcmp(argv[i], "-f") == 0)
 		{
 			if (i < argc - 1)
@@ -33,6 +59,15 @@ int main(int argc, char *argv[])
 			i += 1;
 			continue;
 		}
+		if (strcmp(argv[i], "-w") == 0)
+		{
+			if (i < argc - 1)
+			{
+				w.getFolderWatcher().watch(QString::fromUtf8(argv[i + 1]));
+			}
+			i += 1;
+			continue;
+		}
 		backgroundParser.addFile(QString::fromUtf8(argv[i]));
 	}
 